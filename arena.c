@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 1994, 1995, 1996, 1997, 1998, 1999, 2000, 2001,
+ *               2002, 2003, 2004
+ *      Ohio University.
+ *
+ * ---
+ *
+ * Starting with the release of tcptrace version 6 in 2001, tcptrace
+ * is licensed under the GNU General Public License (GPL).  We believe
+ * that, among the available licenses, the GPL will do the best job of
+ * allowing tcptrace to continue to be a valuable, freely-available
+ * and well-maintained tool for the networking community.
+ *
+ * Previous versions of tcptrace were released under a license that
+ * was much less restrictive with respect to how tcptrace could be
+ * used in commercial products.  Because of this, I am willing to
+ * consider alternate license arrangements as allowed in Section 10 of
+ * the GNU GPL.  Before I would consider licensing tcptrace under an
+ * alternate agreement with a particular individual or company,
+ * however, I would have to be convinced that such an alternative
+ * would be to the greater benefit of the networking community.
+ * 
+ * ---
+ *
+ * This file is part of Tcptrace.
+ *
+ * Tcptrace was originally written and continues to be maintained by
+ * Shawn Ostermann with the help of a group of devoted students and
+ * users (see the file 'THANKS').  The work on tcptrace has been made
+ * possible over the years through the generous support of NASA GRC,
+ * the National Science Foundation, and Sun Microsystems.
+ *
+ * Tcptrace is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tcptrace is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tcptrace (in the file 'COPYING'); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ * Author:      Shawn Ostermann
+ *              School of Electrical Engineering and Computer Science
+ *              Ohio University
+ *              Athens, OH
+ *              http://www.tcptrace.org/
+ */
+#include "tcptrace.h"
+static char const GCC_UNUSED copyright[] =
+    "@(#)Copyright (c) 2004 -- Ohio University.\n";
+static char const GCC_UNUSED rcsid[] =
+    "@(#)$Header$";
+
+
+/*
+ * arena.c -- bump allocation for memory with a common lifetime
+ *
+ * Lots of little things (host names, letters, sequence spaces, module
+ * records) are created along with a connection and never freed until
+ * the connection itself goes away, if it ever does.  Rather than a
+ * malloc() and free() for each of them, they're carved out of an
+ * arena: a list of big chunks handed out by bumping a pointer, all of
+ * which are released together by ArenaFree().
+ *
+ * There's one arena for everything that lives for the whole run (see
+ * RunAlloc()), and real-time mode gives each connection an arena of
+ * its own, which goes away when the connection is removed.
+ */
+
+/* everything handed out is aligned this well */
+#define ARENA_ALIGN	8
+#define ARENA_ROUND(n)	(((n) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+/* chunk size for the run-lifetime arena */
+#define RUN_CHUNK_SIZE	(64*1024)
+
+struct arena_chunk {
+  struct arena_chunk	*next;		/* older chunks */
+  unsigned		size;		/* bytes of data space */
+  unsigned		used;		/* bytes handed out so far */
+};
+
+/* the arena header lives at the front of its first chunk */
+struct arena {
+  struct arena_chunk	*chunks;	/* newest chunk first */
+  unsigned		chunk_size;	/* data space in a new chunk */
+  unsigned long		total;		/* bytes malloc()ed for the chunks */
+};
+
+#define CHUNK_HDR	ARENA_ROUND(sizeof(struct arena_chunk))
+#define ARENA_HDR	ARENA_ROUND(sizeof(struct arena))
+#define CHUNK_DATA(pc)	((char *)(pc) + CHUNK_HDR)
+
+/* global variables */
+static arena	*run_arena = NULL;	/* lives until we exit */
+static unsigned long	arena_bytes = 0; /* malloc()ed by all live arenas */
+
+/* local routines */
+static struct arena_chunk *ArenaNewChunk(const unsigned);
+
+
+
+/*
+ * ArenaNewChunk - allocate a chunk with room for size bytes of data
+ */
+static struct arena_chunk *
+ArenaNewChunk(
+	      const unsigned size)
+{
+  struct arena_chunk	*pc;
+
+  pc = (struct arena_chunk *)malloc(CHUNK_HDR + size);
+  if (pc == NULL) {
+    fprintf(stderr, "ArenaNewChunk: cannot allocate %u bytes: ", size);
+    fprintf(stderr, "malloc failed\n");
+    exit(1);
+  }
+  pc->next = NULL;
+  pc->size = size;
+  pc->used = 0;
+
+  return pc;
+}
+
+/*
+ * ArenaCreate - make a new arena that grows chunk_size bytes at a time.
+ *		The arena header itself uses the start of the first chunk,
+ *		so an arena that never outgrows it costs one malloc().
+ */
+arena *
+ArenaCreate(
+	    const unsigned chunk_size)
+{
+  struct arena_chunk	*pc;
+  arena			*pa;
+
+  pc = ArenaNewChunk(ARENA_ROUND(chunk_size));
+  pa = (arena *)CHUNK_DATA(pc);
+  pc->used = ARENA_HDR;
+
+  pa->chunks = pc;
+  pa->chunk_size = ARENA_ROUND(chunk_size);
+  pa->total = CHUNK_HDR + pa->chunk_size;
+  arena_bytes += pa->total;
+
+  return pa;
+}
+
+/*
+ * ArenaAlloc - give out bytes of zeroed memory from the arena
+ */
+void *
+ArenaAlloc(
+	   arena *pa,
+	   const unsigned bytes)
+{
+  struct arena_chunk	*pc = pa->chunks;
+  unsigned		need = ARENA_ROUND(bytes);
+  void			*ptr;
+
+  if (pc->used + need > pc->size) {
+    if (need > pa->chunk_size / 4) {
+      /* big ones get a chunk to themselves, behind the current one */
+      /* (so the space left in the current one isn't wasted) */
+      struct arena_chunk *pbig = ArenaNewChunk(need);
+
+      pbig->next = pc->next;
+      pc->next = pbig;
+      pbig->used = need;
+      pa->total += CHUNK_HDR + need;
+      arena_bytes += CHUNK_HDR + need;
+      memset(CHUNK_DATA(pbig), '\00', need);
+      return CHUNK_DATA(pbig);
+    }
+
+    /* start a new chunk */
+    pc = ArenaNewChunk(pa->chunk_size);
+    pc->next = pa->chunks;
+    pa->chunks = pc;
+    pa->total += CHUNK_HDR + pa->chunk_size;
+    arena_bytes += CHUNK_HDR + pa->chunk_size;
+  }
+
+  ptr = CHUNK_DATA(pc) + pc->used;
+  pc->used += need;
+  memset(ptr, '\00', need);
+
+  return ptr;
+}
+
+/*
+ * ArenaStrdup - copy a string into the arena
+ */
+char *
+ArenaStrdup(
+	    arena *pa,
+	    const char *str)
+{
+  unsigned	len = strlen(str) + 1;
+  char		*ptr;
+
+  ptr = ArenaAlloc(pa, len);
+  memcpy(ptr, (char *)str, len);
+
+  return ptr;
+}
+
+/*
+ * ArenaFree - give back everything in the arena, including the arena
+ */
+void
+ArenaFree(
+	  arena *pa)
+{
+  struct arena_chunk	*pc;
+  struct arena_chunk	*next;
+
+  if (pa == NULL)
+    return;
+
+  arena_bytes -= pa->total;
+
+  /* the one holding the arena header is last, so this is safe */
+  for (pc = pa->chunks; pc != NULL; pc = next) {
+    next = pc->next;
+    free(pc);
+  }
+}
+
+/*
+ * RunAlloc - give out zeroed memory that's never freed
+ */
+void *
+RunAlloc(
+	 const unsigned bytes)
+{
+  if (run_arena == NULL)
+    run_arena = ArenaCreate(RUN_CHUNK_SIZE);
+
+  return ArenaAlloc(run_arena, bytes);
+}
+
+/*
+ * RunStrdup - copy a string that's never freed
+ */
+char *
+RunStrdup(
+	  const char *str)
+{
+  if (run_arena == NULL)
+    run_arena = ArenaCreate(RUN_CHUNK_SIZE);
+
+  return ArenaStrdup(run_arena, str);
+}
+
+/*
+ * ArenaBytes - how much memory the arenas are holding, not counting
+ *		the one for things that live until we exit
+ */
+unsigned long
+ArenaBytes(
+	   void)
+{
+  if (run_arena == NULL)
+    return arena_bytes;
+
+  return arena_bytes - run_arena->total;
+}
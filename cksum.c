@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 1994, 1995, 1996, 1997, 1998, 1999, 2000, 2001,
+ *               2002, 2003, 2004
+ *      Ohio University.
+ *
+ * ---
+ *
+ * Starting with the release of tcptrace version 6 in 2001, tcptrace
+ * is licensed under the GNU General Public License (GPL).  We believe
+ * that, among the available licenses, the GPL will do the best job of
+ * allowing tcptrace to continue to be a valuable, freely-available
+ * and well-maintained tool for the networking community.
+ *
+ * Previous versions of tcptrace were released under a license that
+ * was much less restrictive with respect to how tcptrace could be
+ * used in commercial products.  Because of this, I am willing to
+ * consider alternate license arrangements as allowed in Section 10 of
+ * the GNU GPL.  Before I would consider licensing tcptrace under an
+ * alternate agreement with a particular individual or company,
+ * however, I would have to be convinced that such an alternative
+ * would be to the greater benefit of the networking community.
+ * 
+ * ---
+ *
+ * This file is part of Tcptrace.
+ *
+ * Tcptrace was originally written and continues to be maintained by
+ * Shawn Ostermann with the help of a group of devoted students and
+ * users (see the file 'THANKS').  The work on tcptrace has been made
+ * possible over the years through the generous support of NASA GRC,
+ * the National Science Foundation, and Sun Microsystems.
+ *
+ * Tcptrace is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tcptrace is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tcptrace (in the file 'COPYING'); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ * Author:      Shawn Ostermann
+ *              School of Electrical Engineering and Computer Science
+ *              Ohio University
+ *              Athens, OH
+ *              http://www.tcptrace.org/
+ */
+#include "tcptrace.h"
+static char const GCC_UNUSED copyright[] =
+    "@(#)Copyright (c) 2004 -- Ohio University.\n";
+static char const GCC_UNUSED rcsid[] =
+    "@(#)$Header$";
+
+
+
+/*
+ * cksum.c -- Internet (one's complement) checksums
+ *
+ * The one's complement sum doesn't care about byte order: summing the
+ * data as native words of any (even) width and folding the result
+ * down to 16 bits gives the same answer as summing big-endian 16-bit
+ * words, just byte-swapped on a little-endian machine.  That lets us
+ * add a machine word (or a whole vector register) at a time instead
+ * of a byte pair at a time, which matters on jumbo frames.
+ *
+ * Every kernel returns the folded native-order sum of its buffer.
+ * OnesSum() picks the fastest kernel the CPU can run the first time
+ * it's called, and turns the result back into network order.
+ */
+
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__SSE2__)
+#define CKSUM_SSE2
+#include <emmintrin.h>
+#if (__GNUC__ >= 5) || defined(__clang__)
+#define CKSUM_AVX2
+#include <immintrin.h>
+#endif /* GCC 5 */
+#endif /* x86_64 */
+
+
+/* a fixed-size memcpy() is the portable way to load a word from any */
+/* alignment, and the compiler turns it into a single load -- but not */
+/* if it's tcptrace.h's byte-at-a-time MemCpy() */
+#undef memcpy
+
+/* below this, the scalar kernel is as good as any */
+#define CKSUM_SMALL	64
+
+
+/* fold a native-order sum of any width down to 16 bits */
+static u_short
+cksum_fold(
+    u_llong sum)
+{
+    while (sum >> 16)
+	sum = (sum & 0xffff) + (sum >> 16);
+    return((u_short)sum);
+}
+
+
+/*
+ * cksum_scalar - a word at a time, carries added back in as we go
+ */
+static u_short
+cksum_scalar(
+    void *pvoid,		/* any alignment is legal */
+    int nbytes)
+{
+    u_char *pchar = pvoid;
+    u_llong sum = 0;
+    u_llong word;
+
+    while (nbytes >= 4 * (int)sizeof(word)) {
+	/* memcpy() since we can't assume pointer alignment */
+	memcpy(&word, pchar, sizeof(word));
+	sum += word; sum += (sum < word);
+	memcpy(&word, pchar+sizeof(word), sizeof(word));
+	sum += word; sum += (sum < word);
+	memcpy(&word, pchar+2*sizeof(word), sizeof(word));
+	sum += word; sum += (sum < word);
+	memcpy(&word, pchar+3*sizeof(word), sizeof(word));
+	sum += word; sum += (sum < word);
+
+	pchar += 4*sizeof(word);
+	nbytes -= 4*sizeof(word);
+    }
+
+    while (nbytes >= (int)sizeof(word)) {
+	memcpy(&word, pchar, sizeof(word));
+	sum += word; sum += (sum < word);
+
+	pchar += sizeof(word);
+	nbytes -= sizeof(word);
+    }
+
+    /* whatever's left, padded out with zeros (including an odd byte) */
+    if (nbytes > 0) {
+	word = 0;
+	memcpy(&word, pchar, nbytes);
+	sum += word; sum += (sum < word);
+    }
+
+    return(cksum_fold(sum));
+}
+
+
+/* the scalar kernel always works */
+static Bool
+cksum_scalar_usable(void)
+{
+    return(TRUE);
+}
+
+
+#ifdef CKSUM_SSE2
+/*
+ * cksum_sse2 - 16 bytes at a time, each 16-bit word widened into one
+ * of four 32-bit lanes
+ */
+static u_short
+cksum_sse2(
+    void *pvoid,
+    int nbytes)
+{
+    u_char *pchar = pvoid;
+    __m128i zero = _mm_setzero_si128();
+    u_int lanes[4];
+    u_llong sum = 0;
+    int i;
+
+    while (nbytes >= 16) {
+	__m128i acc = zero;
+	/* each lane gains at most 2*0xffff per pass, so stop well */
+	/* short of 32 bits */
+	int passes = 16384;
+
+	for (; (nbytes >= 16) && (passes > 0); --passes) {
+	    __m128i v = _mm_loadu_si128((__m128i *)pchar);
+	    acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+	    acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(v, zero));
+	    pchar += 16;
+	    nbytes -= 16;
+	}
+
+	_mm_storeu_si128((__m128i *)lanes, acc);
+	for (i = 0; i < 4; ++i)
+	    sum += lanes[i];
+    }
+
+    /* the rest (still an even offset from the start) */
+    sum += cksum_scalar(pchar, nbytes);
+
+    return(cksum_fold(sum));
+}
+
+
+/* SSE2 is part of x86_64 */
+static Bool
+cksum_sse2_usable(void)
+{
+    return(TRUE);
+}
+#endif /* CKSUM_SSE2 */
+
+
+#ifdef CKSUM_AVX2
+/*
+ * cksum_avx2 - like cksum_sse2(), but 32 bytes at a time
+ */
+__attribute__((target("avx2")))
+static u_short
+cksum_avx2(
+    void *pvoid,
+    int nbytes)
+{
+    u_char *pchar = pvoid;
+    __m256i zero = _mm256_setzero_si256();
+    u_int lanes[8];
+    u_llong sum = 0;
+    int i;
+
+    while (nbytes >= 32) {
+	__m256i acc = zero;
+	int passes = 16384;
+
+	for (; (nbytes >= 32) && (passes > 0); --passes) {
+	    __m256i v = _mm256_loadu_si256((__m256i *)pchar);
+	    acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(v, zero));
+	    acc = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(v, zero));
+	    pchar += 32;
+	    nbytes -= 32;
+	}
+
+	_mm256_storeu_si256((__m256i *)lanes, acc);
+	for (i = 0; i < 8; ++i)
+	    sum += lanes[i];
+    }
+
+    sum += cksum_scalar(pchar, nbytes);
+
+    return(cksum_fold(sum));
+}
+
+
+static Bool
+cksum_avx2_usable(void)
+{
+    __builtin_cpu_init();
+    return(__builtin_cpu_supports("avx2") != 0);
+}
+#endif /* CKSUM_AVX2 */
+
+
+/* all the kernels, best first */
+struct cksum_kernel cksum_kernels[] = {
+#ifdef CKSUM_AVX2
+    {"avx2", cksum_avx2, cksum_avx2_usable},
+#endif /* CKSUM_AVX2 */
+#ifdef CKSUM_SSE2
+    {"sse2", cksum_sse2, cksum_sse2_usable},
+#endif /* CKSUM_SSE2 */
+    {"scalar", cksum_scalar, cksum_scalar_usable},
+    {NULL, NULL, NULL}
+};
+
+/* the one we're using, chosen on the first call */
+static u_short (*cksum_best)(void *pvoid, int nbytes) = NULL;
+
+
+
+/*
+ * OnesSum - Return the 16-bit ones complement sum of the buffer,
+ * treated as big-endian 16-bit words (an odd last byte is padded
+ * with a zero)
+ */
+u_short
+OnesSum(
+    void *pvoid,		/* any alignment is legal */
+    int nbytes)
+{
+    u_short sum;
+
+    if (nbytes < CKSUM_SMALL) {
+	sum = cksum_scalar(pvoid, nbytes);
+    } else {
+	if (cksum_best == NULL) {
+	    struct cksum_kernel *pck;
+
+	    for (pck = cksum_kernels; pck->name; ++pck) {
+		if ((*pck->usable)()) {
+		    cksum_best = pck->sum;
+		    break;
+		}
+	    }
+	}
+	sum = (*cksum_best)(pvoid, nbytes);
+    }
+
+    return(ntohs(sum));
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 1994, 1995, 1996, 1997, 1998, 1999, 2000, 2001,
+ *               2002, 2003, 2004
+ *      Ohio University.
+ *
+ * ---
+ *
+ * Starting with the release of tcptrace version 6 in 2001, tcptrace
+ * is licensed under the GNU General Public License (GPL).  We believe
+ * that, among the available licenses, the GPL will do the best job of
+ * allowing tcptrace to continue to be a valuable, freely-available
+ * and well-maintained tool for the networking community.
+ *
+ * Previous versions of tcptrace were released under a license that
+ * was much less restrictive with respect to how tcptrace could be
+ * used in commercial products.  Because of this, I am willing to
+ * consider alternate license arrangements as allowed in Section 10 of
+ * the GNU GPL.  Before I would consider licensing tcptrace under an
+ * alternate agreement with a particular individual or company,
+ * however, I would have to be convinced that such an alternative
+ * would be to the greater benefit of the networking community.
+ * 
+ * ---
+ *
+ * This file is part of Tcptrace.
+ *
+ * Tcptrace was originally written and continues to be maintained by
+ * Shawn Ostermann with the help of a group of devoted students and
+ * users (see the file 'THANKS').  The work on tcptrace has been made
+ * possible over the years through the generous support of NASA GRC,
+ * the National Science Foundation, and Sun Microsystems.
+ *
+ * Tcptrace is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tcptrace is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tcptrace (in the file 'COPYING'); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ * Author:      Shawn Ostermann
+ *              School of Electrical Engineering and Computer Science
+ *              Ohio University
+ *              Athens, OH
+ *              http://www.tcptrace.org/
+ */
+#include "tcptrace.h"
+static char const GCC_UNUSED copyright[] =
+    "@(#)Copyright (c) 2004 -- Ohio University.\n";
+static char const GCC_UNUSED rcsid[] =
+    "@(#)$Header$";
+
+
+
+/*
+ * cksumbench.c -- check and time the checksum kernels in cksum.c
+ *
+ * Every kernel this machine can run is checked against the original
+ * byte-pair-at-a-time sum over random data of many lengths and
+ * alignments, then timed on jumbo-frame sized buffers.
+ *
+ *	make cksumbench; ./cksumbench [iterations]
+ */
+
+#define BENCH_LEN	9000		/* a jumbo frame */
+#define BENCH_BUF	(IP_MAXPACKET + 64)
+
+
+/* the way tcptrace used to do it, the answer we must match */
+static u_short
+cksum_reference(
+    void *pvoid,
+    int nbytes)
+{
+    u_char *pchar = pvoid;
+    u_long sum = 0;
+
+    while (nbytes >= 2) {
+	sum += (pchar[0]<<8);
+	sum += pchar[1];
+
+	pchar+=2;
+	nbytes -= 2;
+    }
+
+    if (nbytes == 1)
+	sum += (pchar[0]<<8);
+
+    sum = (sum >> 16) + (sum & 0xffff);
+    sum += (sum >> 16);
+
+    return(sum);
+}
+
+
+/* microseconds spent summing the same buffer over and over */
+static double
+bench(
+    u_short (*sum)(void *, int),
+    u_char *buf,
+    int iters,
+    u_short *presult)
+{
+    struct timeval start, stop;
+    u_short result = 0;
+    int i;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < iters; ++i)
+	result ^= (*sum)(buf + (i & 7), BENCH_LEN);
+    gettimeofday(&stop, NULL);
+
+    *presult = result;
+    return((stop.tv_sec - start.tv_sec) * 1000000.0 +
+	   (stop.tv_usec - start.tv_usec));
+}
+
+
+int
+main(
+    int argc,
+    char *argv[])
+{
+    static int lens[] = {BENCH_LEN, 1500, 65535, BENCH_BUF - 64};
+    struct cksum_kernel *pck;
+    u_char *buf;
+    u_short result;
+    double usecs;
+    int iters = 100000;
+    int errors = 0;
+    int len, off, i;
+
+    if (argc > 1)
+	iters = atoi(argv[1]);
+
+    buf = malloc(BENCH_BUF);
+    srand(1);
+    for (i = 0; i < BENCH_BUF; ++i)
+	buf[i] = rand();
+
+    /* parity with the reference, every kernel that runs here */
+    for (pck = cksum_kernels; pck->name; ++pck) {
+	int checked = 0;
+
+	if (!(*pck->usable)()) {
+	    printf("%-8s not supported on this CPU\n", pck->name);
+	    continue;
+	}
+
+	for (off = 0; off < 8; ++off) {
+	    for (len = 0; len <= 4096 + (int)(sizeof(lens)/sizeof(int)); ++len) {
+		int n = (len <= 4096) ? len : lens[len - 4097];
+		u_short want = cksum_reference(buf+off, n);
+		u_short got = ntohs((*pck->sum)(buf+off, n));
+
+		/* and the dispatcher too, while we're at it */
+		if ((got != want) || (OnesSum(buf+off, n) != want)) {
+		    if (++errors <= 10)
+			printf("%-8s len %d offset %d: got 0x%04x, want 0x%04x\n",
+			       pck->name, n, off, got, want);
+		}
+		++checked;
+	    }
+	}
+	printf("%-8s %d buffers checked\n", pck->name, checked);
+    }
+
+    if (errors) {
+	printf("%d MISMATCHES\n", errors);
+	exit(1);
+    }
+
+    /* and how fast they are */
+    usecs = bench(cksum_reference, buf, iters, &result);
+    printf("%-8s %8.1f ns/packet %8.1f MB/s\n", "original",
+	   usecs * 1000.0 / iters, (double)BENCH_LEN * iters / usecs);
+    for (pck = cksum_kernels; pck->name; ++pck) {
+	if (!(*pck->usable)())
+	    continue;
+	usecs = bench(pck->sum, buf, iters, &result);
+	printf("%-8s %8.1f ns/packet %8.1f MB/s\n", pck->name,
+	       usecs * 1000.0 / iters, (double)BENCH_LEN * iters / usecs);
+    }
+
+    exit(0);
+}
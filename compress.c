@@ -52,6 +52,7 @@
  *		ostermann@cs.ohiou.edu
  *		http://www.tcptrace.org/
  */
+#define _GNU_SOURCE	/* for fopencookie() */
 #include "tcptrace.h"
 static char const GCC_UNUSED copyright[] =
     "@(#)Copyright (c) 2004 -- Ohio University.\n";
@@ -59,8 +60,27 @@ static char const GCC_UNUSED rcsid[] =
     "$Header$";
 
 
+/* we can decompress in-process if we have a library and a way */
+/* to make our own stdio streams */
+#if defined(USE_ZLIB) || defined(USE_BZLIB) || defined(USE_LZMA)
+#if defined(__GLIBC__)
+#define COMP_INPROCESS
+#define COMP_COOKIE_GLIBC
+#elif defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__) || defined(__APPLE__)
+#define COMP_INPROCESS
+#endif /* __GLIBC__ */
+#endif /* USE_ZLIB etc */
+
+/* and with threads, we can decompress the next files ahead of time */
+#if defined(COMP_INPROCESS) && defined(USE_THREADS)
+#define COMP_PREFETCH
+#include <pthread.h>
+#endif /* COMP_INPROCESS && USE_THREADS */
+
 #include "compress.h"
 #include <sys/wait.h>
+#include <fcntl.h>
+#include <errno.h>
 
 /*
  * OK, this stuff is a little complicated.  Here's why:
@@ -78,12 +98,17 @@ static char const GCC_UNUSED rcsid[] =
  *    that reads the rest of the header file and then starts reading
  *    the rest of the data from standard input.  It's slightly inefficient
  *    because of the extra process, but I don't know a way around...
+ *
+ * (All of that is only needed for formats that we have to hand to an
+ *  external program, see "In-process decompression" below.)
  */
 
 
 /* local routines */
 static char *FindBinary(char *binname);
 static struct comp_formats *WhichFormat(char *filename);
+static struct comp_formats *MagicFormat(char *buf, int len);
+static struct comp_formats *FileMagicFormat(char *filename);
 static FILE *CompSaveHeader(char *filename, struct comp_formats *pf);
 static int CompOpenPipe(char *filename, struct comp_formats *pf);
 static FILE *PipeHelper(void);
@@ -99,6 +124,889 @@ static char *tempfile;
 int posn;
 
 
+/*
+ * In-process decompression
+ *
+ * If we're linked with the compression libraries, we don't need any
+ * of the above.  We decompress the file ourselves, a block at a time,
+ * and hand the output to the readers through a stdio stream of our own
+ * making that we install as stdin.  While the readers are sniffing at
+ * the front of the file to figure out its type, we keep a copy of
+ * everything we've decompressed so far, so that they can seek back
+ * over it as often as they like.  Once the file type is known
+ * (CompOpenFile()), we stop saving and the rest just streams thru.
+ * No temp file, no second decompression, and no extra processes.
+ * Standard input is handled the same way (compressed or not), so we
+ * don't need the helper process for that either.
+ */
+#ifdef COMP_INPROCESS
+
+#define COMP_SRC_SIZE (64*1024)		/* compressed bytes read at a time */
+#define COMP_HDR_MAX (1024*1024)	/* most we'll save for re-reading */
+
+/* the compressed input */
+struct comp_src {
+    int		fd;
+    u_char	*buf;
+    u_int	len;		/* bytes in buf */
+    u_int	off;		/* bytes of buf already used */
+    u_long	total;		/* bytes read from fd so far */
+    Bool	eof;
+};
+
+/* a decompression library */
+struct comp_lib {
+    char	*lib_name;
+    void	*(*lib_open)(void);
+    /* returns bytes decompressed into buf, 0 at EOF, -1 on error */
+    int		(*lib_read)(void *state, struct comp_src *psrc,
+			    char *buf, int len);
+    void	(*lib_close)(void *state);
+};
+
+/* the decompressed output, as seen thru stdin */
+struct comp_stream {
+    struct comp_lib *plib;	/* NULL: not compressed, just copy */
+    void	*lib_state;
+    struct comp_src src;
+    char	*hdr;		/* saved copy of the front of the output */
+    u_long	hdr_len;
+    u_long	hdr_size;	/* space in hdr */
+    Bool	hdr_saving;	/* still saving the output? */
+    u_long	pos;		/* where the reader is */
+    u_long	out_pos;	/* how much we've decompressed */
+    struct prefetch *ppf;	/* being decompressed in the background */
+};
+
+static struct comp_stream *comp_active = NULL;
+static FILE *f_real_stdin = NULL;	/* while stdin is ours */
+
+
+
+/* make sure there's something left in the input buffer */
+/* returns the number of bytes available, 0 at EOF */
+static int
+CompSrcFill(
+    struct comp_src *psrc)
+{
+    int len;
+
+    if (psrc->off < psrc->len)
+	return(psrc->len - psrc->off);
+    if (psrc->eof)
+	return(0);
+
+    do {
+	len = read(psrc->fd, psrc->buf, COMP_SRC_SIZE);
+    } while ((len < 0) && (errno == EINTR));
+
+    if (len < 0) {
+	perror("read of compressed file");
+	len = 0;
+    }
+    if (len == 0)
+	psrc->eof = TRUE;
+
+    psrc->len = len;
+    psrc->off = 0;
+    psrc->total += len;
+
+    return(len);
+}
+
+
+
+/* make sure that at least "bytes" bytes are in the (empty) input buffer */
+/* (pipes hand us data in dribs and drabs) */
+static int
+CompSrcPeek(
+    struct comp_src *psrc,
+    int bytes)
+{
+    while (!psrc->eof && (psrc->len < bytes)) {
+	int len;
+
+	do {
+	    len = read(psrc->fd, psrc->buf + psrc->len,
+		       COMP_SRC_SIZE - psrc->len);
+	} while ((len < 0) && (errno == EINTR));
+
+	if (len <= 0) {
+	    if (len < 0)
+		perror("read of compressed file");
+	    psrc->eof = TRUE;
+	    break;
+	}
+	psrc->len += len;
+	psrc->total += len;
+    }
+
+    return(psrc->len);
+}
+
+
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+
+struct zlib_state {
+    z_stream	zs;
+    Bool	at_end;		/* between gzip members */
+    Bool	done;		/* ignoring trailing garbage */
+};
+
+static void *
+ZlibOpen(void)
+{
+    struct zlib_state *pzl = MallocZ(sizeof(struct zlib_state));
+
+    /* 15+32: any window size, gzip or zlib header */
+    if (inflateInit2(&pzl->zs, 15+32) != Z_OK) {
+	fprintf(stderr,"zlib: inflateInit failed\n");
+	exit(-1);
+    }
+
+    return(pzl);
+}
+
+
+static int
+ZlibRead(
+    void *state,
+    struct comp_src *psrc,
+    char *buf,
+    int len)
+{
+    struct zlib_state *pzl = state;
+    z_stream *pz = &pzl->zs;
+    int avail;
+    int ret;
+
+    pz->next_out = (Bytef *)buf;
+    pz->avail_out = len;
+
+    while (!pzl->done && (pz->avail_out == len)) {
+	if ((avail = CompSrcFill(psrc)) == 0) {
+	    if (!pzl->at_end)
+		fprintf(stderr,"gzip: unexpected end of file\n");
+	    break;
+	}
+	pz->next_in = psrc->buf + psrc->off;
+	pz->avail_in = avail;
+	ret = inflate(pz, Z_NO_FLUSH);
+	psrc->off += avail - pz->avail_in;
+
+	switch (ret) {
+	  case Z_STREAM_END:
+	    /* there might be another member after this one */
+	    inflateReset(pz);
+	    pzl->at_end = TRUE;
+	    break;
+	  case Z_OK:
+	  case Z_BUF_ERROR:
+	    pzl->at_end = FALSE;
+	    break;
+	  default:
+	    if (pzl->at_end) {
+		/* junk after the last member, gunzip ignores it too */
+		if (debug)
+		    fprintf(stderr,"gzip: trailing garbage ignored\n");
+		pzl->done = TRUE;
+		break;
+	    }
+	    fprintf(stderr,"gzip: %s\n", pz->msg?pz->msg:"bad compressed data");
+	    return(-1);
+	}
+    }
+
+    return(len - pz->avail_out);
+}
+
+
+static void
+ZlibClose(
+    void *state)
+{
+    struct zlib_state *pzl = state;
+
+    inflateEnd(&pzl->zs);
+    free(pzl);
+}
+
+
+struct comp_lib comp_lib_zlib = {"zlib", ZlibOpen, ZlibRead, ZlibClose};
+#endif /* USE_ZLIB */
+
+
+
+#ifdef USE_BZLIB
+#include <bzlib.h>
+
+struct bzlib_state {
+    bz_stream	bz;
+    Bool	at_end;		/* between bzip2 streams */
+    Bool	done;		/* ignoring trailing garbage */
+};
+
+static void *
+BzlibOpen(void)
+{
+    struct bzlib_state *pbz = MallocZ(sizeof(struct bzlib_state));
+
+    if (BZ2_bzDecompressInit(&pbz->bz, 0, 0) != BZ_OK) {
+	fprintf(stderr,"bzlib: BZ2_bzDecompressInit failed\n");
+	exit(-1);
+    }
+
+    return(pbz);
+}
+
+
+static int
+BzlibRead(
+    void *state,
+    struct comp_src *psrc,
+    char *buf,
+    int len)
+{
+    struct bzlib_state *pbz = state;
+    bz_stream *pb = &pbz->bz;
+    int avail;
+    int ret;
+
+    pb->next_out = buf;
+    pb->avail_out = len;
+
+    while (!pbz->done && (pb->avail_out == len)) {
+	if ((avail = CompSrcFill(psrc)) == 0) {
+	    if (!pbz->at_end)
+		fprintf(stderr,"bzip2: unexpected end of file\n");
+	    break;
+	}
+	pb->next_in = (char *)psrc->buf + psrc->off;
+	pb->avail_in = avail;
+	ret = BZ2_bzDecompress(pb);
+	psrc->off += avail - pb->avail_in;
+
+	switch (ret) {
+	  case BZ_STREAM_END:
+	    /* there might be another stream after this one */
+	    BZ2_bzDecompressEnd(pb);
+	    if (BZ2_bzDecompressInit(pb, 0, 0) != BZ_OK) {
+		fprintf(stderr,"bzlib: BZ2_bzDecompressInit failed\n");
+		exit(-1);
+	    }
+	    pbz->at_end = TRUE;
+	    break;
+	  case BZ_OK:
+	    pbz->at_end = FALSE;
+	    break;
+	  default:
+	    if (pbz->at_end) {
+		/* junk after the last stream, bunzip2 ignores it too */
+		if (debug)
+		    fprintf(stderr,"bzip2: trailing garbage ignored\n");
+		pbz->done = TRUE;
+		break;
+	    }
+	    fprintf(stderr,"bzip2: bad compressed data (error %d)\n", ret);
+	    return(-1);
+	}
+    }
+
+    return(len - pb->avail_out);
+}
+
+
+static void
+BzlibClose(
+    void *state)
+{
+    struct bzlib_state *pbz = state;
+
+    BZ2_bzDecompressEnd(&pbz->bz);
+    free(pbz);
+}
+
+
+struct comp_lib comp_lib_bzlib = {"bzlib", BzlibOpen, BzlibRead, BzlibClose};
+#endif /* USE_BZLIB */
+
+
+
+#ifdef USE_LZMA
+#include <lzma.h>
+
+struct lzma_state {
+    lzma_stream	ls;
+    Bool	done;
+};
+
+static void *
+LzmaOpen(void)
+{
+    struct lzma_state *plz = MallocZ(sizeof(struct lzma_state));
+    lzma_stream init = LZMA_STREAM_INIT;
+
+    plz->ls = init;
+    if (lzma_stream_decoder(&plz->ls, UINT64_MAX, LZMA_CONCATENATED)
+	!= LZMA_OK) {
+	fprintf(stderr,"lzma: lzma_stream_decoder failed\n");
+	exit(-1);
+    }
+
+    return(plz);
+}
+
+
+static int
+LzmaRead(
+    void *state,
+    struct comp_src *psrc,
+    char *buf,
+    int len)
+{
+    struct lzma_state *plz = state;
+    lzma_stream *pl = &plz->ls;
+    int avail;
+    lzma_ret ret;
+
+    pl->next_out = (uint8_t *)buf;
+    pl->avail_out = len;
+
+    while (!plz->done && (pl->avail_out == len)) {
+	avail = CompSrcFill(psrc);
+	pl->next_in = psrc->buf + psrc->off;
+	pl->avail_in = avail;
+	/* at EOF, tell it to wrap up */
+	ret = lzma_code(pl, (avail == 0)?LZMA_FINISH:LZMA_RUN);
+	psrc->off += avail - pl->avail_in;
+
+	if (ret == LZMA_STREAM_END) {
+	    plz->done = TRUE;
+	} else if ((ret != LZMA_OK) || (avail == 0)) {
+	    fprintf(stderr,"xz: %s (error %d)\n",
+		    (avail == 0)?"unexpected end of file":"bad compressed data",
+		    (int)ret);
+	    plz->done = TRUE;
+	    if (avail != 0)
+		return(-1);
+	}
+    }
+
+    return(len - pl->avail_out);
+}
+
+
+static void
+LzmaClose(
+    void *state)
+{
+    struct lzma_state *plz = state;
+
+    lzma_end(&plz->ls);
+    free(plz);
+}
+
+
+struct comp_lib comp_lib_lzma = {"liblzma", LzmaOpen, LzmaRead, LzmaClose};
+#endif /* USE_LZMA */
+
+
+
+#ifdef COMP_PREFETCH
+/*
+ * Prefetching
+ *
+ * With --readahead=N, the (library) decompression of the current file
+ * and the next N-1 on the command line runs in background threads.  Each
+ * thread decompresses its file into a list of chunks, stopping when
+ * PREFETCH_MAX bytes are waiting, and CompStreamProduce() takes the
+ * chunks off the list instead of running the decompressor itself.  The
+ * files are still analyzed one at a time, in order, so nothing else
+ * changes.
+ */
+#define PREFETCH_CHUNK (256*1024)	/* bytes per chunk */
+#define PREFETCH_MAX (16*1024*1024)	/* bytes waiting, per file */
+
+struct prefetch_chunk {
+    struct prefetch_chunk *next;
+    int		len;
+    int		off;		/* bytes already handed out */
+    char	data[PREFETCH_CHUNK];
+};
+
+struct prefetch {
+    char	*filename;
+    struct comp_formats *pf;
+    Bool	claimed;	/* has CompOpenStream() taken it? */
+    pthread_t	thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct prefetch_chunk *head;
+    struct prefetch_chunk *tail;
+    u_long	queued;		/* bytes waiting in the list */
+    u_long	src_total;	/* compressed bytes read */
+    Bool	done;		/* thread finished */
+    Bool	error;		/* ... because of an error */
+    Bool	stop;		/* thread should quit */
+    struct prefetch *next;
+};
+
+static struct prefetch *prefetch_list = NULL;
+
+
+
+/* the background thread, decompress one file into chunks */
+static void *
+PrefetchThread(
+    void *arg)
+{
+    struct prefetch *ppf = arg;
+    struct comp_src src;
+    void *state;
+    sigset_t mask;
+    Bool error = FALSE;
+
+    /* signals are the main thread's business */
+    sigfillset(&mask);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    memset(&src, 0, sizeof(src));
+    if ((src.fd = open(ppf->filename, O_RDONLY)) < 0) {
+	perror(ppf->filename);
+	error = TRUE;
+    } else {
+	src.buf = MallocZ(COMP_SRC_SIZE);
+	state = (*ppf->pf->comp_lib->lib_open)();
+
+	while (1) {
+	    struct prefetch_chunk *pch = MallocZ(sizeof(struct prefetch_chunk));
+	    int ret = 0;
+
+	    /* fill a chunk */
+	    while (pch->len < PREFETCH_CHUNK) {
+		ret = (*ppf->pf->comp_lib->lib_read)(state, &src,
+						     pch->data + pch->len,
+						     PREFETCH_CHUNK - pch->len);
+		if (ret <= 0)
+		    break;
+		pch->len += ret;
+	    }
+	    if (ret < 0)
+		error = TRUE;
+
+	    /* hand it over, once there's room */
+	    pthread_mutex_lock(&ppf->lock);
+	    while (!ppf->stop && (ppf->queued >= PREFETCH_MAX))
+		pthread_cond_wait(&ppf->cond, &ppf->lock);
+	    if (ppf->stop || (pch->len == 0)) {
+		pthread_mutex_unlock(&ppf->lock);
+		free(pch);
+		break;
+	    }
+	    if (ppf->tail)
+		ppf->tail->next = pch;
+	    else
+		ppf->head = pch;
+	    ppf->tail = pch;
+	    ppf->queued += pch->len;
+	    ppf->src_total = src.total;
+	    pthread_cond_broadcast(&ppf->cond);
+	    pthread_mutex_unlock(&ppf->lock);
+
+	    if (ret <= 0)
+		break;
+	}
+
+	(*ppf->pf->comp_lib->lib_close)(state);
+	close(src.fd);
+	free(src.buf);
+    }
+
+    pthread_mutex_lock(&ppf->lock);
+    ppf->done = TRUE;
+    ppf->error = error;
+    ppf->src_total = src.total;
+    pthread_cond_broadcast(&ppf->cond);
+    pthread_mutex_unlock(&ppf->lock);
+
+    return(NULL);
+}
+
+
+
+/* take some decompressed bytes off the list */
+static int
+PrefetchRead(
+    struct prefetch *ppf,
+    char *buf,
+    int len)
+{
+    struct prefetch_chunk *pch;
+    struct prefetch_chunk *pfree = NULL;
+
+    pthread_mutex_lock(&ppf->lock);
+    while ((ppf->head == NULL) && !ppf->done)
+	pthread_cond_wait(&ppf->cond, &ppf->lock);
+
+    if ((pch = ppf->head) == NULL) {
+	pthread_mutex_unlock(&ppf->lock);
+	return(ppf->error?-1:0);
+    }
+
+    if (len > pch->len - pch->off)
+	len = pch->len - pch->off;
+    memcpy(buf, pch->data + pch->off, len);
+    pch->off += len;
+    ppf->queued -= len;
+
+    /* all used up? */
+    if (pch->off == pch->len) {
+	ppf->head = pch->next;
+	if (ppf->head == NULL)
+	    ppf->tail = NULL;
+	pfree = pch;
+	pthread_cond_broadcast(&ppf->cond);
+    }
+    pthread_mutex_unlock(&ppf->lock);
+
+    if (pfree)
+	free(pfree);
+
+    return(len);
+}
+
+
+
+/* stop the thread (if it's still going) and throw away the rest */
+static void
+PrefetchDone(
+    struct prefetch *ppf)
+{
+    struct prefetch **pp;
+
+    pthread_mutex_lock(&ppf->lock);
+    ppf->stop = TRUE;
+    pthread_cond_broadcast(&ppf->cond);
+    pthread_mutex_unlock(&ppf->lock);
+    pthread_join(ppf->thread, NULL);
+
+    while (ppf->head) {
+	struct prefetch_chunk *pch = ppf->head;
+
+	ppf->head = pch->next;
+	free(pch);
+    }
+
+    for (pp = &prefetch_list; *pp; pp = &(*pp)->next) {
+	if (*pp == ppf) {
+	    *pp = ppf->next;
+	    break;
+	}
+    }
+
+    pthread_mutex_destroy(&ppf->lock);
+    pthread_cond_destroy(&ppf->cond);
+    free(ppf->filename);
+    free(ppf);
+}
+
+
+
+/* find the prefetch for this file, if we have one */
+static struct prefetch *
+PrefetchClaim(
+    char *filename)
+{
+    struct prefetch *ppf;
+
+    for (ppf = prefetch_list; ppf; ppf = ppf->next) {
+	if (!ppf->claimed && (strcmp(ppf->filename, filename) == 0)) {
+	    ppf->claimed = TRUE;
+	    return(ppf);
+	}
+    }
+
+    return(NULL);
+}
+#endif /* COMP_PREFETCH */
+
+
+
+/* get the next chunk of output, either decompressed or just copied */
+static int
+CompStreamProduce(
+    struct comp_stream *pcs,
+    char *buf,
+    int len)
+{
+    int avail;
+
+#ifdef COMP_PREFETCH
+    if (pcs->ppf)
+	return(PrefetchRead(pcs->ppf, buf, len));
+#endif /* COMP_PREFETCH */
+
+    if (pcs->plib)
+	return((*pcs->plib->lib_read)(pcs->lib_state, &pcs->src, buf, len));
+
+    if ((avail = CompSrcFill(&pcs->src)) == 0)
+	return(0);
+    if (len > avail)
+	len = avail;
+    memcpy(buf, pcs->src.buf + pcs->src.off, len);
+    pcs->src.off += len;
+
+    return(len);
+}
+
+
+/* stdio "read" routine for our stdin */
+static int
+CompStreamRead(
+    void *cookie,
+    char *buf,
+    int len)
+{
+    struct comp_stream *pcs = cookie;
+    int ret;
+
+    /* re-reading something that we already decompressed? */
+    if (pcs->pos < pcs->out_pos) {
+	if (pcs->pos >= pcs->hdr_len)
+	    return(-1);		/* sorry, didn't save that far */
+	if (len > pcs->hdr_len - pcs->pos)
+	    len = pcs->hdr_len - pcs->pos;
+	memcpy(buf, pcs->hdr + pcs->pos, len);
+	pcs->pos += len;
+	return(len);
+    }
+
+    if ((ret = CompStreamProduce(pcs, buf, len)) <= 0)
+	return(ret);
+
+    /* save it, in case the reader wants to seek back over it */
+    if (pcs->hdr_saving) {
+	if (pcs->hdr_len + ret > pcs->hdr_size) {
+	    u_long newsize = pcs->hdr_size;
+
+	    while (newsize < pcs->hdr_len + ret)
+		newsize *= 2;
+	    if (newsize > COMP_HDR_MAX) {
+		/* that's enough, nobody needs to go back that far */
+		pcs->hdr_saving = FALSE;
+	    } else {
+		pcs->hdr = ReallocZ(pcs->hdr, pcs->hdr_size, newsize);
+		pcs->hdr_size = newsize;
+	    }
+	}
+	if (pcs->hdr_saving) {
+	    memcpy(pcs->hdr + pcs->hdr_len, buf, ret);
+	    pcs->hdr_len += ret;
+	}
+    }
+
+    pcs->pos += ret;
+    pcs->out_pos += ret;
+
+    return(ret);
+}
+
+
+/* stdio "seek" routine for our stdin, returns the new position */
+/* (or -1 if we can't get there) */
+static long
+CompStreamSeek(
+    void *cookie,
+    long offset,
+    int whence)
+{
+    struct comp_stream *pcs = cookie;
+    long newpos;
+
+    switch (whence) {
+      case SEEK_SET: newpos = offset; break;
+      case SEEK_CUR: newpos = pcs->pos + offset; break;
+      default: return(-1);	/* we don't know where the end is */
+    }
+    if (newpos < 0)
+	return(-1);
+
+    if ((newpos <= pcs->hdr_len) || (newpos == pcs->out_pos)) {
+	/* we have that part (or we're just there) */
+	pcs->pos = newpos;
+    } else if (newpos > pcs->out_pos) {
+	/* skip forward */
+	char buf[COMP_HDR_SIZE];
+
+	pcs->pos = pcs->out_pos;
+	while (pcs->pos < newpos) {
+	    int len = sizeof(buf);
+
+	    if (len > newpos - pcs->pos)
+		len = newpos - pcs->pos;
+	    if (CompStreamRead(pcs, buf, len) <= 0)
+		return(-1);
+	}
+    } else {
+	return(-1);
+    }
+
+    return(pcs->pos);
+}
+
+
+static int
+CompStreamClose(
+    void *cookie)
+{
+    struct comp_stream *pcs = cookie;
+
+#ifdef COMP_PREFETCH
+    if (pcs->ppf)
+	PrefetchDone(pcs->ppf);
+#endif /* COMP_PREFETCH */
+    if (pcs->lib_state)
+	(*pcs->plib->lib_close)(pcs->lib_state);
+    if (pcs->src.fd >= 0)
+	close(pcs->src.fd);
+    free(pcs->src.buf);
+    free(pcs->hdr);
+    free(pcs);
+
+    return(0);
+}
+
+
+#ifdef COMP_COOKIE_GLIBC
+/* glibc's fopencookie() interface */
+static ssize_t
+CompCookieRead(
+    void *cookie,
+    char *buf,
+    size_t len)
+{
+    return(CompStreamRead(cookie, buf, len));
+}
+
+static int
+CompCookieSeek(
+    void *cookie,
+    off64_t *poffset,
+    int whence)
+{
+    long newpos = CompStreamSeek(cookie, (long)*poffset, whence);
+
+    if (newpos < 0)
+	return(-1);
+    *poffset = newpos;
+    return(0);
+}
+
+static FILE *
+CompMakeStream(
+    struct comp_stream *pcs)
+{
+    cookie_io_functions_t funcs;
+
+    funcs.read = CompCookieRead;
+    funcs.write = NULL;
+    funcs.seek = CompCookieSeek;
+    funcs.close = CompStreamClose;
+
+    return(fopencookie(pcs, "r", funcs));
+}
+
+#else /* COMP_COOKIE_GLIBC */
+/* the BSD funopen() interface */
+static fpos_t
+CompFunSeek(
+    void *cookie,
+    fpos_t offset,
+    int whence)
+{
+    return(CompStreamSeek(cookie, (long)offset, whence));
+}
+
+static FILE *
+CompMakeStream(
+    struct comp_stream *pcs)
+{
+    return(funopen(pcs, CompStreamRead, NULL, CompFunSeek, CompStreamClose));
+}
+#endif /* COMP_COOKIE_GLIBC */
+
+
+
+/* open the file (which may be stdin) and make its decompressed */
+/* contents appear on stdin */
+static FILE *
+CompOpenStream(
+    char *filename,
+    struct comp_formats *pf)
+{
+    struct comp_stream *pcs;
+    FILE *f;
+
+    pcs = MallocZ(sizeof(struct comp_stream));
+    pcs->src.buf = MallocZ(COMP_SRC_SIZE);
+
+    if (FileIsStdin(filename)) {
+	/* we can't get at the name, so look at the first few bytes */
+	pcs->src.fd = dup(0);
+	CompSrcPeek(&pcs->src, COMP_MAX_MAGIC);
+	pf = MagicFormat((char *)pcs->src.buf, pcs->src.len);
+	if (pf && !pf->comp_lib) {
+	    if (debug)
+		fprintf(stderr,
+			"Standard input looks like '%s', but I can't decompress that myself\n",
+			pf->comp_descr);
+	    pf = NULL;
+	}
+	if (pf && debug)
+	    fprintf(stderr,"Decompressing standard input (%s) using %s\n",
+		    pf->comp_descr, pf->comp_lib->lib_name);
+#ifdef COMP_PREFETCH
+    } else if ((pcs->ppf = PrefetchClaim(filename)) != NULL) {
+	/* it's already being decompressed */
+	if (debug>1)
+	    fprintf(stderr,"Using prefetched data for '%s'\n", filename);
+	pcs->src.fd = -1;
+#endif /* COMP_PREFETCH */
+    } else {
+	if ((pcs->src.fd = open(filename, O_RDONLY)) < 0) {
+	    perror(filename);
+	    free(pcs->src.buf);
+	    free(pcs);
+	    return(NULL);
+	}
+    }
+
+    pcs->plib = pf?pf->comp_lib:NULL;
+    if (pcs->plib && !pcs->ppf)
+	pcs->lib_state = (*pcs->plib->lib_open)();
+
+    pcs->hdr_size = COMP_HDR_SIZE;
+    pcs->hdr = MallocZ(pcs->hdr_size);
+    pcs->hdr_saving = TRUE;
+
+    if ((f = CompMakeStream(pcs)) == NULL) {
+	perror("decompression stream");
+	exit(-1);
+    }
+
+    /* from now on, stdin is the decompressed stream */
+    f_real_stdin = stdin;
+    stdin = f;
+    comp_active = pcs;
+
+    return(stdin);
+}
+
+#endif /* COMP_INPROCESS */
+
+
 static char *FindBinary(
     char *binname)
 {
@@ -160,54 +1068,78 @@ static char *FindBinary(
  
 
 
+/* which format has this magic number at the front? */
+static struct comp_formats *
+MagicFormat(
+    char *buf,
+    int len)
+{
+    int i;
+
+    for (i=0; i < NUM_COMP_FORMATS; ++i) {
+	struct comp_formats *pf = &supported_comp_formats[i];
+
+	if ((len >= pf->comp_magic_len) &&
+	    (memcmp(buf, pf->comp_magic, pf->comp_magic_len) == 0)) {
+	    if (debug>1)
+		fprintf(stderr,"Magic number match for '%s' (%s)\n",
+			pf->comp_suffix, pf->comp_descr);
+	    return(pf);
+	}
+    }
+
+    return(NULL);
+}
+
+
+
+/* look at the front of the file to see which format it is */
+static struct comp_formats *
+FileMagicFormat(
+    char *filename)
+{
+    char magic[COMP_MAX_MAGIC];
+    int len = 0;
+    int fd;
+
+    if ((fd = open(filename, O_RDONLY)) >= 0) {
+	len = read(fd, magic, sizeof(magic));
+	close(fd);
+    }
+
+    return((len > 0)?MagicFormat(magic, len):NULL);
+}
+
+
+
 static struct comp_formats *
 WhichFormat(
     char *filename)
 {
     static struct comp_formats *pf_cache = NULL;
     static char *pf_file_cache = NULL;
-    int len;
-    int lens;
-    int i;
+    struct comp_formats *pf;
 
     /* check the "cache" :-) */
     if (pf_file_cache && (strcmp(filename,pf_file_cache) == 0)) {
 	return(pf_cache);
     }
 
-    len = strlen(filename);
-
-    for (i=0; i < NUM_COMP_FORMATS; ++i) {
-	struct comp_formats *pf = &supported_comp_formats[i];
-
-	if (debug>1)
-	    fprintf(stderr,"Checking for suffix match '%s' against '%s' (%s)\n",
-		    filename,pf->comp_suffix,pf->comp_bin);
-	/* check for suffix match */
-	lens = strlen(pf->comp_suffix);
-	if (strcmp(filename+len-lens, pf->comp_suffix) == 0) {
-	    if (debug>1)
-		fprintf(stderr,"Suffix match!   '%s' against '%s'\n",
-			filename,pf->comp_suffix);
-	    /* stick it in the cache */
-	    pf_file_cache = strdup(filename);
-	    pf_cache = pf;
-	    is_compressed = TRUE;
-
-	    /* and tell the world */
-	    return(pf);
-	}
-    }
+    /* go by the first few bytes of the file, not the name */
+    pf = FileMagicFormat(filename);
 
+    /* stick it in the cache */
+    if (pf_file_cache)
+	free(pf_file_cache);
     pf_file_cache = strdup(filename);
-    pf_cache = NULL;
-    is_compressed = FALSE;
+    pf_cache = pf;
+    is_compressed = (pf != NULL);
 
-    if (debug)
+    if (debug && (pf == NULL))
 	fprintf(stderr,"WhichFormat: failed to find compression format for file '%s'\n",
 		filename);
 
-    return(NULL);
+    return(pf);
 }
 
 
@@ -462,7 +1394,11 @@ CompOpenHeader(
     /* short hand if it's just reading from standard input */
     if (FileIsStdin(filename)) {
 	is_compressed = TRUE;	/* pretend that it's compressed */
+#ifdef COMP_INPROCESS
+	return(CompOpenStream(filename,NULL));
+#else /* COMP_INPROCESS */
 	return(CompSaveHeader(filename,NULL));
+#endif /* COMP_INPROCESS */
     }
 
     /* see if it's a supported compression file */
@@ -485,6 +1421,19 @@ CompOpenHeader(
 	return(stdin);
     }
 
+#ifdef COMP_INPROCESS
+    /* if we can decompress it ourselves, so much the better */
+    if (pf->comp_lib) {
+	if (debug>1)
+	    printf("Decompressing file of type '%s' using %s\n",
+		   pf->comp_descr, pf->comp_lib->lib_name);
+	else if (debug)
+	    printf("Decompressing file using %s\n", pf->comp_lib->lib_name);
+
+	return(CompOpenStream(filename,pf));
+    }
+#endif /* COMP_INPROCESS */
+
     /* open the file through compression */
     if (debug>1)
 	printf("Decompressing file of type '%s' using program '%s'\n",
@@ -510,6 +1459,15 @@ CompOpenFile(
     if (debug>1)
 	fprintf(stderr,"CompOpenFile('%s') called\n", filename);
 
+#ifdef COMP_INPROCESS
+    /* if we're decompressing it ourselves, it's already on stdin, */
+    /* we just don't need to save it any more */
+    if (comp_active) {
+	comp_active->hdr_saving = FALSE;
+	return(stdin);
+    }
+#endif /* COMP_INPROCESS */
+
     /* if it isn't compressed, just leave it at stdin */
     if (!is_compressed)
 	return(stdin);
@@ -716,6 +1674,16 @@ CompCloseFile(
     /* Hmmm... this was commented out, I wonder why? */
 /*     fclose(stdin); */
 
+#ifdef COMP_INPROCESS
+    /* put the real stdin back */
+    if (comp_active) {
+	fclose(stdin);
+	stdin = f_real_stdin;
+	f_real_stdin = NULL;
+	comp_active = NULL;
+    }
+#endif /* COMP_INPROCESS */
+
     /* if we have a child, make sure it's dead */
     if (child_pid != -1) {
 	kill(child_pid,SIGTERM);
@@ -738,6 +1706,64 @@ CompIsCompressed(void)
 }
 
 
+/* how much of the compressed file we've read (-1 if we don't know) */
+long
+CompPosition(void)
+{
+#ifdef COMP_PREFETCH
+    if (comp_active && comp_active->ppf)
+	return((long)comp_active->ppf->src_total);
+#endif /* COMP_PREFETCH */
+#ifdef COMP_INPROCESS
+    if (comp_active && is_compressed)
+	return((long)comp_active->src.total);
+#endif /* COMP_INPROCESS */
+    return(-1);
+}
+
+
+/* start decompressing this file in the background, we'll need it soon */
+/* (only for the formats we can decompress ourselves) */
+void
+CompPrefetch(
+    char *filename)
+{
+#ifdef COMP_PREFETCH
+    struct prefetch *ppf;
+    struct prefetch **pp;
+    struct comp_formats *pf;
+
+    if (FileIsStdin(filename))
+	return;
+    if (((pf = FileMagicFormat(filename)) == NULL) || (pf->comp_lib == NULL))
+	return;
+
+    ppf = MallocZ(sizeof(struct prefetch));
+    ppf->filename = strdup(filename);
+    ppf->pf = pf;
+    pthread_mutex_init(&ppf->lock, NULL);
+    pthread_cond_init(&ppf->cond, NULL);
+
+    if (pthread_create(&ppf->thread, NULL, PrefetchThread, ppf) != 0) {
+	perror("pthread_create");
+	pthread_mutex_destroy(&ppf->lock);
+	pthread_cond_destroy(&ppf->cond);
+	free(ppf->filename);
+	free(ppf);
+	return;
+    }
+
+    /* keep them in order, in case a file is listed twice */
+    for (pp = &prefetch_list; *pp; pp = &(*pp)->next)
+	;
+    *pp = ppf;
+
+    if (debug)
+	fprintf(stderr,"Decompressing '%s' in the background\n", filename);
+#endif /* COMP_PREFETCH */
+}
+
+
 void
 CompFormats(void)
 {
@@ -751,6 +1777,15 @@ CompFormats(void)
 	int arg;
 	struct comp_formats *pf = &supported_comp_formats[i];
 
+#ifdef COMP_INPROCESS
+	if (pf->comp_lib) {
+	    fprintf(stderr,"\t%6s  %-20s  (built in, using %s)\n",
+		    pf->comp_suffix,
+		    pf->comp_descr,
+		    pf->comp_lib->lib_name);
+	    continue;
+	}
+#endif /* COMP_INPROCESS */
 	fprintf(stderr,"\t%6s  %-20s  %s",
 		pf->comp_suffix,
 		pf->comp_descr,
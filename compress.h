@@ -62,40 +62,88 @@ static char const GCC_UNUSED rcsid_compress[] =
 
 /* How to identify various comp formats */
 #define COMP_MAX_ARGS 20	/* maximum args that you can specify */
+#define COMP_MAX_MAGIC 8	/* longest magic number we look for */
 struct comp_formats {
-    char	*comp_suffix;	/* how to recognize these files		*/
+    char	*comp_suffix;	/* usual suffix for these files		*/
     char	*comp_descr;	/* description of the file format	*/
+    char	*comp_magic;	/* how to recognize these files		*/
+    int		comp_magic_len;	/* (bytes in comp_magic) */
+    struct comp_lib *comp_lib;	/* decompress it ourselves (or NULL)	*/
     char	*comp_bin;	/* name of the binary (full path preferred) */
     char	*comp_args[COMP_MAX_ARGS]; /* arguments to pass */
 };
 
+/* decompression that we can do in-process (see compress.c) */
+#if defined(COMP_INPROCESS) && defined(USE_ZLIB)
+extern struct comp_lib comp_lib_zlib;
+#endif /* USE_ZLIB */
+#if defined(COMP_INPROCESS) && defined(USE_BZLIB)
+extern struct comp_lib comp_lib_bzlib;
+#endif /* USE_BZLIB */
+#if defined(COMP_INPROCESS) && defined(USE_LZMA)
+extern struct comp_lib comp_lib_lzma;
+#endif /* USE_LZMA */
+
 /*
  * compression format table:
  * Don't forget:!!!
  *  1) Leave the last line of NULLs alone
  *  2) arg 1 MUST be the name of the program
  *  3) last arg MUST be NULL
- *  4) only the first suffix match is used
+ *  4) only the first magic number match is used, so list the
+ *     in-process libraries before the programs that do the same thing
  *  5) an arg of "%s" will be replaced with the file name,
  *     don't forget to include it!
- *  6) don't forget the "dot" in the suffix (if there is one)
+ *  6) the suffix is just for show now, files are recognized by
+ *     their first few bytes
  */
 
 struct comp_formats supported_comp_formats[] = {
-/*   SUFFIX    DESCRIPTION	    BINARY NAME	   ARGS TO EXECV	*/
-/*   -----   --------------------   -----------   ----------------------*/
+/*   SUFFIX  DESCRIPTION           MAGIC NUMBER             LIBRARY
+                                   BINARY NAME  ARGS TO EXECV	*/
+/*   -----   --------------------  -----------------------  -------	*/
+#if defined(COMP_INPROCESS) && defined(USE_ZLIB)
+    {".gz", "Gnu gzip format",	    "\037\213", 2,	    &comp_lib_zlib,
+				    NULL,	{NULL}},
+#endif /* USE_ZLIB */
 #ifdef GUNZIP
-    {".gz", "Gnu gzip format",	    GUNZIP,     {"gunzip","-c","%s",NULL}},
-    {".Z",  "Unix compress format", GUNZIP,     {"gunzip","-c","%s",NULL}},
+    {".gz", "Gnu gzip format",	    "\037\213", 2,	    NULL,
+				    GUNZIP,     {"gunzip","-c","%s",NULL}},
+    {".Z",  "Unix compress format", "\037\235", 2,	    NULL,
+				    GUNZIP,     {"gunzip","-c","%s",NULL}},
 #endif /* GUNZIP */
 
 #ifdef UNCOMPRESS
-    {".Z",  "Unix compress format", UNCOMPRESS, {"uncompress","-c","%s",NULL}},
+    {".Z",  "Unix compress format", "\037\235", 2,	    NULL,
+				    UNCOMPRESS, {"uncompress","-c","%s",NULL}},
 #endif /* UNCOMPRESS */
 
+#if defined(COMP_INPROCESS) && defined(USE_BZLIB)
+    {".bz2", "bzip2 format",	    "BZh", 3,		    &comp_lib_bzlib,
+				    NULL,	{NULL}},
+#endif /* USE_BZLIB */
 #ifdef BUNZIP2
-    {".bz2", "bzip2 format", BUNZIP2, {"bunzip2","-c","%s",NULL}},
+    {".bz2", "bzip2 format",	    "BZh", 3,		    NULL,
+				    BUNZIP2,	{"bunzip2","-c","%s",NULL}},
 #endif /* BUNZIP2 */
+
+#if defined(COMP_INPROCESS) && defined(USE_LZMA)
+    {".xz", "xz format",	    "\3757zXZ\000", 6,	    &comp_lib_lzma,
+				    NULL,	{NULL}},
+#endif /* USE_LZMA */
+#ifdef UNXZ
+    {".xz", "xz format",	    "\3757zXZ\000", 6,	    NULL,
+				    UNXZ,	{"unxz","-c","%s",NULL}},
+#endif /* UNXZ */
+
+#ifdef UNZSTD
+    {".zst", "Zstandard format",    "\050\265\057\375", 4,  NULL,
+				    UNZSTD,	{"unzstd","-c","%s",NULL}},
+#endif /* UNZSTD */
+
+#ifdef UNLZ4
+    {".lz4", "LZ4 format",	    "\004\042\115\030", 4,  NULL,
+				    UNLZ4,	{"lz4","-dc","%s",NULL}},
+#endif /* UNLZ4 */
 };
 #define NUM_COMP_FORMATS (sizeof(supported_comp_formats) / sizeof(struct comp_formats))
-
@@ -0,0 +1,460 @@
+/*
+ * Copyright (c) 1994, 1995, 1996, 1997, 1998, 1999, 2000, 2001,
+ *               2002, 2003, 2004
+ *      Ohio University.
+ *
+ * ---
+ *
+ * Starting with the release of tcptrace version 6 in 2001, tcptrace
+ * is licensed under the GNU General Public License (GPL).  We believe
+ * that, among the available licenses, the GPL will do the best job of
+ * allowing tcptrace to continue to be a valuable, freely-available
+ * and well-maintained tool for the networking community.
+ *
+ * Previous versions of tcptrace were released under a license that
+ * was much less restrictive with respect to how tcptrace could be
+ * used in commercial products.  Because of this, I am willing to
+ * consider alternate license arrangements as allowed in Section 10 of
+ * the GNU GPL.  Before I would consider licensing tcptrace under an
+ * alternate agreement with a particular individual or company,
+ * however, I would have to be convinced that such an alternative
+ * would be to the greater benefit of the networking community.
+ * 
+ * ---
+ *
+ * This file is part of Tcptrace.
+ *
+ * Tcptrace was originally written and continues to be maintained by
+ * Shawn Ostermann with the help of a group of devoted students and
+ * users (see the file 'THANKS').  The work on tcptrace has been made
+ * possible over the years through the generous support of NASA GRC,
+ * the National Science Foundation, and Sun Microsystems.
+ *
+ * Tcptrace is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tcptrace is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tcptrace (in the file 'COPYING'); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ * Author:      Shawn Ostermann
+ *              School of Electrical Engineering and Computer Science
+ *              Ohio University
+ *              Athens, OH
+ *              http://www.tcptrace.org/
+ */
+#include "tcptrace.h"
+static char const GCC_UNUSED copyright[] =
+    "@(#)Copyright (c) 2004 -- Ohio University.\n";
+static char const GCC_UNUSED rcsid[] =
+    "@(#)$Header$";
+
+
+
+/*
+ * connindex.c -- a sidecar index of where each connection is
+ *
+ * With --make_index, we remember the byte offsets (and times) of the
+ * first and last packet records of every TCP connection and write
+ * them, along with the 4-tuples, to "FILE.tcpidx" next to the first
+ * input file.
+ *
+ * With --use_index and -o, that index is read back and only the parts
+ * of the files that hold the requested connections are read: each
+ * (uncompressed pcap) file is only read from the first record of the
+ * first interesting connection thru the last record of the last one,
+ * and in between, only the packets of those connections go any
+ * further.  The connections we skip over are still counted, so the
+ * connection numbers and host letters come out the same as they would
+ * in a full run.
+ */
+
+#include <sys/stat.h>
+
+/* the index file is "FILE.tcpidx" */
+#define INDEX_SUFFIX	".tcpidx"
+
+/* file header, all in our own byte order */
+#define INDEX_MAGIC	"tcptrace idx 1\n"
+#define INDEX_BYTEORDER	0x01020304
+
+struct index_header {
+    char	magic[16];
+    u_int	byte_order;	/* INDEX_BYTEORDER */
+    u_int	rec_size;	/* sizeof(struct index_rec) */
+    u_int	nfiles;
+    u_int	nconns;
+    timeval	first_packet;	/* of the whole run */
+    timeval	last_packet;
+};
+
+/* then, one of these for each input file, followed by its name */
+struct index_file {
+    u_llong	size;		/* to catch stale indices */
+    u_llong	mtime;
+    u_int	namelen;
+};
+
+/* then, one of these for each connection, in order */
+struct index_rec {
+    tcp_pair_addrblock	addr;
+    tcp_pair_index	where;
+};
+
+
+/* state for --make_index */
+static Bool index_broken = FALSE;	/* saw a packet with no offset */
+
+/* state for --use_index */
+static Bool index_active = FALSE;
+static struct index_rec *index_wanted = NULL;	/* the -o connections */
+static int *index_wanted_num = NULL;		/* ... and their numbers */
+static int index_nwanted = 0;
+static int index_next_new = 0;		/* next one to be created */
+static struct index_header index_hdr;	/* what the full run saw */
+
+
+
+static char *
+IndexFileName(
+    char *filename)
+{
+    static char *name = NULL;
+
+    if (name)
+	free(name);
+    name = MallocZ(strlen(filename) + sizeof(INDEX_SUFFIX));
+    sprintf(name, "%s%s", filename, INDEX_SUFFIX);
+
+    return(name);
+}
+
+
+
+/* remember where this packet of the connection was */
+void
+IndexNotePacket(
+    tcp_pair *ptp,
+    int file_num)
+{
+    tcp_pair_index *pindex = ptp->pindex;
+    long offset;
+
+    if (index_broken)
+	return;
+
+    if ((offset = PcapMmapPacketOffset()) < 0) {
+	fprintf(stderr,"\
+--make_index: file '%s' can't be indexed (only uncompressed pcap files\n\
+read directly can be), no index will be written\n", cur_filename);
+	index_broken = TRUE;
+	return;
+    }
+
+    if (pindex == NULL) {
+	ptp->pindex = pindex = ConnAlloc(ptp,sizeof(tcp_pair_index));
+	pindex->first_file = file_num;
+	pindex->first_offset = offset;
+	pindex->first_time = current_time;
+    }
+    pindex->last_file = file_num;
+    pindex->last_offset = offset;
+    pindex->last_time = current_time;
+}
+
+
+
+void
+IndexWrite(
+    char **filenames,
+    int count)
+{
+    struct index_header hdr;
+    struct index_file ifile;
+    struct index_rec rec;
+    struct stat st;
+    char *name;
+    FILE *f;
+    int i;
+
+    if (index_broken)
+	return;
+
+    name = IndexFileName(filenames[0]);
+    if ((f = fopen(name,"w")) == NULL) {
+	perror(name);
+	return;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    strncpy(hdr.magic, INDEX_MAGIC, sizeof(hdr.magic));
+    hdr.byte_order = INDEX_BYTEORDER;
+    hdr.rec_size = sizeof(struct index_rec);
+    hdr.nfiles = count;
+    hdr.nconns = num_tcp_pairs+1;
+    hdr.first_packet = first_packet;
+    hdr.last_packet = last_packet;
+    fwrite(&hdr, sizeof(hdr), 1, f);
+
+    for (i=0; i < count; ++i) {
+	memset(&ifile, 0, sizeof(ifile));
+	if (stat(filenames[i], &st) == 0) {
+	    ifile.size = st.st_size;
+	    ifile.mtime = st.st_mtime;
+	}
+	ifile.namelen = strlen(filenames[i]);
+	fwrite(&ifile, sizeof(ifile), 1, f);
+	fwrite(filenames[i], ifile.namelen, 1, f);
+    }
+
+    for (i=0; i <= num_tcp_pairs; ++i) {
+	tcp_pair *ptp = ttp[i];
+
+	memset(&rec, 0, sizeof(rec));
+	rec.addr = ptp->addr_pair;
+	if (ptp->pindex)
+	    rec.where = *ptp->pindex;
+	fwrite(&rec, sizeof(rec), 1, f);
+    }
+
+    if (fclose(f) != 0) {
+	perror(name);
+	unlink(name);
+	return;
+    }
+
+    if (debug)
+	fprintf(stderr,"--make_index: wrote %d connections to '%s'\n",
+		num_tcp_pairs+1, name);
+}
+
+
+
+/* read the index back, if it matches these files and there's */
+/* anything we can skip */
+void
+IndexLoad(
+    char **filenames,
+    int count)
+{
+    struct index_header hdr;
+    struct index_file ifile;
+    struct index_rec rec;
+    struct stat st;
+    char *name;
+    char *fname = NULL;
+    FILE *f;
+    int i;
+
+    name = IndexFileName(filenames[0]);
+    if ((f = fopen(name,"r")) == NULL) {
+	fprintf(stderr,"--use_index: no index '%s', reading everything\n",
+		name);
+	return;
+    }
+
+    if ((fread(&hdr, sizeof(hdr), 1, f) != 1) ||
+	(strncmp(hdr.magic, INDEX_MAGIC, sizeof(hdr.magic)) != 0) ||
+	(hdr.byte_order != INDEX_BYTEORDER) ||
+	(hdr.rec_size != sizeof(struct index_rec))) {
+	fprintf(stderr,"--use_index: '%s' isn't an index I can use\n", name);
+	goto fail;
+    }
+
+    /* make sure it's for these files, and they haven't changed */
+    if (hdr.nfiles != count) {
+	fprintf(stderr,"--use_index: '%s' was made from %u files, not %d\n",
+		name, hdr.nfiles, count);
+	goto fail;
+    }
+    for (i=0; i < count; ++i) {
+	if ((fread(&ifile, sizeof(ifile), 1, f) != 1) ||
+	    (ifile.namelen > 4096)) {
+	    fprintf(stderr,"--use_index: '%s' is truncated\n", name);
+	    goto fail;
+	}
+	fname = ReallocZ(fname, 0, ifile.namelen+1);
+	if (fread(fname, ifile.namelen, 1, f) != 1) {
+	    fprintf(stderr,"--use_index: '%s' is truncated\n", name);
+	    goto fail;
+	}
+	fname[ifile.namelen] = '\00';
+	if ((strcmp(fname, filenames[i]) != 0) ||
+	    (stat(filenames[i], &st) != 0) ||
+	    (ifile.size != (u_llong)st.st_size) ||
+	    (ifile.mtime != (u_llong)st.st_mtime)) {
+	    fprintf(stderr,"--use_index: '%s' is out of date for '%s'\n",
+		    name, filenames[i]);
+	    goto fail;
+	}
+    }
+
+    /* keep just the ones that -o asked for */
+    for (i=0; i < hdr.nconns; ++i) {
+	if (fread(&rec, sizeof(rec), 1, f) != 1) {
+	    fprintf(stderr,"--use_index: '%s' is truncated\n", name);
+	    goto fail;
+	}
+	if (IgnoringConn(i+1))
+	    continue;
+
+	/* the hash might not be the same from run to run */
+	rec.addr.hash = AddrHash(&rec.addr);
+
+	index_wanted = ReallocZ(index_wanted,
+				index_nwanted * sizeof(struct index_rec),
+				(index_nwanted+1) * sizeof(struct index_rec));
+	index_wanted_num = ReallocZ(index_wanted_num,
+				    index_nwanted * sizeof(int),
+				    (index_nwanted+1) * sizeof(int));
+	index_wanted[index_nwanted] = rec;
+	index_wanted_num[index_nwanted] = i+1;
+	++index_nwanted;
+    }
+
+    if (index_nwanted == hdr.nconns) {
+	if (debug)
+	    fprintf(stderr,"--use_index: no connections to skip\n");
+	goto fail;
+    }
+
+    if (debug)
+	fprintf(stderr,"--use_index: %d of %u connections from '%s'\n",
+		index_nwanted, hdr.nconns, name);
+
+    index_active = TRUE;
+    index_hdr = hdr;
+    fclose(f);
+    if (fname)
+	free(fname);
+    return;
+
+  fail:
+    fclose(f);
+    if (fname)
+	free(fname);
+    index_nwanted = 0;
+}
+
+
+
+/* only read the part of this file that we need */
+void
+IndexStartFile(
+    int file_num)
+{
+    u_llong start = ~0ULL;
+    u_llong stop = 0;
+    int i;
+
+    if (!index_active)
+	return;
+
+    for (i=0; i < index_nwanted; ++i) {
+	tcp_pair_index *pindex = &index_wanted[i].where;
+	u_llong first, last;
+
+	if ((pindex->first_file > file_num) || (pindex->last_file < file_num))
+	    continue;
+
+	first = (pindex->first_file == file_num)?pindex->first_offset:0;
+	last = (pindex->last_file == file_num)?pindex->last_offset:~0ULL;
+	if (first < start)
+	    start = first;
+	if (last > stop)
+	    stop = last;
+    }
+
+    /* (if there's nothing here, start > stop and we read nothing) */
+    if (!PcapMmapSeek(start, stop) && debug)
+	fprintf(stderr,"--use_index: can't seek in '%s', reading it all\n",
+		cur_filename);
+}
+
+
+
+/* after the last packet, make things look like we read it all */
+void
+IndexFinish(void)
+{
+    if (!index_active)
+	return;
+
+    /* count the connections after the last one we read */
+    SkipTcpPairs(index_hdr.nconns+1);
+
+    /* idle times and the like are measured to the end of the trace */
+    first_packet = index_hdr.first_packet;
+    last_packet = index_hdr.last_packet;
+    if (tv_cmp(current_time, last_packet) < 0)
+	current_time = last_packet;
+}
+
+
+
+/* is this one of the packets we want? */
+Bool
+IndexWantsPacket(
+    struct ip *pip,
+    void *plast,
+    int file_num)
+{
+    struct tcphdr *ptcp;
+    tcp_pair_addrblock addr;
+    long offset;
+    int dir;
+    int i;
+
+    if (!index_active)
+	return(TRUE);
+
+    if ((offset = PcapMmapPacketOffset()) < 0)
+	return(FALSE);
+
+    if (gettcp(pip, &ptcp, &plast) != 0)
+	return(FALSE);
+    if ((char *)ptcp + sizeof(struct tcphdr)-1 > (char *)plast)
+	return(FALSE);
+
+    CopyAddr(&addr, pip, ntohs(ptcp->th_sport), ntohs(ptcp->th_dport));
+
+    for (i=0; i < index_nwanted; ++i) {
+	tcp_pair_index *pindex = &index_wanted[i].where;
+
+	/* before this one started? */
+	if ((file_num < pindex->first_file) ||
+	    ((file_num == pindex->first_file) &&
+	     (offset < pindex->first_offset)))
+	    continue;
+
+	/* after it's done? */
+	if ((file_num > pindex->last_file) ||
+	    ((file_num == pindex->last_file) &&
+	     (offset > pindex->last_offset)))
+	    continue;
+
+	if (!SameConn(&addr, &index_wanted[i].addr, &dir))
+	    continue;
+
+	/* this is where the connection starts, make sure it gets */
+	/* the number it would have had */
+	if ((i >= index_next_new) &&
+	    (file_num == pindex->first_file) &&
+	    (offset == pindex->first_offset)) {
+	    SkipTcpPairs(index_wanted_num[i]);
+	    index_next_new = i+1;
+	}
+
+	return(TRUE);
+    }
+
+    return(FALSE);
+}
@@ -0,0 +1,568 @@
+/*
+ * Copyright (c) 1994, 1995, 1996, 1997, 1998, 1999, 2000, 2001,
+ *               2002, 2003, 2004
+ *      Ohio University.
+ *
+ * ---
+ *
+ * Starting with the release of tcptrace version 6 in 2001, tcptrace
+ * is licensed under the GNU General Public License (GPL).  We believe
+ * that, among the available licenses, the GPL will do the best job of
+ * allowing tcptrace to continue to be a valuable, freely-available
+ * and well-maintained tool for the networking community.
+ *
+ * Previous versions of tcptrace were released under a license that
+ * was much less restrictive with respect to how tcptrace could be
+ * used in commercial products.  Because of this, I am willing to
+ * consider alternate license arrangements as allowed in Section 10 of
+ * the GNU GPL.  Before I would consider licensing tcptrace under an
+ * alternate agreement with a particular individual or company,
+ * however, I would have to be convinced that such an alternative
+ * would be to the greater benefit of the networking community.
+ * 
+ * ---
+ *
+ * This file is part of Tcptrace.
+ *
+ * Tcptrace was originally written and continues to be maintained by
+ * Shawn Ostermann with the help of a group of devoted students and
+ * users (see the file 'THANKS').  The work on tcptrace has been made
+ * possible over the years through the generous support of NASA GRC,
+ * the National Science Foundation, and Sun Microsystems.
+ *
+ * Tcptrace is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tcptrace is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tcptrace (in the file 'COPYING'); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ * Author:      Shawn Ostermann
+ *              School of Electrical Engineering and Computer Science
+ *              Ohio University
+ *              Athens, OH
+ *              http://www.tcptrace.org/
+ */
+
+#include "tcptrace.h"
+static char const GCC_UNUSED copyright[] =
+    "@(#)Copyright (c) 2004 -- Ohio University.\n";
+static char const GCC_UNUSED rcsid[] =
+    "@(#)$Header$";
+
+
+/*
+ * conntab.c -- the TCP connection index
+ *
+ * Prior to this, connection snapshots lived in a fixed array of 4099
+ * hash buckets, each one an AVL tree (see the comment in tcptrace.h).
+ * With millions of concurrent connections every bucket held a deep
+ * tree and every packet paid for a pointer-chasing walk through it.
+ *
+ * The snapshots now live inline in an open-addressed (linear probing)
+ * slot array.  Each slot is exactly the connection's address block
+ * (which carries the full 64 bit hash of the 4-tuple) plus a pointer
+ * to the connection record, 64 bytes on the usual machines, so a probe
+ * usually costs a single cache line.  The hash value is compared
+ * before the addresses, so unrelated slots are rejected cheaply.
+ *
+ * The table grows as connections are added, but never all at once:
+ * when it gets too full we allocate a bigger one and start inserting
+ * there, then every later table operation migrates a few slots from
+ * the old table until it is empty.  Lookups consult both tables while
+ * that is going on.  Removed entries leave a "tombstone" behind so
+ * that the probe chains through them stay intact; tombstones are
+ * counted against the load factor and disappear at the next resize.
+ *
+ * UDP flows are indexed the same way, in a second table of their own.
+ */
+
+
+/* a slot that is empty has a NULL ptp, a deleted slot this marker */
+#define SNAP_TOMBSTONE	((void *)&snap_tombstone)
+static char snap_tombstone;
+#define SNAP_EMPTY(psnap) ((psnap)->ptp == NULL)
+#define SNAP_DEAD(psnap) ((psnap)->ptp == SNAP_TOMBSTONE)
+#define SNAP_LIVE(psnap) (!SNAP_EMPTY(psnap) && !SNAP_DEAD(psnap))
+
+/* sizes must be powers of 2 */
+#define SNAP_INITIAL_SIZE	1024
+/* grow when (live+tombstones) exceeds half of the slots */
+#define SNAP_FULL(ptab) (((ptab)->used + 1) * 2 > (ptab)->size)
+/* old slots migrated per table operation during a resize */
+#define SNAP_MIGRATE_STEP	16
+
+struct snap_table {
+    ptp_snap	*slots;
+    u_long	size;		/* number of slots */
+    u_long	mask;		/* size - 1 */
+    u_long	live;		/* slots holding a connection */
+    u_long	used;		/* live slots plus tombstones */
+};
+
+/* search efficiency data (printed at the end with debug > 1) */
+struct snap_stats {
+    u_llong	searches;	/* lookups performed */
+    u_llong	probes;		/* slots examined by those lookups */
+    u_long	max_probes;	/* longest single probe sequence */
+    u_long	max_live;	/* largest number of connections held */
+    u_long	resizes;	/* number of times we've grown */
+#define SNAP_HIST_BUCKETS 6	/* 0-1, 2, 3-4, 5-8, 9-16, >16 probes */
+    u_llong	hist[SNAP_HIST_BUCKETS];
+};
+
+/* an index: the current table and (while resizing) the one being */
+/* drained, plus its statistics */
+struct conn_index {
+    struct snap_table	tab;
+    struct snap_table	old;
+    u_long		migrate_ix;
+    struct snap_stats	stats;
+};
+
+/* one for TCP connections, one for UDP flows */
+static struct conn_index tcp_index;
+static struct conn_index udp_index;
+
+
+/* local routines */
+static void SnapTableInit(struct snap_table *ptab, u_long size);
+static ptp_snap *SnapLookup(struct snap_table *ptab,
+			    tcp_pair_addrblock *paddr, int *pdir,
+			    u_long *pprobes);
+static void SnapPlace(struct snap_table *ptab, ptp_snap *psnap);
+static void SnapMigrate(struct conn_index *pix, u_long count);
+static void SnapGrow(struct conn_index *pix);
+static ptp_snap *ConnTabFind(struct conn_index *pix,
+			     tcp_pair_addrblock *paddr, int *pdir);
+static void ConnTabInsert(struct conn_index *pix,
+			  tcp_pair_addrblock *paddr, void *ptp);
+static void ConnTabRemove(struct conn_index *pix,
+			  tcp_pair_addrblock *paddr);
+static void ConnTabStats(struct conn_index *pix, char *comment,
+			 char *what);
+
+
+/*
+ * Mix64 - the finalizer from the "splitmix64" generator, every input
+ * bit affects every output bit
+ */
+static inline u_llong
+Mix64(
+    u_llong x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return(x);
+}
+
+
+/* hash a single endpoint (address and port) */
+static inline u_llong
+EndpointHash64(
+    ipaddr *paddr,
+    portnum port)
+{
+    u_llong h;
+
+    if (ADDR_ISV4(paddr)) {
+	h = ((u_llong)ntohl(paddr->un.ip4.s_addr) << 16) | port;
+    } else {
+	u_llong w[2];
+	memcpy(w, paddr->un.ip6.s6_addr, sizeof(w));
+	h = Mix64(w[0]) ^ w[1] ^ ((u_llong)port << 48);
+    }
+
+    return(Mix64(h));
+}
+
+
+/*
+ * AddrHash - compute the 64 bit hash of a connection's 4-tuple.  The
+ * value is the same for both directions of the connection, so a
+ * packet from B to A finds the record created by the A to B packet.
+ */
+hash64
+AddrHash(
+    tcp_pair_addrblock *ptpa)
+{
+    u_llong ha = EndpointHash64(&ptpa->a_address, ptpa->a_port);
+    u_llong hb = EndpointHash64(&ptpa->b_address, ptpa->b_port);
+
+    /* order the halves so the result doesn't depend on direction */
+    if (ha > hb) {
+	u_llong tmp = ha;
+	ha = hb;
+	hb = tmp;
+    }
+
+    return(Mix64(ha ^ ((hb << 32) | (hb >> 32))));
+}
+
+
+
+static void
+SnapTableInit(
+    struct snap_table *ptab,
+    u_long size)
+{
+    ptab->slots = MallocZ(size * sizeof(ptp_snap));
+    ptab->size = size;
+    ptab->mask = size - 1;
+    ptab->live = 0;
+    ptab->used = 0;
+}
+
+
+/*
+ * SnapLookup - find the live slot for a connection in one table.
+ * Returns NULL if it's not there.
+ */
+static ptp_snap *
+SnapLookup(
+    struct snap_table *ptab,
+    tcp_pair_addrblock *paddr,
+    int *pdir,
+    u_long *pprobes)
+{
+    u_long ix;
+    ptp_snap *psnap;
+
+    if (ptab->slots == NULL)
+	return(NULL);
+
+    for (ix = paddr->hash & ptab->mask; ; ix = (ix + 1) & ptab->mask) {
+	psnap = &ptab->slots[ix];
+	++*pprobes;
+
+	if (SNAP_EMPTY(psnap))
+	    return(NULL);
+
+	if (!SNAP_DEAD(psnap) &&
+	    SameConn(paddr, &psnap->addr_pair, pdir))
+	    return(psnap);
+    }
+}
+
+
+/* put a (known to be new) snapshot into the first free slot */
+static void
+SnapPlace(
+    struct snap_table *ptab,
+    ptp_snap *psnap)
+{
+    u_long ix;
+    ptp_snap *pslot;
+
+    for (ix = psnap->addr_pair.hash & ptab->mask; ;
+	 ix = (ix + 1) & ptab->mask) {
+	pslot = &ptab->slots[ix];
+	if (SNAP_EMPTY(pslot)) {
+	    ++ptab->used;
+	    break;
+	}
+	if (SNAP_DEAD(pslot))
+	    break;		/* re-use the tombstone */
+    }
+
+    *pslot = *psnap;
+    ++ptab->live;
+}
+
+
+/* move some slots from the table being drained into the current one */
+static void
+SnapMigrate(
+    struct conn_index *pix,
+    u_long count)
+{
+    ptp_snap *psnap;
+
+    while ((count-- > 0) && (pix->old.slots != NULL)) {
+	psnap = &pix->old.slots[pix->migrate_ix];
+	if (SNAP_LIVE(psnap)) {
+	    SnapPlace(&pix->tab, psnap);
+	    --pix->old.live;
+	    /* leave a tombstone so probe chains in the old table survive */
+	    psnap->ptp = SNAP_TOMBSTONE;
+	}
+
+	if (++pix->migrate_ix == pix->old.size) {
+	    if (debug > 1)
+		fprintf(stderr,
+			"SnapMigrate: finished draining %lu slot table\n",
+			pix->old.size);
+	    free(pix->old.slots);
+	    pix->old.slots = NULL;
+	    pix->old.size = pix->old.live = pix->old.used = 0;
+	    pix->migrate_ix = 0;
+	}
+    }
+}
+
+
+/* start an incremental resize of the table */
+static void
+SnapGrow(
+    struct conn_index *pix)
+{
+    u_long newsize;
+
+    /* (can't really happen, but finish any previous resize first) */
+    if (pix->old.slots != NULL)
+	SnapMigrate(pix, pix->old.size);
+
+    /* double it, unless it's mostly tombstones */
+    newsize = pix->tab.size;
+    while (pix->tab.live * 3 >= newsize)
+	newsize *= 2;
+
+    if (debug > 1)
+	fprintf(stderr,
+		"SnapGrow: %lu live, %lu dead, resizing %lu -> %lu slots\n",
+		pix->tab.live, pix->tab.used - pix->tab.live,
+		pix->tab.size, newsize);
+
+    pix->old = pix->tab;
+    pix->migrate_ix = 0;
+    SnapTableInit(&pix->tab, newsize);
+    ++pix->stats.resizes;
+}
+
+
+
+/* find the snapshot matching an address block in one index */
+static ptp_snap *
+ConnTabFind(
+    struct conn_index *pix,
+    tcp_pair_addrblock *paddr,
+    int *pdir)
+{
+    ptp_snap *psnap;
+    u_long probes = 0;
+    int hist;
+
+    SnapMigrate(pix, SNAP_MIGRATE_STEP);
+
+    psnap = SnapLookup(&pix->tab, paddr, pdir, &probes);
+    if (psnap == NULL)
+	psnap = SnapLookup(&pix->old, paddr, pdir, &probes);
+
+    /* search efficiency instrumentation */
+    ++pix->stats.searches;
+    pix->stats.probes += probes;
+    if (probes > pix->stats.max_probes)
+	pix->stats.max_probes = probes;
+    for (hist = 0; (hist < SNAP_HIST_BUCKETS-1) && (probes > (1u<<hist));
+	 ++hist)
+	;
+    ++pix->stats.hist[hist];
+
+    return(psnap);
+}
+
+
+/* add a new entry to one index */
+static void
+ConnTabInsert(
+    struct conn_index *pix,
+    tcp_pair_addrblock *paddr,
+    void *ptp)
+{
+    ptp_snap snap;
+
+    if (pix->tab.slots == NULL)
+	SnapTableInit(&pix->tab, SNAP_INITIAL_SIZE);
+    else if (SNAP_FULL(&pix->tab))
+	SnapGrow(pix);
+
+    SnapMigrate(pix, SNAP_MIGRATE_STEP);
+
+    snap.addr_pair = *paddr;
+    snap.ptp = ptp;
+    SnapPlace(&pix->tab, &snap);
+
+    if (pix->tab.live + pix->old.live > pix->stats.max_live)
+	pix->stats.max_live = pix->tab.live + pix->old.live;
+}
+
+
+/* remove an entry from one index */
+static void
+ConnTabRemove(
+    struct conn_index *pix,
+    tcp_pair_addrblock *paddr)
+{
+    ptp_snap *psnap;
+    struct snap_table *ptab = &pix->tab;
+    u_long probes = 0;
+    int dir;
+
+    if ((psnap = SnapLookup(ptab, paddr, &dir, &probes)) == NULL) {
+	ptab = &pix->old;
+	psnap = SnapLookup(ptab, paddr, &dir, &probes);
+    }
+
+    if (psnap == NULL) {
+	if (debug)
+	    fprintf(stderr,"SnapRemove: connection %s<->%s not in the index\n",
+		    EndpointName(paddr->a_address, paddr->a_port),
+		    EndpointName(paddr->b_address, paddr->b_port));
+	return;
+    }
+
+    psnap->ptp = SNAP_TOMBSTONE;
+    --ptab->live;
+}
+
+
+/* dump search efficiency information for one index */
+static void
+ConnTabStats(
+    struct conn_index *pix,
+    char *comment,
+    char *what)
+{
+    static char *hist_labels[SNAP_HIST_BUCKETS] = {
+	"0-1", "2", "3-4", "5-8", "9-16", ">16"};
+    struct snap_stats *pstats = &pix->stats;
+    struct snap_table *ptab = &pix->tab;
+    u_long live = pix->tab.live + pix->old.live;
+    int i;
+
+    fprintf(stdout,"%sTotal searches: %" FS_ULL "\n",
+	    comment, pstats->searches);
+    fprintf(stdout,"%s  Total probes: %" FS_ULL "\n",
+	    comment, pstats->probes);
+    fprintf(stdout,"%s  Average probes/search: %.2f\n",
+	    comment, pstats->searches ?
+	    (double)pstats->probes / (double)pstats->searches : 0.0);
+    fprintf(stdout,"%s  Max probes/search: %lu\n",
+	    comment, pstats->max_probes);
+    for (i=0; i < SNAP_HIST_BUCKETS; ++i)
+	fprintf(stdout,"%s    searches needing %5s probes: %" FS_ULL "\n",
+		comment, hist_labels[i], pstats->hist[i]);
+    fprintf(stdout,"%s%s table size: %lu slots (%lu bytes/slot)\n",
+	    comment, what, ptab->size, (u_long)sizeof(ptp_snap));
+    fprintf(stdout,"%s  Live entries: %lu (max %lu)\n",
+	    comment, live, pstats->max_live);
+    fprintf(stdout,"%s  Tombstones: %lu\n",
+	    comment, ptab->used - ptab->live);
+    fprintf(stdout,"%s  Load factor: %.3f (live), %.3f (incl. tombstones)\n",
+	    comment,
+	    ptab->size ? (double)ptab->live / (double)ptab->size : 0.0,
+	    ptab->size ? (double)ptab->used / (double)ptab->size : 0.0);
+    fprintf(stdout,"%s  Resizes: %lu%s\n",
+	    comment, pstats->resizes,
+	    pix->old.slots ? " (one still in progress)" : "");
+}
+
+
+
+/*
+ * SnapFind - find the snapshot for the connection matching an address
+ * block, in either direction.  The direction (A2B or B2A) is returned
+ * through pdir.  The pointer returned is only good until the next
+ * call to SnapInsert() or SnapRemove().
+ */
+ptp_snap *
+SnapFind(
+    tcp_pair_addrblock *paddr,
+    int *pdir)
+{
+    return(ConnTabFind(&tcp_index, paddr, pdir));
+}
+
+
+
+/*
+ * SnapInsert - add a new connection to the index.  The address block
+ * is copied into the table, the connection must not already be there.
+ */
+void
+SnapInsert(
+    tcp_pair_addrblock *paddr,
+    void *ptp)
+{
+    if (debug > 4)
+	printf("SnapInsert(): Inserting a connection into the index\n");
+
+    ConnTabInsert(&tcp_index, paddr, ptp);
+}
+
+
+
+/*
+ * SnapRemove - remove a connection from the index
+ */
+void
+SnapRemove(
+    tcp_pair_addrblock *paddr)
+{
+    if (debug > 4)
+	printf("SnapRemove(): Removing a connection from the index\n");
+
+    ConnTabRemove(&tcp_index, paddr);
+}
+
+
+
+/*
+ * SnapStats - dump search efficiency information for the index
+ */
+void
+SnapStats(
+    char *comment)
+{
+    ConnTabStats(&tcp_index, comment, "Connection");
+}
+
+
+
+/*
+ * UdpSnapFind, UdpSnapInsert, UdpSnapRemove, UdpSnapStats - the same,
+ * for the UDP flow index (the "ptp" is a udp_pair)
+ */
+ptp_snap *
+UdpSnapFind(
+    udp_pair_addrblock *paddr,
+    int *pdir)
+{
+    return(ConnTabFind(&udp_index, paddr, pdir));
+}
+
+
+void
+UdpSnapInsert(
+    udp_pair_addrblock *paddr,
+    udp_pair *pup)
+{
+    ConnTabInsert(&udp_index, paddr, pup);
+}
+
+
+void
+UdpSnapRemove(
+    udp_pair_addrblock *paddr)
+{
+    ConnTabRemove(&udp_index, paddr);
+}
+
+
+void
+UdpSnapStats(
+    char *comment)
+{
+    ConnTabStats(&udp_index, comment, "UDP flow");
+}
@@ -89,6 +89,10 @@ struct supported_formats {
 /*   the reader function should return 0 at EOF and 1 otherwise		*/
 /* This routine must return ONLY IP packets, but they need not all be	*/
 /* TCP packets (if not, they're ignored).				*/
+/* The returned pointers (pphys, ppip, pplast) only need to stay valid	*/
+/* until the next call, so they may point straight into the reader's	*/
+/* own input buffer rather than a copy, as long as the IP header is	*/
+/* aligned well enough for the machine to read it in place.		*/
 
 
 /* install the is_GLORP() routines supported */
@@ -115,6 +119,7 @@ struct supported_formats file_formats[] = {
 	{is_erf,	"erf","Endace Extensible Record Format"},
 #endif /* GROK_ERF */
 #ifdef GROK_TCPDUMP
+	{is_pcap_mmap,	"pcap","tcpdump/pcapng files, read directly (uncompressed only)"},
 	{is_tcpdump,	"tcpdump","tcpdump -- Public domain program from LBL"},
 #endif /* GROK_TCPDUMP */
 };
@@ -69,15 +69,16 @@ static char const GCC_UNUSED rcsid[] =
 /* local routines */
 static char *PrintConst(struct filter_node *pf);
 static char *PrintVar(struct filter_node *pf);
-static void EvalRelopUnsigned(tcp_pair *ptp, struct filter_res *pres, struct filter_node *pf);
-static void EvalRelopSigned(tcp_pair *ptp, struct filter_res *pres, struct filter_node *pf);
-static void EvalRelopIpaddr(tcp_pair *ptp, struct filter_res *pres, struct filter_node *pf);
-static void EvalFilter(tcp_pair *ptp, struct filter_res *pres, struct filter_node *pf);
-static void EvalRelopString(tcp_pair *ptp, struct filter_res *pres, struct filter_node *pf);
-static void EvalVariable(tcp_pair *ptp, struct filter_res *pres, struct filter_node *pf);
-static void EvalConstant(tcp_pair *ptp, struct filter_res *pres, struct filter_node *pf);
+static void CompileFilter(struct filter_node *root);
+static void CompileNode(struct filter_prog *pprog, struct filter_node *pf,
+			int reg);
+static void RunFilterProg(struct filter_prog *pprog, tcp_pair *ptp,
+			  int first, int last);
+static struct filter_node *MakeConjunction(struct filter_node *left,
+					   struct filter_node *right);
+static struct filter_node *MakeDisjunction(struct filter_node *left,
+					   struct filter_node *right);
 static char *PrintFilterInternal(struct filter_node *pf);
-static char *Res2Str(struct filter_res *pres);
 static struct filter_node *MustBeType(enum vartype var_needed, struct filter_node *pf);
 static struct filter_node *LookupVar(char *varname, Bool fclient);
 static void HelpFilterVariables(void);
@@ -533,6 +534,7 @@ MakeBoolConstNode(
 
     pf = MallocZ(sizeof(struct filter_node));
 
+    pf->op = OP_CONSTANT;
     pf->vartype = V_BOOL;
     pf->un.constant.bool = val;
 
@@ -705,30 +707,6 @@ ParseFilter(
     return;
 }
 
-static char *
-Res2Str(
-    struct filter_res *pres)
-{
-    char buf[100];
-    
-    /* for constants */
-    switch (pres->vartype) {
-      case V_ULLONG:	snprintf(buf,sizeof(buf),"ULLONG(%" FS_ULL ")",pres->val.u_longint); break;
-      case V_LLONG:	snprintf(buf,sizeof(buf),"LLONG(%"  FS_LL  ")",pres->val.longint); break;
-      case V_STRING:	snprintf(buf,sizeof(buf),"STRING(%s)",pres->val.string); break;
-      case V_BOOL:	snprintf(buf,sizeof(buf),"BOOL(%s)",  BOOL2STR(pres->val.bool)); break;
-      default: {
-	  fprintf(stderr,"Res2Str: unknown constant type %d (%s)\n",
-		  pres->vartype, Vartype2Str(pres->vartype));
-	  exit(-1);
-      }
-    }
-
-    /* small memory leak, but it's just done once for debugging... */
-    return(strdup(buf));
-}
-
-
 void
 PrintFilter(
     struct filter_node *pf)
@@ -859,6 +837,7 @@ LookupVar(
 	    else
 		pf->un.variable.offset = (char *)ptr - (char *)&ptp_dummy;
 	    pf->un.variable.fclient = fclient;
+	    pf->un.variable.early = pfl->early;
 
 	    return(pf);
 	}
@@ -872,779 +851,677 @@ LookupVar(
     exit(-1);
 }
 
-static u_llong
-Ptr2Signed(
-    tcp_pair *ptp,
-    enum vartype vartype,
-    void *ptr)
-{
-    u_llong val;
-
-    switch (vartype) {
-      case V_LLONG:	val = *((llong *) ptr); break;
-      case V_LONG:	val = *((long *) ptr); break;
-      case V_INT:	val = *((int *) ptr); break;
-      case V_SHORT:	val = *((short *) ptr); break;
-      case V_CHAR:	val = *((char *) ptr); break;
-      default: {
-	  fprintf(stderr,
-		  "Ptr2Signed: can't convert type %s to signed\n",
-		  Vartype2Str(vartype));
-	  exit(-1);
-      }
-    }
-    return(val);
-}
-
-static u_llong
-Ptr2Unsigned(
-    tcp_pair *ptp,
-    enum vartype vartype,
-    void *ptr)
-{
-    u_llong val;
+/**************************************************************/
+/**************************************************************/
+/**							     **/
+/**  The following routines COMPILE and RUN filter trees     **/
+/**							     **/
+/**************************************************************/
+/**************************************************************/
 
-    switch (vartype) {
-      case V_ULLONG:	val = *((u_llong *) ptr); break;
-      case V_ULONG:	val = *((u_long *) ptr); break;
-      case V_UINT:	val = *((u_int *) ptr); break;
-      case V_USHORT:	val = *((u_short *) ptr); break;
-      case V_UCHAR:	val = *((u_char *) ptr); break;
-      case V_BOOL:	val = *((Bool *) ptr)==TRUE; break;
-      default: {
-	  fprintf(stderr,
-		  "Ptr2Unsigned: can't convert variable type %s to unsigned\n",
-		  Vartype2Str(vartype));
-	  exit(-1);
-      }
+/* The tree is only walked once, when it's installed.  What we run for */
+/* each connection is a flat list of instructions, with the variable   */
+/* types and offsets already resolved and the constant parts already   */
+/* computed.  Each subtree leaves its value in one register, and a     */
+/* binary operation evaluates its left side into register N and its   */
+/* right side into N+1, so registers are allocated like a stack.       */
 
-    }
-    return(val);
-}
 
+/* the compiled filter, and the part of it we can check early */
+static struct filter_prog filter_prog;
+static struct filter_prog early_prog;
+static struct filter_prog *pearly_check = NULL; /* which one to check early */
+static union Constant *filter_regs = NULL;
+static int filter_nregs = 0;
 
 
 static char *
-Var2String(
-    tcp_pair *ptp,
-    struct filter_node *pf)
+Opcode2Str(
+    enum filter_opcode opcode)
 {
-    void *ptr;
-    char *str;
-
-    ptr = (char *)ptp + pf->un.variable.offset;
-    str = *((char **)ptr);
-
-    if (str == NULL)
-	str = "<NULL>";
-
-    if (debug)
-	printf("Var2String returns 0x%p (%s)\n",
-	       str, str);
-
-    return(str);
+    switch (opcode) {
+      case FI_CONST:		return("CONST");
+      case FI_LD_ULLONG:	return("LD_ULLONG");
+      case FI_LD_ULONG:		return("LD_ULONG");
+      case FI_LD_UINT:		return("LD_UINT");
+      case FI_LD_USHORT:	return("LD_USHORT");
+      case FI_LD_UCHAR:		return("LD_UCHAR");
+      case FI_LD_BOOL:		return("LD_BOOL");
+      case FI_LD_LLONG:		return("LD_LLONG");
+      case FI_LD_LONG:		return("LD_LONG");
+      case FI_LD_INT:		return("LD_INT");
+      case FI_LD_SHORT:		return("LD_SHORT");
+      case FI_LD_CHAR:		return("LD_CHAR");
+      case FI_LD_STRING:	return("LD_STRING");
+      case FI_LD_IPADDR:	return("LD_IPADDR");
+      case FI_CALL_SIGNED:	return("CALL_SIGNED");
+      case FI_CALL_UNSIGNED:	return("CALL_UNSIGNED");
+      case FI_PLUS:		return("PLUS");
+      case FI_MINUS:		return("MINUS");
+      case FI_TIMES:		return("TIMES");
+      case FI_BAND:		return("BAND");
+      case FI_BOR:		return("BOR");
+      case FI_DIVIDE_U:		return("DIVIDE_U");
+      case FI_MOD_U:		return("MOD_U");
+      case FI_DIVIDE_S:		return("DIVIDE_S");
+      case FI_MOD_S:		return("MOD_S");
+      case FI_EQUAL:		return("EQUAL");
+      case FI_NEQUAL:		return("NEQUAL");
+      case FI_GREATER_U:	return("GREATER_U");
+      case FI_GREATER_EQ_U:	return("GREATER_EQ_U");
+      case FI_LESS_U:		return("LESS_U");
+      case FI_LESS_EQ_U:	return("LESS_EQ_U");
+      case FI_GREATER_S:	return("GREATER_S");
+      case FI_GREATER_EQ_S:	return("GREATER_EQ_S");
+      case FI_LESS_S:		return("LESS_S");
+      case FI_LESS_EQ_S:	return("LESS_EQ_S");
+      case FI_STRING_REL:	return("STRING_REL");
+      case FI_IPADDR_REL:	return("IPADDR_REL");
+      case FI_NOT:		return("NOT");
+      case FI_JUMP_FALSE:	return("JUMP_FALSE");
+      case FI_JUMP_TRUE:	return("JUMP_TRUE");
+    }
+    return("??");
 }
 
 
-static u_long
-Var2Signed(
-    tcp_pair *ptp,
-    struct filter_node *pf)
+static void
+PrintFilterProg(
+    char *what,
+    struct filter_prog *pprog)
 {
-    void *ptr;
+    int i;
 
-    ptr = (char *)ptp + pf->un.variable.offset;
+    printf("%s program: %d instructions, %d registers\n",
+	   what, pprog->ninsns, filter_nregs);
+    for (i=0; i < pprog->ninsns; ++i) {
+	struct filter_insn *pi = &pprog->insns[i];
 
-    switch (pf->un.variable.realtype) {
-      case V_LLONG: return(Ptr2Signed(ptp,V_LLONG,ptr));
-      case V_LONG:  return(Ptr2Signed(ptp,V_LONG,ptr));
-      case V_INT:   return(Ptr2Signed(ptp,V_INT,ptr));
-      case V_SHORT: return(Ptr2Signed(ptp,V_SHORT,ptr));
-      case V_CHAR:  return(Ptr2Signed(ptp,V_CHAR,ptr));
-      case V_FUNC:
-      {   /* call the function */
-	  llong (*pfunc)(tcp_pair *ptp);
-	  pfunc = (llong (*)(tcp_pair *))(pf->un.variable.offset);
-	  return((*pfunc)(ptp));
-      }
-      default: {
-	  fprintf(stderr,
-		  "Filter eval error, can't convert variable type %s to signed\n",
-		  Vartype2Str(pf->un.variable.realtype));
-	  exit(-1);
-      }
+	printf("  %3d: %-14s r%u", i, Opcode2Str(pi->opcode), pi->reg);
+	switch (pi->opcode) {
+	  case FI_CONST:
+	    printf(", %" FS_ULL, pi->val.u_longint);
+	    break;
+	  case FI_JUMP_FALSE:
+	  case FI_JUMP_TRUE:
+	    printf(", %d", pi->target);
+	    break;
+	  case FI_STRING_REL:
+	  case FI_IPADDR_REL:
+	    printf(", %s", Op2Str(pi->relop));
+	    break;
+	  case FI_CALL_SIGNED:
+	  case FI_CALL_UNSIGNED:
+	    break;
+	  default:
+	    if ((pi->opcode >= FI_LD_ULLONG) && (pi->opcode <= FI_LD_IPADDR))
+		printf(", +%lu", pi->offset);
+	    break;
+	}
+	printf("\n");
     }
 }
 
 
-static ipaddr *
-Var2Ipaddr(
-    tcp_pair *ptp,
-    struct filter_node *pf)
+/* string and address comparisons come down to a 3-way answer */
+static Bool
+RelopResult(
+    enum optype relop,
+    int cmp)
 {
-    void *ptr;
-
-    ptr = (char *)ptp + pf->un.variable.offset;
-
-    switch (pf->un.variable.realtype) {
-      case V_IPADDR: return(ptr);
+    switch (relop) {
+      case OP_GREATER:	   return(cmp >  0);
+      case OP_GREATER_EQ:  return(cmp >= 0);
+      case OP_LESS:	   return(cmp <  0);
+      case OP_LESS_EQ:	   return(cmp <= 0);
+      case OP_EQUAL:	   return(cmp == 0);
+      case OP_NEQUAL:	   return(cmp != 0);
       default: {
-	  fprintf(stderr,
-		  "Filter eval error, can't convert variable type %s to ipaddr\n",
-		  Vartype2Str(pf->un.variable.realtype));
+	  fprintf(stderr,"RelopResult: unsupported operation %d (%s)\n",
+		  relop, Op2Str(relop));
 	  exit(-1);
       }
     }
 }
 
 
+/* the field an instruction loads, within this connection */
+#define PFIELD(type) ((type *)((char *)ptp + pi->offset))
 
-static u_long
-Var2Unsigned(
+/* run instructions [first,last) against a connection */
+static void
+RunFilterProg(
+    struct filter_prog *pprog,
     tcp_pair *ptp,
-    struct filter_node *pf)
+    int first,
+    int last)
 {
-    void *ptr;
+    union Constant *r = filter_regs;
+    struct filter_insn *pi;
+    union Constant *pr;
+    int ix = first;
+    int cmp;
 
-    ptr = (char *)ptp + pf->un.variable.offset;
+    while (ix < last) {
+	pi = &pprog->insns[ix++];
+	pr = &r[pi->reg];
+
+	switch (pi->opcode) {
+	  case FI_CONST:	*pr = pi->val; break;
+
+	  case FI_LD_ULLONG:	pr->u_longint = *PFIELD(u_llong); break;
+	  case FI_LD_ULONG:	pr->u_longint = *PFIELD(u_long); break;
+	  case FI_LD_UINT:	pr->u_longint = *PFIELD(u_int); break;
+	  case FI_LD_USHORT:	pr->u_longint = *PFIELD(u_short); break;
+	  case FI_LD_UCHAR:	pr->u_longint = *PFIELD(u_char); break;
+	  case FI_LD_BOOL:	pr->u_longint = (*PFIELD(Bool) == TRUE); break;
+	  case FI_LD_LLONG:	pr->longint = *PFIELD(llong); break;
+	  case FI_LD_LONG:	pr->longint = *PFIELD(long); break;
+	  case FI_LD_INT:	pr->longint = *PFIELD(int); break;
+	  case FI_LD_SHORT:	pr->longint = *PFIELD(short); break;
+	  case FI_LD_CHAR:	pr->longint = *PFIELD(char); break;
+	  case FI_LD_STRING:
+	    pr->string = *PFIELD(char *);
+	    if (pr->string == NULL)
+		pr->string = "<NULL>";
+	    break;
+	  case FI_LD_IPADDR:	pr->pipaddr = PFIELD(ipaddr); break;
+
+	  case FI_CALL_SIGNED: {
+	      llong (*pfunc)(tcp_pair *ptp);
+	      pfunc = (llong (*)(tcp_pair *))(pi->offset);
+	      pr->longint = (*pfunc)(ptp);
+	      break;
+	  }
+	  case FI_CALL_UNSIGNED: {
+	      u_llong (*pfunc)(tcp_pair *ptp);
+	      pfunc = (u_llong (*)(tcp_pair *))(pi->offset);
+	      pr->u_longint = (*pfunc)(ptp);
+	      break;
+	  }
+
+	  /* two's complement, so these don't care about the sign */
+	  case FI_PLUS:	  pr->u_longint = pr[0].u_longint + pr[1].u_longint; break;
+	  case FI_MINUS:  pr->u_longint = pr[0].u_longint - pr[1].u_longint; break;
+	  case FI_TIMES:  pr->u_longint = pr[0].u_longint * pr[1].u_longint; break;
+	  case FI_BAND:	  pr->u_longint = pr[0].u_longint & pr[1].u_longint; break;
+	  case FI_BOR:	  pr->u_longint = pr[0].u_longint | pr[1].u_longint; break;
+	  case FI_EQUAL:  pr->u_longint = pr[0].u_longint == pr[1].u_longint; break;
+	  case FI_NEQUAL: pr->u_longint = pr[0].u_longint != pr[1].u_longint; break;
+
+	  case FI_DIVIDE_U: pr->u_longint = pr[0].u_longint / pr[1].u_longint; break;
+	  case FI_MOD_U:    pr->u_longint = pr[0].u_longint % pr[1].u_longint; break;
+	  case FI_DIVIDE_S: pr->longint = pr[0].longint / pr[1].longint; break;
+	  case FI_MOD_S:    pr->longint = pr[0].longint % pr[1].longint; break;
+
+	  case FI_GREATER_U:	pr->u_longint = pr[0].u_longint >  pr[1].u_longint; break;
+	  case FI_GREATER_EQ_U: pr->u_longint = pr[0].u_longint >= pr[1].u_longint; break;
+	  case FI_LESS_U:	pr->u_longint = pr[0].u_longint <  pr[1].u_longint; break;
+	  case FI_LESS_EQ_U:	pr->u_longint = pr[0].u_longint <= pr[1].u_longint; break;
+	  case FI_GREATER_S:	pr->u_longint = pr[0].longint >  pr[1].longint; break;
+	  case FI_GREATER_EQ_S: pr->u_longint = pr[0].longint >= pr[1].longint; break;
+	  case FI_LESS_S:	pr->u_longint = pr[0].longint <  pr[1].longint; break;
+	  case FI_LESS_EQ_S:	pr->u_longint = pr[0].longint <= pr[1].longint; break;
+
+	  case FI_STRING_REL:
+	    cmp = strcmp(pr[0].string,pr[1].string);
+	    pr->u_longint = RelopResult(pi->relop,cmp);
+	    break;
 
-    switch (pf->un.variable.realtype) {
-      case V_ULLONG: return(Ptr2Unsigned(ptp,V_ULLONG,ptr));
-      case V_ULONG:  return(Ptr2Unsigned(ptp,V_ULONG,ptr));
-      case V_UINT:   return(Ptr2Unsigned(ptp,V_UINT,ptr));
-      case V_USHORT: return(Ptr2Unsigned(ptp,V_USHORT,ptr));
-      case V_UCHAR:  return(Ptr2Unsigned(ptp,V_UCHAR,ptr));
-      case V_BOOL:   return(Ptr2Unsigned(ptp,V_BOOL,ptr));
-      case V_UFUNC:
-      {   /* call the function */
-	  u_llong (*pfunc)(tcp_pair *ptp);
-	  pfunc = (u_llong (*)(tcp_pair *))(pf->un.variable.offset);
-	  return((*pfunc)(ptp));
-      }
-      default: {
-	  fprintf(stderr,
-		  "Filter eval error, can't convert variable type %s to unsigned\n",
-		  Vartype2Str(pf->un.variable.realtype));
-	  exit(-1);
-      }
+	  case FI_IPADDR_REL:
+	    cmp = IPcmp(pr[0].pipaddr,pr[1].pipaddr);
+	    /* always FALSE unless both the same type */
+	    if (cmp == -2)
+		pr->u_longint = FALSE;
+	    else
+		pr->u_longint = RelopResult(pi->relop,cmp);
+	    break;
+
+	  case FI_NOT:	pr->u_longint = !pr->u_longint; break;
+
+	  case FI_JUMP_FALSE:
+	    if (!pr->u_longint)
+		ix = pi->target;
+	    break;
+	  case FI_JUMP_TRUE:
+	    if (pr->u_longint)
+		ix = pi->target;
+	    break;
+	}
+
+	if (debug > 1)
+	    printf("RunFilterProg: %3d: %-14s r%u = %" FS_ULL "\n",
+		   (int)(pi - pprog->insns), Opcode2Str(pi->opcode),
+		   pi->reg, pr->u_longint);
     }
 }
+#undef PFIELD
 
 
-static u_llong
-Const2Unsigned(
-    struct filter_node *pf)
+static struct filter_insn *
+EmitInsn(
+    struct filter_prog *pprog,
+    enum filter_opcode opcode,
+    int reg)
 {
-    switch (pf->vartype) {
-      case V_ULLONG:	return((u_llong) pf->un.constant.u_longint);
-      case V_LLONG:	return((u_llong) pf->un.constant.longint);
-      default: {
-	  fprintf(stderr,
-		  "Filter eval error, can't convert constant type %d (%s) to unsigned\n",
-		  pf->vartype, Vartype2Str(pf->vartype));
-	  exit(-1);
-      }
+    struct filter_insn *pi;
+
+    if (pprog->ninsns == pprog->maxinsns) {
+	int new_max = (pprog->maxinsns == 0) ? 32 : pprog->maxinsns * 2;
+	pprog->insns = ReallocZ(pprog->insns,
+				pprog->maxinsns * sizeof(struct filter_insn),
+				new_max * sizeof(struct filter_insn));
+	pprog->maxinsns = new_max;
     }
+
+    /* binary operations look at reg+1 as well */
+    if (reg+2 > filter_nregs) {
+	filter_regs = ReallocZ(filter_regs,
+			       filter_nregs * sizeof(union Constant),
+			       (reg+2) * sizeof(union Constant));
+	filter_nregs = reg+2;
+    }
+
+    pi = &pprog->insns[pprog->ninsns++];
+    memset(pi, 0, sizeof(struct filter_insn));
+    pi->opcode = opcode;
+    pi->reg = reg;
+
+    return(pi);
 }
 
 
-static llong
-Const2Signed(
+/* can this subtree be computed before we ever see a connection? */
+static Bool
+IsConstTree(
     struct filter_node *pf)
 {
-    switch (pf->vartype) {
-      case V_ULLONG:	return((llong) pf->un.constant.u_longint);
-      case V_LLONG:	return((llong) pf->un.constant.longint);
-      default: {
-	  fprintf(stderr,
-		  "Filter eval error, can't convert constant type %d (%s) to signed\n",
-		  pf->vartype, Vartype2Str(pf->vartype));
-	  exit(-1);
+    switch (pf->op) {
+      case OP_CONSTANT:
+	return(TRUE);
+
+      case OP_VARIABLE:
+	return(FALSE);
+
+      case OP_NOT:
+      case OP_SIGNED:
+	return(IsConstTree(pf->un.unary.pf));
+
+      case OP_DIVIDE:
+      case OP_MOD: {
+	  /* leave dividing by zero to happen when it used to */
+	  struct filter_node *pright = pf->un.binary.right;
+	  while (pright->op == OP_SIGNED)
+	      pright = pright->un.unary.pf;
+	  if ((pright->op != OP_CONSTANT) ||
+	      (pright->un.constant.u_longint == 0))
+	      return(FALSE);
+	  return(IsConstTree(pf->un.binary.left));
       }
+
+      default:
+	return(IsConstTree(pf->un.binary.left) &&
+	       IsConstTree(pf->un.binary.right));
     }
 }
 
 
-static ipaddr *
-Const2Ipaddr(
+static enum filter_opcode
+RelopOpcode(
     struct filter_node *pf)
 {
-    switch (pf->vartype) {
-      case V_IPADDR:	return(pf->un.constant.pipaddr);
+    Bool sign;
+
+    switch (pf->un.binary.left->vartype) {
+      case V_STRING:	return(FI_STRING_REL);
+      case V_IPADDR:	return(FI_IPADDR_REL);
+      case V_ULLONG:	sign = FALSE; break;
+      case V_LLONG:	sign = TRUE; break;
       default: {
 	  fprintf(stderr,
-		  "Filter eval error, can't convert constant type %d (%s) to ipaddr\n",
-		  pf->vartype, Vartype2Str(pf->vartype));
+		  "CompileFilter: binary op %d (%s) not supported on data type %d (%s)\n",
+		  pf->op, Op2Str(pf->op),
+		  pf->vartype, Vartype2Str(pf->un.binary.left->vartype));
 	  exit(-1);
       }
     }
+
+    switch (pf->op) {
+      case OP_EQUAL:	  return(FI_EQUAL);
+      case OP_NEQUAL:	  return(FI_NEQUAL);
+      case OP_GREATER:	  return(sign?FI_GREATER_S:FI_GREATER_U);
+      case OP_GREATER_EQ: return(sign?FI_GREATER_EQ_S:FI_GREATER_EQ_U);
+      case OP_LESS:	  return(sign?FI_LESS_S:FI_LESS_U);
+      case OP_LESS_EQ:	  return(sign?FI_LESS_EQ_S:FI_LESS_EQ_U);
+      default:		  return(FI_CONST); /* not reached */
+    }
 }
 
 
-static void
-EvalMathopUnsigned(
-    tcp_pair *ptp,
-    struct filter_res *pres,
+static enum filter_opcode
+MathopOpcode(
     struct filter_node *pf)
 {
-    u_llong varl;
-    u_llong varr;
-    struct filter_res res;
-    u_llong ret;
-
-    /* grab left hand side */
-    EvalFilter(ptp,&res,pf->un.binary.left);
-    varl = res.val.u_longint;
+    Bool sign;
 
-    /* grab right hand side */
-    EvalFilter(ptp,&res,pf->un.binary.right);
-    varr = res.val.u_longint;
-
-    /* perform the operation */
-    switch (pf->op) {
-      case OP_PLUS:	  ret = (varl + varr); break;
-      case OP_MINUS:	  ret = (varl - varr); break;
-      case OP_TIMES:	  ret = (varl * varr); break;
-      case OP_DIVIDE:	  ret = (varl / varr); break;
-      case OP_MOD:	  ret = (varl % varr); break;
-      case OP_BAND:	  ret = (varl & varr); break;
-      case OP_BOR:	  ret = (varl | varr); break;
+    switch (pf->un.binary.left->vartype) {
+      case V_ULLONG:	sign = FALSE; break;
+      case V_LLONG:	sign = TRUE; break;
       default: {
-	  fprintf(stderr,"EvalMathodUnsigned: unsupported binary op: %d (%s)\n",
-		  pf->op, Op2Str(pf->op));
+	  fprintf(stderr,
+		  "CompileFilter: binary op %d (%s) not supported on data type %d (%s)\n",
+		  pf->op, Op2Str(pf->op),
+		  pf->vartype, Vartype2Str(pf->un.binary.left->vartype));
 	  exit(-1);
       }
     }
 
-    /* fill in the answer */
-    pres->vartype = V_ULLONG;
-    pres->val.u_longint = ret;
-
-	if (debug)
-		printf("EvalMathopUnsigned %" FS_ULL " %s %" FS_ULL " returns %s\n",
-
-	       varl, Op2Str(pf->op), varr,
-	       Res2Str(pres));
-
-
-    return;
+    switch (pf->op) {
+      case OP_PLUS:	return(FI_PLUS);
+      case OP_MINUS:	return(FI_MINUS);
+      case OP_TIMES:	return(FI_TIMES);
+      case OP_BAND:	return(FI_BAND);
+      case OP_BOR:	return(FI_BOR);
+      case OP_DIVIDE:	return(sign?FI_DIVIDE_S:FI_DIVIDE_U);
+      case OP_MOD:	return(sign?FI_MOD_S:FI_MOD_U);
+      default:		return(FI_CONST); /* not reached */
+    }
 }
 
 
-
 static void
-EvalMathopSigned(
-    tcp_pair *ptp,
-    struct filter_res *pres,
-    struct filter_node *pf)
+CompileVariable(
+    struct filter_prog *pprog,
+    struct filter_node *pf,
+    int reg)
 {
-    llong varl;
-    llong varr;
-    struct filter_res res;
-    llong ret;
+    enum filter_opcode opcode;
+    struct filter_insn *pi;
 
-    /* grab left hand side */
-    EvalFilter(ptp,&res,pf->un.binary.left);
-    varl = res.val.longint;
-
-    /* grab right hand side */
-    EvalFilter(ptp,&res,pf->un.binary.right);
-    varr = res.val.longint;
-
-    /* perform the operation */
-    switch (pf->op) {
-      case OP_PLUS:	  ret = (varl + varr); break;
-      case OP_MINUS:	  ret = (varl - varr); break;
-      case OP_TIMES:	  ret = (varl * varr); break;
-      case OP_DIVIDE:	  ret = (varl / varr); break;
-      case OP_MOD:	  ret = (varl % varr); break;
-      case OP_BAND:	  ret = (varl & varr); break;
-      case OP_BOR:	  ret = (varl | varr); break;
+    switch (pf->un.variable.realtype) {
+      case V_ULLONG:	opcode = FI_LD_ULLONG; break;
+      case V_ULONG:	opcode = FI_LD_ULONG; break;
+      case V_UINT:	opcode = FI_LD_UINT; break;
+      case V_USHORT:	opcode = FI_LD_USHORT; break;
+      case V_UCHAR:	opcode = FI_LD_UCHAR; break;
+      case V_BOOL:	opcode = FI_LD_BOOL; break;
+      case V_LLONG:	opcode = FI_LD_LLONG; break;
+      case V_LONG:	opcode = FI_LD_LONG; break;
+      case V_INT:	opcode = FI_LD_INT; break;
+      case V_SHORT:	opcode = FI_LD_SHORT; break;
+      case V_CHAR:	opcode = FI_LD_CHAR; break;
+      case V_STRING:	opcode = FI_LD_STRING; break;
+      case V_IPADDR:	opcode = FI_LD_IPADDR; break;
+      case V_FUNC:	opcode = FI_CALL_SIGNED; break;
+      case V_UFUNC:	opcode = FI_CALL_UNSIGNED; break;
       default: {
-	  fprintf(stderr,"EvalMathodSigned: unsupported binary op: %d (%s)\n",
-		  pf->op, Op2Str(pf->op));
+	  fprintf(stderr,"CompileVariable: unknown var type %d (%s)\n",
+		  pf->un.variable.realtype,
+		  Vartype2Str(pf->un.variable.realtype));
 	  exit(-1);
       }
     }
 
-    /* fill in the answer */
-    pres->vartype = V_LLONG;
-    pres->val.longint = ret;
-
-    if (debug)
-	printf("EvalMathopSigned %" FS_LL " %s %" FS_LL " returns %s\n",
-	       varl, Op2Str(pf->op), varr,
-	       Res2Str(pres));
-
-
-    return;
+    pi = EmitInsn(pprog,opcode,reg);
+    pi->offset = pf->un.variable.offset;
 }
 
 
-
-/* evaluate a leaf-node UNSigned NUMBER */
 static void
-EvalRelopUnsigned(
-    tcp_pair *ptp,
-    struct filter_res *pres,
-    struct filter_node *pf)
+CompileConstant(
+    struct filter_prog *pprog,
+    struct filter_node *pf,
+    int reg)
 {
-    u_llong varl;
-    u_llong varr;
-    struct filter_res res;
-    Bool ret;
+    struct filter_insn *pi;
 
-    /* grab left hand side */
-    EvalFilter(ptp,&res,pf->un.binary.left);
-    varl = res.val.u_longint;
+    pi = EmitInsn(pprog,FI_CONST,reg);
 
-    /* grab right hand side */
-    EvalFilter(ptp,&res,pf->un.binary.right);
-    varr = res.val.u_longint;
-
-    /* perform the operation */
-    switch (pf->op) {
-      case OP_GREATER:    ret = (varl >  varr); break;
-      case OP_GREATER_EQ: ret = (varl >= varr); break;
-      case OP_LESS:	  ret = (varl <  varr); break;
-      case OP_LESS_EQ:	  ret = (varl <= varr); break;
-      case OP_EQUAL:	  ret = (varl == varr); break;
-      case OP_NEQUAL:	  ret = (varl != varr); break;
+    switch (pf->vartype) {
+      case V_LLONG:	pi->val.longint = pf->un.constant.longint; break;
+      case V_ULLONG:	pi->val.u_longint = pf->un.constant.u_longint; break;
+      case V_STRING:	pi->val.string = pf->un.constant.string; break;
+      case V_IPADDR:	pi->val.pipaddr = pf->un.constant.pipaddr; break;
+      case V_BOOL:	pi->val.u_longint = (pf->un.constant.bool != 0); break;
       default: {
-	  fprintf(stderr,"EvalUnsigned: unsupported binary op: %d (%s)\n",
-		  pf->op, Op2Str(pf->op));
+	  fprintf(stderr,"CompileConstant: unknown constant type %d (%s)\n",
+		  pf->vartype, Vartype2Str(pf->vartype));
 	  exit(-1);
       }
     }
-
-    /* fill in the answer */
-    pres->vartype = V_BOOL;
-    pres->val.bool = ret;
-
-    if (debug)
-	printf("EvalUnsigned %" FS_ULL " %s %" FS_ULL " returns %s\n",
-	       varl, Op2Str(pf->op), varr,
-	       BOOL2STR(ret));
-
-
-    return;
 }
 
 
-
-/* evaluate a leaf-node Signed NUMBER */
+/* generate code that leaves the value of the subtree in register reg */
 static void
-EvalRelopSigned(
-    tcp_pair *ptp,
-    struct filter_res *pres,
-    struct filter_node *pf)
+CompileNode(
+    struct filter_prog *pprog,
+    struct filter_node *pf,
+    int reg)
 {
-    llong varl;
-    llong varr;
-    struct filter_res res;
-    Bool ret;
-
-    /* grab left hand side */
-    EvalFilter(ptp,&res,pf->un.binary.left);
-    varl = res.val.longint;
-
-    /* grab right hand side */
-    EvalFilter(ptp,&res,pf->un.binary.right);
-    varr = res.val.longint;
+    int start = pprog->ninsns;
+    int jump;
+    struct filter_insn *pi;
 
     switch (pf->op) {
-      case OP_GREATER:     ret = (varl >  varr); break;
-      case OP_GREATER_EQ:  ret = (varl >= varr); break;
-      case OP_LESS:        ret = (varl <  varr); break;
-      case OP_LESS_EQ:     ret = (varl <= varr); break;
-      case OP_EQUAL:       ret = (varl == varr); break;
-      case OP_NEQUAL:      ret = (varl != varr); break;
-      default: {
-	  fprintf(stderr,"EvalSigned: internal error\n");
-	  exit(-1);
-      }
-    }
-
-    /* fill in the answer */
-    pres->vartype = V_BOOL;
-    pres->val.bool = ret;
-
-    if (debug)
-	printf("EvalSigned %" FS_LL " %s %" FS_LL " returns %s\n",
-	       varl, Op2Str(pf->op), varr, 
-	       BOOL2STR(ret));
-
-    return;
-}
+      case OP_CONSTANT:
+	CompileConstant(pprog,pf,reg);
+	return;
 
+      case OP_VARIABLE:
+	CompileVariable(pprog,pf,reg);
+	return;
 
+      case OP_SIGNED:
+	/* same bits, it's only the later operations that care */
+	CompileNode(pprog,pf->un.unary.pf,reg);
+	return;
 
+      case OP_NOT:
+	CompileNode(pprog,pf->un.unary.pf,reg);
+	EmitInsn(pprog,FI_NOT,reg);
+	break;
 
-/* evaluate a leaf-node IPaddress */
-static void
-EvalRelopIpaddr(
-    tcp_pair *ptp,
-    struct filter_res *pres,
-    struct filter_node *pf)
-{
-    ipaddr *varl;
-    ipaddr *varr;
-    struct filter_res res;
-    int result;
-    Bool ret;
+      case OP_AND:
+      case OP_OR:
+	CompileNode(pprog,pf->un.binary.left,reg);
+
+	/* a constant left side decides it, or doesn't matter */
+	if ((pprog->ninsns == start+1) &&
+	    (pprog->insns[start].opcode == FI_CONST)) {
+	    Bool left = (pprog->insns[start].val.u_longint != 0);
+	    if ((pf->op == OP_AND) ? !left : left)
+		return;
+	    pprog->ninsns = start;
+	    CompileNode(pprog,pf->un.binary.right,reg);
+	    return;
+	}
 
-     /* grab left hand side */
-     EvalFilter(ptp,&res,pf->un.binary.left);
-     varl = res.val.pipaddr;
-
-     /* grab right hand side */
-     EvalFilter(ptp,&res,pf->un.binary.right);
-     varr = res.val.pipaddr;
-
-     /* compare the 2 addresses */
-     result = IPcmp(varl,varr);
-
-     /* always evaluates FALSE unless both same type */
-     if (result == -2) {
-	 if (debug) {
-	     printf("EvalIpaddr %s", HostAddr(*varl));
-	     printf("%s fails, different addr types\n",
-		    HostAddr(*varr));
-	 }
-	 ret = FALSE;
-     } else {
-	 switch (pf->op) {
-	   case OP_GREATER:     ret = (result >  0); break;
-	   case OP_GREATER_EQ:  ret = (result >= 0); break;
-	   case OP_LESS:        ret = (result <  0); break;
-	   case OP_LESS_EQ:     ret = (result <= 0); break;
-	   case OP_EQUAL:       ret = (result == 0); break;
-	   case OP_NEQUAL:      ret = (result != 0); break;
-	   default: {
-	       fprintf(stderr,"EvalIpaddr: internal error\n");
-	       exit(-1);
-	   }
-	 }
-     }
-
-     /* fill in the answer */
-     pres->vartype = V_BOOL;
-     pres->val.bool = ret;
-
-     if (debug) {
-	 printf("EvalIpaddr %s %s", HostAddr(*varl), Op2Str(pf->op));
-	 printf("%s returns %s\n", HostAddr(*varr), BOOL2STR(ret));
-     }
-
-     return;
- }
-
-
-
-
-/* evaluate a leaf-node string */
-static void
-EvalRelopString(
-    tcp_pair *ptp,
-    struct filter_res *pres,
-    struct filter_node *pf)
-{
-    char *varl;
-    char *varr;
-    struct filter_res res;
-    Bool ret;
-    int cmp;
+	/* only look at the right side if we still need to */
+	jump = pprog->ninsns;
+	EmitInsn(pprog,(pf->op == OP_AND)?FI_JUMP_FALSE:FI_JUMP_TRUE, reg);
+	CompileNode(pprog,pf->un.binary.right,reg);
+	pprog->insns[jump].target = pprog->ninsns;
+	break;
 
-    /* grab left hand side */
-    EvalFilter(ptp,&res,pf->un.binary.left);
-    varl = res.val.string;
+      case OP_EQUAL:
+      case OP_NEQUAL:
+      case OP_GREATER:
+      case OP_GREATER_EQ:
+      case OP_LESS:
+      case OP_LESS_EQ:
+	CompileNode(pprog,pf->un.binary.left,reg);
+	CompileNode(pprog,pf->un.binary.right,reg+1);
+	pi = EmitInsn(pprog,RelopOpcode(pf),reg);
+	pi->relop = pf->op;
+	break;
 
-    /* grab right hand side */
-    EvalFilter(ptp,&res,pf->un.binary.right);
-    varr = res.val.string;
+      case OP_PLUS:
+      case OP_MINUS:
+      case OP_TIMES:
+      case OP_DIVIDE:
+      case OP_MOD:
+      case OP_BAND:
+      case OP_BOR:
+	CompileNode(pprog,pf->un.binary.left,reg);
+	CompileNode(pprog,pf->un.binary.right,reg+1);
+	EmitInsn(pprog,MathopOpcode(pf),reg);
+	break;
 
-    /* compare the strings */
-    cmp = strcmp(varl,varr);
- 
-    switch (pf->op) {
-      case OP_GREATER:	   ret = (cmp >  0); break;
-      case OP_GREATER_EQ:  ret = (cmp >= 0); break;
-      case OP_LESS:	   ret = (cmp <  0); break;
-      case OP_LESS_EQ:	   ret = (cmp <= 0); break;
-      case OP_EQUAL:	   ret = (cmp == 0); break;
-      case OP_NEQUAL:	   ret = (cmp != 0); break;
-      default: {
-	  fprintf(stderr,"EvalRelopString: unsupported operating %d (%s)\n",
-		  pf->op, Op2Str(pf->op));
-	  exit(-1);
-      }
+      default:
+	fprintf(stderr,
+		"CompileNode: operation %d (%s) not supported on data type %d (%s)\n",
+		pf->op,Op2Str(pf->op),
+		pf->vartype,Vartype2Str(pf->vartype));
+	exit(-1);
     }
 
-    /* fill in the answer */
-    pres->vartype = V_BOOL;
-    pres->val.bool = ret;
-
-    if (debug)
-	printf("EvalString '%s' %s '%s' returns %s\n",
-	       varl, Op2Str(pf->op), varr, 
-	       BOOL2STR(ret));
+    /* fold constant subtrees by running them now and keeping the answer */
+    if (IsConstTree(pf)) {
+	union Constant val;
 
-    return;
+	RunFilterProg(pprog,NULL,start,pprog->ninsns);
+	val = filter_regs[reg];
+	pprog->ninsns = start;
+	pi = EmitInsn(pprog,FI_CONST,reg);
+	pi->val = val;
+    }
 }
 
 
-static void
-EvalVariable(
-    tcp_pair *ptp,
-    struct filter_res *pres,
+/* does the subtree only use things we know from a connection's */
+/* first packet (addresses, ports, and names)? */
+static Bool
+IsEarlyTree(
     struct filter_node *pf)
 {
-    switch (pf->vartype) {
-      case V_CHAR:	
-      case V_SHORT:	
-      case V_INT:	
-      case V_LONG:	
-      case V_LLONG:	
-	pres->vartype = V_LLONG;
-	pres->val.u_longint = Var2Signed(ptp,pf);
-	break;
-
-      case V_UCHAR:	
-      case V_USHORT:	
-      case V_UINT:	
-      case V_ULONG:	
-      case V_ULLONG:	
-	pres->vartype = V_ULLONG;
-	pres->val.longint = Var2Unsigned(ptp,pf);
-	break;
-
-      case V_STRING:	
-	pres->vartype = V_STRING;
-	pres->val.string = Var2String(ptp,pf);
-	break;
+    switch (pf->op) {
+      case OP_CONSTANT:
+	return(TRUE);
 
-      case V_BOOL:
-	pres->vartype = V_BOOL;
-	pres->val.bool = (Var2Unsigned(ptp,pf) != 0);
-	break;
+      case OP_VARIABLE:
+	return(pf->un.variable.early);
 
-      case V_IPADDR:
-	pres->vartype = V_IPADDR;
-	pres->val.pipaddr = Var2Ipaddr(ptp,pf);
-	break;
+      case OP_NOT:
+      case OP_SIGNED:
+	return(IsEarlyTree(pf->un.unary.pf));
 
       default:
-	fprintf(stderr,"EvalVariable: unknown var type %d (%s)\n",
-		pf->vartype, Vartype2Str(pf->vartype));
-	exit(-1);
+	return(IsEarlyTree(pf->un.binary.left) &&
+	       IsEarlyTree(pf->un.binary.right));
     }
-
 }
 
 
-
-static void
-EvalConstant(
-    tcp_pair *ptp,
-    struct filter_res *pres,
+/* Find a condition that every connection passing the filter must also */
+/* pass, built only from early subtrees, so that a connection failing */
+/* it can be ignored as soon as it's seen.  NULL means there isn't one */
+static struct filter_node *
+EarlyCondition(
     struct filter_node *pf)
 {
-    switch (pf->vartype) {
-      case V_CHAR:	
-      case V_SHORT:	
-      case V_INT:	
-      case V_LONG:	
-      case V_LLONG:	
-	pres->vartype = V_LLONG;
-	pres->val.u_longint = Const2Signed(pf);
-	break;
-
-      case V_UCHAR:	
-      case V_USHORT:	
-      case V_UINT:	
-      case V_ULONG:	
-      case V_ULLONG:	
-	pres->vartype = V_LLONG;
-	pres->val.longint = Const2Unsigned(pf);
-	break;
+    struct filter_node *left;
+    struct filter_node *right;
 
-      case V_STRING:	
-	pres->vartype = V_STRING;
-	pres->val.string = pf->un.constant.string;
-	break;
+    if (IsEarlyTree(pf))
+	return(pf);
 
-      case V_BOOL:
-	pres->vartype = V_BOOL;
-	pres->val.bool = (Var2Unsigned(ptp,pf) != 0);
-	break;
+    switch (pf->op) {
+      case OP_AND:
+	/* either half is enough */
+	left = EarlyCondition(pf->un.binary.left);
+	right = EarlyCondition(pf->un.binary.right);
+	if (left == NULL)
+	    return(right);
+	if (right == NULL)
+	    return(left);
+	return(MakeConjunction(left,right));
 
-      case V_IPADDR:
-	pres->vartype = V_IPADDR;
-	pres->val.pipaddr = Const2Ipaddr(pf);
-	break;
+      case OP_OR:
+	/* need something from both halves */
+	left = EarlyCondition(pf->un.binary.left);
+	right = EarlyCondition(pf->un.binary.right);
+	if ((left == NULL) || (right == NULL))
+	    return(NULL);
+	return(MakeDisjunction(left,right));
 
       default:
-	fprintf(stderr,"EvalConstant: unknown var type %d (%s)\n",
-		pf->vartype, Vartype2Str(pf->vartype));
+	/* anything else depends on the whole connection */
+	return(NULL);
     }
-
 }
-    
-
 
 
 static void
-EvalFilter(
-    tcp_pair *ptp,
-    struct filter_res *pres,
-    struct filter_node *pf)
+CompileFilter(
+    struct filter_node *root)
 {
-    struct filter_res res;
-    
-    if (!pf) {
-	fprintf(stderr,"EvalFilter called with NULL!!!\n");
-	exit(-1);
-    }
+    struct filter_node *early;
+
+    filter_prog.ninsns = 0;
+    CompileNode(&filter_prog,root,0);
 
-    /* variables are easy */
-    if (pf->op == OP_VARIABLE) {
-	EvalVariable(ptp,pres,pf);
+    if (debug)
+	PrintFilterProg("Filter",&filter_prog);
+
+    /* if the whole thing is early, just run it sooner */
+    early_prog.ninsns = 0;
+    early = EarlyCondition(root);
+    if (early == NULL) {
+	pearly_check = NULL;
+	return;
+    } else if (early == root) {
+	pearly_check = &filter_prog;
 	return;
     }
 
-    /* constants are easy */
-    if (pf->op == OP_CONSTANT) {
-	EvalConstant(ptp,pres,pf);
-	return;
+    CompileNode(&early_prog,early,0);
+    pearly_check = &early_prog;
+
+    if (debug) {
+	printf("Early filter: %s\n", Filter2Str(early));
+	PrintFilterProg("Early filter",&early_prog);
     }
+}
 
-    switch (pf->op) {
-      case OP_EQUAL:
-      case OP_NEQUAL:
-      case OP_GREATER:
-      case OP_GREATER_EQ:
-      case OP_LESS:
-      case OP_LESS_EQ:
-	if (pf->un.binary.left->vartype == V_ULLONG) {
-	    EvalRelopUnsigned(ptp,&res,pf);
-	    pres->vartype = V_BOOL;
-	    pres->val.bool = res.val.bool;
-	} else if (pf->un.binary.left->vartype == V_LLONG) {
-	    EvalRelopSigned(ptp,&res,pf);
-	    pres->vartype = V_BOOL;
-	    pres->val.bool = res.val.bool;
-	} else if (pf->un.binary.left->vartype == V_STRING) {
-	    EvalRelopString(ptp,&res,pf);
-	    pres->vartype = V_LLONG;
-	    pres->val.longint = res.val.longint;
-	} else if (pf->un.binary.left->vartype == V_IPADDR) {
-	    EvalRelopIpaddr(ptp,&res,pf);
-	    pres->vartype = V_BOOL;
-	    pres->val.bool = res.val.bool;
-	} else {
-	    fprintf(stderr,
-		    "EvalFilter: binary op %d (%s) not supported on data type %d (%s)\n",
-		    pf->op, Op2Str(pf->op),
-		    pf->vartype, Vartype2Str(pf->un.binary.left->vartype));
-	    exit(-1);
-	}
-	break;
 
-      case OP_PLUS:
-      case OP_MINUS:
-      case OP_TIMES:
-      case OP_DIVIDE:
-      case OP_MOD:
-      case OP_BAND:
-      case OP_BOR:
-	if (pf->un.binary.left->vartype == V_ULLONG) {
-	    EvalMathopUnsigned(ptp,&res,pf);
-	    pres->vartype = V_ULLONG;
-	    pres->val.u_longint = res.val.u_longint;
-	} else if (pf->un.binary.left->vartype == V_LLONG) {
-	    EvalMathopSigned(ptp,&res,pf);
-	    pres->vartype = V_LLONG;
-	    pres->val.longint = res.val.longint;
-	} else {
-	    fprintf(stderr,
-		    "EvalFilter: binary op %d (%s) not supported on data type %d (%s)\n",
-		    pf->op, Op2Str(pf->op),
-		    pf->vartype, Vartype2Str(pf->un.binary.left->vartype));
-	    exit(-1);
-	}
-	break;
 
-      case OP_AND:
-      case OP_OR:
-	if (pf->vartype == V_BOOL) {
-	    struct filter_res res1;
-	    struct filter_res res2;
-	    Bool ret;
-	    if (pf->op == OP_OR) {
-		EvalFilter(ptp,&res1,pf->un.binary.left);
-		EvalFilter(ptp,&res2,pf->un.binary.right);
-		ret = res1.val.bool || res2.val.bool;
-	    } else {
-		EvalFilter(ptp,&res1,pf->un.binary.left);
-		EvalFilter(ptp,&res2,pf->un.binary.right);
-		ret = res1.val.bool &&  res2.val.bool;
-	    }
-	    pres->vartype = V_BOOL;
-	    pres->val.bool = ret;
-	} else {
-	    fprintf(stderr,
-		    "EvalFilter: binary op %d (%s) not supported on data type %d (%s)\n",
-		    pf->op, Op2Str(pf->op),
-		    pf->vartype, Vartype2Str(pf->un.binary.left->vartype));
-	    exit(-1);
-	}
-	break;
 
-      case OP_NOT:
-	if (pf->vartype == V_BOOL) {
-	    EvalFilter(ptp,&res,pf->un.unary.pf);
-	    pres->vartype = V_BOOL;
-	    pres->val.bool = !res.val.bool;
-	} else {
-	    fprintf(stderr,
-		    "EvalFilter: unary operation %d (%s) not supported on data type %d (%s)\n",
-		    pf->op, Op2Str(pf->op),
-		    pf->vartype, Vartype2Str(pf->vartype));
-	    exit(-1);
-	}
-	break;
+Bool
+PassesFilter(
+    tcp_pair *ptp)
+{
+    Bool ret;
 
-      default:
-	fprintf(stderr,
-		"EvalFilter: operation %d (%s) not supported on data type %d (%s)\n",
-		pf->op,Op2Str(pf->op),
-		pf->vartype,Vartype2Str(pf->vartype));
-	exit(-1);
-    }
+    RunFilterProg(&filter_prog,ptp,0,filter_prog.ninsns);
+    ret = (filter_regs[0].u_longint != 0);
 
     if (debug)
-	printf("EvalFilter('%s') returns %s\n",
-	       Filter2Str(pf),Res2Str(pres));
+	printf("PassesFilter('%s<->%s') returns %s\n",
+	       ptp->a_endpoint, ptp->b_endpoint,
+	       BOOL2STR(ret));
 
-    return;
+    return(ret);
 }
 
 
-
-
+/* called as soon as a connection is created, if this fails then */
+/* PassesFilter() will too and there's no point analyzing it */
 Bool
-PassesFilter(
+PassesEarlyFilter(
     tcp_pair *ptp)
 {
-    struct filter_res res;
+    struct filter_prog *pprog = pearly_check;
     Bool ret;
 
-    /* recurse down the tree */
-    EvalFilter(ptp,&res,filter_root);
-    ret = res.val.bool;
+    if (pprog == NULL)
+	return(TRUE);
+
+    RunFilterProg(pprog,ptp,0,pprog->ninsns);
+    ret = (filter_regs[0].u_longint != 0);
 
     if (debug)
-	printf("PassesFilter('%s<->%s') returns %s\n",
+	printf("PassesEarlyFilter('%s<->%s') returns %s\n",
 	       ptp->a_endpoint, ptp->b_endpoint,
 	       BOOL2STR(ret));
 
@@ -1733,6 +1610,9 @@ InstallFilter(
 	exit(-1);
     }
     filter_root = root;
+
+    /* this is what actually gets run for each connection */
+    CompileFilter(root);
 }
 
 
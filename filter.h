@@ -129,6 +129,7 @@ struct Variable {
     u_long 	offset;
     Bool	fclient;	/* from the client or server side? */
     enum vartype realtype;
+    Bool	early;		/* known from the first packet */
 };
 
 /* Binary - binary operation */
@@ -157,10 +158,76 @@ struct filter_node {
 };
 
 
-/* the result of executing a filter node */
-struct filter_res {
-    enum vartype vartype;
-    union Constant val;
+/* a filter tree is compiled once into a flat program of these */
+/* instructions (see CompileFilter()).  Each one works on a register, */
+/* and binary operations take their right operand from the next one */
+enum filter_opcode {
+    /* load a constant */
+    FI_CONST	  = 1,
+
+    /* load a field of the connection, by its real type */
+    FI_LD_ULLONG,
+    FI_LD_ULONG,
+    FI_LD_UINT,
+    FI_LD_USHORT,
+    FI_LD_UCHAR,
+    FI_LD_BOOL,
+    FI_LD_LLONG,
+    FI_LD_LONG,
+    FI_LD_INT,
+    FI_LD_SHORT,
+    FI_LD_CHAR,
+    FI_LD_STRING,
+    FI_LD_IPADDR,
+
+    /* call a function for a calculated value */
+    FI_CALL_SIGNED,
+    FI_CALL_UNSIGNED,
+
+    /* arithmetic */
+    FI_PLUS,
+    FI_MINUS,
+    FI_TIMES,
+    FI_BAND,
+    FI_BOR,
+    FI_DIVIDE_U,
+    FI_MOD_U,
+    FI_DIVIDE_S,
+    FI_MOD_S,
+
+    /* comparisons, leaving 0 or 1 */
+    FI_EQUAL,
+    FI_NEQUAL,
+    FI_GREATER_U,
+    FI_GREATER_EQ_U,
+    FI_LESS_U,
+    FI_LESS_EQ_U,
+    FI_GREATER_S,
+    FI_GREATER_EQ_S,
+    FI_LESS_S,
+    FI_LESS_EQ_S,
+    FI_STRING_REL,		/* relop given in the instruction */
+    FI_IPADDR_REL,		/* relop given in the instruction */
+
+    /* booleans */
+    FI_NOT,
+    FI_JUMP_FALSE,		/* for AND */
+    FI_JUMP_TRUE		/* for OR */
+};
+
+struct filter_insn {
+    enum filter_opcode opcode;
+    u_short	reg;		/* result (and left operand) register */
+    enum optype	relop;		/* for string and address comparisons */
+    u_long	offset;		/* field offset or function, like Variable */
+    int		target;		/* where a jump goes */
+    union Constant val;		/* for FI_CONST */
+};
+
+struct filter_prog {
+    struct filter_insn *insns;
+    int		ninsns;
+    int		maxinsns;
 };
 
 
@@ -171,6 +238,7 @@ struct filter_line {
     void 	*cl_addr;	/* address when in client */
     void 	*sv_addr;	/* address when in server */
     char	*descr;		/* brief description */
+    Bool	early;		/* known as soon as the connection is seen */
 };
 
 
@@ -62,9 +62,9 @@ static tcp_pair ptp_dummy;
 #define PTP(a,b)	&ptp_dummy.a,&ptp_dummy.b
 #define PTPA(a,b)	&ptp_dummy.addr_pair.a,&ptp_dummy.addr_pair.b
 struct filter_line filters[] = {
-    {"hostname",	V_STRING, PTP(a_hostname,b_hostname),"FQDN host name (unless -n)"},
-    {"portname",	V_STRING, PTP(a_portname,b_portname),"service name of the port (unless -n)"},
-    {"port",		V_USHORT, PTPA(a_port,b_port),"port NUMBER"},
+    {"hostname",	V_STRING, PTP(a_hostname,b_hostname),"FQDN host name (unless -n)",TRUE},
+    {"portname",	V_STRING, PTP(a_portname,b_portname),"service name of the port (unless -n)",TRUE},
+    {"port",		V_USHORT, PTPA(a_port,b_port),"port NUMBER",TRUE},
 
     {"mss",		V_INT,	PTCB_C_S(mss),"maximum segment size"},
     {"f1323_ws",	V_BOOL,	PTCB_C_S(f1323_ws),"1323 window scaling requested"},
@@ -138,7 +138,7 @@ struct filter_line filters[] = {
    /* HOST IP addresses */
     {"hostaddr",	V_IPADDR,
      PTP(addr_pair.a_address, addr_pair.b_address),
-     "IP Address (v4 or v6 in standard textual notation"},
+     "IP Address (v4 or v6 in standard textual notation",TRUE},
 
     /* computed functions */
 
@@ -0,0 +1,427 @@
+/*
+ * Copyright (c) 1994, 1995, 1996, 1997, 1998, 1999, 2000, 2001,
+ *               2002, 2003, 2004
+ *      Ohio University.
+ *
+ * ---
+ *
+ * Starting with the release of tcptrace version 6 in 2001, tcptrace
+ * is licensed under the GNU General Public License (GPL).  We believe
+ * that, among the available licenses, the GPL will do the best job of
+ * allowing tcptrace to continue to be a valuable, freely-available
+ * and well-maintained tool for the networking community.
+ *
+ * Previous versions of tcptrace were released under a license that
+ * was much less restrictive with respect to how tcptrace could be
+ * used in commercial products.  Because of this, I am willing to
+ * consider alternate license arrangements as allowed in Section 10 of
+ * the GNU GPL.  Before I would consider licensing tcptrace under an
+ * alternate agreement with a particular individual or company,
+ * however, I would have to be convinced that such an alternative
+ * would be to the greater benefit of the networking community.
+ * 
+ * ---
+ *
+ * This file is part of Tcptrace.
+ *
+ * Tcptrace was originally written and continues to be maintained by
+ * Shawn Ostermann with the help of a group of devoted students and
+ * users (see the file 'THANKS').  The work on tcptrace has been made
+ * possible over the years through the generous support of NASA GRC,
+ * the National Science Foundation, and Sun Microsystems.
+ *
+ * Tcptrace is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tcptrace is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tcptrace (in the file 'COPYING'); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ * Author:      Shawn Ostermann
+ *              School of Electrical Engineering and Computer Science
+ *              Ohio University
+ *              Athens, OH
+ *              http://www.tcptrace.org/
+ */
+#include "tcptrace.h"
+static char const GCC_UNUSED copyright[] =
+    "@(#)Copyright (c) 2004 -- Ohio University.\n";
+static char const GCC_UNUSED rcsid[] =
+    "@(#)$Header$";
+
+
+
+
+/*
+ * live.c -- capture packets from a network interface (--live)
+ *
+ * Rather than reading a file, packets are taken straight from a Linux
+ * AF_PACKET socket with a TPACKET_V3 receive ring.  The ring is a set
+ * of blocks that the kernel fills with packets and hands over to us
+ * whole; we leave each packet where it is, handing out pointers into
+ * the block, and give the block back once we've moved on to the next
+ * one.  Blocks that don't fill up are handed over after LIVE_BLOCK_TMO
+ * milliseconds anyway, so a quiet interface doesn't hold packets back.
+ *
+ * LiveRead() looks just like any other pread_f routine, so the packets
+ * go through the normal analysis (always in real-time mode, since a
+ * capture has no end).  It returns EOF on SIGINT, after which the
+ * kernel's counts of packets it had to drop for lack of room in the
+ * ring are available from LiveStats().
+ */
+
+#ifdef __linux__
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#endif /* __linux__ */
+
+/* TPACKET_V3 arrived in Linux 3.2, along with this */
+#ifdef TP_STATUS_BLK_TMO
+#define HAVE_TPACKET_V3
+#endif
+
+
+#ifdef HAVE_TPACKET_V3
+
+/* tuning */
+#define LIVE_BLOCK_SIZE	(1024*1024)	/* bytes per ring block */
+#define LIVE_FRAME_SIZE	2048		/* nominal, V3 frames are packed */
+#define LIVE_BLOCK_TMO	100		/* ms before a partial block is ours */
+#define LIVE_WAIT_TMO	1		/* seconds to wait in pselect() */
+
+/* the ring and where we are in it */
+static struct live {
+    int			fd;
+    char		*ring;
+    u_int		block_nr;
+    u_int		block;		/* the one we're reading (or waiting for) */
+    Bool		holding;	/* ... and it's ours, not the kernel's */
+    u_int		left;		/* packets left in it */
+    struct tpacket3_hdr	*ppkt;		/* the next of them */
+    int			ifindex;
+    Bool		loopback;	/* sees everything twice */
+
+    /* from the kernel (PACKET_STATISTICS resets them when read) */
+    u_long		packets;
+    u_long		drops;
+    u_long		freezes;
+} live;
+
+/* for links without an ethernet header of their own */
+static struct ether_header live_eth;
+
+static volatile sig_atomic_t live_stop = 0;
+
+
+/* local routines */
+static int LiveRead(struct timeval *, int *, int *, void **,
+		    int *, struct ip **, void **);
+static void LiveSig(int signum);
+static void LiveGetStats(void);
+
+
+
+#define LIVE_BLOCK(ix) \
+    ((struct tpacket_block_desc *)(live.ring + (ix) * LIVE_BLOCK_SIZE))
+
+
+/* read the next IP packet from the ring, returns 0 on SIGINT */
+static int
+LiveRead(
+    struct timeval	*ptime,
+    int		 	*plen,
+    int		 	*ptlen,
+    void		**pphys,
+    int			*pphystype,
+    struct ip		**ppip,
+    void		**pplast)
+{
+    struct tpacket_block_desc *pbd;
+    struct tpacket3_hdr *ppkt;
+    struct sockaddr_ll *psll;
+    char *pmac;
+    char *pnet;
+    u_short proto;
+
+    while (1) {
+	if (live_stop)
+	    return(0);
+
+	if (live.left == 0) {
+	    /* done with this block, the kernel can have it back */
+	    if (live.holding) {
+		LIVE_BLOCK(live.block)->hdr.bh1.block_status = TP_STATUS_KERNEL;
+		live.holding = FALSE;
+		live.block = (live.block + 1) % live.block_nr;
+	    }
+
+	    /* wait until the next one is ours */
+	    pbd = LIVE_BLOCK(live.block);
+	    /* (ProcessPackets() keeps SIGINT blocked, so let it in */
+	    /*  while we wait) */
+	    while ((pbd->hdr.bh1.block_status & TP_STATUS_USER) == 0) {
+		struct timespec ts;
+		sigset_t mask;
+		fd_set fds;
+
+		if (live_stop)
+		    return(0);
+
+		sigprocmask(SIG_BLOCK, NULL, &mask);
+		sigdelset(&mask, SIGINT);
+		FD_ZERO(&fds);
+		FD_SET(live.fd, &fds);
+		ts.tv_sec = LIVE_WAIT_TMO;
+		ts.tv_nsec = 0;
+		if ((pselect(live.fd + 1, &fds, NULL, NULL, &ts, &mask) < 0) &&
+		    (errno != EINTR)) {
+		    perror("pselect");
+		    return(0);
+		}
+	    }
+
+	    live.holding = TRUE;
+	    live.left = pbd->hdr.bh1.num_pkts;
+	    live.ppkt = (struct tpacket3_hdr *)
+		((char *)pbd + pbd->hdr.bh1.offset_to_first_pkt);
+	    if (live.left == 0)
+		continue;
+	}
+
+	ppkt = live.ppkt;
+	--live.left;
+	live.ppkt = (struct tpacket3_hdr *)((char *)ppkt + ppkt->tp_next_offset);
+
+	/* the link level address follows the header */
+	psll = (struct sockaddr_ll *)
+	    ((char *)ppkt + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+	proto = ntohs(psll->sll_protocol);
+
+	/* if it's not IP, then skip it */
+	if ((proto != ETH_P_IP) && (proto != ETH_P_IPV6)) {
+	    if (debug > 2)
+		fprintf(stderr,"LiveRead: not an IP packet\n");
+	    continue;
+	}
+
+	/* on loopback, we'd see each one going out and coming back in */
+	if (live.loopback && (psll->sll_pkttype == PACKET_OUTGOING))
+	    continue;
+
+	pmac = (char *)ppkt + ppkt->tp_mac;
+	pnet = (char *)ppkt + ppkt->tp_net;
+
+	/* use the ethernet header if there is one, else pretend */
+	if (pnet - pmac == sizeof(struct ether_header)) {
+	    *pphys = pmac;
+	} else {
+	    live_eth.ether_type = htons(proto);
+	    *pphys = &live_eth;
+	}
+	*pphystype = PHYS_ETHER;
+	*ppip      = (struct ip *)pnet;
+	*pplast    = pmac + ppkt->tp_snaplen - 1; /* last byte in IP packet */
+	ptime->tv_sec  = ppkt->tp_sec;
+	ptime->tv_usec = ppkt->tp_nsec / 1000;
+	*plen      = ppkt->tp_len;
+	*ptlen     = ppkt->tp_snaplen;
+
+	return(1);
+    }
+}
+
+
+/* SIGINT ends the capture, the way EOF ends a file */
+static void
+LiveSig(
+    int signum)
+{
+    live_stop = 1;
+}
+
+
+/* fold in the kernel's counters (which start over each time we ask) */
+static void
+LiveGetStats(void)
+{
+    struct tpacket_stats_v3 st;
+    socklen_t len = sizeof(st);
+
+    if (live.fd < 0)
+	return;
+
+    if (getsockopt(live.fd, SOL_PACKET, PACKET_STATISTICS, &st, &len) != 0) {
+	perror("getsockopt(PACKET_STATISTICS)");
+	return;
+    }
+    live.packets += st.tp_packets;	/* (already includes the drops) */
+    live.drops += st.tp_drops;
+    live.freezes += st.tp_freeze_q_cnt;
+}
+
+
+/* open the interface and set up the ring, returns the reading routine */
+pread_f *
+LiveStart(
+    char *ifname)
+{
+    struct tpacket_req3 req;
+    struct sockaddr_ll sll;
+    struct packet_mreq mr;
+    struct ifreq ifr;
+    int version = TPACKET_V3;
+    size_t ring_size;
+
+    memset(&live, 0, sizeof(live));
+    live.fd = -1;
+
+    if ((live.ifindex = if_nametoindex(ifname)) == 0) {
+	perror(ifname);
+	exit(1);
+    }
+
+    /* no protocol yet, so nothing arrives before the ring is ready */
+    if ((live.fd = socket(AF_PACKET, SOCK_RAW, 0)) < 0) {
+	perror("socket(AF_PACKET)");
+	fprintf(stderr,"(live capture usually needs root or CAP_NET_RAW)\n");
+	exit(1);
+    }
+
+    if (setsockopt(live.fd, SOL_PACKET, PACKET_VERSION,
+		   &version, sizeof(version)) != 0) {
+	perror("setsockopt(PACKET_VERSION)");
+	exit(1);
+    }
+
+    live.block_nr = (live_ring_size * 1024 * 1024) / LIVE_BLOCK_SIZE;
+    if (live.block_nr < 2)
+	live.block_nr = 2;
+    ring_size = (size_t)live.block_nr * LIVE_BLOCK_SIZE;
+
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = LIVE_BLOCK_SIZE;
+    req.tp_block_nr = live.block_nr;
+    req.tp_frame_size = LIVE_FRAME_SIZE;
+    req.tp_frame_nr = ring_size / LIVE_FRAME_SIZE;
+    req.tp_retire_blk_tov = LIVE_BLOCK_TMO;
+    if (setsockopt(live.fd, SOL_PACKET, PACKET_RX_RING,
+		   &req, sizeof(req)) != 0) {
+	perror("setsockopt(PACKET_RX_RING)");
+	exit(1);
+    }
+
+    live.ring = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		     live.fd, 0);
+    if (live.ring == MAP_FAILED) {
+	perror("mmap");
+	exit(1);
+    }
+
+    /* loopback needs special handling (see LiveRead()) */
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name) - 1);
+    if ((ioctl(live.fd, SIOCGIFFLAGS, &ifr) == 0) &&
+	(ifr.ifr_flags & IFF_LOOPBACK))
+	live.loopback = TRUE;
+
+    /* now start taking everything */
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex = live.ifindex;
+    if (bind(live.fd, (struct sockaddr *)&sll, sizeof(sll)) != 0) {
+	perror(ifname);
+	exit(1);
+    }
+
+    /* not fatal, we'll still see this host's own traffic */
+    memset(&mr, 0, sizeof(mr));
+    mr.mr_ifindex = live.ifindex;
+    mr.mr_type = PACKET_MR_PROMISC;
+    if (setsockopt(live.fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP,
+		   &mr, sizeof(mr)) != 0) {
+	if (debug)
+	    perror("setsockopt(PACKET_MR_PROMISC)");
+    }
+
+    /* throw away anything counted before the ring was bound */
+    LiveGetStats();
+    live.packets = live.drops = live.freezes = 0;
+
+    signal(SIGINT, LiveSig);
+
+    if (debug)
+	fprintf(stderr,"LiveStart: %u blocks of %u bytes on '%s'%s\n",
+		live.block_nr, LIVE_BLOCK_SIZE, ifname,
+		live.loopback?" (loopback)":"");
+
+    return(LiveRead);
+}
+
+
+void
+LiveStop(void)
+{
+    if (live.fd < 0)
+	return;
+
+    LiveGetStats();
+    signal(SIGINT, SIG_DFL);
+
+    munmap(live.ring, (size_t)live.block_nr * LIVE_BLOCK_SIZE);
+    close(live.fd);
+    live.fd = -1;
+}
+
+
+void
+LiveStats(void)
+{
+    LiveGetStats();
+
+    fprintf(stdout,
+	    "%skernel ring: %lu packets received, %lu dropped (ring full %lu times)\n",
+	    comment, live.packets, live.drops, live.freezes);
+    fprintf(stdout,"%s%lu packets were too short to process\n",
+	    comment, ctrunc);
+}
+
+
+#else /* HAVE_TPACKET_V3 */
+
+
+pread_f *
+LiveStart(
+    char *ifname)
+{
+    fprintf(stderr,
+	    "Sorry, live capture needs Linux AF_PACKET sockets (TPACKET_V3)\n");
+    exit(1);
+    return(NULL);  /* NOTREACHED */
+}
+
+
+void
+LiveStop(void)
+{
+}
+
+
+void
+LiveStats(void)
+{
+}
+
+#endif /* HAVE_TPACKET_V3 */
@@ -0,0 +1,483 @@
+/*
+ * Copyright (c) 1994, 1995, 1996, 1997, 1998, 1999, 2000, 2001,
+ *               2002, 2003, 2004
+ *      Ohio University.
+ *
+ * ---
+ *
+ * Starting with the release of tcptrace version 6 in 2001, tcptrace
+ * is licensed under the GNU General Public License (GPL).  We believe
+ * that, among the available licenses, the GPL will do the best job of
+ * allowing tcptrace to continue to be a valuable, freely-available
+ * and well-maintained tool for the networking community.
+ *
+ * Previous versions of tcptrace were released under a license that
+ * was much less restrictive with respect to how tcptrace could be
+ * used in commercial products.  Because of this, I am willing to
+ * consider alternate license arrangements as allowed in Section 10 of
+ * the GNU GPL.  Before I would consider licensing tcptrace under an
+ * alternate agreement with a particular individual or company,
+ * however, I would have to be convinced that such an alternative
+ * would be to the greater benefit of the networking community.
+ * 
+ * ---
+ *
+ * This file is part of Tcptrace.
+ *
+ * Tcptrace was originally written and continues to be maintained by
+ * Shawn Ostermann with the help of a group of devoted students and
+ * users (see the file 'THANKS').  The work on tcptrace has been made
+ * possible over the years through the generous support of NASA GRC,
+ * the National Science Foundation, and Sun Microsystems.
+ *
+ * Tcptrace is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tcptrace is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tcptrace (in the file 'COPYING'); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ * Author:      Shawn Ostermann
+ *              School of Electrical Engineering and Computer Science
+ *              Ohio University
+ *              Athens, OH
+ *              http://www.tcptrace.org/
+ */
+
+#include "tcptrace.h"
+static char const GCC_UNUSED copyright[] =
+    "@(#)Copyright (c) 2004 -- Ohio University.\n";
+static char const GCC_UNUSED rcsid[] =
+    "@(#)$Header$";
+
+
+
+/*
+ * merge.c -- read several trace files at once, in timestamp order
+ *
+ * With --merge, all of the input files are taken to be simultaneous
+ * captures (from several taps, say) rather than one capture that was
+ * split into pieces.  Rather than reading them one after the other,
+ * each file is opened by a reader of its own and the packets are
+ * handed to the analysis in global timestamp order.
+ *
+ * The packet reading routines (and the decompression code underneath
+ * them) all keep their state in globals and in stdin, so only one file
+ * can be open in any one process.  Each file is therefore read in a
+ * child process, which sends its packets back over a pipe.  The main
+ * process keeps exactly one packet (plus the stdio buffer) from each
+ * child and always hands out the oldest one, using a heap keyed on the
+ * packet time.  The pipes themselves provide the flow control, so the
+ * memory used stays flat no matter how big or how many the files are,
+ * and the files get decoded and decompressed in parallel for free.
+ */
+
+#if !defined(__WIN32) && !defined(__VMS)
+
+#include <sys/wait.h>
+
+/* stdio buffer on each end of the pipes */
+#define MERGE_BUFSIZE	(64*1024)
+
+/* the most we'll pass for a single packet (bigger ones are truncated) */
+#define MERGE_MAX_IPLEN	(IP_MAXPACKET+1)
+
+/* packet buffer to start with, grown as needed */
+#define MERGE_INIT_IPLEN	2048
+
+/* what goes down the pipe before each packet */
+struct merge_rec {
+    struct timeval	time;
+    int			len;
+    int			tlen;
+    int			phystype;
+    Bool		has_phys;	/* physical header follows */
+    u_int		iplen;		/* bytes from pip thru plast */
+};
+
+/* one input file */
+struct merge_input {
+    char		*filename;
+    int			ix;		/* order on the command line */
+    pid_t		pid;		/* the reader process */
+    FILE		*f;		/* read end of its pipe */
+    u_long		npkts;
+
+    /* the next packet from this file */
+    struct merge_rec	rec;
+    struct ether_header	phys;
+    char		*data;
+    u_int		data_size;
+};
+
+static struct merge_input *inputs = NULL;
+static int num_inputs = 0;
+
+/* heap of the inputs with a packet waiting, oldest on top */
+static struct merge_input **heap = NULL;
+static int heap_len = 0;
+
+/* has the packet on top of the heap been handed out? */
+static Bool top_used = FALSE;
+
+
+/* local routines */
+static void MergeChild(char *filename, int fd);
+static Bool MergeNext(struct merge_input *);
+static void MergeDone(struct merge_input *, Bool check);
+static Bool MergeBefore(struct merge_input *, struct merge_input *);
+static void MergeSiftDown(int);
+static void MergeSiftUp(int);
+static int MergeRead(struct timeval *, int *, int *, void **,
+		     int *, struct ip **, void **);
+
+
+
+/* the reader process, send all of the packets in the file back up */
+/* the pipe, never returns */
+static void
+MergeChild(
+    char *filename,
+    int fd)
+{
+    pread_f *ppread;
+    FILE *f;
+    struct merge_rec rec;
+    void *phys;
+    struct ip *pip;
+    void *plast;
+    long iplen;
+
+    /* ^C is for the main process to handle */
+    signal(SIGINT,SIG_IGN);
+
+    if ((f = fdopen(fd,"w")) == NULL) {
+	perror("fdopen");
+	_exit(1);
+    }
+    setvbuf(f, NULL, _IOFBF, MERGE_BUFSIZE);
+
+    ppread = OpenTraceFile(filename);
+
+    memset(&rec, 0, sizeof(rec));
+    while ((*ppread)(&rec.time,&rec.len,&rec.tlen,
+		     &phys,&rec.phystype,&pip,&plast)) {
+	iplen = (char *)plast - (char *)pip + 1;
+	if (iplen < 0)
+	    iplen = 0;
+	else if (iplen > MERGE_MAX_IPLEN)
+	    iplen = MERGE_MAX_IPLEN;
+
+	rec.has_phys = (phys != NULL);
+	rec.iplen = iplen;
+	if ((fwrite(&rec, sizeof(rec), 1, f) != 1) ||
+	    (phys && (fwrite(phys, sizeof(struct ether_header), 1, f) != 1)) ||
+	    (fwrite(pip, 1, iplen, f) != (size_t)iplen)) {
+	    /* the main process quit early */
+	    _exit(0);
+	}
+    }
+
+    fclose(f);
+    CompCloseFile(filename);
+
+    /* don't run anybody's exit handlers or flush stdout, they */
+    /* belong to the main process */
+    _exit(0);
+}
+
+
+
+/* get the next packet from the input, FALSE at EOF */
+static Bool
+MergeNext(
+    struct merge_input *pmi)
+{
+    struct merge_rec *prec = &pmi->rec;
+
+    if (fread(prec, sizeof(*prec), 1, pmi->f) != 1)
+	return(FALSE);
+
+    if (prec->iplen > MERGE_MAX_IPLEN)
+	goto bad;
+
+    if (prec->iplen > pmi->data_size) {
+	pmi->data = ReallocZ(pmi->data, pmi->data_size, prec->iplen);
+	pmi->data_size = prec->iplen;
+    }
+
+    if (prec->has_phys &&
+	(fread(&pmi->phys, sizeof(pmi->phys), 1, pmi->f) != 1))
+	goto bad;
+    if (fread(pmi->data, 1, prec->iplen, pmi->f) != prec->iplen)
+	goto bad;
+
+    ++pmi->npkts;
+    return(TRUE);
+
+  bad:
+    fprintf(stderr,"Error reading packets from file '%s' for merging\n",
+	    pmi->filename);
+    exit(-1);
+}
+
+
+
+/* done with the input, get rid of the reader process.  If check is */
+/* set, the reader must have finished happily. */
+static void
+MergeDone(
+    struct merge_input *pmi,
+    Bool check)
+{
+    int status;
+
+    if (pmi->f == NULL)
+	return;
+
+    /* closing the pipe kills the reader off if it isn't done yet */
+    fclose(pmi->f);
+    pmi->f = NULL;
+
+    if (waitpid(pmi->pid, &status, 0) < 0) {
+	perror("waitpid");
+	return;
+    }
+
+    if (debug)
+	fprintf(stderr,"Merge: %lu packets from file '%s'\n",
+		pmi->npkts, pmi->filename);
+
+    if (check && (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))) {
+	/* the reader already said what went wrong */
+	exit(-1);
+    }
+}
+
+
+
+/* does a's packet come before b's?  (ties go to the earlier file) */
+static Bool
+MergeBefore(
+    struct merge_input *a,
+    struct merge_input *b)
+{
+    if (a->rec.time.tv_sec != b->rec.time.tv_sec)
+	return(a->rec.time.tv_sec < b->rec.time.tv_sec);
+    if (a->rec.time.tv_usec != b->rec.time.tv_usec)
+	return(a->rec.time.tv_usec < b->rec.time.tv_usec);
+    return(a->ix < b->ix);
+}
+
+
+
+static void
+MergeSiftDown(
+    int i)
+{
+    struct merge_input *pmi = heap[i];
+
+    while (1) {
+	int child = 2*i + 1;
+
+	if (child >= heap_len)
+	    break;
+	if ((child+1 < heap_len) && MergeBefore(heap[child+1],heap[child]))
+	    ++child;
+	if (!MergeBefore(heap[child],pmi))
+	    break;
+	heap[i] = heap[child];
+	i = child;
+    }
+    heap[i] = pmi;
+}
+
+
+
+static void
+MergeSiftUp(
+    int i)
+{
+    struct merge_input *pmi = heap[i];
+
+    while (i > 0) {
+	int parent = (i-1) / 2;
+
+	if (!MergeBefore(pmi,heap[parent]))
+	    break;
+	heap[i] = heap[parent];
+	i = parent;
+    }
+    heap[i] = pmi;
+}
+
+
+
+/* the pread_f routine for the merged files */
+static int
+MergeRead(
+    struct timeval	*ptime,
+    int		 	*plen,
+    int		 	*ptlen,
+    void		**pphys,
+    int			*pphystype,
+    struct ip		**ppip,
+    void		**pplast)
+{
+    struct merge_input *pmi;
+
+    /* the caller is done with the last packet, replace it */
+    if (top_used) {
+	pmi = heap[0];
+	if (!MergeNext(pmi)) {
+	    MergeDone(pmi, TRUE);
+	    heap[0] = heap[--heap_len];
+	}
+	if (heap_len > 0)
+	    MergeSiftDown(0);
+	top_used = FALSE;
+    }
+
+    if (heap_len == 0)
+	return(0);
+
+    pmi = heap[0];
+    top_used = TRUE;
+
+    /* connections remember which file they were first seen in */
+    cur_filename = pmi->filename;
+
+    *ptime = pmi->rec.time;
+    *plen = pmi->rec.len;
+    *ptlen = pmi->rec.tlen;
+    *pphys = pmi->rec.has_phys?&pmi->phys:NULL;
+    *pphystype = pmi->rec.phystype;
+    *ppip = (struct ip *)pmi->data;
+    *pplast = pmi->data + pmi->rec.iplen - 1;
+
+    return(1);
+}
+
+
+
+/* start a reader for each of the files, returns the routine that */
+/* gives back their packets in timestamp order */
+pread_f *
+MergeStart(
+    char **names,
+    int count)
+{
+    int fds[2];
+    int i, j;
+
+    inputs = MallocZ(count * sizeof(struct merge_input));
+    heap = MallocZ(count * sizeof(struct merge_input *));
+    num_inputs = count;
+    heap_len = 0;
+    top_used = FALSE;
+
+    /* don't let the readers inherit anything still in the buffers */
+    fflush(stdout);
+    fflush(stderr);
+
+    for (i=0; i < count; ++i) {
+	struct merge_input *pmi = &inputs[i];
+
+	pmi->filename = names[i];
+	pmi->ix = i;
+	pmi->data = MallocZ(MERGE_INIT_IPLEN);
+	pmi->data_size = MERGE_INIT_IPLEN;
+
+	if (pipe(fds) != 0) {
+	    perror("pipe");
+	    exit(-1);
+	}
+
+	if ((pmi->pid = fork()) < 0) {
+	    perror("fork");
+	    exit(-1);
+	}
+
+	if (pmi->pid == 0) {
+	    /* child, only needs the write end of its own pipe */
+	    for (j=0; j < i; ++j)
+		fclose(inputs[j].f);
+	    close(fds[0]);
+	    MergeChild(names[i], fds[1]);
+	}
+
+	close(fds[1]);
+	if ((pmi->f = fdopen(fds[0],"r")) == NULL) {
+	    perror("fdopen");
+	    exit(-1);
+	}
+	setvbuf(pmi->f, NULL, _IOFBF, MERGE_BUFSIZE);
+    }
+
+    /* get the first packet from each of them */
+    for (i=0; i < count; ++i) {
+	struct merge_input *pmi = &inputs[i];
+
+	if (MergeNext(pmi)) {
+	    heap[heap_len] = pmi;
+	    MergeSiftUp(heap_len++);
+	} else {
+	    /* empty (or unreadable) file */
+	    MergeDone(pmi, TRUE);
+	}
+    }
+
+    if (debug)
+	fprintf(stderr,"Merging %d files by timestamp\n", count);
+
+    return(MergeRead);
+}
+
+
+
+/* shut down any readers that are still going */
+void
+MergeStop(void)
+{
+    int i;
+
+    for (i=0; i < num_inputs; ++i) {
+	MergeDone(&inputs[i], FALSE);
+	free(inputs[i].data);
+    }
+
+    free(inputs);
+    free(heap);
+    inputs = NULL;
+    heap = NULL;
+    num_inputs = heap_len = 0;
+}
+
+
+#else /* !__WIN32 && !__VMS */
+
+
+pread_f *
+MergeStart(
+    char **names,
+    int count)
+{
+    fprintf(stderr,"Sorry, --merge isn't supported on this platform\n");
+    exit(1);
+}
+
+
+void
+MergeStop(void)
+{
+}
+
+#endif /* !__WIN32 && !__VMS */
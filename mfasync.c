@@ -0,0 +1,622 @@
+/*
+ * Copyright (c) 1994, 1995, 1996, 1997, 1998, 1999, 2000, 2001,
+ *               2002, 2003, 2004
+ *      Ohio University.
+ *
+ * ---
+ *
+ * Starting with the release of tcptrace version 6 in 2001, tcptrace
+ * is licensed under the GNU General Public License (GPL).  We believe
+ * that, among the available licenses, the GPL will do the best job of
+ * allowing tcptrace to continue to be a valuable, freely-available
+ * and well-maintained tool for the networking community.
+ *
+ * Previous versions of tcptrace were released under a license that
+ * was much less restrictive with respect to how tcptrace could be
+ * used in commercial products.  Because of this, I am willing to
+ * consider alternate license arrangements as allowed in Section 10 of
+ * the GNU GPL.  Before I would consider licensing tcptrace under an
+ * alternate agreement with a particular individual or company,
+ * however, I would have to be convinced that such an alternative
+ * would be to the greater benefit of the networking community.
+ * 
+ * ---
+ *
+ * This file is part of Tcptrace.
+ *
+ * Tcptrace was originally written and continues to be maintained by
+ * Shawn Ostermann with the help of a group of devoted students and
+ * users (see the file 'THANKS').  The work on tcptrace has been made
+ * possible over the years through the generous support of NASA GRC,
+ * the National Science Foundation, and Sun Microsystems.
+ *
+ * Tcptrace is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tcptrace is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tcptrace (in the file 'COPYING'); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ * Author:      Shawn Ostermann
+ *              School of Electrical Engineering and Computer Science
+ *              Ohio University
+ *              Athens, OH
+ *              http://www.tcptrace.org/
+ */
+#include "tcptrace.h"
+static char const GCC_UNUSED copyright[] =
+    "@(#)Copyright (c) 2004 -- Ohio University.\n";
+static char const GCC_UNUSED rcsid[] =
+    "@(#)$Header$";
+
+
+
+
+
+/*
+ * mfasync.c -- write the output files in the background (--output_threads)
+ *
+ * With --output_threads=N, mfiles.c doesn't hand each printf and write
+ * to stdio; it gathers the bytes for each MFILE into a buffer of its
+ * own, and when the buffer fills (or the file is flushed, sought or
+ * closed) hands the whole thing to us with the file offset it belongs
+ * at.  Each file is tied to one of N writer threads, which keeps a
+ * queue of buffers and pwrite()s them in order, so the bytes for a
+ * given file always land in the order they were written.  The analysis
+ * only waits on the disk if more than MA_MAX_QUEUED bytes are waiting
+ * to be written, or when a file is closed with Mfclose().
+ *
+ * The writers open the files themselves, lazily, and each keeps its
+ * own LRU list of open descriptors (like mfiles.c does for FILEs) so
+ * that together they stay under the open file limit, leaving a few
+ * descriptors for the main thread.
+ *
+ * Any error writing a file is reported (and we quit) the next time the
+ * main thread hands over some work.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+
+
+#ifdef USE_THREADS
+
+#include <pthread.h>
+
+/* tuning */
+#define MA_MAX_QUEUED	(64*1024*1024)	/* bytes waiting for the writers */
+#define MA_FD_RESERVE	64		/* descriptors left for the main thread */
+#define MA_FD_MAX	4096		/* most descriptors per writer */
+
+/* what a job asks the writer to do */
+enum ma_op {
+    MA_WRITE,		/* write the buffer (just open the file if len == 0) */
+    MA_CLOSE,		/* close the descriptor, the file may be used again */
+    MA_RELEASE		/* close the descriptor and forget the file */
+};
+
+struct ma_writer;
+
+/* one output file */
+struct ma_file {
+    char		*fname;
+    struct ma_writer	*pmw;		/* the thread that writes it */
+    int			fd;		/* -1 if not open right now */
+    Bool		created;	/* opened before? */
+    Bool		truncate;	/* empty it the first time */
+    u_long		pending;	/* jobs not yet done */
+
+    /* the writer's LRU list of open files */
+    struct ma_file	*next;
+    struct ma_file	*prev;
+};
+
+struct ma_job {
+    enum ma_op		op;
+    struct ma_file	*pmaf;
+    char		*buf;
+    u_long		len;
+    u_llong		offset;
+    struct timeval	queued;		/* when it was handed over */
+    struct ma_job	*next;
+};
+
+struct ma_writer {
+    pthread_t		thread;
+    pthread_cond_t	cond;		/* there's work to do */
+    struct ma_job	*head;
+    struct ma_job	*tail;
+
+    /* open descriptors, only touched by the writer itself */
+    struct ma_file	*lru_head;	/* LEAST recently used */
+    struct ma_file	*lru_tail;
+    int			nopen;
+    u_long		opens;
+    u_long		reopens;	/* ... of files closed for lack of fds */
+};
+
+static pthread_mutex_t	ma_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	ma_cond_done = PTHREAD_COND_INITIALIZER;
+static struct ma_writer	*ma_writers = NULL;
+static int		ma_nwriters = 0;
+static int		ma_next_writer = 0;
+static int		ma_fd_limit;		/* per writer */
+static Bool		ma_stopping = FALSE;
+static u_long		ma_queued = 0;		/* bytes waiting */
+
+/* the first thing that went wrong, if anything */
+static int		ma_errno = 0;
+static char		*ma_errfile = NULL;
+
+/* some statistics */
+static u_llong ma_bytes_queued = 0;	/* bytes handed over in total */
+static u_long ma_jobs = 0;		/* writes finished */
+static double ma_latency_total = 0.0;	/* queued to written, in usecs */
+static double ma_latency_max = 0.0;
+static u_long ma_full_waits = 0;	/* main thread waited for room */
+
+
+/* local routines */
+static void *MAsyncThread(void *arg);
+static int MAsyncDo(struct ma_writer *pmw, struct ma_job *pjob);
+static int MAsyncFd(struct ma_writer *pmw, struct ma_file *pmaf);
+static void MAsyncCloseFd(struct ma_writer *pmw, struct ma_file *pmaf);
+static void MAsyncQueue(struct ma_file *pmaf, enum ma_op op,
+			char *buf, u_long len, u_llong offset);
+
+
+
+/* start the writer threads, returns FALSE if we can't */
+Bool
+MAsyncStart(
+    int nthreads)
+{
+    struct rlimit rl;
+    int fds = MA_FD_MAX * nthreads;
+    int i;
+
+    /* split up the descriptors we're allowed */
+    if ((getrlimit(RLIMIT_NOFILE, &rl) == 0) &&
+	(rl.rlim_cur != RLIM_INFINITY) &&
+	(rl.rlim_cur < (rlim_t) fds + MA_FD_RESERVE))
+	fds = (int) rl.rlim_cur - MA_FD_RESERVE;
+    ma_fd_limit = fds / nthreads;
+    if (ma_fd_limit < 1)
+	ma_fd_limit = 1;
+
+    ma_writers = MallocZ(nthreads * sizeof(struct ma_writer));
+    for (i=0; i < nthreads; ++i) {
+	struct ma_writer *pmw = &ma_writers[i];
+
+	pthread_cond_init(&pmw->cond, NULL);
+	if (pthread_create(&pmw->thread, NULL, MAsyncThread, pmw) != 0) {
+	    perror("pthread_create");
+	    exit(-1);
+	}
+	++ma_nwriters;
+    }
+
+    if (debug)
+	fprintf(stderr,
+		"Output: %d writer threads, %d descriptors each\n",
+		ma_nwriters, ma_fd_limit);
+
+    return(TRUE);
+}
+
+
+
+/* a new output file, it's created (or emptied) in the background */
+struct ma_file *
+MAsyncOpen(
+    char *fname,
+    Bool truncate)
+{
+    struct ma_file *pmaf;
+
+    pmaf = MallocZ(sizeof(struct ma_file));
+    pmaf->fname = strdup(fname);
+    pmaf->fd = -1;
+    pmaf->truncate = truncate;
+
+    /* spread the files around the writers */
+    pmaf->pmw = &ma_writers[ma_next_writer];
+    ma_next_writer = (ma_next_writer + 1) % ma_nwriters;
+
+    /* so that it exists even if nothing is ever written */
+    MAsyncQueue(pmaf, MA_WRITE, NULL, 0, 0);
+
+    return(pmaf);
+}
+
+
+
+/* write len bytes at offset, the buffer (from malloc) is ours now */
+void
+MAsyncWrite(
+    struct ma_file *pmaf,
+    char *buf,
+    u_long len,
+    u_llong offset)
+{
+    MAsyncQueue(pmaf, MA_WRITE, buf, len, offset);
+}
+
+
+
+/* close the file and wait until everything has been written, it */
+/* will be opened again if there's more */
+void
+MAsyncClose(
+    struct ma_file *pmaf)
+{
+    MAsyncQueue(pmaf, MA_CLOSE, NULL, 0, 0);
+
+    pthread_mutex_lock(&ma_lock);
+    while ((pmaf->pending > 0) && (ma_errno == 0))
+	pthread_cond_wait(&ma_cond_done, &ma_lock);
+    pthread_mutex_unlock(&ma_lock);
+}
+
+
+
+/* we're done with the file for good, the writer finishes it up */
+/* and frees it (the caller mustn't touch it again) */
+void
+MAsyncRelease(
+    struct ma_file *pmaf)
+{
+    MAsyncQueue(pmaf, MA_RELEASE, NULL, 0, 0);
+}
+
+
+
+/* wait for everything to be written and stop the threads */
+void
+MAsyncStop(void)
+{
+    u_long opens = 0;
+    u_long reopens = 0;
+    int i;
+
+    if (ma_nwriters == 0)
+	return;
+
+    pthread_mutex_lock(&ma_lock);
+    ma_stopping = TRUE;
+    for (i=0; i < ma_nwriters; ++i)
+	pthread_cond_signal(&ma_writers[i].cond);
+    pthread_mutex_unlock(&ma_lock);
+
+    for (i=0; i < ma_nwriters; ++i) {
+	struct ma_writer *pmw = &ma_writers[i];
+
+	pthread_join(pmw->thread, NULL);
+	while (pmw->lru_head)
+	    MAsyncCloseFd(pmw, pmw->lru_head);
+	opens += pmw->opens;
+	reopens += pmw->reopens;
+    }
+
+    if (ma_errno != 0) {
+	errno = ma_errno;
+	perror(ma_errfile);
+	exit(-1);
+    }
+
+    if (debug)
+	fprintf(stderr,
+		"Output: %" FS_ULL " bytes queued, %lu writes, latency avg %.0f usecs max %.0f usecs, %lu opens, %lu reopens, waited for room %lu times\n",
+		ma_bytes_queued, ma_jobs,
+		(ma_jobs > 0) ? (ma_latency_total / ma_jobs) : 0.0,
+		ma_latency_max, opens, reopens, ma_full_waits);
+
+    ma_nwriters = 0;
+    free(ma_writers);
+    ma_writers = NULL;
+}
+
+
+
+/* hand a job to the file's writer, waiting for room if need be */
+static void
+MAsyncQueue(
+    struct ma_file *pmaf,
+    enum ma_op op,
+    char *buf,
+    u_long len,
+    u_llong offset)
+{
+    struct ma_writer *pmw = pmaf->pmw;
+    struct ma_job *pjob;
+
+    pjob = MallocZ(sizeof(struct ma_job));
+    pjob->op = op;
+    pjob->pmaf = pmaf;
+    pjob->buf = buf;
+    pjob->len = len;
+    pjob->offset = offset;
+    gettimeofday(&pjob->queued, NULL);
+
+    pthread_mutex_lock(&ma_lock);
+    while ((ma_queued > MA_MAX_QUEUED) && (ma_errno == 0)) {
+	++ma_full_waits;
+	pthread_cond_wait(&ma_cond_done, &ma_lock);
+    }
+
+    /* something went wrong in the background */
+    if (ma_errno != 0) {
+	errno = ma_errno;
+	perror(ma_errfile);
+	exit(-1);
+    }
+
+    if (pmw->tail)
+	pmw->tail->next = pjob;
+    else
+	pmw->head = pjob;
+    pmw->tail = pjob;
+    ++pmaf->pending;
+    ma_queued += len;
+    ma_bytes_queued += len;
+    pthread_cond_signal(&pmw->cond);
+    pthread_mutex_unlock(&ma_lock);
+}
+
+
+
+/* a writer thread, do the jobs in order until told to stop */
+static void *
+MAsyncThread(
+    void *arg)
+{
+    struct ma_writer *pmw = arg;
+    struct ma_job *pjob;
+    struct timeval now;
+    sigset_t mask;
+    double latency;
+    int err;
+
+    /* signals are the main thread's business */
+    sigfillset(&mask);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    while (1) {
+	pthread_mutex_lock(&ma_lock);
+	while ((pmw->head == NULL) && !ma_stopping)
+	    pthread_cond_wait(&pmw->cond, &ma_lock);
+	if ((pjob = pmw->head) == NULL) {
+	    /* stopping, and nothing left */
+	    pthread_mutex_unlock(&ma_lock);
+	    break;
+	}
+	pmw->head = pjob->next;
+	if (pmw->head == NULL)
+	    pmw->tail = NULL;
+	pthread_mutex_unlock(&ma_lock);
+
+	err = MAsyncDo(pmw, pjob);
+
+	gettimeofday(&now, NULL);
+	latency = (double) (now.tv_sec - pjob->queued.tv_sec) * 1000000.0 +
+	    (double) (now.tv_usec - pjob->queued.tv_usec);
+
+	pthread_mutex_lock(&ma_lock);
+	if ((err != 0) && (ma_errno == 0)) {
+	    ma_errno = err;
+	    ma_errfile = strdup(pjob->pmaf->fname);
+	}
+	ma_queued -= pjob->len;
+	if (pjob->len > 0) {
+	    ++ma_jobs;
+	    ma_latency_total += latency;
+	    if (latency > ma_latency_max)
+		ma_latency_max = latency;
+	}
+	--pjob->pmaf->pending;
+	pthread_cond_broadcast(&ma_cond_done);
+	pthread_mutex_unlock(&ma_lock);
+
+	/* nobody else knows about a released file */
+	if (pjob->op == MA_RELEASE) {
+	    free(pjob->pmaf->fname);
+	    free(pjob->pmaf);
+	}
+	if (pjob->buf)
+	    free(pjob->buf);
+	free(pjob);
+    }
+
+    return(NULL);
+}
+
+
+
+/* do one job, returns 0 or an errno */
+static int
+MAsyncDo(
+    struct ma_writer *pmw,
+    struct ma_job *pjob)
+{
+    struct ma_file *pmaf = pjob->pmaf;
+    char *pch = pjob->buf;
+    u_long len = pjob->len;
+    u_llong offset = pjob->offset;
+    ssize_t ret;
+    int fd;
+
+    if (pjob->op != MA_WRITE) {
+	if (pmaf->fd != -1)
+	    MAsyncCloseFd(pmw, pmaf);
+	return(0);
+    }
+
+    if ((fd = MAsyncFd(pmw, pmaf)) == -1)
+	return(errno);
+
+    while (len > 0) {
+	ret = pwrite(fd, pch, len, (off_t)offset);
+	if (ret < 0) {
+	    if (errno == EINTR)
+		continue;
+	    return(errno);
+	}
+	pch += ret;
+	offset += ret;
+	len -= ret;
+    }
+
+    return(0);
+}
+
+
+
+/* the file's descriptor, opening it if need be (-1 on error) */
+static int
+MAsyncFd(
+    struct ma_writer *pmw,
+    struct ma_file *pmaf)
+{
+    int flags = O_WRONLY;
+    int fd;
+
+    if (pmaf->fd != -1) {
+	/* it goes to the end of the LRU list */
+	if (pmw->lru_tail != pmaf) {
+	    if (pmaf->prev)
+		pmaf->prev->next = pmaf->next;
+	    else
+		pmw->lru_head = pmaf->next;
+	    pmaf->next->prev = pmaf->prev;
+	    pmaf->next = NULL;
+	    pmaf->prev = pmw->lru_tail;
+	    pmw->lru_tail->next = pmaf;
+	    pmw->lru_tail = pmaf;
+	}
+	return(pmaf->fd);
+    }
+
+    if (pmw->nopen >= ma_fd_limit)
+	MAsyncCloseFd(pmw, pmw->lru_head);
+
+    if (!pmaf->created) {
+	flags |= O_CREAT;
+	if (pmaf->truncate)
+	    flags |= O_TRUNC;
+    }
+
+    while ((fd = open(pmaf->fname, flags, 0666)) == -1) {
+	/* if we're out of descriptors, give one of ours back */
+	if ((errno != EMFILE) || (pmw->lru_head == NULL))
+	    return(-1);
+	MAsyncCloseFd(pmw, pmw->lru_head);
+    }
+
+    if (pmaf->created)
+	++pmw->reopens;
+    else
+	++pmw->opens;
+    pmaf->created = TRUE;
+    pmaf->fd = fd;
+
+    pmaf->next = NULL;
+    pmaf->prev = pmw->lru_tail;
+    if (pmw->lru_tail)
+	pmw->lru_tail->next = pmaf;
+    else
+	pmw->lru_head = pmaf;
+    pmw->lru_tail = pmaf;
+    ++pmw->nopen;
+
+    if (debug > 1)
+	fprintf(stderr,"MAsync: opened file '%s'\n", pmaf->fname);
+
+    return(fd);
+}
+
+
+
+/* close the file's descriptor and take it off the LRU list */
+static void
+MAsyncCloseFd(
+    struct ma_writer *pmw,
+    struct ma_file *pmaf)
+{
+    close(pmaf->fd);
+    pmaf->fd = -1;
+
+    if (pmaf->prev)
+	pmaf->prev->next = pmaf->next;
+    else
+	pmw->lru_head = pmaf->next;
+    if (pmaf->next)
+	pmaf->next->prev = pmaf->prev;
+    else
+	pmw->lru_tail = pmaf->prev;
+    pmaf->next = pmaf->prev = NULL;
+    --pmw->nopen;
+}
+
+
+#else /* USE_THREADS */
+
+
+Bool
+MAsyncStart(
+    int nthreads)
+{
+    fprintf(stderr,
+	    "Warning: not compiled with thread support, --output_threads ignored\n");
+    return(FALSE);
+}
+
+
+/* (never called without the threads) */
+struct ma_file *
+MAsyncOpen(
+    char *fname,
+    Bool truncate)
+{
+    return(NULL);
+}
+
+
+void
+MAsyncWrite(
+    struct ma_file *pmaf,
+    char *buf,
+    u_long len,
+    u_llong offset)
+{
+}
+
+
+void
+MAsyncClose(
+    struct ma_file *pmaf)
+{
+}
+
+
+void
+MAsyncRelease(
+    struct ma_file *pmaf)
+{
+}
+
+
+void
+MAsyncStop(void)
+{
+}
+
+#endif /* USE_THREADS */
@@ -78,8 +78,23 @@ struct mfile {
     MFILE *next;
     MFILE *prev;
     long fptr;
+
+    /* with --output_threads, the bytes are gathered here instead */
+    /* and handed to mfasync.c (the LRU list is then the files */
+    /* holding a buffer, rather than the ones holding a FILE) */
+    struct ma_file *pmaf;
+    char *abuf;
+    u_int alen;		/* bytes in abuf */
+    u_int asize;	/* bytes allocated for abuf */
+    u_llong apos;	/* file offset of abuf[0] */
+    u_llong aend;	/* size of the file, as far as we know */
 };
 
+/* buffer sizes for --output_threads */
+#define MA_BUF_MIN	512		/* a file's first buffer */
+#define MA_BUF_MAX	(64*1024)	/* most bytes gathered per write */
+#define MA_BUF_TOTAL	(32*1024*1024)	/* ...for all the files at once */
+
 
 /* local static routines */
 static void Mcheck(MFILE *pmf);
@@ -88,6 +103,10 @@ static void Mf_totail(MFILE *pmf, MFILE *ptail);
 static void Mf_unlink(MFILE *pmf);
 static void M_closeold(void);
 static void M_mkdirp(char *directory);
+static void Ma_touch(MFILE *pmf);
+static void Ma_room(MFILE *pmf, u_long need);
+static void Ma_flush(MFILE *pmf);
+static void Ma_evict(MFILE *pmf);
 
 
 /* head and tail of LRU open file list */
@@ -97,6 +116,11 @@ MFILE mf_tail;  /* MOST recently used */
 MFILE mfc_head;  /* closed files, LEAST recently closed */
 MFILE mfc_tail;  /* closed files, MOST recently closed */
 
+/* are the writes being done in the background? */
+static Bool mf_async = FALSE;
+static Bool mf_async_checked = FALSE;
+static u_long mf_abuffered = 0;	/* bytes allocated for the buffers */
+
 
 void
 Minit(void)
@@ -113,6 +137,23 @@ Minit(void)
 }
 
 
+/* write out whatever's still buffered and wait for it all to hit */
+/* the disk (only needed with --output_threads) */
+void
+Mfinish(void)
+{
+    MFILE *pmf;
+
+    if (!mf_async)
+	return;
+
+    for (pmf = mf_head.next; pmf != &mf_tail; pmf = pmf->next)
+	Ma_flush(pmf);
+    MAsyncStop();
+    mf_async = FALSE;
+}
+
+
 
 
 MFILE *
@@ -130,6 +171,13 @@ Mfopen(
 	exit(-1);
     }
 
+    /* (the options aren't known yet when Minit() is called) */
+    if (!mf_async_checked) {
+	mf_async_checked = TRUE;
+	if (output_threads > 0)
+	    mf_async = MAsyncStart(output_threads);
+    }
+
     pmf = (MFILE *) MallocZ(sizeof(MFILE));
 
     /* use the directory specified by the user, if requested */
@@ -158,6 +206,17 @@ Mfopen(
 	    prefix,
 	    fname);
 
+    if (mf_async) {
+	struct stat str_stat;
+
+	/* appending starts at the end of what's there now */
+	if ((strcmp(mode,"a") == 0) && (stat(pmf->fname,&str_stat) == 0))
+	    pmf->apos = pmf->aend = str_stat.st_size;
+	pmf->pmaf = MAsyncOpen(pmf->fname, (strcmp(mode,"w") == 0));
+	Mf_totail(pmf,&mfc_tail);
+	return(pmf);
+    }
+
     // The 'b' in the file mode has no meaning in UNIX systems.
     // It has meaning in Operating Systems like Windows that
     // seem to treat text and binary files differently.
@@ -188,7 +247,8 @@ Mfpipe(
 	if (pipe(pipes) == 0)
 	    return(0);
 
-	if (errno != EMFILE) {
+	/* (with --output_threads, we don't hold any to give back) */
+	if ((errno != EMFILE) || mf_async) {
 	    perror("pipe");
 	    exit(-1);
 	}
@@ -201,6 +261,15 @@ Mfpipe(
 }
 
 
+/* the name the file was really opened as (with --output_dir, etc) */
+char *
+Mfname(
+    MFILE *pmf)
+{
+    return(pmf->fname);
+}
+
+
 int
 Mfileno(
     MFILE *pmf)
@@ -208,6 +277,11 @@ Mfileno(
     /* Warning, I'll GIVE you the fd, but I won't guarantee that it'll stay */
     /* where you want it if you call my functions back!!! */
 
+    if (mf_async) {
+	fprintf(stderr,"Mfileno: not available with --output_threads\n");
+	exit(-1);
+    }
+
     Mcheck(pmf);
     return(fileno(pmf->stream));
 }
@@ -223,6 +297,28 @@ Mvfprintf(
 {
     int ret;
 
+    if (mf_async) {
+	u_int room;
+	va_list aq;
+
+	/* try it in what's left of the buffer first */
+	Ma_touch(pmf);
+	room = pmf->asize - pmf->alen;
+	va_copy(aq, ap);
+	ret = vsnprintf(room ? pmf->abuf + pmf->alen : NULL, room, format, aq);
+	va_end(aq);
+	if (ret < 0)
+	    return(ret);
+	if ((u_int) ret >= room) {
+	    Ma_room(pmf, ret + 1);
+	    vsnprintf(pmf->abuf + pmf->alen, ret + 1, format, ap);
+	}
+	pmf->alen += ret;
+	if (pmf->apos + pmf->alen > pmf->aend)
+	    pmf->aend = pmf->apos + pmf->alen;
+	return(ret);
+    }
+
     Mcheck(pmf);
     ret = vfprintf(pmf->stream,format,ap);
 
@@ -242,8 +338,7 @@ Mfprintf(
 
     va_start(ap,format);
 
-    Mcheck(pmf);
-    ret = vfprintf(pmf->stream,format,ap);
+    ret = Mvfprintf(pmf,format,ap);
 
     va_end(ap);
 
@@ -255,6 +350,9 @@ long
 Mftell(
     MFILE *pmf)
 {
+    if (mf_async)
+	return(pmf->apos + pmf->alen);
+
     Mcheck(pmf);
     return(ftell(pmf->stream));
 }
@@ -266,6 +364,24 @@ Mfseek(
     long offset,
     int ptrname)
 {
+    if (mf_async) {
+	long pos;
+
+	switch (ptrname) {
+	  case SEEK_SET: pos = offset; break;
+	  case SEEK_CUR: pos = pmf->apos + pmf->alen + offset; break;
+	  case SEEK_END: pos = pmf->aend + offset; break;
+	  default: errno = EINVAL; return(-1);
+	}
+	if (pos < 0) {
+	    errno = EINVAL;
+	    return(-1);
+	}
+	Ma_flush(pmf);
+	pmf->apos = pos;
+	return(0);
+    }
+
     Mcheck(pmf);
     return(fseek(pmf->stream, offset, ptrname));
 }
@@ -278,11 +394,68 @@ Mfwrite(
     u_long nitems,
     MFILE *pmf)
 {
+    if (mf_async) {
+	u_long len = size * nitems;
+
+	Ma_touch(pmf);
+	Ma_room(pmf, len);
+	memcpy(pmf->abuf + pmf->alen, buf, len);
+	pmf->alen += len;
+	if (pmf->apos + pmf->alen > pmf->aend)
+	    pmf->aend = pmf->apos + pmf->alen;
+	return(nitems);
+    }
+
     Mcheck(pmf);
     return(fwrite(buf,size,nitems,pmf->stream));
 }
 
 
+/* write len bytes at file offset "offset" without moving the stream's */
+/* own position, so callers that write all over a file needn't seek */
+int
+Mfpwrite(
+    MFILE *pmf,
+    void *buf,
+    u_long len,
+    u_llong offset)
+{
+    char *pch = buf;
+    ssize_t ret;
+    int fd;
+
+    if (mf_async) {
+	char *copy = MallocZ(len);
+
+	/* anything gathered up goes first, so it's overwritten in order */
+	Ma_flush(pmf);
+	memcpy(copy, buf, len);
+	MAsyncWrite(pmf->pmaf, copy, len, offset);
+	if (offset + len > pmf->aend)
+	    pmf->aend = offset + len;
+	return(0);
+    }
+
+    Mcheck(pmf);
+    fflush(pmf->stream);
+    fd = fileno(pmf->stream);
+
+    while (len > 0) {
+	ret = pwrite(fd, pch, len, (off_t)offset);
+	if (ret < 0) {
+	    if (errno == EINTR)
+		continue;
+	    return(-1);
+	}
+	pch += ret;
+	offset += ret;
+	len -= ret;
+    }
+
+    return(0);
+}
+
+
 int
 Mfclose(
     MFILE *pmf)
@@ -291,6 +464,13 @@ Mfclose(
 
     if (debug>1)
 	fprintf(stderr,"Mfclose: called for file '%s'\n", pmf->fname);
+
+    /* (waits for the writes, so the file can be unlinked, etc) */
+    if (mf_async) {
+	Ma_flush(pmf);
+	MAsyncClose(pmf->pmaf);
+	return(0);
+    }
 	
     Mcheck(pmf);
     ret=fclose(pmf->stream);
@@ -299,10 +479,37 @@ Mfclose(
 }
 
 
+/* close the file for good: unlike Mfclose, the MFILE is taken off the */
+/* LRU list and freed, so the caller must not touch it again */
+int
+Mfrelease(
+    MFILE *pmf)
+{
+    int ret = 0;
+
+    if (mf_async) {
+	/* no need to wait, the writer finishes up */
+	Ma_evict(pmf);
+	MAsyncRelease(pmf->pmaf);
+    } else {
+	ret = Mfclose(pmf);
+    }
+    Mf_unlink(pmf);
+    free(pmf->fname);
+    free(pmf);
+    return(ret);
+}
+
+
 int
 Mfflush(
     MFILE *pmf)
 {
+    if (mf_async) {
+	Ma_flush(pmf);
+	return(0);
+    }
+
     Mcheck(pmf);
     return(fflush(pmf->stream));
 }
@@ -389,6 +596,97 @@ Mcheck(
 
 }
 
+/* (--output_threads) the file was just written to, so it goes to */
+/* the end of the line */
+static void
+Ma_touch(
+    MFILE *pmf)
+{
+    if (mf_tail.prev != pmf) {
+	Mf_unlink(pmf);
+	Mf_totail(pmf,&mf_tail);
+    }
+}
+
+
+/* (--output_threads) make sure there's room for "need" more bytes */
+/* in the file's buffer, handing over what's there if it's full */
+static void
+Ma_room(
+    MFILE *pmf,
+    u_long need)
+{
+    u_long nsize;
+
+    if (pmf->alen + need <= pmf->asize)
+	return;
+
+    /* grow it if we can, otherwise start a new one */
+    if (pmf->alen + need <= MA_BUF_MAX) {
+	nsize = (pmf->asize > 0) ? pmf->asize : MA_BUF_MIN;
+	while (nsize < pmf->alen + need)
+	    nsize *= 2;
+	if (nsize > MA_BUF_MAX)
+	    nsize = MA_BUF_MAX;
+    } else {
+	Ma_flush(pmf);
+	if (pmf->abuf) {
+	    free(pmf->abuf);
+	    pmf->abuf = NULL;
+	    mf_abuffered -= pmf->asize;
+	    pmf->asize = 0;
+	}
+	nsize = (need > MA_BUF_MAX) ? need : MA_BUF_MAX;
+    }
+
+    /* give back the buffers of the files that haven't been used lately */
+    while ((mf_abuffered + (nsize - pmf->asize) > MA_BUF_TOTAL) &&
+	   (mf_head.next != pmf))
+	Ma_evict(mf_head.next);
+
+    pmf->abuf = ReallocZ(pmf->abuf, pmf->asize, nsize);
+    mf_abuffered += nsize - pmf->asize;
+    pmf->asize = nsize;
+}
+
+
+/* (--output_threads) hand the bytes gathered so far to the writer */
+static void
+Ma_flush(
+    MFILE *pmf)
+{
+    if (pmf->alen == 0)
+	return;
+
+    /* the buffer goes with them */
+    MAsyncWrite(pmf->pmaf, pmf->abuf, pmf->alen, pmf->apos);
+    pmf->apos += pmf->alen;
+    pmf->abuf = NULL;
+    pmf->alen = 0;
+    mf_abuffered -= pmf->asize;
+    pmf->asize = 0;
+}
+
+
+/* (--output_threads) take the file's buffer back, it goes on the */
+/* list of those without one */
+static void
+Ma_evict(
+    MFILE *pmf)
+{
+    Ma_flush(pmf);
+    if (pmf->abuf) {
+	free(pmf->abuf);
+	pmf->abuf = NULL;
+	mf_abuffered -= pmf->asize;
+	pmf->asize = 0;
+    }
+
+    Mf_unlink(pmf);
+    Mf_totail(pmf,&mfc_tail);
+}
+
+
 #ifdef OLD
 static void
 M_printlru(void)
@@ -142,7 +142,7 @@ MakeConnRec(void)
 {
     struct conn_info *pci;
 
-    pci = MallocZ(sizeof(struct conn_info));
+    pci = RunAlloc(sizeof(struct conn_info));
 
     /* chain it in (at head of list) */
     pci->next = connhead;
@@ -157,7 +157,7 @@ MakeUDPConnRec(void)
 {
     struct uconn_info *puci;
 
-    puci = MallocZ(sizeof(struct uconn_info));
+    puci = RunAlloc(sizeof(struct uconn_info));
 
     /* chain it in (at head of list) */
     puci->next = uconnhead;
@@ -59,12 +59,17 @@ static char const GCC_UNUSED rcsid[] =
 
 #ifdef LOAD_MODULE_HTTP
 
-#include <sys/mman.h>
 #include "mod_http.h"
 
 
 #define DEFAULT_SERVER_PORT 80
 
+/* tuning for the in-line parsers */
+#define HTTP_WINDOW	(256*1024)	/* most reply bytes waiting on a request */
+					/* held for each direction */
+#define HTTP_LOOKAHEAD	2048		/* most a header step looks at */
+#define HTTP_CHUNK	(64*1024)	/* bytes handed to a parser at once */
+
 
 /* Revised HTTP module with a new HTTP parser provided by Bruce Mah */
 
@@ -90,6 +95,24 @@ char *MethodCodeString[] = {
      "TRACE"
 };
 
+/* states for the request (client) parser */
+typedef enum {
+    GetStateStartMethod,
+    GetStateFinishMethod,
+    GetStateFindContentLength,
+    GetStateFinishHeader
+} GetState;
+
+/* states for the reply (server) parser */
+typedef enum {
+    ContentStateStartHttp,
+    ContentStateFinishHttp,
+    ContentStateFindResponse,
+    ContentStateFindContentLength,
+    ContentStateFinishHeader,
+    ContentStateFindEnd		/* of a body with no Content-Length */
+} ContentState;
+
 /* info gathered for each GET */
 struct get_info {
     timeval get_time;		/* when CLIENT sent GET */
@@ -98,6 +121,7 @@ struct get_info {
     timeval ack_time;		/* when CLIENT acked CONTENT */
     unsigned request_position;  /* byte offset for this request */
     unsigned reply_position;    /* byte offset for this reply */
+    unsigned reply_end;		/* byte offset just past it (0 if unfinished) */
     MethodCode method;          /* HTTP method code */
     unsigned response_code;     /* HTTP response code */
     unsigned content_length;	/* as reported by server */
@@ -118,6 +142,30 @@ struct time_stamp {
 };
 
 
+/* one direction of a connection, as its parser sees it */
+/* (offsets count from 0 at the byte after the SYN) */
+struct http_stream {
+    Bool started;		/* seen any of its data? */
+    u_long next;		/* offset of the next in-order byte */
+
+    /* in-order bytes the parser hasn't finished with (NUL-terminated) */
+    char *buf;
+    u_long buf_off;		/* offset of buf[0] */
+    u_int buf_len;
+    u_int buf_size;
+
+    /* parser state */
+    int state;			/* GetState or ContentState */
+    u_llong skip;		/* body bytes still to pass over */
+    u_llong content_length;	/* of the request being read */
+    u_long body_start;		/* where a reply body without a length began */
+    struct get_info *panswered;	/* last request a reply was found for */
+    Bool stalled;		/* found a reply before its request */
+    Bool parsing;		/* (StreamParse() is working on it) */
+    Bool lost;			/* gave up on it */
+};
+
+
 /* info kept for each client */
 static struct client_info {
     PLOTTER plotter;
@@ -165,6 +213,10 @@ static struct http_info {
     struct get_info *gets_head;
     struct get_info *gets_tail;
 
+    /* the requests and replies, parsed as they arrive */
+    struct http_stream client;
+    struct http_stream server;
+
     struct http_info *next;
 } *httphead = NULL, *httptail = NULL;
 
@@ -179,10 +231,20 @@ static timeval WhenSent(struct time_stamp *phead, struct time_stamp *ptail,
 			u_long position);
 static timeval WhenAcked(struct time_stamp *phead, struct time_stamp *ptail,
 			 u_long position);
-static void MFUnMap(MFILE *mf, char *firstbyte);
-static void MFMap(MFILE *mf, char **firstbyte, char **lastbyte);
-static void FindGets(struct http_info *ph);
-static void FindContent(struct http_info *ph);
+static void StreamAppend(struct http_info *ph, struct http_stream *ps,
+			 char *pdata, u_long len);
+static void StreamParse(struct http_info *ph, struct http_stream *ps,
+			Bool eof);
+static void StreamFree(struct http_stream *ps);
+static u_int ParseGets(struct http_info *ph, struct http_stream *ps,
+		       Bool eof);
+static u_int ParseContent(struct http_info *ph, struct http_stream *ps,
+			  Bool eof);
+static void ReplyDone(struct http_info *ph, struct http_stream *ps,
+		      struct get_info *pget, u_long last_position);
+static Bool HaveLine(char *pch, u_int left);
+static char *FindEither(char *pch, u_int left, int c1, int c2);
+static void HttpFinish(struct http_info *ph);
 static void HttpGather(struct http_info *ph);
 static struct http_info *MakeHttpRec(void);
 static struct get_info *MakeGetRec(struct http_info *ph);
@@ -237,9 +299,9 @@ http_init(
 
     /* init stuff */
 
-    /* We need to save the contents for accurate reconstruction of questions */
-    /* and answers */
-    save_tcp_data = TRUE;
+    /* (the questions and answers are pulled out of the byte streams */
+    /*  as they go by, see http_stream_data(), so there's no need to */
+    /*  save the contents to disk anymore) */
 
 
     return(1);	/* TRUE means call http_read and http_done later */
@@ -275,7 +337,7 @@ MakeGetRec(
 {
     struct get_info *pg;
 
-    pg = MallocZ(sizeof(struct get_info));
+    pg = RunAlloc(sizeof(struct get_info));
    
     /* initialize some fields */
     pg->get_string = "- -";
@@ -299,7 +361,7 @@ MakeHttpRec()
 {
     struct http_info *ph;
 
-    ph = MallocZ(sizeof(struct http_info));
+    ph = RunAlloc(sizeof(struct http_info));
 
     ph->get_head.next = &ph->get_tail;
     ph->get_tail.prev = &ph->get_head;
@@ -422,7 +484,6 @@ http_read(
     struct tcphdr *ptcp;
     unsigned tcp_length;
     unsigned tcp_data_length;
-    char *pdata;
     struct http_info *ph = mod_data;
 
     /* find the start of the TCP header */
@@ -434,9 +495,6 @@ http_read(
     if ((ntohs(ptcp->th_sport) != httpd_port) && (ntohs(ptcp->th_dport) != httpd_port))
 	return;
 
-    /* find the data */
-    pdata = (char *)ptcp + (unsigned)TH_OFF(ptcp)*4;
-
     /* for client, record both ACKs and DATA time stamps */
     if (ph && IS_CLIENT(ptcp)) {
 	if (tcp_data_length > 0) {
@@ -490,6 +548,47 @@ http_read(
 }
 
 
+
+/* the bytes of the connection, in order, for the parsers */
+void
+http_stream_data(
+    tcp_pair *ptp,		/* info I have about this connection */
+    tcb *ptcb,			/* the direction they came from */
+    u_llong offset,		/* where they go in it */
+    char *pdata,		/* the bytes (NULL for a hole) */
+    u_long len,			/* how many */
+    void *mod_data)		/* module specific info for this connection */
+{
+    struct http_info *ph = mod_data;
+
+    if (ph == NULL)
+	return;
+
+    /* on other ports nothing is timed, so there's nothing to parse, */
+    /* but http.times still reports how many bytes went each way */
+    if ((ptp->addr_pair.a_port != httpd_port) &&
+	(ptp->addr_pair.b_port != httpd_port)) {
+	struct http_stream *ps =
+	    (ptcb == ph->tcb_client) ? &ph->client : &ph->server;
+
+	ps->started = TRUE;
+	ps->next += len;
+	return;
+    }
+
+    if (ptcb == ph->tcb_client) {
+	ph->client.started = TRUE;
+	StreamAppend(ph, &ph->client, pdata, len);
+	/* a reply might have been waiting for this request */
+	if (ph->server.stalled && !ph->server.parsing)
+	    StreamParse(ph, &ph->server, FALSE);
+    } else {
+	ph->server.started = TRUE;
+	StreamAppend(ph, &ph->server, pdata, len);
+    }
+}
+
+
 static double
 ts2d(timeval *pt)
 {
@@ -500,73 +599,186 @@ ts2d(timeval *pt)
 }
 
 
+/* the next in-order bytes (or a hole's worth of zeros, if pdata is NULL) */
 static void
-MFMap(
-    MFILE *mf,
-    char **firstbyte,
-    char **lastbyte)
+StreamAppend(
+    struct http_info *ph,
+    struct http_stream *ps,
+    char *pdata,
+    u_long len)
 {
-    int fd;
-    char *vaddr;
-    int len;
-    
-    /* find length of file */
-    if (Mfseek(mf,0,SEEK_END) != 0) {
-	perror("fseek");
-	exit(-1);
+    u_long take;
+
+    while (len > 0) {
+	if (ps->lost) {
+	    ps->next += len;
+	    return;
+	}
+
+	/* message bodies don't need to be looked at, just counted */
+	if ((ps->skip > 0) && (ps->buf_len == 0)) {
+	    take = (ps->skip < len) ? ps->skip : len;
+	    ps->skip -= take;
+	    ps->buf_off += take;
+	} else {
+	    take = (len < HTTP_CHUNK) ? len : HTTP_CHUNK;
+	    if (ps->buf_len + take + 1 > ps->buf_size) {
+		ps->buf_size = ps->buf_len + take + 1 + HTTP_LOOKAHEAD;
+		if (ps->buf == NULL)
+		    ps->buf = MallocZ(ps->buf_size);
+		else
+		    ps->buf = ReallocZ(ps->buf, ps->buf_len+1, ps->buf_size);
+	    }
+	    if (pdata)
+		memcpy(ps->buf + ps->buf_len, pdata, take);
+	    else
+		memset(ps->buf + ps->buf_len, 0, take);
+	    ps->buf_len += take;
+	    ps->buf[ps->buf_len] = '\00';
+	}
+
+	ps->next += take;
+	if (pdata)
+	    pdata += take;
+	len -= take;
+
+	StreamParse(ph, ps, FALSE);
     }
-    len = Mftell(mf);
+}
+
+
+/* run the parser over what's buffered and drop whatever it's done with */
+static void
+StreamParse(
+    struct http_info *ph,
+    struct http_stream *ps,
+    Bool eof)
+{
+    u_int used;
+
+    if (ps->lost)
+	return;
+
+    if (ps == &ph->client)
+	used = ParseGets(ph, ps, eof);
+    else
+	used = ParseContent(ph, ps, eof);
 
-    if (len == 0) {
-      *firstbyte = NULL;
-      *lastbyte = NULL;
-      return;
+    if (used > 0) {
+	ps->buf_len -= used;
+	ps->buf_off += used;
+	memmove(ps->buf, ps->buf + used, ps->buf_len + 1);
     }
-  
-    /* Memory map the entire file */
-    fd = Mfileno(mf);
-    vaddr = mmap((caddr_t) 0,	/* put it anywhere	*/
-		 len,		/* fixed size		*/
-		 PROT_READ,	/* read only		*/
-		 MAP_PRIVATE,	/* won't be sharing...	*/
-		 fd,		/* attach to 'fd'	*/
-		 (off_t) 0);	/* ... offset 0 in 'fd'	*/
-    if (vaddr == (char *) -1) {
-	perror("mmap");
-	exit(-1);
+
+    /* a reply that turns up before its request has to wait for it, but */
+    /* not forever: push along the requests we're still holding, and if */
+    /* that doesn't turn one up, this reply doesn't have one */
+    if (ps->stalled && !eof && (ps->buf_len > HTTP_WINDOW)) {
+	struct get_info *ptail = ph->gets_tail;
+
+	ps->parsing = TRUE;
+	ReasmFlush(ph->tcb_client);
+	ps->parsing = FALSE;
+	if (ph->gets_tail != ptail) {
+	    StreamParse(ph, ps, FALSE);
+	    return;
+	}
+	if (debug)
+	    fprintf(stderr,"http: no request for the reply at offset %lu of %s, ignoring the rest\n",
+		    ps->buf_off, ph->ptp->b_endpoint);
+	StreamFree(ps);
+	ps->stalled = FALSE;
+	ps->lost = TRUE;
     }
+}
+
 
-    *firstbyte = vaddr;
-    *lastbyte = vaddr+len-1;
+static void
+StreamFree(
+    struct http_stream *ps)
+{
+    if (ps->buf)
+	free(ps->buf);
+    ps->buf = NULL;
+    ps->buf_len = ps->buf_size = 0;
+}
 
-    return;
+
+/* is there enough of the header line at pch (a '\r') to decide on? */
+static Bool
+HaveLine(
+    char *pch,
+    u_int left)
+{
+    if (left >= HTTP_LOOKAHEAD)
+	return(TRUE);
+    return((left > 2) && (memchr(pch+2, '\n', left-2) != NULL));
 }
 
 
+/* the first c1 or c2 in the next "left" bytes, or NULL */
+static char *
+FindEither(
+    char *pch,
+    u_int left,
+    int c1,
+    int c2)
+{
+    char *p1 = memchr(pch, c1, left);
+    char *p2 = memchr(pch, c2, p1 ? (p1 - pch) : left);
+
+    return(p2 ? p2 : p1);
+}
+
 
+/* the connection's over: finish parsing and work out the times */
 static void
-MFUnMap(
-    MFILE *mf,
-    char *firstbyte)
+HttpFinish(
+    struct http_info *ph)
 {
-    int fd;
-    int len;
-    
-    /* find length of file */
-    if (Mfseek(mf,0,SEEK_END) != 0) {
-	perror("fseek");
-	exit(-1);
-    }
-    len = Mftell(mf);
+    struct http_stream *pcs = &ph->client;
+    struct http_stream *pss = &ph->server;
+    struct get_info *pget;
 
-    /* unmap it */
-    fd = Mfileno(mf);
-    if (munmap(firstbyte,len) != 0) {
-	perror("munmap");
-	exit(-1);
+    /* all the requests first, so every reply can find its own */
+    /* (the streams themselves have already been handed over whole) */
+    StreamParse(ph, pcs, TRUE);
+    StreamParse(ph, pss, TRUE);
+    StreamFree(pcs);
+    StreamFree(pss);
+
+    /* it takes both sides to say anything */
+    if (!pcs->started || !pss->started) {
+	ph->gets_head = ph->gets_tail = NULL;
+	ph->total_request_count = ph->total_reply_count = 0;
+	return;
     }
 
-    return;
+    if (pcs->next > 0)
+	ph->total_request_length = pcs->next - 1;
+    if ((ph->gets_head != NULL) && (pss->next > 0))
+	ph->total_reply_length = pss->next - 1;
+
+    for (pget = ph->gets_head; pget; pget = pget->next) {
+	/* when was the request sent? */
+	pget->get_time =
+	    WhenSent(&ph->get_head,&ph->get_tail,pget->request_position);
+
+	if (pget->reply_end == 0)
+	    continue;
+
+	/* when was the first byte sent? */
+	pget->send_time =
+	    WhenSent(&ph->data_head,&ph->data_tail,pget->reply_position);
+
+	/* when was the LAST byte sent? */
+	pget->lastbyte_time =
+	    WhenSent(&ph->data_head,&ph->data_tail,pget->reply_end);
+
+	/* when was the last byte ACKed? */
+	pget->ack_time =
+	    WhenAcked(&ph->ack_head,&ph->ack_tail,pget->reply_end);
+    }
 }
 
 
@@ -575,13 +787,7 @@ HttpGather(
     struct http_info *ph)
 {
     while (ph) {
-	if (ph->tcb_client->extr_contents_file &&
-	    ph->tcb_server->extr_contents_file)
-	{
-	    FindGets(ph);
-	    FindContent(ph);
-	}
-
+	HttpFinish(ph);
 	ph = ph->next;
     }
 }
@@ -664,261 +870,273 @@ WhenSent(
 
 
 
+/* a reply's over, on to the next one */
 static void
-FindContent(
-    struct http_info *ph)
+ReplyDone(
+    struct http_info *ph,
+    struct http_stream *ps,
+    struct get_info *pget,
+    u_long last_position)
+{
+    if (debug > 4)
+	printf("Content length: %d\n", pget->content_length);
+
+    pget->reply_end = last_position;
+    ph->total_reply_count++;
+
+    ps->panswered = pget;
+    ps->state = ContentStateStartHttp;
+}
+
+
+/* the server's side: pick the replies out of what's buffered, */
+/* returning how many bytes we're done with */
+static u_int
+ParseContent(
+    struct http_info *ph,
+    struct http_stream *ps,
+    Bool eof)
 {
-    tcb *tcb = ph->tcb_server;
-    MFILE *mf = tcb->extr_contents_file;
-    char *pdata;
-    char *plast;
+    char *pdata = ps->buf;
+    u_int len = ps->buf_len;
+    u_int i = 0;
     char *pch;
     char *pch2;
+    u_int left;
     struct get_info *pget;
     char getbuf[1024];
-    u_long position = 0;
-    unsigned last_position = 0;
-    int done;
-    int i;
-    typedef enum {
-       ContentStateStartHttp,
-       ContentStateFinishHttp,
-       ContentStateFindResponse,
-       ContentStateFindContentLength,
-       ContentStateFinishHeader} StateType;
-    StateType state;
-
-    pget = ph->gets_head;
-    if ((mf) && (pget)) {
- 
-       state = ContentStateStartHttp;
-       done = 0;
+    u_long off;
+    int j;
 
-       /* Memory map the entire file (I hope it's short!) */
-       MFMap(mf,&pdata,&plast);
-      
-       if (pdata == NULL) {
-	 return;
-       }
-      
-       pch = pdata;
-       
-       ph->total_reply_length = (unsigned) (plast - pdata);
-       ph->total_reply_count= 0;
-       
-       while ((!done) && (pch <= (char *) plast)) {
-           switch (state) {
-
-	    /* Start state: Find "HTTP/" that begins a response */
-	    case (ContentStateStartHttp): {
-	       if (strncasecmp(pch, "HTTP/", 5) == 0) {
-
-		  /* Found start of a response */
-		  state = ContentStateFinishHttp;
-		  position = pch - pdata + 1;
-		  pget->reply_position = position;
-		  pch += 5;
-	       }
-	       else {
-		  pch++;
-	       }
+    while (i < len) {
+	pch = pdata + i;
+	left = len - i;
+
+	/* the body of the last one */
+	if (ps->skip > 0) {
+	    if (ps->skip >= left) {
+		ps->skip -= left;
+		i = len;
+		break;
+	    }
+	    i += ps->skip;
+	    ps->skip = 0;
+	    continue;
+	}
+
+	/* the request this reply goes with */
+	pget = ps->panswered ? ps->panswered->next : ph->gets_head;
+
+	switch (ps->state) {
+
+	  /* Start state: Find "HTTP/" that begins a response */
+	  case ContentStateStartHttp:
+	    pch = FindEither(pch, left, 'H', 'h');
+	    if (pch == NULL) {
+		i = len;
+		break;
 	    }
-	      break;
-
-	    /* Finish off HTTP string (version number) by looking for whitespace */
-	    case (ContentStateFinishHttp): {
-	       if (*(pch) == ' ') {
-		  state = ContentStateFindResponse;
-	       }
-	       else {
-		  pch++;
-	       }
+	    i = pch - pdata;
+	    left = len - i;
+	    if ((left < 5) && !eof)
+		return(i);
+
+	    if ((left < 5) || (strncasecmp(pch, "HTTP/", 5) != 0)) {
+		++i;
+		break;
 	    }
-	      break;
-	      
-	    /* Look for response code by finding non-whitespace. */
-	    case (ContentStateFindResponse): {
-	       if (*(pch) != ' ') {
-		  pget->response_code = atoi(pch);
-		  pch += 3;
-		  state = ContentStateFindContentLength;
-	       }
-	       else {
-		  pch++;
-	       }
+
+	    /* Found start of a response */
+	    if (pget == NULL) {
+		/* no more questions: quit, unless there's more to come */
+		if (eof) {
+		    ps->stalled = FALSE;
+		    return(len);
+		}
+		ps->stalled = TRUE;
+		return(i);
 	    }
-	      break;
-	      
-	    /* this state is now misnamed since we pull out other */
-	    /* headers than just content-length now. */
-	    case (ContentStateFindContentLength): {
-	       if (strncasecmp(pch, "\r\nContent-Length:", 17) == 0) {
-		  /* Got content-length field, ignore rest of header */
-		  pget->content_length = atoi(&(pch[17]));
-		  pch += 18;
-	       }
-	       else if (strncasecmp(pch, "\r\nContent-Type:", 15) == 0) {
-		  /* Get content-type field, skipping leading spaces */
-		  pch += 15;
-		  while (*pch == ' ') {
-		     pch++;
-		  }
-		  for (i=0,pch2 = pch; ; ++i, ++pch2) {
-		     if ((*pch2 == '\n') || (*pch2 == '\r') ||
-			 (i >= sizeof(getbuf)-1)) {
-			getbuf[i] = '\00';
-			pch = pch2;  /* skip forward */
+	    ps->stalled = FALSE;
+	    pget->reply_position = ps->buf_off + i + 1;
+	    i += 5;
+	    ps->state = ContentStateFinishHttp;
+	    break;
+
+	  /* Finish off HTTP string (version number) by looking for */
+	  /* whitespace */
+	  case ContentStateFinishHttp:
+	    pch = memchr(pch, ' ', left);
+	    if (pch == NULL) {
+		i = len;
+		break;
+	    }
+	    i = pch - pdata;
+	    ps->state = ContentStateFindResponse;
+	    break;
+
+	  /* Look for response code by finding non-whitespace. */
+	  case ContentStateFindResponse:
+	    if (*pch == ' ') {
+		++i;
+		break;
+	    }
+	    if (!eof && (left < HTTP_LOOKAHEAD) &&
+		(memchr(pch, '\n', left) == NULL))
+		return(i);
+	    pget->response_code = atoi(pch);
+	    i += 3;
+	    ps->state = ContentStateFindContentLength;
+	    break;
+
+	  /* this state is now misnamed since we pull out other */
+	  /* headers than just content-length now. */
+	  case ContentStateFindContentLength:
+	    pch = memchr(pch, '\r', left);
+	    if (pch == NULL) {
+		i = len;
+		break;
+	    }
+	    i = pch - pdata;
+	    left = len - i;
+	    if (!eof && !HaveLine(pch, left))
+		return(i);
+
+	    if ((left >= 17) &&
+		(strncasecmp(pch, "\r\nContent-Length:", 17) == 0)) {
+		/* Got content-length field, ignore rest of header */
+		pget->content_length = atoi(pch+17);
+		i += 18;
+	    } else if ((left >= 15) &&
+		       (strncasecmp(pch, "\r\nContent-Type:", 15) == 0)) {
+		/* Get content-type field, skipping leading spaces */
+		for (i += 15; (i < len) && (pdata[i] == ' '); ++i)
+		    ;
+		for (j=0, pch2 = pdata+i; ; ++j, ++pch2) {
+		    if ((pch2 == pdata+len) ||
+			(*pch2 == '\n') || (*pch2 == '\r') ||
+			(j >= sizeof(getbuf)-1)) {
+			getbuf[j] = '\00';
+			i = pch2 - pdata;  /* skip forward */
 			break;
-		     }
-		     getbuf[i] = *pch2;
-		  }
-		  
-		  /* If there are any spaces in the Content-Type */
-		  /* field, we need to truncate at that point */
-		    {
-		       char *sp;
-		       sp = (char *)index(getbuf, ' ');
-		       if (sp) {
-			  *sp = '\00';
-		       }
 		    }
-		  pget->content_type = strdup(getbuf);
-		  
-	       }
-	       else if (strncmp(pch, "\r\n\r\n", 4) == 0) {
-		  /* No content-length header detected */
-		  /* No increment for pch here, effectively fall through */
-		  /* pget->content_length = 0; */
-		  state = ContentStateFinishHeader;
-	       }
-	       else {
-		  pch++;
-	       }
+		    getbuf[j] = *pch2;
+		}
+
+		/* If there are any spaces in the Content-Type */
+		/* field, we need to truncate at that point */
+		pch2 = index(getbuf, ' ');
+		if (pch2)
+		    *pch2 = '\00';
+		pget->content_type = strdup(getbuf);
+	    } else if ((left >= 4) && (strncmp(pch, "\r\n\r\n", 4) == 0)) {
+		/* No content-length header detected */
+		ps->state = ContentStateFinishHeader;
+	    } else {
+		++i;
+	    }
+	    break;
+
+	  /* Skip over the rest of the header */
+	  case ContentStateFinishHeader:
+	    pch = memchr(pch, '\r', left);
+	    if (pch == NULL) {
+		i = len;
+		break;
 	    }
-	      break;
-	      
-	    /* Skip over the rest of the header */
-	    case (ContentStateFinishHeader): {
-	       if (strncmp(pch, "\r\n\r\n", 4) == 0) {
-		  
-		  /* Found end of header */
-		  pch += 4;
-		  
-		  /*
-		   * At this point, we need to find the end of the
-		   * response body.  There's a variety of ways to
-		   * do this, but in any case, we need to make sure
-		   * that pget->content_length, pch, and last_postiion
-		   * are all set appropriately.
-		   *
-		   * See if we can ignore the body.  We can do this
-		   * for the reply to HEAD, for a 204 (no content),
-		   * 205 (reset content), or 304 (not modified).
-		   */
-		  if ((pget->method == MethodCodeHead) ||
-		      (pget->response_code == 204) ||
-		      (pget->response_code == 205) ||
-		      (pget->response_code == 304)) {
-		     pget->content_length = 0;
-		  }
-		  
-		  /*
-		   * Use content-length header if one was present.
-		   * XXX is content_length > 0 the right test?
-		   */
-		  else if (pget->content_length > 0) {
-		     pch += pget->content_length;
-		  }
-		  
-		  /*
-		   * No content-length header, so delimit response
-		   * by end of file.
-		   * 
-		   * But, make sure we do not have a "\r\n\r\n" string
-		   * in the response, because that might indicate the 
-		   * beginning of a following response.
-		   * (Patch from Yufei Wang)
-		   */
-		  else {
-		   char *start = pch;
-		   while (pch <= (char *)plast) {
-		     if (strncmp(pch, "\r\n\r\n", 4) == 0) {
-		       pch += 4;
-		       state = ContentStateStartHttp;
-		       break;
-		     } else {
-		       pch++;
-		     }
-		   } 
-		   
-		   if (state == ContentStateStartHttp) {
-		     pget->content_length = pch - start;
-		   } else {
-		     /* calculate the content length */
-		     pget->content_length = plast - start + 1;
-		     pch = plast + 1;
-		   }
-		  }
-		 
-		  /* Set next state and do original tcptrace
-		   * processing based on what we learned above.
-		   */
-		  state = ContentStateStartHttp;
-		  last_position = pch - pdata + 1;
-		  
-		  /* when was the first byte sent? */
-		  pget->send_time = WhenSent(&ph->data_head,&ph->data_tail,position);
-		  
-		  /* when was the LAST byte sent? */
-		  pget->lastbyte_time = WhenSent(&ph->data_head,&ph->data_tail,last_position);
-		  
-		  /* when was the last byte ACKed? */
-		  if (debug > 4)
-		    printf("Content length: %d\n", pget->content_length);
-		  pget->ack_time = WhenAcked(&ph->ack_head,&ph->ack_tail,last_position);
-
-		  /* increment our counts */
-		  ph->total_reply_count++;
-
-		  /* skip to the next request */
-		  pget = pget->next;
-
-		  if (!pget) {
-		     /* no more questions, quit */
-		     done = 1;
-		     break;
-		  }
-	       }
-	       else {
-		  pch++;
-	       }
+	    i = pch - pdata;
+	    left = len - i;
+	    if ((left < 4) && !eof)
+		return(i);
+	    if ((left < 4) || (strncmp(pch, "\r\n\r\n", 4) != 0)) {
+		++i;
+		break;
+	    }
+
+	    /* Found end of header */
+	    i += 4;
+	    off = ps->buf_off + i;
+
+	    /*
+	     * See if we can ignore the body.  We can do this
+	     * for the reply to HEAD, for a 204 (no content),
+	     * 205 (reset content), or 304 (not modified).
+	     */
+	    if ((pget->method == MethodCodeHead) ||
+		(pget->response_code == 204) ||
+		(pget->response_code == 205) ||
+		(pget->response_code == 304)) {
+		pget->content_length = 0;
+		ReplyDone(ph, ps, pget, off + 1);
+	    }
+
+	    /*
+	     * Use content-length header if one was present.
+	     * XXX is content_length > 0 the right test?
+	     */
+	    else if (pget->content_length > 0) {
+		ps->skip = pget->content_length;
+		ReplyDone(ph, ps, pget,
+			  (unsigned)(off + pget->content_length + 1));
+	    }
+
+	    /*
+	     * No content-length header, so the response runs to the
+	     * end of the stream, or to a "\r\n\r\n", which might be
+	     * the beginning of a following response.
+	     * (Patch from Yufei Wang)
+	     */
+	    else {
+		ps->body_start = off;
+		ps->state = ContentStateFindEnd;
 	    }
-	      break;
-	      
-	   }
-       }
-       
-       MFUnMap(mf,pdata);
+	    break;
+
+	  case ContentStateFindEnd:
+	    pch = memchr(pch, '\r', left);
+	    if (pch == NULL) {
+		i = len;
+		break;
+	    }
+	    i = pch - pdata;
+	    left = len - i;
+	    if ((left < 4) && !eof)
+		return(i);
+	    if ((left < 4) || (strncmp(pch, "\r\n\r\n", 4) != 0)) {
+		++i;
+		break;
+	    }
+	    i += 4;
+	    off = ps->buf_off + i;
+	    pget->content_length = off - ps->body_start;
+	    ReplyDone(ph, ps, pget, off + 1);
+	    break;
+	}
     }
-   else {
-      if (debug > 4) {
-	 printf("FindContent() with null server contents");
-      }
-   }
-   
+
+    /* the last body ran to the end of the stream */
+    if (eof && (ps->state == ContentStateFindEnd)) {
+	pget = ps->panswered ? ps->panswered->next : ph->gets_head;
+	off = ps->buf_off + len;
+	pget->content_length = off - ps->body_start;
+	ReplyDone(ph, ps, pget, off + 1);
+    }
+
+    return((i < len) ? i : len);
 }
 
+
 static char * formatGetString(char * s) 
 {
   int len = strlen(s);
   int i = 0;
   int j = 0;
-  char *buf = (char *)malloc(len);
-  char ascii[2];
+  char *buf = (char *)malloc(len+1);
+  char ascii[3];
   while (i < len) {
-    if (s[i] == '%') {
+    if ((s[i] == '%') && (i+2 < len)) {
       ascii[0] = s[i+1];
       ascii[1] = s[i+2];
+      ascii[2] = '\00';
       buf[j++] = atoi(ascii);
       i = i+3;
     } else {
@@ -930,186 +1148,189 @@ static char * formatGetString(char * s)
   return buf;
 }
 
-static void
-FindGets(
-    struct http_info *ph)
+/* the client's side: pick the requests out of what's buffered, */
+/* returning how many bytes we're done with */
+static u_int
+ParseGets(
+    struct http_info *ph,
+    struct http_stream *ps,
+    Bool eof)
 {
-    tcb *tcb = ph->tcb_client;
-    MFILE *mf = tcb->extr_contents_file;
-    char *pdata;
-    char *plast;
+    char *pdata = ps->buf;
+    u_int len = ps->buf_len;
+    u_int i = 0;
     char *pch;
     char *pch2;
-    struct get_info *pget = NULL;
+    u_int left;
+    struct get_info *pget;
     char getbuf[1024];
-    u_long position = 0;
-    int j;
     int methodlen;
-    unsigned long long contentLength = 0;
+    int j;
 
-     typedef enum {
-       GetStateStartMethod,
-       GetStateFinishMethod,
-       GetStateFindContentLength,
-       GetStateFinishHeader
-     } StateType;
-     StateType state;
+    while (i < len) {
+	pch = pdata + i;
+	left = len - i;
 
-   if (mf) {
+	/* the body of the last one */
+	if (ps->skip > 0) {
+	    if (ps->skip >= left) {
+		ps->skip -= left;
+		i = len;
+		break;
+	    }
+	    i += ps->skip;
+	    ps->skip = 0;
+	    continue;
+	}
 
-      /* Memory map the entire file (I hope it's short!) */
-      MFMap(mf,&pdata,&plast);
+	switch (ps->state) {
 
-      if (pdata == NULL) {
-	return;
-      }
-	
-      ph->total_request_length = (unsigned) (plast - pdata);
-      ph->total_request_count = 0;
-      
-      state = GetStateStartMethod;
-      
-      /* search for method string*/
-      pch = pdata;
-      while (pch <= (char *)plast) {
-	  switch (state) {
-	     
 	  /* Start state: Find access method keyword */
-	  case (GetStateStartMethod): {
-	     
-	  /* Try to find a word describing a method.  These
-	   * are all the methods defined in
-           * draft-ietf-http-v11-spec-rev-06
-	   */
-	     MethodCode method = MethodCodeUnknown;
-	     methodlen = 0;
-	     if (strncasecmp(pch, "options ", 8) == 0) {
-		methodlen = 8;
-		method = MethodCodeOptions;
-	     }
-	     else if (strncasecmp(pch, "get ", 4) == 0) {
-		methodlen = 4;
-		method = MethodCodeGet;
-	     }
-	     else if (strncasecmp(pch, "head ", 5) == 0) {
-		methodlen = 5;
-		method = MethodCodeHead;
-	     }
-	     else if (strncasecmp(pch, "post ", 5) == 0) {
-		methodlen = 5;
-		method = MethodCodePost;
-	     }
-	     else if (strncasecmp(pch, "put ", 4) == 0) {
-		methodlen = 4;
-		method = MethodCodePut;
-	     }
-	     else if (strncasecmp(pch, "delete ", 7) == 0) {
-		methodlen = 7;
-		method = MethodCodeDelete;
-	     }
-	     else if (strncasecmp(pch, "trace ", 6) == 0) {
-		methodlen = 6;
-		method = MethodCodeTrace;
-	     }
-	     
-	     if (methodlen > 0) {
-		/* make a new record for this entry */
-		pget = MakeGetRec(ph);
-		
-		/* remember where it started */
-		position = pch - pdata + 1;
-		pget->request_position = position;
-		pget->reply_position = 0;
-		pget->method = method;
-		
-		contentLength = 0;
-		pch += methodlen;
-		state = GetStateFinishMethod;
-	     }
-	     else {
-		/* Couldn't find a valid method, so increment */
-		/* and attempt to resynchronize.  This shouldn't */
-		/* happen often. */
-		pch++;
-	     }
-	     
-	  };
-	    break;
-	    
-	  case (GetStateFinishMethod): {
-	     /* grab the GET string */
-	     for (j=0,pch2 = pch; ; ++j,++pch2) {
-		if ((*pch2 == '\n') || (*pch2 == '\r') ||
-		    (j >= sizeof(getbuf)-1)) {
-		   getbuf[j] = '\00';
-		   pch = pch2;  /* skip forward */
-		   state = GetStateFindContentLength;
-		   break;
-		}
-		getbuf[j] = *pch2;
-	     }
-	     pget->get_string = formatGetString(getbuf);
-	     
-	     /* grab the time stamps */
-	     pget->get_time =
-	       WhenSent(&ph->get_head,&ph->get_tail,position);
-	     ph->total_request_count++;
-	     
-	  }
-	     break;
-	     
-	  /* Locate content-length field, if any */
-	   case (GetStateFindContentLength): {
-	      
-	      if (strncasecmp(pch, "\r\nContent-Length:", 17) == 0) {
-		 /* Get content-length field */
-		 contentLength = atoi(&pch[17]);
-		 pch += 17;
+	  case GetStateStartMethod: {
+	      /* Try to find a word describing a method.  These
+	       * are all the methods defined in
+	       * draft-ietf-http-v11-spec-rev-06
+	       */
+	      MethodCode method = MethodCodeUnknown;
+
+	      /* (which all start with one of these) */
+	      while ((left > 0) && (strchr("dghopt", tolower(*pch)) == NULL)) {
+		  ++pch;
+		  --left;
+	      }
+	      i = pch - pdata;
+	      if (left == 0)
+		  break;
+	      if ((left < 8) && !eof)
+		  return(i);
+
+	      methodlen = 0;
+	      if (strncasecmp(pch, "options ", 8) == 0) {
+		  methodlen = 8;
+		  method = MethodCodeOptions;
+	      }
+	      else if (strncasecmp(pch, "get ", 4) == 0) {
+		  methodlen = 4;
+		  method = MethodCodeGet;
+	      }
+	      else if (strncasecmp(pch, "head ", 5) == 0) {
+		  methodlen = 5;
+		  method = MethodCodeHead;
 	      }
-	      else if (strncmp(pch, "\r\n\r\n", 4) == 0) {
-		 /* No content-length header detected, assume */
-		 /* zero.  Fall through (effective). */
-		 /* contentLength = 0; */
-		 state = GetStateFinishHeader;
+	      else if (strncasecmp(pch, "post ", 5) == 0) {
+		  methodlen = 5;
+		  method = MethodCodePost;
+	      }
+	      else if (strncasecmp(pch, "put ", 4) == 0) {
+		  methodlen = 4;
+		  method = MethodCodePut;
+	      }
+	      else if (strncasecmp(pch, "delete ", 7) == 0) {
+		  methodlen = 7;
+		  method = MethodCodeDelete;
+	      }
+	      else if (strncasecmp(pch, "trace ", 6) == 0) {
+		  methodlen = 6;
+		  method = MethodCodeTrace;
+	      }
+
+	      if ((methodlen > 0) && (methodlen <= left)) {
+		  /* make a new record for this entry */
+		  pget = MakeGetRec(ph);
+
+		  /* remember where it started */
+		  pget->request_position = ps->buf_off + i + 1;
+		  pget->reply_position = 0;
+		  pget->method = method;
+
+		  ps->content_length = 0;
+		  i += methodlen;
+		  ps->state = GetStateFinishMethod;
 	      }
 	      else {
-		 pch++;
+		  /* Couldn't find a valid method, so increment */
+		  /* and attempt to resynchronize.  This shouldn't */
+		  /* happen often. */
+		  ++i;
 	      }
-	   }
-	     break;
-	     
-	  case (GetStateFinishHeader): {
-	     if (strncmp(pch, "\r\n\r\n", 4) == 0) {
-		
-		/* Found end of header */
-		pch += 4;
-		
-		/* Find end of response body. */
-		if (contentLength > 0) {
-		   pch += contentLength;
-		}
-		else {
-		   /* XXX What if a POST with no content-length? */
-		}
-		
-		state = GetStateStartMethod;
-	     }
-	     else {
-		pch++;
-	     }
 	  }
-	     break;
-	  }
-      }
-            
-      MFUnMap(mf,pdata);
-   }
-   
-   else {
-      if (debug > 4) {
-	 printf("FindGets() with null client contents");
-      }
-   }
+	    break;
+
+	  case GetStateFinishMethod:
+	    /* grab the GET string */
+	    j = (left < sizeof(getbuf)-1) ? left : sizeof(getbuf)-1;
+	    pch2 = FindEither(pch, j, '\n', '\r');
+	    if (pch2 == NULL) {
+		if ((j < sizeof(getbuf)-1) && !eof)
+		    return(i);
+		pch2 = pch + j;
+	    }
+	    j = pch2 - pch;
+	    memcpy(getbuf, pch, j);
+	    getbuf[j] = '\00';
+	    i = pch2 - pdata;  /* skip forward */
+
+	    ph->gets_tail->get_string = formatGetString(getbuf);
+	    ph->total_request_count++;
+	    ps->state = GetStateFindContentLength;
+	    break;
+
+	  /* Locate content-length field, if any */
+	  case GetStateFindContentLength:
+	    pch = memchr(pch, '\r', left);
+	    if (pch == NULL) {
+		i = len;
+		break;
+	    }
+	    i = pch - pdata;
+	    left = len - i;
+	    if (!eof && !HaveLine(pch, left))
+		return(i);
+
+	    if ((left >= 17) &&
+		(strncasecmp(pch, "\r\nContent-Length:", 17) == 0)) {
+		/* Get content-length field */
+		ps->content_length = atoi(pch+17);
+		i += 17;
+	    }
+	    else if ((left >= 4) && (strncmp(pch, "\r\n\r\n", 4) == 0)) {
+		/* No content-length header detected, assume */
+		/* zero.  Fall through (effective). */
+		ps->state = GetStateFinishHeader;
+	    }
+	    else {
+		++i;
+	    }
+	    break;
+
+	  case GetStateFinishHeader:
+	    pch = memchr(pch, '\r', left);
+	    if (pch == NULL) {
+		i = len;
+		break;
+	    }
+	    i = pch - pdata;
+	    left = len - i;
+	    if ((left < 4) && !eof)
+		return(i);
+	    if ((left < 4) || (strncmp(pch, "\r\n\r\n", 4) != 0)) {
+		++i;
+		break;
+	    }
+
+	    /* Found end of header */
+	    i += 4;
+
+	    /* Find end of request body. */
+	    /* XXX What if a POST with no content-length? */
+	    ps->skip = ps->content_length;
+
+	    ps->state = GetStateStartMethod;
+	    break;
+	}
+    }
+
+    return(i);
 }
 
 
@@ -62,3 +62,5 @@ void http_done(void);
 void http_usage(void);
 void http_newfile(char *newfile, u_long filesize, Bool fcompressed);
 void *http_newconn(tcp_pair *ptp);
+void http_stream_data(tcp_pair *ptp, tcb *ptcb, u_llong offset, char *pdata,
+		      u_long len, void *pmod_data);
@@ -187,30 +187,23 @@ static void ipCheck(struct ip *pip, void *plast);
 static void tcpCheck(struct ip *pip, tcp_pair *ptcp, void *plast);
 static void udpCheck(struct ip *pip, udp_pair *pup, void *plast);
 
-static itcinfo *Makeitcinfo(void);
+static itcinfo *Makeitcinfo(tcp_pair *);
 static iucinfo *Makeiucinfo(void);
-static void Freeitcinfo(itcinfo *);
 static void Freeiucinfo(iucinfo *);
 
 /* declarations of memory management functions for the module */
 
-static long itcinfo_pool = -1;
 static long iucinfo_pool = -1;
 
 /* tcp packet */
 
+/* the record comes out of the connection's own memory, and goes */
+/* away along with it */
 static itcinfo *
      Makeitcinfo(
-		void)
+		tcp_pair *ptp)
 {
-     itcinfo *ptr = NULL;
-     
-     if (itcinfo_pool < 0) {
-	  itcinfo_pool = MakeMemPool(sizeof(itcinfo), 0);
-     }
-     
-     ptr = PoolMalloc(itcinfo_pool, sizeof(itcinfo));
-     return ptr;
+     return ConnAlloc(ptp, sizeof(itcinfo));
 }
 
 /* udp packet */
@@ -230,13 +223,6 @@ static iucinfo *
 }
 
 
-static void
-     Freeitcinfo(
-		itcinfo *ptr)
-{
-     PoolFree(itcinfo_pool, ptr);
-}
-
 static void
      Freeiucinfo(
 		 iucinfo *ptr)
@@ -356,7 +342,7 @@ void *
      inbounds_tcp_newconn( 
 		       tcp_pair *ptp)
 {
-     itcinfo *newConn = Makeitcinfo();
+     itcinfo *newConn = Makeitcinfo(ptp);
      
      if (mod_info->last_tcp_scheduled_time.tv_sec == 0) {
 	  mod_info->last_tcp_scheduled_time = current_time;
@@ -431,7 +417,7 @@ void
 	  conn->prev->next = conn->next;
 	  conn->next->prev = conn->prev;
      }
-     Freeitcinfo(conn);
+     /* (the record itself is freed along with the connection) */
      return;
 }
 
@@ -474,7 +460,7 @@ void
      }
      
      if (0) {
-	  printf("hash %i\t\tclosed %i, a2bfin %i, b2afin %i\n", 
+	  printf("hash %" FS_ULL "\t\tclosed %i, a2bfin %i, b2afin %i\n", 
 		 ptp->addr_pair.hash, conn->closed, 
 		 ptp->a2b.fin_count, ptp->b2a.fin_count);
 	  fflush(stdout);
@@ -712,13 +698,8 @@ void *
      return newConn;
 }
 
-/* This function is not invoked by tcptrace currently and is here mostly
- * for the sake of completeness. You may need to fix the module definition
- * in modules.h and fix tcptrace.c/trace.c to make sure this function gets 
- * invoked (if you need this functionality, of course) - Mani, 4 Mar 2004.
- */
-
-/* delete timedout UDP connections */
+/* delete timedout UDP connections (called from udp.c in real-time mode */
+/* when a flow has been idle for remove_udp_conn_interval) */
 void
      inbounds_udp_deleteconn(
 			     udp_pair *pup, // info I have about this conn.
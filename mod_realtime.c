@@ -108,27 +108,14 @@ static u_llong nontcpudp_packets = 0;
 static struct protocol *plist = NULL;
 
 /* declarations of memory management functions for the module */
-static long rtconn_pool   = -1;
 
+/* the record comes out of the connection's own memory, and */
+/* goes away along with it */
 static rtconn *
 MakeRtconn(
-	   void)
+	   tcp_pair *ptp)
 {
-  rtconn *ptr = NULL;
-
-  if (rtconn_pool < 0) {
-    rtconn_pool = MakeMemPool(sizeof(rtconn), 0);
-  }
-
-  ptr = PoolMalloc(rtconn_pool, sizeof(rtconn));
-  return ptr;
-}
-
-static void
-FreeRtconn(
-	   rtconn *ptr)
-{
-  PoolFree(rtconn_pool, ptr);
+  return ConnAlloc(ptp, sizeof(rtconn));
 }
 
 
@@ -212,7 +199,7 @@ void *
 realtime_newconn( 
 		 tcp_pair *ptp)
 {
-   rtconn *new_conn = MakeRtconn();
+   rtconn *new_conn = MakeRtconn(ptp);
    
    if (mod_info->last_scheduled_time.tv_sec == 0) {
       mod_info->last_scheduled_time = current_time;
@@ -273,7 +260,7 @@ realtime_deleteconn(
     conn->next->prev = conn->prev;
   }
 
-  FreeRtconn(conn);
+  /* (the record itself is freed along with the connection) */
   return;
 }
 
@@ -213,7 +213,7 @@ MakeRttgraphRec()
 {
     struct rttgraph_info *prttg;
 
-    prttg = MallocZ(sizeof(struct rttgraph_info));
+    prttg = RunAlloc(sizeof(struct rttgraph_info));
 
     /* (...leave the samples pointer NULL until first needed) */
     prttg->a2b.samples.max_samples = 0;
@@ -3809,14 +3809,14 @@ IsNewBurst(
 
 
     if (graph_tsg) {
-	plotter_perm_color(ptcb->tsg_plotter, "green");
-	plotter_text(ptcb->tsg_plotter, current_time, seq, "a", "?");
+	plotter_perm_color(ptcb->pgraphs->tsg_plotter, "green");
+	plotter_text(ptcb->pgraphs->tsg_plotter, current_time, seq, "a", "?");
     }
 
     /* it's only a NEW burst if there was a PREVIOUS burst */
     if (ptcbc->burst_bytes == 0) {
 	if (graph_tsg)
-	    plotter_text(ptcb->tsg_plotter, current_time, seq, "b", "==0");
+	    plotter_text(ptcb->pgraphs->tsg_plotter, current_time, seq, "b", "==0");
 	return(FALSE);
     }
 
@@ -3824,7 +3824,7 @@ IsNewBurst(
     if (SEQ_LESSTHAN(ptcb_otherdir->ack,seq)) {
 	/* not ACKed */
 	if (graph_tsg)
-	    plotter_text(ptcb->tsg_plotter, current_time, seq, "b", "noack");
+	    plotter_text(ptcb->pgraphs->tsg_plotter, current_time, seq, "b", "noack");
 	return(FALSE);
     }
 
@@ -3836,7 +3836,7 @@ IsNewBurst(
 	    if (graph_tsg) {
 		char buf[100];
 		snprintf(buf,sizeof(buf),"short (%ld < %ld)", etime_usecs, last_rtt_usecs);
-		plotter_text(ptcb->tsg_plotter, current_time, seq, "b", buf);
+		plotter_text(ptcb->pgraphs->tsg_plotter, current_time, seq, "b", buf);
 	    }
 	    return(FALSE);
 	}
@@ -3846,15 +3846,15 @@ IsNewBurst(
     if (ptcb == orig_lastdata) {
 	/* no intervening data */
 	if (graph_tsg)
-	    plotter_text(ptcb->tsg_plotter, current_time, seq, "b", "!data");
+	    plotter_text(ptcb->pgraphs->tsg_plotter, current_time, seq, "b", "!data");
 	return(FALSE);
     }
 
     /* ... else, it's a new burst */
 
     if (graph_tsg) {
-	plotter_perm_color(ptcb->tsg_plotter, "magenta");
-	plotter_text(ptcb->tsg_plotter, current_time, seq, "r", "YES!!");
+	plotter_perm_color(ptcb->pgraphs->tsg_plotter, "magenta");
+	plotter_text(ptcb->pgraphs->tsg_plotter, current_time, seq, "r", "YES!!");
     }
     return(TRUE);
 }
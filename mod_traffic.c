@@ -565,7 +565,7 @@ MakeConnRec(void)
 {
     struct conn_info *pci;
 
-    pci = MallocZ(sizeof(struct conn_info));
+    pci = RunAlloc(sizeof(struct conn_info));
 
     /* chain it in (at head of list) */
     pci->next = connhead;
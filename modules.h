@@ -135,6 +135,25 @@ struct module {
     void (*module_deleteconn) (
 	 tcp_pair *ptp,		/* info I have about this connection */
 	 void *pmodstruct);	/* module-specific structure */
+
+    /* Called for old UDP flows when they are deleted by */
+    /* the real-time version of the program */
+    void (*module_udp_deleteconn) (
+	 udp_pair *pup,		/* info I have about this connection */
+	 void *pmodstruct);	/* module-specific structure */
+
+    /* If you want the connection's contents rather than its packets, */
+    /* I'll put each direction back in order and hand it to you a run */
+    /* of bytes at a time, each byte exactly once, after the read */
+    /* routine has seen the packet that completed it (see reasm.c). */
+    /* A hole I had to give up on comes with pdata NULL.		*/
+    void (*module_stream_data) (
+	 tcp_pair *ptp,		/* info I have about this connection */
+	 tcb *ptcb,		/* the direction it's from */
+	 u_llong offset,	/* of pdata[0], the byte after the SYN is 0 */
+	 char *pdata,		/* the bytes (only good during the call) */
+	 u_long len,		/* how many */
+	 void *pmodstruct);	/* module-specific structure */
 };
 
 
@@ -189,7 +208,9 @@ struct module modules[] = {
      http_usage,		/* routine to call to print module usage */
      http_newfile,		/* routine to call on each new file */
      http_newconn,		/* routine to call on each new connection */
-     NULL, NULL, NULL, NULL},	/* not interested in non-tcp */
+     NULL, NULL, NULL,		/* not interested in non-tcp */
+     NULL, NULL,		/* routines to call on old connections */
+     http_stream_data},		/* routine to pass the byte streams */
 #endif /* LOAD_MODULE_HTTP */
 
     /* list other modules here ... */
@@ -276,7 +297,8 @@ struct module modules[] = {
      inbounds_udp_newconn,       /* routine to call on each new UDP conn */
      inbounds_nontcpudp_read, 	 /* routine to pass each non-tcp and non-udp 
 				    packets*/
-     inbounds_tcp_deleteconn},        /* routine to remove TCP connections */
+     inbounds_tcp_deleteconn,        /* routine to remove TCP connections */
+     inbounds_udp_deleteconn},       /* routine to remove UDP connections */
 #endif /* LOAD_MODULE_INBOUNDS */
   
 };
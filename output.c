@@ -75,12 +75,14 @@ static void StatLineF(char *, char *, char *, double, double);
 static void StatLineField(char *, char *, char *, u_long, int);
 static void StatLineFieldF(char *, char *, char *, double, int);
 static void StatLineOne(char *, char *, char *);
+static int FormatPrec(char *);
 static char *FormatBrief(tcp_pair *ptp);
 static char *UDPFormatBrief(udp_pair *pup);
 
 /* locally global variables*/
 static u_int sv_print_count    = 0;
 static u_int sv_expected_count = 0;
+static Bool sv_mode = FALSE;	/* doing --csv/--tsv/--sv for this one */
 
 /* global variables */
 char *sp;  /* Separator used for long output with <SP>-separated-values */
@@ -218,6 +220,7 @@ PrintTrace(
 
    /* Reset the counter for each connection */
    sv_print_count = 1; /* The first field (conn_#) gets printed in trace.c */
+   sv_mode = (csv || tsv || (sv != NULL));
    
 
     /* calculate elapsed time */
@@ -228,17 +231,19 @@ PrintTrace(
     /* Check if comma-separated-values or tab-separated-values
      * has been requested.
      */ 
-   if(csv || tsv || (sv != NULL)) {
-       fprintf(stdout,"%s%s%s%s%s%s%s%s",
-	       ptp->a_hostname, sp, ptp->b_hostname, sp,
-	       ptp->a_portname, sp, ptp->b_portname, sp);
+   if(sv_mode) {
+       SVRaw(ptp->a_hostname); SVRaw(sp);
+       SVRaw(ptp->b_hostname); SVRaw(sp);
+       SVRaw(ptp->a_portname); SVRaw(sp);
+       SVRaw(ptp->b_portname); SVRaw(sp);
        sv_print_count += 4;
        /* Print the start and end times. In other words,
 	* print the time of the first and the last packet
 	*/ 
-       fprintf(stdout,"%ld.%ld %s %ld.%ld %s",
-	       (long)ptp->first_time.tv_sec, (long)ptp->first_time.tv_usec, sp,
-	       (long)ptp->last_time.tv_sec, (long)ptp->last_time.tv_usec, sp);
+       SVRawU(ptp->first_time.tv_sec); SVRaw(".");
+       SVRawU(ptp->first_time.tv_usec); SVRaw(" "); SVRaw(sp); SVRaw(" ");
+       SVRawU(ptp->last_time.tv_sec); SVRaw(".");
+       SVRawU(ptp->last_time.tv_usec); SVRaw(" "); SVRaw(sp);
        sv_print_count += 2;      
     }
     else {
@@ -269,7 +274,7 @@ PrintTrace(
     }
    
     StatLineI("total packets","", pab->packets, pba->packets);
-    if (pab->reset_count || pba->reset_count || csv || tsv || (sv != NULL))
+    if (pab->reset_count || pba->reset_count || sv_mode)
 	StatLineI("resets sent","", pab->reset_count, pba->reset_count);
     StatLineI("ack pkts sent","", pab->ack_pkts, pba->ack_pkts);
     StatLineI("pure acks sent","", pab->pureack_pkts, pba->pureack_pkts);
@@ -295,18 +300,18 @@ PrintTrace(
 		       pab->syn_count, pab->fin_count),bufl),
 	      (snprintf(bufr,sizeof(bufr),"%d/%d",
 		       pba->syn_count, pba->fin_count),bufr));
-    if (pab->f1323_ws || pba->f1323_ws || pab->f1323_ts || pba->f1323_ts || csv || tsv || (sv != NULL)) {
+    if (pab->f1323_ws || pba->f1323_ws || pab->f1323_ts || pba->f1323_ts || sv_mode) {
 	StatLineP("req 1323 ws/ts","","%s",
 		  (snprintf(bufl,sizeof(bufl),"%c/%c",
 		      pab->f1323_ws?'Y':'N',pab->f1323_ts?'Y':'N'),bufl),
 		  (snprintf(bufr,sizeof(bufr),"%c/%c",
 		      pba->f1323_ws?'Y':'N',pba->f1323_ts?'Y':'N'),bufr));
     }
-    if (pab->f1323_ws || pba->f1323_ws || csv || tsv || (sv != NULL)) {
+    if (pab->f1323_ws || pba->f1323_ws || sv_mode) {
 	StatLineI("adv wind scale","",
 		  (u_long)pab->window_scale, (u_long)pba->window_scale);
     }
-    if (pab->fsack_req || pba->fsack_req || csv || tsv || (sv != NULL)) {
+    if (pab->fsack_req || pba->fsack_req || sv_mode) {
 	StatLineP("req sack","","%s",
 		  pab->fsack_req?"Y":"N",
 		  pba->fsack_req?"Y":"N");
@@ -476,11 +481,11 @@ PrintTrace(
 	      ZERO_TIME(&pba->last_time)?"NA":
 	      (snprintf(bufr,sizeof(bufr),"%8.1f",(double)pba->idle_max/1000.0),bufr));
 
-    if ((pab->num_hardware_dups != 0) || (pba->num_hardware_dups != 0)  || csv || tsv || (sv != NULL)) {
+    if ((pab->num_hardware_dups != 0) || (pba->num_hardware_dups != 0)  || sv_mode) {
 	StatLineI("hardware dups","segs",
 		  pab->num_hardware_dups, pba->num_hardware_dups);
 
-        if(!(csv || tsv || (sv != NULL)))       
+        if(!sv_mode)       
 	  fprintf(stdout,
 		  "       ** WARNING: presence of hardware duplicates makes these figures suspect!\n");
     }
@@ -495,7 +500,7 @@ PrintTrace(
 		  (double) (pba->unique_bytes) / etime);
 
     if (print_rtt) {
-        if(!(csv || tsv || (sv != NULL)))
+        if(!sv_mode)
 	  fprintf(stdout,"\n");
 	StatLineI("RTT samples","", pab->rtt_count, pba->rtt_count);
 	StatLineF("RTT min","ms","%8.1f",
@@ -510,12 +515,12 @@ PrintTrace(
 	StatLineF("RTT stdev","ms","%8.1f",
 		  Stdev(pab->rtt_sum, pab->rtt_sum2, pab->rtt_count) / 1000.0,
 		  Stdev(pba->rtt_sum, pba->rtt_sum2, pba->rtt_count) / 1000.0);
-        if(!(csv || tsv || (sv != NULL)))
+        if(!sv_mode)
 	  fprintf(stdout,"\n");
 	StatLineF("RTT from 3WHS","ms","%8.1f",
 		  (double)pab->rtt_3WHS/1000.0,
 		  (double)pba->rtt_3WHS/1000.0);
-        if(!(csv || tsv || (sv != NULL)))
+        if(!sv_mode)
 	  fprintf(stdout,"\n");
 	StatLineI("RTT full_sz smpls","", 
 		  pab->rtt_full_count, pba->rtt_full_count);
@@ -531,12 +536,12 @@ PrintTrace(
 	StatLineF("RTT full_sz stdev","ms","%8.1f",
 		  Stdev(pab->rtt_full_sum, pab->rtt_full_sum2, pab->rtt_full_count) / 1000.0,
 		  Stdev(pba->rtt_full_sum, pba->rtt_full_sum2, pba->rtt_full_count) / 1000.0);
-        if(!(csv || tsv || (sv != NULL)))
+        if(!sv_mode)
 	  fprintf(stdout,"\n");
 	StatLineI("post-loss acks","",
 		  pab->rtt_nosample, pba->rtt_nosample);
-	if (pab->rtt_amback || pba->rtt_amback || csv || tsv || (sv != NULL)) {
-	   if(!(csv || tsv || (sv != NULL)))
+	if (pab->rtt_amback || pba->rtt_amback || sv_mode) {
+	   if(!sv_mode)
 	     fprintf(stdout, "\
 \t  For the following 5 RTT statistics, only ACKs for\n\
 \t  multiply-transmitted segments (ambiguous ACKs) were\n\
@@ -586,8 +591,8 @@ PrintTrace(
 			pba->retr_tm_count) / 1000.0);
     }
    
-   if(csv || tsv || (sv != NULL)) {
-      printf("\n");
+   if(sv_mode) {
+      SVEndRow();
       /* Error checking: print an error message if the count of printed fields
        * doesn't correspond to the actual fields expected.
        */
@@ -608,6 +613,14 @@ PrintBrief(
     tcb *pba = &ptp->b2a;
     static int max_width = -1;
 
+    /* in real-time mode the others aren't around to measure, so it */
+    /* just widens as we go */
+    if (run_continuously) {
+	int len = strlen(FormatBrief(ptp));
+	if (len > max_width)
+	    max_width = len;
+    }
+
     /* determine the maximum connection name width to make it nice */
     if (max_width == -1) {
 	int ix;
@@ -750,6 +763,14 @@ StatLineI_L(
     u_long argright)
 {
     char *format = "%8lu";
+
+    /* (the fast way, unless it'd need more digits than valbuf holds) */
+    if (sv_mode && ((double)argleft < 1e19) && ((double)argright < 1e19)) {
+	SVFieldU(argleft);
+	SVFieldU(argright);
+	sv_print_count += 2;
+	return;
+    }
     StatLineField(label,units,format,argleft,0);
     StatLineField(label,units,format,argright,1);
 }
@@ -765,6 +786,13 @@ StatLineI_LL(
     u_llong argright)
 {
     char *format = "%8" FS_ULL;
+
+    if (sv_mode) {
+	SVFieldU(argleft);
+	SVFieldU(argright);
+	sv_print_count += 2;
+	return;
+    }
     StatLineFieldL(label,units,format,argleft,0);
     StatLineFieldL(label,units,format,argright,1);
 }
@@ -787,10 +815,10 @@ StatLineFieldL(
     snprintf(valbuf,sizeof(valbuf),format,arg);
 
     /* print the field */
-    if(!(csv || tsv || (sv != NULL)))
+    if(!sv_mode)
      printf("     ");
     StatLineOne(label, units, valbuf);
-    if (f_rightside && !(csv || tsv || (sv != NULL))) 
+    if (f_rightside && !sv_mode) 
 	printf("\n");
 }
 #endif /* HAVE_LONG_LONG */
@@ -804,6 +832,19 @@ StatLineF(
     double argleft,
     double argright)
 {
+    if (sv_mode) {
+	int prec = FormatPrec(format);
+	if (finite(argleft))
+	    SVFieldF(argleft,prec);
+	else
+	    SVField("NA");
+	if (finite(argright))
+	    SVFieldF(argright,prec);
+	else
+	    SVField("NA");
+	sv_print_count += 2;
+	return;
+    }
     StatLineFieldF(label,units,format,argleft,0);
     StatLineFieldF(label,units,format,argright,1);
 }
@@ -825,10 +866,10 @@ StatLineField(
     snprintf(valbuf,sizeof(valbuf),format,arg);
 
     /* print the field */
-    if(!(csv || tsv || (sv != NULL)))
+    if(!sv_mode)
      printf("     ");
     StatLineOne(label, units, valbuf);
-    if (f_rightside && !(csv || tsv || (sv != NULL)))
+    if (f_rightside && !sv_mode)
 	printf("\n");
 }
 
@@ -853,13 +894,13 @@ StatLineFieldF(
 	snprintf(valbuf,sizeof(valbuf),format,arg);
 
     /* print the field */
-    if(!(csv || tsv || (sv != NULL)))
+    if(!sv_mode)
      printf("     ");
     if (printable)
 	StatLineOne(label, units, valbuf);
     else
 	StatLineOne(label, "", "NA");
-    if (f_rightside && !(csv || tsv || (sv != NULL)))
+    if (f_rightside && !sv_mode)
 	printf("\n");
 }
 
@@ -876,8 +917,8 @@ StatLineOne(
     snprintf(labbuf,sizeof(labbuf), "%s:", label);
 
     /* print the field */
-    if(csv || tsv || (sv != NULL)) {
-       printf("%15s%s", value, sp);
+    if(sv_mode) {
+       SVField(value);
        /* Count the fields printed until this point. Used as a guard with the
 	* <SP>-separated-values option to ensure correct alignment of headers
 	* and field values.
@@ -889,6 +930,17 @@ StatLineOne(
 }
 
 
+/* the precision from a "%8.1f" style format */
+static int
+FormatPrec(
+    char *format)
+{
+    char *pdot = strchr(format,'.');
+
+    return((pdot == NULL)?6:atoi(pdot+1));
+}
+
+
 char *
 elapsed2str(
     double etime)
@@ -0,0 +1,1128 @@
+/*
+ * Copyright (c) 1994, 1995, 1996, 1997, 1998, 1999, 2000, 2001,
+ *               2002, 2003, 2004
+ *      Ohio University.
+ *
+ * ---
+ *
+ * Starting with the release of tcptrace version 6 in 2001, tcptrace
+ * is licensed under the GNU General Public License (GPL).  We believe
+ * that, among the available licenses, the GPL will do the best job of
+ * allowing tcptrace to continue to be a valuable, freely-available
+ * and well-maintained tool for the networking community.
+ *
+ * Previous versions of tcptrace were released under a license that
+ * was much less restrictive with respect to how tcptrace could be
+ * used in commercial products.  Because of this, I am willing to
+ * consider alternate license arrangements as allowed in Section 10 of
+ * the GNU GPL.  Before I would consider licensing tcptrace under an
+ * alternate agreement with a particular individual or company,
+ * however, I would have to be convinced that such an alternative
+ * would be to the greater benefit of the networking community.
+ * 
+ * ---
+ *
+ * This file is part of Tcptrace.
+ *
+ * Tcptrace was originally written and continues to be maintained by
+ * Shawn Ostermann with the help of a group of devoted students and
+ * users (see the file 'THANKS').  The work on tcptrace has been made
+ * possible over the years through the generous support of NASA GRC,
+ * the National Science Foundation, and Sun Microsystems.
+ *
+ * Tcptrace is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tcptrace is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tcptrace (in the file 'COPYING'); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ * Author:      Shawn Ostermann
+ *              School of Electrical Engineering and Computer Science
+ *              Ohio University
+ *              Athens, OH
+ *              http://www.tcptrace.org/
+ */
+#include "tcptrace.h"
+static char const GCC_UNUSED copyright[] =
+    "@(#)Copyright (c) 2004 -- Ohio University.\n";
+static char const GCC_UNUSED rcsid[] =
+    "@(#)$Header$";
+
+
+
+
+
+/*
+ * plotbin.c -- graphs in a compact binary form (--binary_plots)
+ *
+ * Most of the graphs that -G makes are never looked at, but as xplot
+ * text they cost a printf and 30 or 40 bytes per point.  With
+ * --binary_plots, plotter.c hands each plot command to us instead and
+ * we store it in a FILE.tpb, a few bytes per point; --render_plots
+ * turns the ones someone actually wants to see into xplot (exactly
+ * what tcptrace would have written) or gnuplot input afterwards.
+ *
+ * The file is "TPB1" followed by records, each a type byte, a varint
+ * payload length and the payload:
+ *
+ *   'H'  the xplot header: a flags byte (PB_SWITCHED if the axes are
+ *        switched, as for the time line charts) and then the header
+ *        text, exactly as it would appear in the .xpl file
+ *
+ *   'B'  a block of up to PB_BLOCK_EVENTS plot commands, stored by
+ *        column: a varint count of commands, then five columns, each
+ *        a varint byte length and the bytes:
+ *          ops     one byte per command (see pb_ops[] below; colors
+ *                  are PB_OP_COLOR + their index in pb_colors[])
+ *          colors  one byte per command, the temporary color for just
+ *                  that command (0 for none, PB_COLOR_NAMED if the
+ *                  name is in the strings column)
+ *          times   a zigzag varint per time on the command (0, 1 or 2
+ *                  of them), in usecs, as a difference from the one
+ *                  before (the first in a block is from 0)
+ *          values  the same, for the Y values (32 bits)
+ *          strings a varint length and the bytes, for any text
+ *
+ * Times are stored after the -z adjustment, so the renderer doesn't
+ * need to know what the options were.  Each block stands on its own,
+ * so we can write partial ones whenever we run short of memory.
+ */
+
+
+/* tuning */
+#define PB_BLOCK_EVENTS	8192		/* commands per block */
+#define PB_BUF_TOTAL	(32*1024*1024)	/* bytes buffered for all the plots */
+
+/* the columns of a block */
+#define PB_COL_OPS	0
+#define PB_COL_COLORS	1
+#define PB_COL_TIMES	2
+#define PB_COL_VALUES	3
+#define PB_COL_STRINGS	4
+#define PB_NCOLS	5
+
+/* header flags */
+#define PB_SWITCHED	0x01
+
+/* ops that aren't in the table */
+#define PB_OP_STRING	0	/* a line of text (no times or values) */
+#define PB_OP_OTHER2	1	/* some other command, one point */
+#define PB_OP_OTHER4	2	/* some other command, two points */
+#define PB_OP_COLOR	64	/* + the color's index */
+
+#define PB_COLOR_NAMED	255
+
+#define PB_MAGIC	"TPB1"
+
+/* the plot commands we know */
+static struct pb_op {
+    char	*cmd;
+    int		argc;		/* 0, 2 or 4, as for CallDoPlot() */
+    char	*gpl_style;	/* how gnuplot should draw it */
+} pb_ops[] = {
+    {NULL, 0, NULL},				/* PB_OP_STRING */
+    {NULL, 2, "points pt 1"},			/* PB_OP_OTHER2 */
+    {NULL, 4, "lines"},				/* PB_OP_OTHER4 */
+    {"line", 4, "lines"},
+    {"dline", 4, "lines dt 2"},
+    {"dot", 2, "points pt 7 ps 0.3"},
+    {"diamond", 2, "points pt 12"},
+    {"plus", 2, "points pt 1"},
+    {"box", 2, "points pt 4"},
+    {"uarrow", 2, "points pt 9"},
+    {"darrow", 2, "points pt 11"},
+    {"larrow", 2, "points pt 8"},
+    {"rarrow", 2, "points pt 10"},
+    {"utick", 2, "points pt 2 ps 0.5"},
+    {"dtick", 2, "points pt 2 ps 0.5"},
+    {"ltick", 2, "points pt 2 ps 0.5"},
+    {"rtick", 2, "points pt 2 ps 0.5"},
+    {"htick", 2, "points pt 2 ps 0.5"},
+    {"vtick", 2, "points pt 2 ps 0.5"},
+    {"invisible", 2, NULL},
+    {"ltext", 2, "right"},
+    {"rtext", 2, "left"},
+    {"atext", 2, "center offset 0,0.5"},
+    {"btext", 2, "center offset 0,-0.5"},
+};
+#define PB_NUM_OPS (sizeof(pb_ops) / sizeof(struct pb_op))
+
+/* the colors xplot knows (index 0 is "no color") */
+static char *pb_colors[] = {
+    NULL, "white", "green", "red", "blue", "yellow", "purple", "orange",
+    "magenta", "pink"
+};
+#define PB_NUM_COLORS (sizeof(pb_colors) / sizeof(char *))
+
+
+/* a column being gathered */
+struct pb_col {
+    char	*buf;
+    u_int	len;
+    u_int	size;
+};
+
+/* one plot being written */
+struct plotbin {
+    MFILE		*f;
+    struct pb_col	cols[PB_NCOLS];
+    u_int		nevents;	/* in this block */
+    u_llong		prev_time;
+    u_int		prev_value;
+
+    /* the plots with a block going */
+    struct plotbin	*next;
+    struct plotbin	*prev;
+};
+
+/* reading a binary plot back */
+struct pb_reader {
+    u_char	*p;
+    u_char	*end;
+    Bool	bad;		/* ran off the end */
+};
+
+/* a set of points drawn the same way, for gnuplot */
+struct pb_group {
+    char	*color;
+    char	*style;
+    dstring_t	*data;
+};
+
+/* one plot being rendered */
+struct pb_render {
+    Bool	gnuplot;
+    Bool	switched;	/* axes switched (see PB_SWITCHED) */
+    FILE	*out;		/* the .xpl file */
+    dstring_t	*cmd;		/* (room for strings from the file) */
+    dstring_t	*color;
+
+    /* gathered up for gnuplot */
+    char	*title;
+    char	*xlabel;
+    char	*ylabel;
+    char	*cur_color;
+    struct pb_group *groups;
+    int		ngroups;
+    dstring_t	*labels;
+    dstring_t	*text_at;	/* a text command waiting for its text */
+    char	*text_align;
+    char	*text_color;
+    dstring_t	*scratch;
+};
+
+static struct plotbin *pb_active = NULL;
+static u_long pb_buffered = 0;		/* bytes allocated for the columns */
+
+
+/* local routines */
+static void PbFlush(struct plotbin *ppb);
+static void PbGrow(struct pb_col *pcol, u_int need);
+static void PbPutByte(struct pb_col *pcol, u_int byte);
+static void PbPutVarint(struct pb_col *pcol, u_llong val);
+static void PbPutSigned(struct pb_col *pcol, llong val);
+static void PbPutString(struct pb_col *pcol, char *str);
+static void PbWriteRecord(MFILE *f, int type, struct pb_col *parts, int nparts);
+static int PbOp(char *cmd, int argc);
+static int PbColor(char *color);
+static u_llong PbGetVarint(struct pb_reader *pr);
+static llong PbGetSigned(struct pb_reader *pr);
+static char *PbGetString(struct pb_reader *pr, dstring_t *pds);
+static Bool PbRenderBlock(struct pb_reader *pr, struct pb_render *prend);
+static void PbXplotEvent(struct pb_render *prend, int op, char *cmd,
+			 int argc, u_llong *times, u_int *values, char *color);
+static void PbGnuplotEvent(struct pb_render *prend, int op, char *cmd,
+			   int argc, u_llong *times, u_int *values, char *color);
+static void PbGnuplotHeader(struct pb_render *prend, char *text, int len);
+static Bool PbGnuplotWrite(struct pb_render *prend, char *gplname);
+static void PbCoord(struct pb_render *prend, dstring_t *pds,
+		    u_llong usecs, u_int value);
+static void PbQuoted(FILE *f, char *str);
+
+
+
+/* start a binary plot in a file that has just been opened */
+struct plotbin *
+PlotBinOpen(
+    MFILE *f)
+{
+    struct plotbin *ppb;
+
+    ppb = MallocZ(sizeof(struct plotbin));
+    ppb->f = f;
+    Mfwrite(PB_MAGIC, 1, strlen(PB_MAGIC), f);
+
+    return(ppb);
+}
+
+
+
+/* the xplot header, as text */
+void
+PlotBinHeader(
+    struct plotbin *ppb,
+    Bool axis_switched,
+    char *text)
+{
+    struct pb_col rec;
+    u_int len = strlen(text);
+
+    memset(&rec, 0, sizeof(rec));
+    PbPutByte(&rec, axis_switched ? PB_SWITCHED : 0);
+    PbGrow(&rec, len);
+    memcpy(rec.buf + rec.len, text, len);
+    rec.len += len;
+
+    PbWriteRecord(ppb->f, 'H', &rec, 1);
+    free(rec.buf);
+}
+
+
+
+/* one plot command, "argc" is 0, 2 or 4 as for CallDoPlot() and the */
+/* times have already been adjusted for -z; "color" (if not NULL) is */
+/* the temporary color for just this command */
+void
+PlotBinEvent(
+    struct plotbin *ppb,
+    char *cmd,
+    int argc,
+    struct timeval t1,
+    u_long x1,
+    struct timeval t2,
+    u_long x2,
+    char *color)
+{
+    struct pb_col *pcols = ppb->cols;
+    u_long before = 0;
+    u_long after = 0;
+    int op;
+    int ix;
+    int i;
+
+    for (i=0; i < PB_NCOLS; ++i)
+	before += pcols[i].size;
+
+    op = PbOp(cmd, argc);
+    PbPutByte(&pcols[PB_COL_OPS], op);
+    if (op < PB_OP_COLOR && pb_ops[op].cmd == NULL)
+	PbPutString(&pcols[PB_COL_STRINGS], cmd);
+
+    ix = PbColor(color);
+    PbPutByte(&pcols[PB_COL_COLORS], ix);
+    if (ix == PB_COLOR_NAMED)
+	PbPutString(&pcols[PB_COL_STRINGS], color);
+
+    if (argc >= 2) {
+	/* (the seconds are unsigned in the xplot output too) */
+	u_llong usecs = (u_llong)(unsigned)t1.tv_sec * 1000000 + t1.tv_usec;
+
+	PbPutSigned(&pcols[PB_COL_TIMES], (llong)(usecs - ppb->prev_time));
+	ppb->prev_time = usecs;
+	PbPutSigned(&pcols[PB_COL_VALUES], (int)((u_int)x1 - ppb->prev_value));
+	ppb->prev_value = (u_int)x1;
+    }
+    if (argc >= 4) {
+	u_llong usecs = (u_llong)(unsigned)t2.tv_sec * 1000000 + t2.tv_usec;
+
+	PbPutSigned(&pcols[PB_COL_TIMES], (llong)(usecs - ppb->prev_time));
+	ppb->prev_time = usecs;
+	PbPutSigned(&pcols[PB_COL_VALUES], (int)((u_int)x2 - ppb->prev_value));
+	ppb->prev_value = (u_int)x2;
+    }
+
+    /* the first one in a block puts it on the active list */
+    if (ppb->nevents++ == 0) {
+	ppb->prev = NULL;
+	ppb->next = pb_active;
+	if (pb_active)
+	    pb_active->prev = ppb;
+	pb_active = ppb;
+    }
+
+    for (i=0; i < PB_NCOLS; ++i)
+	after += pcols[i].size;
+    pb_buffered += after - before;
+
+    if (ppb->nevents >= PB_BLOCK_EVENTS) {
+	PbFlush(ppb);
+    } else if (pb_buffered > PB_BUF_TOTAL) {
+	/* short of memory, write out what everyone has */
+	while (pb_active)
+	    PbFlush(pb_active);
+    }
+}
+
+
+
+/* write out what's left, the caller closes the file */
+void
+PlotBinClose(
+    struct plotbin *ppb)
+{
+    PbFlush(ppb);
+    free(ppb);
+}
+
+
+
+/* write the block that's being gathered (if any) and free its memory */
+static void
+PbFlush(
+    struct plotbin *ppb)
+{
+    struct pb_col parts[1 + 2*PB_NCOLS];
+    int i;
+
+    if (ppb->nevents == 0)
+	return;
+
+    /* the count, then the length and bytes of each column */
+    memset(parts, 0, sizeof(parts));
+    PbPutVarint(&parts[0], ppb->nevents);
+    for (i=0; i < PB_NCOLS; ++i) {
+	PbPutVarint(&parts[1 + 2*i], ppb->cols[i].len);
+	parts[2 + 2*i] = ppb->cols[i];
+    }
+    PbWriteRecord(ppb->f, 'B', parts, 1 + 2*PB_NCOLS);
+
+    for (i=0; i < PB_NCOLS; ++i) {
+	free(ppb->cols[i].buf);
+	pb_buffered -= ppb->cols[i].size;
+	free(parts[1 + 2*i].buf);
+    }
+    free(parts[0].buf);
+    memset(ppb->cols, 0, sizeof(ppb->cols));
+    ppb->nevents = 0;
+    ppb->prev_time = 0;
+    ppb->prev_value = 0;
+
+    /* off the active list */
+    if (ppb->prev)
+	ppb->prev->next = ppb->next;
+    else
+	pb_active = ppb->next;
+    if (ppb->next)
+	ppb->next->prev = ppb->prev;
+    ppb->next = ppb->prev = NULL;
+}
+
+
+
+/* write a record made of the parts, one after the other */
+static void
+PbWriteRecord(
+    MFILE *f,
+    int type,
+    struct pb_col *parts,
+    int nparts)
+{
+    struct pb_col head;
+    u_llong len = 0;
+    int i;
+
+    for (i=0; i < nparts; ++i)
+	len += parts[i].len;
+
+    memset(&head, 0, sizeof(head));
+    PbPutByte(&head, type);
+    PbPutVarint(&head, len);
+    Mfwrite(head.buf, 1, head.len, f);
+    free(head.buf);
+
+    for (i=0; i < nparts; ++i)
+	if (parts[i].len > 0)
+	    Mfwrite(parts[i].buf, 1, parts[i].len, f);
+}
+
+
+
+static void
+PbGrow(
+    struct pb_col *pcol,
+    u_int need)
+{
+    u_int nsize;
+
+    if (pcol->len + need <= pcol->size)
+	return;
+
+    nsize = (pcol->size > 0) ? pcol->size : 64;
+    while (nsize < pcol->len + need)
+	nsize *= 2;
+    pcol->buf = ReallocZ(pcol->buf, pcol->size, nsize);
+    pcol->size = nsize;
+}
+
+
+static void
+PbPutByte(
+    struct pb_col *pcol,
+    u_int byte)
+{
+    PbGrow(pcol, 1);
+    pcol->buf[pcol->len++] = byte;
+}
+
+
+/* 7 bits at a time, low bits first, the high bit means "more" */
+static void
+PbPutVarint(
+    struct pb_col *pcol,
+    u_llong val)
+{
+    PbGrow(pcol, 10);
+    while (val >= 0x80) {
+	pcol->buf[pcol->len++] = (val & 0x7f) | 0x80;
+	val >>= 7;
+    }
+    pcol->buf[pcol->len++] = val;
+}
+
+
+/* zigzag, so that small negative differences are small too */
+static void
+PbPutSigned(
+    struct pb_col *pcol,
+    llong val)
+{
+    PbPutVarint(pcol, ((u_llong)val << 1) ^ (u_llong)(val >> 63));
+}
+
+
+static void
+PbPutString(
+    struct pb_col *pcol,
+    char *str)
+{
+    u_int len = strlen(str);
+
+    PbPutVarint(pcol, len);
+    PbGrow(pcol, len);
+    memcpy(pcol->buf + pcol->len, str, len);
+    pcol->len += len;
+}
+
+
+static int
+PbOp(
+    char *cmd,
+    int argc)
+{
+    int i;
+
+    if (argc == 0) {
+	for (i=1; i < PB_NUM_COLORS; ++i)
+	    if (strcmp(cmd, pb_colors[i]) == 0)
+		return(PB_OP_COLOR + i);
+	return(PB_OP_STRING);
+    }
+
+    for (i=PB_OP_OTHER4+1; i < PB_NUM_OPS; ++i)
+	if ((pb_ops[i].argc == argc) && (strcmp(cmd, pb_ops[i].cmd) == 0))
+	    return(i);
+
+    return((argc == 2) ? PB_OP_OTHER2 : PB_OP_OTHER4);
+}
+
+
+static int
+PbColor(
+    char *color)
+{
+    int i;
+
+    if (color == NULL)
+	return(0);
+
+    for (i=1; i < PB_NUM_COLORS; ++i)
+	if (strcmp(color, pb_colors[i]) == 0)
+	    return(i);
+
+    return(PB_COLOR_NAMED);
+}
+
+
+
+/* the same name, but with a different extension in place of .xpl, */
+/* .tpb or .gpl (or added on, if it has none of them) */
+char *
+PlotSwapExt(
+    char *filename,
+    char *ext)
+{
+    int len = strlen(filename);
+    char *newname;
+
+    if ((len > 4) &&
+	((strcmp(filename+len-4, ".xpl") == 0) ||
+	 (strcmp(filename+len-4, ".tpb") == 0) ||
+	 (strcmp(filename+len-4, ".gpl") == 0)))
+	len -= 4;
+
+    newname = MallocZ(len + strlen(ext) + 1);
+    memcpy(newname, filename, len);
+    strcpy(newname+len, ext);
+
+    return(newname);
+}
+
+
+
+/* turn a binary plot into xplot ("xplot": FILE.xpl) or gnuplot */
+/* ("gnuplot": FILE.gpl, which plots FILE.datasets) input, returns */
+/* FALSE if it couldn't */
+Bool
+PlotRender(
+    char *filename,
+    char *format)
+{
+    struct pb_render rend;
+    struct pb_reader rd;
+    struct stat str_stat;
+    u_char *buf;
+    char *outname;
+    FILE *f;
+    Bool ok = TRUE;
+
+    if ((f = fopen(filename, "rb")) == NULL) {
+	perror(filename);
+	return(FALSE);
+    }
+    if ((fstat(fileno(f), &str_stat) != 0) ||
+	(str_stat.st_size < strlen(PB_MAGIC))) {
+	fprintf(stderr, "%s: not a tcptrace binary plot\n", filename);
+	fclose(f);
+	return(FALSE);
+    }
+    /* (one extra, zeroed, since DSAppendStringN() looks one past the end) */
+    buf = MallocZ(str_stat.st_size + 1);
+    if (fread(buf, 1, str_stat.st_size, f) != str_stat.st_size) {
+	perror(filename);
+	fclose(f);
+	free(buf);
+	return(FALSE);
+    }
+    fclose(f);
+
+    if (memcmp(buf, PB_MAGIC, strlen(PB_MAGIC)) != 0) {
+	fprintf(stderr, "%s: not a tcptrace binary plot\n", filename);
+	free(buf);
+	return(FALSE);
+    }
+
+    memset(&rend, 0, sizeof(rend));
+    rend.gnuplot = (strcmp(format, "gnuplot") == 0);
+    rend.cmd = DSNew();
+    rend.color = DSNew();
+    if (rend.gnuplot) {
+	outname = PlotSwapExt(filename, ".gpl");
+	rend.cur_color = "white";
+	rend.labels = DSNew();
+	rend.scratch = DSNew();
+    } else {
+	outname = PlotSwapExt(filename, ".xpl");
+	if ((rend.out = fopen(outname, "w")) == NULL) {
+	    perror(outname);
+	    ok = FALSE;
+	}
+    }
+
+    rd.p = buf + strlen(PB_MAGIC);
+    rd.end = buf + str_stat.st_size;
+    rd.bad = FALSE;
+    while (ok && (rd.p < rd.end)) {
+	struct pb_reader rec;
+	int type = *rd.p++;
+	u_llong len = PbGetVarint(&rd);
+
+	if (rd.bad || (len > rd.end - rd.p)) {
+	    ok = FALSE;
+	    break;
+	}
+	rec.p = rd.p;
+	rec.end = rd.p + len;
+	rec.bad = FALSE;
+	rd.p += len;
+
+	switch (type) {
+	  case 'H':
+	    if (len < 1) {
+		ok = FALSE;
+		break;
+	    }
+	    rend.switched = (*rec.p & PB_SWITCHED) != 0;
+	    if (rend.gnuplot)
+		PbGnuplotHeader(&rend, (char *)rec.p+1, len-1);
+	    else
+		fwrite(rec.p+1, 1, len-1, rend.out);
+	    break;
+	  case 'B':
+	    ok = PbRenderBlock(&rec, &rend);
+	    break;
+	  default:
+	    /* (something newer, skip it) */
+	    break;
+	}
+    }
+
+    if (!ok)
+	fprintf(stderr, "%s: bad or truncated binary plot\n", filename);
+
+    if (rend.gnuplot) {
+	int i;
+
+	if (ok)
+	    ok = PbGnuplotWrite(&rend, outname);
+	for (i=0; i < rend.ngroups; ++i) {
+	    DSDestroy(&rend.groups[i].data);
+	    free(rend.groups[i].color);
+	}
+	free(rend.groups);
+	free(rend.title);
+	free(rend.xlabel);
+	free(rend.ylabel);
+	DSDestroy(&rend.labels);
+	DSDestroy(&rend.scratch);
+	if (rend.text_at)
+	    DSDestroy(&rend.text_at);
+	free(rend.text_color);
+    } else if (rend.out) {
+	fprintf(rend.out, "go\n");
+	if (fclose(rend.out) != 0) {
+	    perror(outname);
+	    ok = FALSE;
+	}
+    }
+
+    if (debug && ok)
+	fprintf(stderr, "Rendered '%s' as '%s'\n", filename, outname);
+
+    DSDestroy(&rend.cmd);
+    DSDestroy(&rend.color);
+    free(outname);
+    free(buf);
+
+    return(ok);
+}
+
+
+
+/* decode one block of commands and render them */
+static Bool
+PbRenderBlock(
+    struct pb_reader *pr,
+    struct pb_render *prend)
+{
+    struct pb_reader cols[PB_NCOLS];
+    u_llong prev_time = 0;
+    u_int prev_value = 0;
+    u_llong nevents;
+    u_llong n;
+    int i;
+
+    nevents = PbGetVarint(pr);
+    for (i=0; i < PB_NCOLS; ++i) {
+	u_llong len = PbGetVarint(pr);
+
+	if (pr->bad || (len > pr->end - pr->p))
+	    return(FALSE);
+	cols[i].p = pr->p;
+	cols[i].end = pr->p + len;
+	cols[i].bad = FALSE;
+	pr->p += len;
+    }
+
+    for (n=0; n < nevents; ++n) {
+	u_llong times[2];
+	u_int values[2];
+	char *cmd;
+	char *color;
+	int argc;
+	int op;
+	int ix;
+
+	if ((cols[PB_COL_OPS].p >= cols[PB_COL_OPS].end) ||
+	    (cols[PB_COL_COLORS].p >= cols[PB_COL_COLORS].end))
+	    return(FALSE);
+	op = *cols[PB_COL_OPS].p++;
+	ix = *cols[PB_COL_COLORS].p++;
+
+	if (op >= PB_OP_COLOR) {
+	    if (op - PB_OP_COLOR >= PB_NUM_COLORS)
+		return(FALSE);
+	    cmd = pb_colors[op - PB_OP_COLOR];
+	    argc = 0;
+	} else {
+	    if (op >= PB_NUM_OPS)
+		return(FALSE);
+	    cmd = pb_ops[op].cmd;
+	    if (cmd == NULL)
+		cmd = PbGetString(&cols[PB_COL_STRINGS], prend->cmd);
+	    argc = pb_ops[op].argc;
+	}
+
+	if (ix == PB_COLOR_NAMED)
+	    color = PbGetString(&cols[PB_COL_STRINGS], prend->color);
+	else if (ix < PB_NUM_COLORS)
+	    color = pb_colors[ix];
+	else
+	    return(FALSE);
+
+	for (i=0; i < argc/2; ++i) {
+	    prev_time += PbGetSigned(&cols[PB_COL_TIMES]);
+	    prev_value += (int)PbGetSigned(&cols[PB_COL_VALUES]);
+	    times[i] = prev_time;
+	    values[i] = prev_value;
+	}
+
+	if (cols[PB_COL_STRINGS].bad || cols[PB_COL_TIMES].bad ||
+	    cols[PB_COL_VALUES].bad)
+	    return(FALSE);
+
+	if (prend->gnuplot)
+	    PbGnuplotEvent(prend, op, cmd, argc, times, values, color);
+	else
+	    PbXplotEvent(prend, op, cmd, argc, times, values, color);
+    }
+
+    return(TRUE);
+}
+
+
+
+/* the line that tcptrace would have written (see CallDoPlot()) */
+static void
+PbXplotEvent(
+    struct pb_render *prend,
+    int op,
+    char *cmd,
+    int argc,
+    u_llong *times,
+    u_int *values,
+    char *color)
+{
+    FILE *f = prend->out;
+    int i;
+
+    fputs(cmd, f);
+    for (i=0; i < argc/2; ++i) {
+	unsigned secs = times[i] / 1000000;
+	unsigned usecs = times[i] % 1000000;
+
+	if (prend->switched)
+	    fprintf(f, " %u -%u.%06u", values[i], secs, usecs);
+	else
+	    fprintf(f, " %u.%06u %u", secs, usecs, values[i]);
+    }
+    if (color)
+	fprintf(f, " %s", color);
+    putc('\n', f);
+}
+
+
+
+/* sort the command into the set of points drawn the same way */
+static void
+PbGnuplotEvent(
+    struct pb_render *prend,
+    int op,
+    char *cmd,
+    int argc,
+    u_llong *times,
+    u_int *values,
+    char *color)
+{
+    struct pb_group *pgrp = NULL;
+    char *style;
+    int i;
+
+    /* a color by itself changes the color from here on */
+    if (op >= PB_OP_COLOR) {
+	prend->cur_color = cmd;
+	return;
+    }
+
+    /* a line of text, hopefully the one a text command is waiting for */
+    if (op == PB_OP_STRING) {
+	if (prend->text_at) {
+	    DSAppendString(prend->labels, "set label \"");
+	    DSErase(prend->scratch);
+	    for (; *cmd; ++cmd) {
+		if ((*cmd == '"') || (*cmd == '\\'))
+		    DSAppendChar(prend->scratch, '\\');
+		DSAppendChar(prend->scratch, *cmd);
+	    }
+	    DSAppendString(prend->labels, DSVal(prend->scratch));
+	    DSAppendString(prend->labels, "\" at ");
+	    DSAppendString(prend->labels, DSVal(prend->text_at));
+	    DSAppendString(prend->labels, " ");
+	    DSAppendString(prend->labels, prend->text_align);
+	    DSAppendString(prend->labels, " tc rgb \"");
+	    DSAppendString(prend->labels, prend->text_color);
+	    DSAppendString(prend->labels, "\" front\n");
+	    DSDestroy(&prend->text_at);
+	}
+	return;
+    }
+
+    if (color == NULL)
+	color = prend->cur_color;
+    /* (a white background in gnuplot) */
+    if (strcmp(color, "white") == 0)
+	color = "black";
+
+    if ((style = pb_ops[op].gpl_style) == NULL)
+	return;			/* invisible */
+
+    /* text comes on the next line */
+    if ((op < PB_NUM_OPS) && (pb_ops[op].cmd != NULL) &&
+	(strcmp(pb_ops[op].cmd + 1, "text") == 0)) {
+	if (prend->text_at == NULL)
+	    prend->text_at = DSNew();
+	DSErase(prend->text_at);
+	PbCoord(prend, prend->text_at, times[0], values[0]);
+	prend->text_align = style;
+	free(prend->text_color);
+	prend->text_color = strdup(color);
+	return;
+    }
+
+    /* the points go in with the others of the same color and style */
+    for (i=0; i < prend->ngroups; ++i) {
+	if ((prend->groups[i].style == style) &&
+	    (strcmp(prend->groups[i].color, color) == 0)) {
+	    pgrp = &prend->groups[i];
+	    break;
+	}
+    }
+    if (pgrp == NULL) {
+	prend->groups = ReallocZ(prend->groups,
+				 prend->ngroups * sizeof(struct pb_group),
+				 (prend->ngroups+1) * sizeof(struct pb_group));
+	pgrp = &prend->groups[prend->ngroups++];
+	pgrp->color = strdup(color);
+	pgrp->style = style;
+	pgrp->data = DSNew();
+    }
+
+    for (i=0; i < argc/2; ++i) {
+	PbCoord(prend, pgrp->data, times[i], values[i]);
+	DSAppendChar(pgrp->data, '\n');
+    }
+    /* (a blank line keeps separate line segments apart) */
+    if (argc == 4)
+	DSAppendChar(pgrp->data, '\n');
+}
+
+
+
+/* "x y" for a point, as xplot would have them */
+static void
+PbCoord(
+    struct pb_render *prend,
+    dstring_t *pds,
+    u_llong usecs,
+    u_int value)
+{
+    char buf[64];
+
+    if (prend->switched)
+	snprintf(buf, sizeof(buf), "%u -%u.%06u", value,
+		 (unsigned)(usecs / 1000000), (unsigned)(usecs % 1000000));
+    else
+	snprintf(buf, sizeof(buf), "%u.%06u %u",
+		 (unsigned)(usecs / 1000000), (unsigned)(usecs % 1000000),
+		 value);
+    DSAppendString(pds, buf);
+}
+
+
+
+/* pick the title and axis labels out of the xplot header */
+static void
+PbGnuplotHeader(
+    struct pb_render *prend,
+    char *text,
+    int len)
+{
+    char **pwhich = NULL;
+    char *end = text + len;
+
+    while (text < end) {
+	char *eol = memchr(text, '\n', end - text);
+	int linelen = eol ? (eol - text) : (end - text);
+
+	if (pwhich) {
+	    free(*pwhich);
+	    *pwhich = MallocZ(linelen + 1);
+	    memcpy(*pwhich, text, linelen);
+	    pwhich = NULL;
+	} else if ((linelen == 5) && (strncmp(text, "title", 5) == 0)) {
+	    pwhich = &prend->title;
+	} else if ((linelen == 6) && (strncmp(text, "xlabel", 6) == 0)) {
+	    pwhich = &prend->xlabel;
+	} else if ((linelen == 6) && (strncmp(text, "ylabel", 6) == 0)) {
+	    pwhich = &prend->ylabel;
+	}
+
+	text += linelen + 1;
+    }
+}
+
+
+
+/* write out the FILE.gpl script and the FILE.datasets it plots */
+static Bool
+PbGnuplotWrite(
+    struct pb_render *prend,
+    char *gplname)
+{
+    char *dataname = PlotSwapExt(gplname, ".datasets");
+    char *database;
+    FILE *f;
+    int i;
+
+    /* the data, one gnuplot "index" per group */
+    if ((f = fopen(dataname, "w")) == NULL) {
+	perror(dataname);
+	free(dataname);
+	return(FALSE);
+    }
+    for (i=0; i < prend->ngroups; ++i) {
+	fputs(DSVal(prend->groups[i].data), f);
+	fputs("\n\n", f);
+    }
+    fclose(f);
+
+    /* the script, which expects to be run where the data is */
+    if ((f = fopen(gplname, "w")) == NULL) {
+	perror(gplname);
+	free(dataname);
+	return(FALSE);
+    }
+    if ((database = strrchr(dataname, '/')) != NULL)
+	++database;
+    else
+	database = dataname;
+
+    fprintf(f, "# made by tcptrace --render_plots=gnuplot\n");
+    if (prend->title) {
+	fprintf(f, "set title ");
+	PbQuoted(f, prend->title);
+    }
+    if (prend->xlabel) {
+	fprintf(f, "set xlabel ");
+	PbQuoted(f, prend->xlabel);
+    }
+    if (prend->ylabel) {
+	fprintf(f, "set ylabel ");
+	PbQuoted(f, prend->ylabel);
+    }
+    fprintf(f, "unset key\n");
+    fprintf(f, "set format x \"%%.6f\"\n");
+    fputs(DSVal(prend->labels), f);
+
+    if (prend->ngroups == 0) {
+	fprintf(f, "plot [0:1] NaN notitle\n");
+    } else {
+	fprintf(f, "plot ");
+	for (i=0; i < prend->ngroups; ++i) {
+	    struct pb_group *pgrp = &prend->groups[i];
+
+	    fprintf(f, "%s \"%s\" index %d with %s lc rgb \"%s\"",
+		    (i == 0) ? "" : ", \\\n     ",
+		    (i == 0) ? database : "", i,
+		    pgrp->style, pgrp->color);
+	}
+	fprintf(f, "\n");
+    }
+    fprintf(f, "pause -1 \"Hit return to continue\"\n");
+
+    if (fclose(f) != 0) {
+	perror(gplname);
+	free(dataname);
+	return(FALSE);
+    }
+
+    free(dataname);
+    return(TRUE);
+}
+
+
+/* a gnuplot string, and the end of the line */
+static void
+PbQuoted(
+    FILE *f,
+    char *str)
+{
+    putc('"', f);
+    for (; *str; ++str) {
+	if ((*str == '"') || (*str == '\\'))
+	    putc('\\', f);
+	putc(*str, f);
+    }
+    fputs("\"\n", f);
+}
+
+
+
+static u_llong
+PbGetVarint(
+    struct pb_reader *pr)
+{
+    u_llong val = 0;
+    int shift = 0;
+
+    while (pr->p < pr->end) {
+	u_char byte = *pr->p++;
+
+	if (shift < 64)
+	    val |= (u_llong)(byte & 0x7f) << shift;
+	shift += 7;
+	if ((byte & 0x80) == 0)
+	    return(val);
+    }
+
+    pr->bad = TRUE;
+    return(0);
+}
+
+
+static llong
+PbGetSigned(
+    struct pb_reader *pr)
+{
+    u_llong val = PbGetVarint(pr);
+
+    return((llong)(val >> 1) ^ -(llong)(val & 1));
+}
+
+
+/* a string from the strings column, in pds (so it's terminated) */
+static char *
+PbGetString(
+    struct pb_reader *pr,
+    dstring_t *pds)
+{
+    u_llong len = PbGetVarint(pr);
+
+    DSErase(pds);
+    if (pr->bad || (len > pr->end - pr->p)) {
+	pr->bad = TRUE;
+	return("");
+    }
+    DSAppendStringN(pds, (char *)pr->p, len);
+    pr->p += len;
+
+    return(DSVal(pds));
+}
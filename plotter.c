@@ -74,6 +74,8 @@ struct plotter_info {
     char *title;                /* Plotter title */
     char *xlabel;               /* Plotter x-axis label */
     char *ylabel;               /* Plotter y-axis label */
+    PLOTTER next_free;		/* next released slot (see plotter_release) */
+    struct plotbin *pbin;	/* with --binary_plots, see plotbin.c */
 };
 
 
@@ -81,11 +83,13 @@ struct plotter_info {
 /* locally global parameters */
 static int max_plotters;
 static PLOTTER plotter_ix = NO_PLOTTER;
+static PLOTTER free_plotters = NO_PLOTTER; /* slots given back, for reuse */
 static char *temp_color = NULL;
 static struct plotter_info *pplotters;
 
 
 /* local routine declarations */
+static struct timeval xp_time(PLOTTER pl, struct timeval time);
 static char *xp_timestamp(PLOTTER pl, struct timeval time);
 static char *TSGPlotName(tcb *plast, PLOTTER, char *suffix);
 static void DoPlot(PLOTTER pl, char *fmt, ...);
@@ -113,6 +117,31 @@ xp_timestamp(
     unsigned usecs;
     unsigned decimal;
     char *pbuf;
+
+    time = xp_time(pl, time);
+
+    /* calculate time components */
+    secs = time.tv_sec;
+    usecs = time.tv_usec;
+    decimal = usecs;
+
+    /* use one of 4 rotating static buffers (for multiple calls per printf) */
+    bufix = (bufix+1)%NUM_BUFS;
+    pbuf = bufs[bufix];
+
+    snprintf(pbuf,sizeof(bufs[bufix]),"%u.%06u",secs,decimal);
+
+    return(pbuf);
+}
+
+
+/* the time as it goes on the graph (relative to the first one, with */
+/* -z or switched axes) */
+static struct timeval
+xp_time(
+    PLOTTER pl,
+    struct timeval time)
+{
     struct plotter_info *ppi;
    
     ppi = &pplotters[pl];
@@ -140,18 +169,7 @@ increasing time order.  Try without the '-z' flag\n",
 	}
     }
 
-    /* calculate time components */
-    secs = time.tv_sec;
-    usecs = time.tv_usec;
-    decimal = usecs;
-
-    /* use one of 4 rotating static buffers (for multiple calls per printf) */
-    bufix = (bufix+1)%NUM_BUFS;
-    pbuf = bufs[bufix];
-
-    snprintf(pbuf,sizeof(bufs[bufix]),"%u.%06u",secs,decimal);
-
-    return(pbuf);
+    return(time);
 }
 
 
@@ -303,13 +321,21 @@ new_plotter(
     MFILE *f;
     struct plotter_info *ppi;
 
-    ++plotter_ix;
-    if (plotter_ix >= max_plotters) {
-	plotter_makemore();
-    }
+    if (free_plotters != NO_PLOTTER) {
+	/* reuse a slot that a finished connection gave back */
+	pl = free_plotters;
+	ppi = &pplotters[pl];
+	free_plotters = ppi->next_free;
+	memset(ppi,'\00',sizeof(struct plotter_info));
+    } else {
+	++plotter_ix;
+	if (plotter_ix >= max_plotters) {
+	    plotter_makemore();
+	}
 
-    pl = plotter_ix;
-    ppi = &pplotters[pl];
+	pl = plotter_ix;
+	ppi = &pplotters[pl];
+    }
 
     if (filename == NULL)
 	filename = TSGPlotName(plast,pl,suffix);
@@ -319,17 +345,26 @@ new_plotter(
 	filename = buf;
     }
 
+    /* FILE.tpb rather than FILE.xpl */
+    if (plot_binary)
+	filename = PlotSwapExt(filename, PLOTBIN_FILE_EXTENSION);
+    else
+	filename = strdup(filename);
+
     if (debug)
 	fprintf(stderr,"Plotter %d file is '%s'\n", pl, filename);
 
     if ((f = Mfopen(filename,"w")) == NULL) {
 	perror(filename);
+	free(filename);
 	return(NO_PLOTTER);
     }
 
     ppi->fplot = f;
     ppi->p2plast = plast;
-    ppi->filename = strdup(filename);
+    ppi->filename = filename;
+    if (plot_binary)
+	ppi->pbin = PlotBinOpen(f);
     ppi->axis_switched = FALSE;
     ppi->header_done = FALSE;
    
@@ -373,27 +408,51 @@ plotter_done(void)
         if(!ppi->header_done)
 	 WritePlotHeader(pl);
        
+	if (ppi->pbin) {
+	    PlotBinClose(ppi->pbin);
+	    ppi->pbin = NULL;
+	}
+
 	if (!ignore_non_comp ||
 	    ((ppi->p2plast != NULL) && (ConnComplete(ppi->p2plast->ptp)))) {
-	    Mfprintf(f,"go\n");
+	    if (!plot_binary)
+		Mfprintf(f,"go\n");
 	    Mfclose(f);
 	} else {
-	    fname = ppi->p2plast->tsg_plotfile;
+	    /* (from the MFILE, not the tcb, which might not have */
+	    /* any graph state, say for a module's plot) */
+	    fname = strdup(Mfname(f));
 	    if (debug)
 		fprintf(stderr,"Removing incomplete plot file '%s'\n",
 			fname);
 	    Mfclose(f);
 	    if (unlink(fname) != 0)
 		perror(fname);
+	    free(fname);
 	}
 
 	if(xplot_all_files){
-		if(output_file_dir!=NULL) {
-			DSAppendString(xplot_cmd_buff,output_file_dir);
-			DSAppendString(xplot_cmd_buff,"/");
+		char *path;
+
+		path = MallocZ(strlen(ppi->filename) +
+			       (output_file_dir ? strlen(output_file_dir) : 0) + 2);
+		sprintf(path, "%s%s%s",
+			output_file_dir ? output_file_dir : "",
+			output_file_dir ? "/" : "",
+			ppi->filename);
+
+		/* xplot wants to see the text, so it's needed after all */
+		if (plot_binary) {
+		    char *xplname = PlotSwapExt(path, ".xpl");
+
+		    PlotRender(path, "xplot");
+		    free(path);
+		    path = xplname;
 		}
-		DSAppendString(xplot_cmd_buff,ppi->filename);
+
+		DSAppendString(xplot_cmd_buff,path);
 		DSAppendString(xplot_cmd_buff," ");	
+		free(path);
 	}
     }
 
@@ -408,6 +467,45 @@ plotter_done(void)
 
 
 
+/* finish one plot early (in streaming mode, when its connection is */
+/* retired) and give its slot back so that the next new_plotter() */
+/* can reuse it */
+void
+plotter_release(
+    PLOTTER pl)
+{
+    struct plotter_info *ppi;
+
+    if ((pl == NO_PLOTTER) || (pl > plotter_ix))
+	return;
+
+    ppi = &pplotters[pl];
+    if (ppi->fplot == NULL)
+	return;
+
+    if (!ppi->header_done)
+	WritePlotHeader(pl);
+    if (ppi->pbin) {
+	PlotBinClose(ppi->pbin);
+	ppi->pbin = NULL;
+    } else {
+	Mfprintf(ppi->fplot,"go\n");
+    }
+    Mfrelease(ppi->fplot);
+
+    free(ppi->filename);
+    free(ppi->title);
+    free(ppi->xlabel);
+    free(ppi->ylabel);
+    ppi->fplot = NULL;
+    ppi->p2plast = NULL;
+
+    ppi->next_free = free_plotters;
+    free_plotters = pl;
+}
+
+
+
 void
 plotter_temp_color(
     PLOTTER pl,
@@ -808,12 +906,34 @@ CallDoPlot(
    va_end(ap);
 
    memset(fmt, 0, sizeof(fmt));
+
+   /* (--binary_plots) just store the command, see plotbin.c */
+   if (ppi->pbin) {
+      struct timeval bt1 = {0,0};
+      struct timeval bt2 = {0,0};
+
+      if (ppi->fplot == NULL)
+	 return;
+      if (!ppi->header_done)
+	 WritePlotHeader(pl);
+
+      /* (the same order xp_timestamp() would have been called in) */
+      if (plot_argc > 0)
+	 bt1 = xp_time(pl,t1);
+      if (plot_argc > 2)
+	 bt2 = xp_time(pl,t2);
+      snprintf(fmt, sizeof(fmt), "%s", plot_cmd);
+      PlotBinEvent(ppi->pbin, fmt, plot_argc, bt1, x1, bt2, x2, temp_color);
+      temp_color = NULL;
+      return;
+   }
    
    if(ppi->axis_switched) {
       switch(plot_argc) {
        case 0:
+	 /* (it's text, such as an http URL, not a format) */
 	 snprintf(fmt, sizeof(fmt), "%s", plot_cmd);
-	 DoPlot(pl, fmt);
+	 DoPlot(pl, "%s", fmt);
 	 break;
        case 2:
 	 snprintf(fmt, sizeof(fmt), "%s %%u -%%s", plot_cmd);
@@ -833,8 +953,9 @@ CallDoPlot(
    else {
       switch(plot_argc) {
        case 0:
+	 /* (it's text, such as an http URL, not a format) */
 	 snprintf(fmt, sizeof(fmt), "%s", plot_cmd);
-	 DoPlot(pl, fmt);
+	 DoPlot(pl, "%s", fmt);
 	 break;
        case 2:
 	 snprintf(fmt, sizeof(fmt), "%s %%s %%u", plot_cmd);
@@ -859,8 +980,10 @@ static void
 WritePlotHeader(
     PLOTTER pl)
 {
+   static dstring_t *pds = NULL;
    MFILE *f = NULL;
    struct plotter_info *ppi;
+   char buf[64];
 
    if (pl == NO_PLOTTER)
      return;
@@ -875,9 +998,14 @@ WritePlotHeader(
    if ((f = ppi->fplot) == NULL)
      return;
 
+   /* (gathered up first, since a binary plot stores it as a whole) */
+   if (pds == NULL)
+      pds = DSNew();
+   DSErase(pds);
+
    if(ppi->axis_switched) {   
       /* Header for the Time Line Charts */
-      Mfprintf(f,"%s %s\n", "unsigned", "dtime");
+      DSAppendString(pds, "unsigned dtime\n");
    }
    else {
       /* Header for all other plots */
@@ -887,23 +1015,33 @@ WritePlotHeader(
       /* ugly hack -- unsigned makes the graphs hard to work with and is
        only needed for the time sequence graphs */
       /* suggestion by Michele Clark at UNC - make them double instead */
-      Mfprintf(f,"%s %s\n",
+      snprintf(buf, sizeof(buf), "%s %s\n",
 	       graph_time_zero?"dtime":"timeval",
 	       ((strcmp(ppi->ylabel,"sequence number") == 0)&&(!graph_seq_zero))?
 	       "double":"signed");
+      DSAppendString(pds, buf);
    }
    
    if (show_title) {
-      if (xplot_title_prefix)
-	Mfprintf(f,"title\n%s %s\n",
-		 ExpandFormat(xplot_title_prefix),
-		 ppi->title);
-      else
-	Mfprintf(f,"title\n%s\n", ppi->title);
+      DSAppendString(pds, "title\n");
+      if (xplot_title_prefix) {
+	DSAppendString(pds, ExpandFormat(xplot_title_prefix));
+	DSAppendString(pds, " ");
+      }
+      DSAppendString(pds, ppi->title);
+      DSAppendString(pds, "\n");
    }
    
-   Mfprintf(f,"xlabel\n%s\n", ppi->xlabel);
-   Mfprintf(f,"ylabel\n%s\n", ppi->ylabel);
+   DSAppendString(pds, "xlabel\n");
+   DSAppendString(pds, ppi->xlabel);
+   DSAppendString(pds, "\nylabel\n");
+   DSAppendString(pds, ppi->ylabel);
+   DSAppendString(pds, "\n");
+
+   if (ppi->pbin)
+      PlotBinHeader(ppi->pbin, ppi->axis_switched, DSVal(pds));
+   else
+      Mfprintf(f,"%s",DSVal(pds));
    
    /* Indicate that the header has now been written to the plotter file */
    ppi->header_done = TRUE;
@@ -91,6 +91,7 @@ struct Pool {
 static struct Pool	*pools = NULL;	/* table of memory pools */
 static unsigned		table_size = 0;	/* size of the pool table */
 static int		pool_num = 0;	/* number of existing memory pools */
+static unsigned long	bytes_in_use = 0; /* handed out and not yet freed */
 
 /* local routines */
 static void *PoolValloc(const int, const unsigned, unsigned *);
@@ -205,6 +206,7 @@ PoolMalloc(
     exit(1);
   }
   bnumber = bytes / pools[poolid].block_size;
+  bytes_in_use += bytes;
 
   if (pools[poolid].block_no < bnumber) {
     if (PoolRealloc(poolid, bnumber) < 0) {
@@ -482,6 +484,7 @@ PoolFree(
   if (!ptr)
     return;
 
+  bytes_in_use -= pools[poolid].block_size;
   memset(ptr, '\00', pools[poolid].block_size);
   block = (struct Block *)ptr;
 
@@ -530,4 +533,15 @@ PoolFree(
   pools[poolid].block_no++;
 }
 
+
+/*
+ * PoolBytesInUse - how many bytes of all the pools are handed out
+ */
+unsigned long
+PoolBytesInUse(
+	       void)
+{
+  return bytes_in_use;
+}
+
 #endif
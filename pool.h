@@ -64,5 +64,7 @@ void *PoolMalloc(const int poolid, const unsigned bytes);
 
 void PoolFree(const int poolid, void *prt);
 
+unsigned long PoolBytesInUse(void);
+
 #endif
 
@@ -60,8 +60,6 @@ static char const GCC_UNUSED rcsid[] =
 
 static long tcp_pair_pool = -1;
 static long udp_pair_pool = -1;
-static long seqspace_pool = -1;
-static long ptp_snap_pool = -1;
 static long ptp_ptr_pool  = -1;
 static long segment_pool  = -1;
 static long quadrant_pool = -1;
@@ -108,48 +106,6 @@ FreeUdpPair(
   PoolFree(udp_pair_pool, ptr);
 }
 
-seqspace *
-MakeSeqspace(
-	     void)
-{
-  seqspace	*ptr = NULL;
-
-  if (seqspace_pool < 0) {
-    seqspace_pool = MakeMemPool(sizeof(seqspace), 0);
-  }
-  
-  ptr = PoolMalloc(seqspace_pool, sizeof(seqspace));
-  return ptr;
-}
-
-void
-FreeSeqspace(
-	     seqspace *ptr)
-{
-  PoolFree(seqspace_pool, ptr);
-}
-
-ptp_snap *
-MakePtpSnap(
-	    void)
-{
-  ptp_snap	*ptr = NULL;
-
-  if (ptp_snap_pool < 0) {
-    ptp_snap_pool = MakeMemPool(sizeof(ptp_snap), 0);
-  }
-  
-  ptr = PoolMalloc(ptp_snap_pool, sizeof(ptp_snap));
-  return ptr;
-}
-
-void
-FreePtpSnap(
-	    ptp_snap *ptr)
-{
-  PoolFree(ptp_snap_pool, ptr);
-}
-
 ptp_ptr *
 MakePtpPtr(
 	   void)
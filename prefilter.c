@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 1994, 1995, 1996, 1997, 1998, 1999, 2000, 2001,
+ *               2002, 2003, 2004
+ *      Ohio University.
+ *
+ * ---
+ *
+ * Starting with the release of tcptrace version 6 in 2001, tcptrace
+ * is licensed under the GNU General Public License (GPL).  We believe
+ * that, among the available licenses, the GPL will do the best job of
+ * allowing tcptrace to continue to be a valuable, freely-available
+ * and well-maintained tool for the networking community.
+ *
+ * Previous versions of tcptrace were released under a license that
+ * was much less restrictive with respect to how tcptrace could be
+ * used in commercial products.  Because of this, I am willing to
+ * consider alternate license arrangements as allowed in Section 10 of
+ * the GNU GPL.  Before I would consider licensing tcptrace under an
+ * alternate agreement with a particular individual or company,
+ * however, I would have to be convinced that such an alternative
+ * would be to the greater benefit of the networking community.
+ * 
+ * ---
+ *
+ * This file is part of Tcptrace.
+ *
+ * Tcptrace was originally written and continues to be maintained by
+ * Shawn Ostermann with the help of a group of devoted students and
+ * users (see the file 'THANKS').  The work on tcptrace has been made
+ * possible over the years through the generous support of NASA GRC,
+ * the National Science Foundation, and Sun Microsystems.
+ *
+ * Tcptrace is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tcptrace is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tcptrace (in the file 'COPYING'); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ * Author:      Shawn Ostermann
+ *              School of Electrical Engineering and Computer Science
+ *              Ohio University
+ *              Athens, OH
+ *              http://www.tcptrace.org/
+ */
+#include "tcptrace.h"
+static char const GCC_UNUSED copyright[] =
+    "@(#)Copyright (c) 2004 -- Ohio University.\n";
+static char const GCC_UNUSED rcsid[] =
+    "@(#)$Header$";
+
+
+
+/*
+ * prefilter.c -- per-packet BPF filter (--bpf=expr)
+ *
+ * The expression is compiled by libpcap for raw IP packets, so the
+ * same program works no matter which file format the packets came
+ * from; it's run on the IP header the reader hands back, before the
+ * packet goes anywhere near the TCP or UDP analysis.
+ */
+
+#include <pcap.h>
+
+/* older libpcaps don't have this */
+#ifndef PCAP_NETMASK_UNKNOWN
+#define PCAP_NETMASK_UNKNOWN	0xffffffff
+#endif
+
+/* the biggest raw IP packet we'll filter */
+#define BPF_SNAPLEN	65535
+
+/* the compiled filter */
+static struct bpf_program bpf_prog;
+
+
+void
+InstallBPF(
+    char *expr)
+{
+    pcap_t *pcap;
+
+    pcap = pcap_open_dead(DLT_RAW, BPF_SNAPLEN);
+    if (pcap == NULL) {
+	fprintf(stderr,"--bpf: can't get a pcap handle to compile with\n");
+	exit(-1);
+    }
+
+    if (pcap_compile(pcap, &bpf_prog, expr, 1, PCAP_NETMASK_UNKNOWN) < 0) {
+	fprintf(stderr,"--bpf: bad filter expression '%s': %s\n",
+		expr, pcap_geterr(pcap));
+	exit(-1);
+    }
+
+    if (debug)
+	fprintf(stderr,"--bpf: '%s' compiled into %u instructions\n",
+		expr, bpf_prog.bf_len);
+
+    pcap_close(pcap);
+}
+
+
+/* does this IP packet pass the --bpf filter? */
+Bool
+PassesBPF(
+    struct ip *pip,
+    void *plast,
+    int len,
+    int tlen)
+{
+    struct pcap_pkthdr hdr;
+    int caplen = (char *)plast - (char *)pip + 1;
+
+    /* the link header is in both len and tlen, so the difference */
+    /* is how much of the IP packet didn't get captured */
+    hdr.caplen = caplen;
+    hdr.len = caplen + ((len > tlen) ? (len - tlen) : 0);
+    hdr.ts.tv_sec = 0;
+    hdr.ts.tv_usec = 0;
+
+    return(pcap_offline_filter(&bpf_prog, &hdr, (u_char *)pip) != 0);
+}
@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 1994, 1995, 1996, 1997, 1998, 1999, 2000, 2001,
+ *               2002, 2003, 2004
+ *      Ohio University.
+ *
+ * ---
+ *
+ * Starting with the release of tcptrace version 6 in 2001, tcptrace
+ * is licensed under the GNU General Public License (GPL).  We believe
+ * that, among the available licenses, the GPL will do the best job of
+ * allowing tcptrace to continue to be a valuable, freely-available
+ * and well-maintained tool for the networking community.
+ *
+ * Previous versions of tcptrace were released under a license that
+ * was much less restrictive with respect to how tcptrace could be
+ * used in commercial products.  Because of this, I am willing to
+ * consider alternate license arrangements as allowed in Section 10 of
+ * the GNU GPL.  Before I would consider licensing tcptrace under an
+ * alternate agreement with a particular individual or company,
+ * however, I would have to be convinced that such an alternative
+ * would be to the greater benefit of the networking community.
+ * 
+ * ---
+ *
+ * This file is part of Tcptrace.
+ *
+ * Tcptrace was originally written and continues to be maintained by
+ * Shawn Ostermann with the help of a group of devoted students and
+ * users (see the file 'THANKS').  The work on tcptrace has been made
+ * possible over the years through the generous support of NASA GRC,
+ * the National Science Foundation, and Sun Microsystems.
+ *
+ * Tcptrace is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tcptrace is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tcptrace (in the file 'COPYING'); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ * Author:      Shawn Ostermann
+ *              School of Electrical Engineering and Computer Science
+ *              Ohio University
+ *              Athens, OH
+ *              http://www.tcptrace.org/
+ */
+
+#include "tcptrace.h"
+static char const GCC_UNUSED copyright[] =
+    "@(#)Copyright (c) 2004 -- Ohio University.\n";
+static char const GCC_UNUSED rcsid[] =
+    "@(#)$Header$";
+
+
+/*
+ * readahead.c -- overlap trace file reading with analysis
+ *
+ * With --readahead, the packet reading routine chosen for the
+ * input file is run in a thread of its own.  That thread copies each
+ * packet (the physical header and the IP datagram out to plast) into
+ * a batch buffer and hands full batches over through a small bounded
+ * queue.  The main thread gets the packets back, one at a time, through
+ * ReadAheadRead(), which looks just like any other pread_f routine, so
+ * the rest of ProcessFile() doesn't know the difference.
+ *
+ * Only the reading (and decompression pipe, pcap parsing, byte
+ * swapping, etc) is moved off the main thread.  The analysis itself
+ * (dotrace(), the modules, the plotters) shares far too many globals
+ * to be split by connection, so it still runs serially on the main
+ * thread and the output is identical to a single threaded run.
+ */
+
+#ifdef USE_THREADS
+
+#include <pthread.h>
+
+/* tuning */
+#define RA_BATCH_PKTS	1024		/* packets per batch */
+#define RA_BATCH_BYTES	(1024*1024)	/* packet bytes per batch */
+#define RA_NUM_BATCHES	8		/* batches in flight */
+
+/* the most we'll copy for a single packet (bigger ones are truncated) */
+#define RA_MAX_IPLEN	(IP_MAXPACKET+1)
+#define RA_PHYSLEN	((sizeof(struct ether_header) + 7) & ~7)
+#define RA_MAX_NEED	(RA_PHYSLEN + ((RA_MAX_IPLEN + 7) & ~7))
+
+/* one packet, as returned by the real reading routine */
+struct ra_pkt {
+    struct timeval	time;
+    int			len;
+    int			tlen;
+    int			phystype;
+    Bool		has_phys;	/* was a physical header returned? */
+    u_int		offset;		/* where the packet starts in data */
+    u_int		iplen;		/* bytes from pip thru plast */
+};
+
+struct ra_batch {
+    int			npkts;
+    u_int		used;		/* bytes of data in use */
+    Bool		eof;		/* no more packets after this batch */
+    struct ra_pkt	*pkts;
+    char		*data;
+    struct ra_batch	*next;
+};
+
+/* a list of batches */
+struct ra_queue {
+    struct ra_batch	*head;
+    struct ra_batch	*tail;
+};
+
+static pthread_t	ra_thread;
+static pthread_mutex_t	ra_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	ra_cond_full = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	ra_cond_free = PTHREAD_COND_INITIALIZER;
+static struct ra_queue	ra_full;	/* filled by the reader */
+static struct ra_queue	ra_free;	/* empty, ready for the reader */
+static Bool		ra_running = FALSE;
+static Bool		ra_stopping = FALSE;
+static pread_f		*ra_pread;	/* the real reading routine */
+
+/* the batch the main thread is currently working thru */
+static struct ra_batch	*ra_cur = NULL;
+static int		ra_cur_ix = 0;
+
+/* some statistics */
+static u_long ra_batches = 0;
+static u_long ra_reader_waits = 0;
+static u_long ra_analyzer_waits = 0;
+
+
+/* local routines */
+static void RAEnqueue(struct ra_queue *, struct ra_batch *);
+static struct ra_batch *RADequeue(struct ra_queue *);
+static void *RAReader(void *);
+static int ReadAheadRead(struct timeval *, int *, int *, void **,
+			 int *, struct ip **, void **);
+
+
+
+static void
+RAEnqueue(
+    struct ra_queue *pq,
+    struct ra_batch *pb)
+{
+    pb->next = NULL;
+    if (pq->tail)
+	pq->tail->next = pb;
+    else
+	pq->head = pb;
+    pq->tail = pb;
+}
+
+
+
+static struct ra_batch *
+RADequeue(
+    struct ra_queue *pq)
+{
+    struct ra_batch *pb = pq->head;
+
+    if (pb) {
+	pq->head = pb->next;
+	if (pq->head == NULL)
+	    pq->tail = NULL;
+    }
+    return(pb);
+}
+
+
+
+/* the reader thread, fill batches until EOF (or until told to stop) */
+static void *
+RAReader(
+    void *arg)
+{
+    struct ra_batch *pb;
+    sigset_t mask;
+    Bool eof = FALSE;
+
+    /* signals are the main thread's business */
+    sigfillset(&mask);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    while (!eof) {
+	/* get an empty batch */
+	pthread_mutex_lock(&ra_lock);
+	while (!ra_stopping && (ra_free.head == NULL)) {
+	    ++ra_reader_waits;
+	    pthread_cond_wait(&ra_cond_free, &ra_lock);
+	}
+	if (ra_stopping) {
+	    pthread_mutex_unlock(&ra_lock);
+	    break;
+	}
+	pb = RADequeue(&ra_free);
+	pthread_mutex_unlock(&ra_lock);
+
+	/* fill it, as long as the biggest possible packet still fits */
+	pb->npkts = 0;
+	pb->used = 0;
+	pb->eof = FALSE;
+	while ((pb->npkts < RA_BATCH_PKTS) &&
+	       (pb->used + RA_MAX_NEED <= RA_BATCH_BYTES)) {
+	    struct ra_pkt *ppkt = &pb->pkts[pb->npkts];
+	    void *phys;
+	    struct ip *pip;
+	    void *plast;
+	    long iplen;
+
+	    if ((*ra_pread)(&ppkt->time,&ppkt->len,&ppkt->tlen,
+			    &phys,&ppkt->phystype,&pip,&plast) == 0) {
+		eof = TRUE;
+		pb->eof = TRUE;
+		break;
+	    }
+
+	    iplen = (char *)plast - (char *)pip + 1;
+	    if (iplen < 0)
+		iplen = 0;
+	    else if (iplen > RA_MAX_IPLEN)
+		iplen = RA_MAX_IPLEN;
+
+	    ppkt->has_phys = (phys != NULL);
+	    ppkt->offset = pb->used;
+	    ppkt->iplen = iplen;
+	    /* (only an Ethernet header's worth of phys is kept; nothing */
+	    /* past the readers understands any other kind, and print.c */
+	    /* only looks inside PHYS_ETHER) */
+	    if (phys)
+		memcpy(pb->data + pb->used, phys, sizeof(struct ether_header));
+	    memcpy(pb->data + pb->used + RA_PHYSLEN, pip, iplen);
+
+	    /* keep every packet 8-byte aligned */
+	    pb->used += RA_PHYSLEN + ((iplen + 7) & ~7);
+	    ++pb->npkts;
+	}
+
+	/* hand it over */
+	pthread_mutex_lock(&ra_lock);
+	RAEnqueue(&ra_full, pb);
+	++ra_batches;
+	pthread_cond_signal(&ra_cond_full);
+	pthread_mutex_unlock(&ra_lock);
+    }
+
+    return(NULL);
+}
+
+
+
+/* the pread_f routine that the main thread sees */
+static int
+ReadAheadRead(
+    struct timeval	*ptime,
+    int		 	*plen,
+    int		 	*ptlen,
+    void		**pphys,
+    int			*pphystype,
+    struct ip		**ppip,
+    void		**pplast)
+{
+    struct ra_pkt *ppkt;
+    char *pdata;
+
+    /* done with the current batch? */
+    while ((ra_cur == NULL) || (ra_cur_ix >= ra_cur->npkts)) {
+	if (ra_cur && ra_cur->eof)
+	    return(0);
+
+	pthread_mutex_lock(&ra_lock);
+	if (ra_cur) {
+	    /* the caller is done with the previous packet, */
+	    /* so the batch can be recycled */
+	    RAEnqueue(&ra_free, ra_cur);
+	    pthread_cond_signal(&ra_cond_free);
+	}
+	while (ra_full.head == NULL) {
+	    ++ra_analyzer_waits;
+	    pthread_cond_wait(&ra_cond_full, &ra_lock);
+	}
+	ra_cur = RADequeue(&ra_full);
+	pthread_mutex_unlock(&ra_lock);
+	ra_cur_ix = 0;
+    }
+
+    ppkt = &ra_cur->pkts[ra_cur_ix++];
+    pdata = ra_cur->data + ppkt->offset;
+
+    *ptime = ppkt->time;
+    *plen = ppkt->len;
+    *ptlen = ppkt->tlen;
+    *pphys = ppkt->has_phys?pdata:NULL;
+    *pphystype = ppkt->phystype;
+    *ppip = (struct ip *)(pdata + RA_PHYSLEN);
+    *pplast = (char *)*ppip + ppkt->iplen - 1;
+
+    return(1);
+}
+
+
+
+/* start reading ahead with the given routine, returns the routine */
+/* that the caller should use instead */
+pread_f *
+ReadAheadStart(
+    pread_f *ppread)
+{
+    static struct ra_batch *batches = NULL;
+    int i;
+
+    if (batches == NULL) {
+	batches = MallocZ(RA_NUM_BATCHES * sizeof(struct ra_batch));
+	for (i=0; i < RA_NUM_BATCHES; ++i) {
+	    batches[i].pkts = MallocZ(RA_BATCH_PKTS * sizeof(struct ra_pkt));
+	    batches[i].data = MallocZ(RA_BATCH_BYTES);
+	}
+    }
+
+    ra_full.head = ra_full.tail = NULL;
+    ra_free.head = ra_free.tail = NULL;
+    for (i=0; i < RA_NUM_BATCHES; ++i)
+	RAEnqueue(&ra_free, &batches[i]);
+    ra_cur = NULL;
+    ra_cur_ix = 0;
+    ra_pread = ppread;
+    ra_stopping = FALSE;
+
+    if (pthread_create(&ra_thread, NULL, RAReader, NULL) != 0) {
+	perror("pthread_create");
+	fprintf(stderr,"Reading the file without a separate thread\n");
+	return(ppread);
+    }
+    ra_running = TRUE;
+
+    if (debug)
+	fprintf(stderr,"Reading ahead in a separate thread\n");
+
+    return(ReadAheadRead);
+}
+
+
+
+/* stop the reader (which may be well ahead of us, or done already) */
+void
+ReadAheadStop(void)
+{
+    if (!ra_running)
+	return;
+
+    pthread_mutex_lock(&ra_lock);
+    ra_stopping = TRUE;
+    pthread_cond_signal(&ra_cond_free);
+    pthread_mutex_unlock(&ra_lock);
+
+    pthread_join(ra_thread, NULL);
+    ra_running = FALSE;
+
+    if (debug)
+	fprintf(stderr,
+		"Read ahead: %lu batches, reader waited %lu times, analysis waited %lu times\n",
+		ra_batches, ra_reader_waits, ra_analyzer_waits);
+}
+
+
+#else /* USE_THREADS */
+
+
+pread_f *
+ReadAheadStart(
+    pread_f *ppread)
+{
+    static Bool warned = FALSE;
+
+    if (!warned) {
+	fprintf(stderr,
+		"Warning: not compiled with thread support, --readahead ignored\n");
+	warned = TRUE;
+    }
+    return(ppread);
+}
+
+
+void
+ReadAheadStop(void)
+{
+}
+
+#endif /* USE_THREADS */
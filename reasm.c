@@ -0,0 +1,518 @@
+/*
+ * Copyright (c) 1994, 1995, 1996, 1997, 1998, 1999, 2000, 2001,
+ *               2002, 2003, 2004
+ *      Ohio University.
+ *
+ * ---
+ *
+ * Starting with the release of tcptrace version 6 in 2001, tcptrace
+ * is licensed under the GNU General Public License (GPL).  We believe
+ * that, among the available licenses, the GPL will do the best job of
+ * allowing tcptrace to continue to be a valuable, freely-available
+ * and well-maintained tool for the networking community.
+ *
+ * Previous versions of tcptrace were released under a license that
+ * was much less restrictive with respect to how tcptrace could be
+ * used in commercial products.  Because of this, I am willing to
+ * consider alternate license arrangements as allowed in Section 10 of
+ * the GNU GPL.  Before I would consider licensing tcptrace under an
+ * alternate agreement with a particular individual or company,
+ * however, I would have to be convinced that such an alternative
+ * would be to the greater benefit of the networking community.
+ * 
+ * ---
+ *
+ * This file is part of Tcptrace.
+ *
+ * Tcptrace was originally written and continues to be maintained by
+ * Shawn Ostermann with the help of a group of devoted students and
+ * users (see the file 'THANKS').  The work on tcptrace has been made
+ * possible over the years through the generous support of NASA GRC,
+ * the National Science Foundation, and Sun Microsystems.
+ *
+ * Tcptrace is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tcptrace is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tcptrace (in the file 'COPYING'); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ * Author:      Shawn Ostermann
+ *              School of Electrical Engineering and Computer Science
+ *              Ohio University
+ *              Athens, OH
+ *              http://www.tcptrace.org/
+ */
+#include "tcptrace.h"
+static char const GCC_UNUSED copyright[] =
+    "@(#)Copyright (c) 2004 -- Ohio University.\n";
+static char const GCC_UNUSED rcsid[] =
+    "@(#)$Header$";
+
+
+
+
+
+/*
+ * reasm.c -- put each direction's payload back in order for the modules
+ *
+ * Modules that want to look at what a connection carried, rather than
+ * at its packets, fill in module_stream_data (see modules.h) and get
+ * each direction's bytes handed to them in order, once, no matter how
+ * the segments were lost, reordered, duplicated, or repacketized on
+ * the wire.  Each run of bytes comes with its offset in the stream (0
+ * is the byte after the SYN, or the first byte we saw if we missed
+ * that), which is 64 bits wide, so sequence number wraparound doesn't
+ * show.
+ *
+ * Data that arrives in order is handed over right out of the packet.
+ * Data that arrives early is copied (once, however many modules are
+ * listening) into a buffer from one of a few memory pools and held
+ * until the hole in front of it fills.  A connection holds at most
+ * --reasm_window KB that way; past that, the oldest hole is given up
+ * on and handed over as pdata == NULL, so that the offsets of what
+ * follows stay right.  Whatever's still missing when the connection
+ * goes away (or at the end of the run) is handed over the same way.
+ *
+ * The buffers are reference counted: a module that wants to keep the
+ * bytes it was just handed past the call can ReasmHold() them and
+ * ReasmRelease() them when it's done, rather than making a copy.
+ */
+
+
+/* the pools the buffers come from, by (data) size */
+#define REASM_NCLASSES	4
+static u_int reasm_class_size[REASM_NCLASSES] = {
+    256, 2048, 9216, 65536
+};
+static int reasm_pool[REASM_NCLASSES] = {-1, -1, -1, -1};
+
+/* the data from the packet being traced, until the modules have seen it */
+static struct reasm_pending {
+    tcb		*ptcb;
+    u_long	pnum;		/* which packet it came from */
+    seqnum	seq;
+    char	*pdata;
+    u_long	len;
+} pending;
+
+/* what's being handed to the modules right now (for ReasmHold()) */
+static reasm_buf *deliver_buf;
+static char *deliver_data;
+static u_long deliver_len;
+static u_llong deliver_off;
+
+/* every direction that's seen data, so the stragglers can be flushed */
+static tcb_reasm *reasm_active = NULL;
+
+
+/* local routines */
+static tcb_reasm *ReasmGet(tcb *ptcb);
+static void ReasmData(tcb *ptcb, seqnum seq, char *pdata, u_long len);
+static void ReasmDeliver(tcb_reasm *pr, reasm_buf *pbuf,
+			 char *pdata, u_long len);
+static void ReasmDrain(tcb_reasm *pr);
+static void ReasmGiveUp(tcb_reasm *pr, u_llong upto);
+static reasm_buf *ReasmBufAlloc(u_long len);
+static u_long ReasmHeld(tcp_pair *ptp);
+
+
+
+/* remember the data in the packet dotrace() is looking at */
+void
+ReasmNote(
+    tcb *ptcb,
+    seqnum seq,
+    char *pdata,
+    u_long len)
+{
+    pending.ptcb = ptcb;
+    pending.pnum = pnum;
+    pending.seq = seq;
+    pending.pdata = pdata;
+    pending.len = len;
+}
+
+
+
+/* the modules have seen the packet, now give them its data */
+void
+ReasmPacket(
+    tcp_pair *ptp)
+{
+    tcb *ptcb = pending.ptcb;
+
+    pending.ptcb = NULL;
+    if ((ptcb == NULL) || (pending.pnum != pnum) || (ptcb->ptp != ptp))
+	return;
+
+    ReasmData(ptcb, pending.seq, pending.pdata, pending.len);
+}
+
+
+
+/* place one segment's data in its direction's stream */
+static void
+ReasmData(
+    tcb *ptcb,
+    seqnum seq,
+    char *pdata,
+    u_long len)
+{
+    tcb_reasm *pr = ReasmGet(ptcb);
+    tcb_reasm *pvictim;
+    tcb_reasm *pother;
+    reasm_buf *pbuf;
+    reasm_buf **ppbuf;
+    long long off;
+    u_llong end;
+    u_long window = reasm_window * 1024;
+
+    if (pr->finished || (len == 0))
+	return;
+
+    /* the stream starts just past the SYN (or, if we missed that, */
+    /* with the first data we see) */
+    if (!pr->started) {
+	pr->started = TRUE;
+	pr->next_seq = (ptcb->syn_count > 0) ? ptcb->syn+1 : seq;
+	pr->next_off = 0;
+    }
+
+    /* where this falls, measured from the next byte we're waiting */
+    /* for (so that sequence number wraparound doesn't matter) */
+    off = (long long)pr->next_off + (int)(seq - pr->next_seq);
+
+    /* can't place anything from before the start */
+    if (off < 0) {
+	if ((u_long)-off >= len)
+	    return;
+	pdata += -off;
+	len -= -off;
+	off = 0;
+    }
+    end = off + len;
+
+    while (1) {
+	/* old news (a retransmission) */
+	if (end <= pr->next_off)
+	    return;
+
+	/* in order, possibly overlapping what they've already seen */
+	if ((u_llong)off <= pr->next_off) {
+	    u_long skip = pr->next_off - off;
+	    ReasmDeliver(pr, NULL, pdata + skip, len - skip);
+	    ReasmDrain(pr);
+	    return;
+	}
+
+	/* early, hold onto it if there's room */
+	if (ReasmHeld(ptcb->ptp) + len <= window)
+	    break;
+
+	/* no room, so give up on the oldest hole in whichever */
+	/* direction is holding more */
+	pother = ptcb->ptwin->preasm;
+	pvictim = pr;
+	if (pother && (pother->early_bytes > pr->early_bytes))
+	    pvictim = pother;
+	if (pvictim->early == NULL) {
+	    /* nothing held anywhere, this one's just too big to wait */
+	    ReasmGiveUp(pr, off);
+	} else {
+	    ReasmGiveUp(pvictim, pvictim->early->off);
+	    ReasmDrain(pvictim);
+	}
+    }
+
+    /* if we're already holding all of it, we're done */
+    for (ppbuf = &pr->early; (pbuf = *ppbuf) != NULL; ppbuf = &pbuf->next) {
+	if (pbuf->off > (u_llong)off)
+	    break;
+	if (pbuf->off + pbuf->len >= end)
+	    return;
+    }
+
+    pbuf = ReasmBufAlloc(len);
+    pbuf->off = off;
+    memcpy(pbuf->data, pdata, len);
+    pbuf->next = *ppbuf;
+    *ppbuf = pbuf;
+    pr->early_bytes += len;
+
+    if (debug > 5)
+	printf("reasm: holding %lu bytes at offset %llu (waiting for %llu)\n",
+	       len, (u_llong)off, pr->next_off);
+}
+
+
+
+/* hand the next in-order bytes to the modules */
+static void
+ReasmDeliver(
+    tcb_reasm *pr,
+    reasm_buf *pbuf,
+    char *pdata,
+    u_long len)
+{
+    tcb *ptcb = pr->ptcb;
+    u_llong off = pr->next_off;
+    reasm_buf *save_buf = deliver_buf;
+    char *save_data = deliver_data;
+    u_long save_len = deliver_len;
+    u_llong save_off = deliver_off;
+
+    /* (a module might pull more of this stream along while we're in */
+    /* here, so move past these first) */
+    pr->next_off += len;
+    pr->next_seq += len;
+
+    deliver_buf = pbuf;
+    deliver_data = pdata;
+    deliver_len = len;
+    deliver_off = off;
+    ModulesPerStream(ptcb->ptp, ptcb, off, pdata, len);
+    deliver_buf = save_buf;
+    deliver_data = save_data;
+    deliver_len = save_len;
+    deliver_off = save_off;
+}
+
+
+
+/* the held pieces that fit now */
+static void
+ReasmDrain(
+    tcb_reasm *pr)
+{
+    reasm_buf *pbuf;
+    u_long skip;
+
+    while (((pbuf = pr->early) != NULL) && (pbuf->off <= pr->next_off)) {
+	pr->early = pbuf->next;
+	pr->early_bytes -= pbuf->len;
+	pbuf->next = NULL;
+	if (pbuf->off + pbuf->len > pr->next_off) {
+	    skip = pr->next_off - pbuf->off;
+	    ReasmDeliver(pr, pbuf, pbuf->data + skip, pbuf->len - skip);
+	}
+	ReasmRelease(pbuf);
+    }
+}
+
+
+
+/* stop waiting for the bytes before upto */
+static void
+ReasmGiveUp(
+    tcb_reasm *pr,
+    u_llong upto)
+{
+    if (upto <= pr->next_off)
+	return;
+
+    if (debug > 1)
+	fprintf(stderr,"reasm: %s->%s: giving up on %llu bytes at offset %llu\n",
+		pr->ptcb->host_letter, pr->ptcb->ptwin->host_letter,
+		upto - pr->next_off, pr->next_off);
+
+    ReasmDeliver(pr, NULL, NULL, upto - pr->next_off);
+}
+
+
+
+/* everything that one direction's holding, holes and all */
+void
+ReasmFlush(
+    tcb *ptcb)
+{
+    tcb_reasm *pr = ptcb->preasm;
+
+    if (pr == NULL)
+	return;
+
+    while (pr->early) {
+	ReasmGiveUp(pr, pr->early->off);
+	ReasmDrain(pr);
+    }
+}
+
+
+
+/* the connection's over (or the run is), hand over whatever's left */
+void
+ReasmFinish(
+    tcp_pair *ptp)
+{
+    if (ptp->a2b.preasm && !ptp->a2b.preasm->finished) {
+	ReasmFlush(&ptp->a2b);
+	ptp->a2b.preasm->finished = TRUE;
+    }
+    if (ptp->b2a.preasm && !ptp->b2a.preasm->finished) {
+	ReasmFlush(&ptp->b2a);
+	ptp->b2a.preasm->finished = TRUE;
+    }
+}
+
+
+
+/* finish every connection that's still around */
+void
+ReasmDone(void)
+{
+    tcb_reasm *pr;
+
+    for (pr = reasm_active; pr; pr = pr->next_active)
+	ReasmFinish(pr->ptcb->ptp);
+}
+
+
+
+/* the connection's going away, give back its buffers */
+void
+ReasmFree(
+    tcp_pair *ptp)
+{
+    tcb *ptcb;
+    tcb_reasm *pr;
+    reasm_buf *pbuf;
+    int i;
+
+    for (i = 0; i < 2; ++i) {
+	ptcb = (i == 0) ? &ptp->a2b : &ptp->b2a;
+	if ((pr = ptcb->preasm) == NULL)
+	    continue;
+
+	while ((pbuf = pr->early) != NULL) {
+	    pr->early = pbuf->next;
+	    ReasmRelease(pbuf);
+	}
+	pr->early_bytes = 0;
+
+	if (pr->prev_active)
+	    pr->prev_active->next_active = pr->next_active;
+	else
+	    reasm_active = pr->next_active;
+	if (pr->next_active)
+	    pr->next_active->prev_active = pr->prev_active;
+
+	/* (the record itself goes with the connection's memory) */
+	ptcb->preasm = NULL;
+    }
+}
+
+
+
+/* keep the bytes just handed to a module_stream_data routine: they're */
+/* at pbuf->data + (offset - pbuf->off) until ReasmRelease(pbuf) */
+reasm_buf *
+ReasmHold(void)
+{
+    reasm_buf *pbuf;
+
+    if (deliver_data == NULL)
+	return(NULL);		/* not delivering, or a hole */
+
+    /* held data already has a buffer of its own, but data straight */
+    /* out of the packet has to be copied (once, for everyone who */
+    /* wants it) */
+    if (deliver_buf == NULL) {
+	pbuf = ReasmBufAlloc(deliver_len);
+	memcpy(pbuf->data, deliver_data, deliver_len);
+	pbuf->off = deliver_off;
+	pbuf->refs = 0;		/* (only the holders own it) */
+	deliver_buf = pbuf;
+	deliver_data = pbuf->data;
+    }
+
+    ++deliver_buf->refs;
+    return(deliver_buf);
+}
+
+
+
+void
+ReasmRelease(
+    reasm_buf *pbuf)
+{
+    if (--pbuf->refs > 0)
+	return;
+    PoolFree(reasm_pool[pbuf->bclass], pbuf);
+}
+
+
+
+static reasm_buf *
+ReasmBufAlloc(
+    u_long len)
+{
+    reasm_buf *pbuf;
+    int bclass;
+
+    for (bclass = 0; bclass < REASM_NCLASSES-1; ++bclass)
+	if (len <= reasm_class_size[bclass])
+	    break;
+    if (len > reasm_class_size[bclass]) {
+	fprintf(stderr,"ReasmBufAlloc: %lu bytes is too many\n", len);
+	exit(-1);
+    }
+
+    if (reasm_pool[bclass] < 0)
+	reasm_pool[bclass] =
+	    MakeMemPool(sizeof(reasm_buf) + reasm_class_size[bclass], 0);
+
+    pbuf = PoolMalloc(reasm_pool[bclass],
+		      sizeof(reasm_buf) + reasm_class_size[bclass]);
+    pbuf->data = (char *)(pbuf+1);
+    pbuf->len = len;
+    pbuf->refs = 1;
+    pbuf->bclass = bclass;
+
+    return(pbuf);
+}
+
+
+
+/* set up a direction's reassembly the first time it has data */
+static tcb_reasm *
+ReasmGet(
+    tcb *ptcb)
+{
+    tcb_reasm *pr = ptcb->preasm;
+
+    if (pr == NULL) {
+	pr = ptcb->preasm = ConnAlloc(ptcb->ptp,sizeof(tcb_reasm));
+	pr->ptcb = ptcb;
+	pr->next_active = reasm_active;
+	if (reasm_active)
+	    reasm_active->prev_active = pr;
+	reasm_active = pr;
+    }
+
+    return(pr);
+}
+
+
+
+/* bytes held early for both directions of a connection */
+static u_long
+ReasmHeld(
+    tcp_pair *ptp)
+{
+    u_long held = 0;
+
+    if (ptp->a2b.preasm)
+	held += ptp->a2b.preasm->early_bytes;
+    if (ptp->b2a.preasm)
+	held += ptp->b2a.preasm->early_bytes;
+
+    return(held);
+}
@@ -83,15 +83,22 @@ It can also keep track of packets that come out of order.
 
 /* locally global variables*/
 
+/* segments to allocate for a quadrant the first time */
+#define QUAD_INIT_SEGS	16
+
+/* the ix'th lowest segment in a quadrant */
+#define SEG(pquad,ix)	(&(pquad)->segs[(pquad)->first + (ix)])
+
 
 /* local routine definitions*/
-static void insert_seg_between (quadrant *,
-				segment *,
-				segment *,
-				segment *);
-static void collapse_quad (quadrant *);
-static segment *create_seg (seqnum,
+static segment *insert_seg (quadrant *,
+			    u_int,
+			    seqnum,
 			    seglen);
+static void grow_quad (quadrant *);
+static u_int find_seg (quadrant *,
+		       seqnum);
+static void collapse_quad (quadrant *);
 static quadrant *whichquad (seqspace *,
 			    seqnum);
 static quadrant *create_quadrant (void);
@@ -172,15 +179,19 @@ addseg (tcb * ptcb,
     segment *pseg_new;
     int rexlen = 0;
     Bool split = FALSE;
+    u_int ix;
 
-    /* check each segment in the segment list */
-    pseg = pquad->seglist_head;
-
+    /* skip the segments that end before this one starts */
     /* (optimize expected case, it just goes at the end) */
-    if (pquad->seglist_tail &&
-	(thisseg_firstbyte > pquad->seglist_tail->seq_lastbyte))
-	pseg = NULL;
-    for (; pseg != NULL; pseg = pseg->next) {
+    if ((pquad->nsegs == 0) ||
+	(thisseg_firstbyte > SEG (pquad, pquad->nsegs - 1)->seq_lastbyte))
+	ix = pquad->nsegs;
+    else
+	ix = find_seg (pquad, thisseg_firstbyte);
+
+    /* check each remaining segment in the quadrant */
+    for (; ix < pquad->nsegs; ++ix) {
+	pseg = SEG (pquad, ix);
 	if (thisseg_firstbyte > pseg->seq_lastbyte) {
 	    /* goes beyond this one */
 	    continue;
@@ -195,9 +206,9 @@ addseg (tcb * ptcb,
 	    if (thisseg_lastbyte < pseg->seq_lastbyte)
 		*pout_order = TRUE;
 
-	    /* make a new segment record for it */
-	    pseg_new = create_seg (thisseg_firstbyte, len);
-	    insert_seg_between (pquad, pseg_new, pseg->prev, pseg);
+	    /* make a new segment record for it (which moves this one up) */
+	    pseg_new = insert_seg (pquad, ix, thisseg_firstbyte, len);
+	    pseg = SEG (pquad, ++ix);
 
 	    /* see if we overlap the next segment in the list */
 	    if (thisseg_lastbyte < pseg->seq_firstbyte) {
@@ -243,8 +254,7 @@ addseg (tcb * ptcb,
 
     /* if we got to the end, then it doesn't go BEFORE anybody, */
     /* tack it onto the end */
-    pseg_new = create_seg (thisseg_firstbyte, len);
-    insert_seg_between (pquad, pseg_new, pquad->seglist_tail, NULL);
+    insert_seg (pquad, pquad->nsegs, thisseg_firstbyte, len);
 
     return (rexlen);
 }
@@ -252,14 +262,80 @@ addseg (tcb * ptcb,
 
 
 /**********************************************************************/
+/* index of the first segment in the quadrant that ends at or after */
+/* seq (nsegs if there isn't one) */
+static u_int
+find_seg (quadrant * pquad,
+	  seqnum seq)
+{
+    u_int lo = 0;
+    u_int hi = pquad->nsegs;
+
+    /* the segments never overlap, so they're sorted by both ends */
+    while (lo < hi) {
+	u_int mid = lo + (hi - lo) / 2;
+
+	if (SEG (pquad, mid)->seq_lastbyte < seq)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+
+    return (lo);
+}
+
+
+
+/**********************************************************************/
+/* make room at the end of the quadrant's array */
+static void
+grow_quad (quadrant * pquad)
+{
+    u_int newmax;
+
+    if ((pquad->first > 0) && (pquad->first >= pquad->maxsegs / 2)) {
+	/* at least half of it is free at the front, reuse that */
+	memmove (pquad->segs, SEG (pquad, 0),
+		 pquad->nsegs * sizeof (segment));
+	pquad->first = 0;
+	return;
+    }
+
+    newmax = pquad->maxsegs ? (2 * pquad->maxsegs) : QUAD_INIT_SEGS;
+    pquad->segs = ReallocZ (pquad->segs,
+			    pquad->maxsegs * sizeof (segment),
+			    newmax * sizeof (segment));
+    pquad->maxsegs = newmax;
+}
+
+
+
+/**********************************************************************/
+/* add a new segment to the quadrant so that it becomes the ix'th one */
 static segment *
-create_seg (seqnum seq,
+insert_seg (quadrant * pquad,
+	    u_int ix,
+	    seqnum seq,
 	    seglen len)
 {
     segment *pseg;
 
-    pseg = (segment *) MallocZ (sizeof (segment));
+    if ((pquad->first > 0) && (ix < pquad->nsegs / 2)) {
+	/* cheaper to slide the ones before it down */
+	--pquad->first;
+	memmove (SEG (pquad, 0), SEG (pquad, 1), ix * sizeof (segment));
+    } else {
+	/* slide the ones after it up */
+	if (pquad->first + pquad->nsegs == pquad->maxsegs)
+	    grow_quad (pquad);
+	memmove (SEG (pquad, ix + 1), SEG (pquad, ix),
+		 (pquad->nsegs - ix) * sizeof (segment));
+    }
+    ++pquad->nsegs;
 
+    pseg = SEG (pquad, ix);
+    pseg->retrans = 0;
+    pseg->acked = 0;
     pseg->time = current_time;
     pseg->seq_firstbyte = seq;
     pseg->seq_lastbyte = seq + len - 1;
@@ -273,7 +349,7 @@ create_quadrant (void)
 {
     quadrant *pquad;
 
-    pquad = (quadrant *) MallocZ (sizeof (quadrant));
+    pquad = MakeQuadrant ();
 
     return (pquad);
 }
@@ -340,86 +416,59 @@ whichquad (seqspace * sspace,
 static void
 collapse_quad (quadrant * pquad)
 {
-    Bool freed;
     segment *pseg;
-    segment *tmpseg;
+    segment *pseg_out;
+    u_int nacked;
+    int ix;
 
-    if ((pquad == NULL) || (pquad->seglist_head == NULL))
+    if ((pquad == NULL) || (pquad->nsegs == 0))
 	return;
 
-    pseg = pquad->seglist_head;
-    while (pseg != NULL) {
-	freed = FALSE;
-	if (pseg->next == NULL)
+    /* if a segment has not been ACKed, then neither have the ones */
+    /* that follow, so only the ACKed ones at the front are collapsed */
+    for (nacked = 0; nacked < pquad->nsegs; ++nacked)
+	if (!SEG (pquad, nacked)->acked)
 	    break;
 
-	/* if this segment has not been ACKed, then neither have the */
-	/* ones that follow, so no need to continue */
-	if (!pseg->acked)
-	    break;
+    /* if two neighboring ACKed segments "fit together", then collapse */
+    /* them into one (larger) segment.  Working from the back, the     */
+    /* survivors are packed up against the first un-ACKed segment,     */
+    /* so nothing behind it needs to move                              */
+    if (nacked > 1) {
+	pseg_out = SEG (pquad, nacked - 1);
+	for (ix = nacked - 2; ix >= 0; --ix) {
+	    pseg = SEG (pquad, ix);
 
-	/* if this segment and the next one have both been ACKed and they */
-	/* "fit together", then collapse them into one (larger) segment   */
-	if (pseg->acked && pseg->next->acked &&
-	    (pseg->seq_lastbyte + 1 == pseg->next->seq_firstbyte)) {
-	    pseg->seq_lastbyte = pseg->next->seq_lastbyte;
-
-	    /* the new ACK count is the ACK count of the later segment */
-	    pseg->acked = pseg->next->acked;
-
-	    /* the new "transmit time" is the greater of the two */
-	    if (tv_gt (pseg->next->time, pseg->time))
-		pseg->time = pseg->next->time;
-
-	    tmpseg = pseg->next;
-	    pseg->next = pseg->next->next;
-	    if (pseg->next != NULL)
-		pseg->next->prev = pseg;
-	    if (tmpseg == pquad->seglist_tail)
-		pquad->seglist_tail = pseg;
-	    free (tmpseg);
-	    freed = TRUE;
+	    if (pseg->seq_lastbyte + 1 == pseg_out->seq_firstbyte) {
+		pseg_out->seq_firstbyte = pseg->seq_firstbyte;
+		pseg_out->retrans = pseg->retrans;
+
+		/* the ACK count stays that of the later segment */
+
+		/* the new "transmit time" is the greater of the two */
+		if (tv_gt (pseg->time, pseg_out->time))
+		    pseg_out->time = pseg->time;
+	    } else {
+		--pseg_out;
+		if (pseg_out != pseg)
+		    *pseg_out = *pseg;
+	    }
 	}
 
-	if (!freed)
-	    pseg = pseg->next;
-	/* else, see if the next one also can be collapsed into me */
+	/* drop the space the collapsed segments were using */
+	ix = pseg_out - SEG (pquad, 0);
+	pquad->first += ix;
+	pquad->nsegs -= ix;
     }
 
     /* see if the quadrant is now "full" */
-    if ((pquad->seglist_head->seq_lastbyte -
-	 pquad->seglist_head->seq_firstbyte + 1) == QUADSIZE) {
+    if ((SEG (pquad, 0)->seq_lastbyte -
+	 SEG (pquad, 0)->seq_firstbyte + 1) == QUADSIZE) {
 	pquad->full = TRUE;
     }
 }
 
 
-static void
-insert_seg_between (quadrant * pquad,
-		    segment * pseg_new,
-		    segment * pseg_before,
-		    segment * pseg_after)
-{
-    /* fix forward pointers */
-    pseg_new->next = pseg_after;
-    if (pseg_after != NULL) {
-	pseg_after->prev = pseg_new;
-    } else {
-	/* I'm the tail of the list */
-	pquad->seglist_tail = pseg_new;
-    }
-
-    /* fix backward pointers */
-    pseg_new->prev = pseg_before;
-    if (pseg_before != NULL) {
-	pseg_before->next = pseg_new;
-    } else {
-	/* I'm the head of the list */
-	pquad->seglist_head = pseg_new;
-    }
-}
-
-
 static enum t_ack
 rtt_ackin (tcb * ptcb,
 	   segment * pseg,
@@ -563,6 +612,7 @@ ack_in (tcb * ptcb,
     quadrant *pquad;
     quadrant *pquad_prev;
     segment *pseg;
+    u_int ix;
     Bool changed_one = FALSE;
     Bool intervening_xmits = FALSE;
     timeval last_xmit = { 0, 0 };
@@ -582,7 +632,8 @@ ack_in (tcb * ptcb,
     /* check each segment in the segment list for the PREVIOUS quadrant */
     pquad = whichquad (ptcb->ss, ack);
     pquad_prev = pquad->prev;
-    for (pseg = pquad_prev->seglist_head; pseg != NULL; pseg = pseg->next) {
+    for (ix = 0; ix < pquad_prev->nsegs; ++ix) {
+	pseg = SEG (pquad_prev, ix);
 	if (!pseg->acked) {
 	    ++pseg->acked;
 	    changed_one = TRUE;
@@ -598,7 +649,8 @@ ack_in (tcb * ptcb,
 
     /* check each segment in the segment list for the CURRENT quadrant */
     changed_one = FALSE;
-    for (pseg = pquad->seglist_head; pseg != NULL; pseg = pseg->next) {
+    for (ix = 0; ix < pquad->nsegs; ++ix) {
+	pseg = SEG (pquad, ix);
 	if (ack <= pseg->seq_firstbyte) {
 	    /* doesn't cover anything else on the list */
 	    break;
@@ -686,18 +738,9 @@ ack_in (tcb * ptcb,
 void
 freequad (quadrant ** ppquad)
 {
-    segment *pseg;
-    segment *pseg_next;
-
-    pseg = (*ppquad)->seglist_head;
-    while (pseg && pseg->next) {
-	pseg_next = pseg->next;
-	free (pseg);
-	pseg = pseg_next;
-    }
-    if (pseg)
-	free (pseg);
-    free (*ppquad);
+    if ((*ppquad)->segs)
+	free ((*ppquad)->segs);
+    FreeQuadrant (*ppquad);
     *ppquad = NULL;
 }
 
@@ -709,12 +752,12 @@ dump_rtt_sample (tcb * ptcb,
 		 double etime_rtt)
 {
     /* if the FILE is "-1", couldn't open file */
-    if (ptcb->rtt_dump_file == (MFILE *) - 1) {
+    if (ptcb->pgraphs->rtt_dump_file == (MFILE *) - 1) {
 	return;
     }
 
     /* if the FILE is NULL, open file */
-    if (ptcb->rtt_dump_file == (MFILE *) NULL) {
+    if (ptcb->pgraphs->rtt_dump_file == (MFILE *) NULL) {
 	MFILE *f;
 	static char filename[15];
 
@@ -724,16 +767,16 @@ dump_rtt_sample (tcb * ptcb,
 
 	if ((f = Mfopen (filename, "w")) == NULL) {
 	    perror (filename);
-	    ptcb->rtt_dump_file = (MFILE *) - 1;
+	    ptcb->pgraphs->rtt_dump_file = (MFILE *) - 1;
 	}
 
 	if (debug)
 	    fprintf (stderr, "RTT Sample file is '%s'\n", filename);
 
-	ptcb->rtt_dump_file = f;
+	ptcb->pgraphs->rtt_dump_file = f;
     }
 
-    Mfprintf (ptcb->rtt_dump_file, "%lu %lu\n",
+    Mfprintf (ptcb->pgraphs->rtt_dump_file, "%lu %lu\n",
 	      pseg->seq_firstbyte,
 	      (int) (etime_rtt / 1000) /* convert from us to ms */ );
 }
@@ -749,7 +792,7 @@ graph_rtt_sample (tcb * ptcb,
     char title[210];
 
     /* if the FILE is NULL, open file */
-    if (ptcb->rtt_plotter == NO_PLOTTER) {
+    if (ptcb->pgraphs->rtt_plotter == NO_PLOTTER) {
 	char *name_from, *name_to;
 	if (ptcb == &ptcb->ptp->a2b) {
 	    name_from = ptcb->ptp->a_endpoint;
@@ -760,29 +803,35 @@ graph_rtt_sample (tcb * ptcb,
 	}
 	snprintf (title, sizeof (title), "%s_==>_%s (rtt samples)",
 		  name_from, name_to);
-	ptcb->rtt_plotter =
+	ptcb->pgraphs->rtt_plotter =
 	    new_plotter (ptcb, NULL, title, "time", "rtt (ms)",
 			 RTT_GRAPH_FILE_EXTENSION);
-	plotter_perm_color (ptcb->rtt_plotter, "red");
+	plotter_perm_color (ptcb->pgraphs->rtt_plotter, "red");
 
 	if (graph_time_zero) {
 	    /* set graph zero points */
-	    plotter_nothing (ptcb->rtt_plotter, current_time);
+	    plotter_nothing (ptcb->pgraphs->rtt_plotter, current_time);
 	}
-	ptcb->rtt_line = new_line (ptcb->rtt_plotter, "rtt", "red");
+	ptcb->pgraphs->rtt_line =
+	    new_line (ptcb->pgraphs->rtt_plotter, "rtt", "red");
     }
 
     if (etime_rtt <= 1)
 	return;
 
-    extend_line (ptcb->rtt_line, current_time, (int) (etime_rtt / 1000));
+    extend_line (ptcb->pgraphs->rtt_line, current_time,
+		 (int) (etime_rtt / 1000));
 }
 
 Bool IsRTO(tcb *ptcb, seqnum s) {
   quadrant *pquad = whichquad(ptcb->ss,s);
   segment *pseg;
+  u_int ix;
 
-  for (pseg = pquad->seglist_head; pseg != NULL; pseg = pseg->next) {
+  /* the segment ending just before s, if there is one */
+  ix = find_seg(pquad, s-1);
+  if (ix < pquad->nsegs) {
+    pseg = SEG(pquad, ix);
     if (s == (pseg->seq_lastbyte+1)) {
       if (pseg->acked < 4) return TRUE;
       else return FALSE;
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 1994, 1995, 1996, 1997, 1998, 1999, 2000, 2001,
+ *               2002, 2003, 2004
+ *      Ohio University.
+ *
+ * ---
+ *
+ * Starting with the release of tcptrace version 6 in 2001, tcptrace
+ * is licensed under the GNU General Public License (GPL).  We believe
+ * that, among the available licenses, the GPL will do the best job of
+ * allowing tcptrace to continue to be a valuable, freely-available
+ * and well-maintained tool for the networking community.
+ *
+ * Previous versions of tcptrace were released under a license that
+ * was much less restrictive with respect to how tcptrace could be
+ * used in commercial products.  Because of this, I am willing to
+ * consider alternate license arrangements as allowed in Section 10 of
+ * the GNU GPL.  Before I would consider licensing tcptrace under an
+ * alternate agreement with a particular individual or company,
+ * however, I would have to be convinced that such an alternative
+ * would be to the greater benefit of the networking community.
+ * 
+ * ---
+ *
+ * This file is part of Tcptrace.
+ *
+ * Tcptrace was originally written and continues to be maintained by
+ * Shawn Ostermann with the help of a group of devoted students and
+ * users (see the file 'THANKS').  The work on tcptrace has been made
+ * possible over the years through the generous support of NASA GRC,
+ * the National Science Foundation, and Sun Microsystems.
+ *
+ * Tcptrace is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tcptrace is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tcptrace (in the file 'COPYING'); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ * Author:      Shawn Ostermann
+ *              School of Electrical Engineering and Computer Science
+ *              Ohio University
+ *              Athens, OH
+ *              http://www.tcptrace.org/
+ */
+#include "tcptrace.h"
+static char const GCC_UNUSED copyright[] =
+    "@(#)Copyright (c) 2004 -- Ohio University.\n";
+static char const GCC_UNUSED rcsid[] =
+    "@(#)$Header$";
+
+
+
+
+
+/*
+ * svout.c -- buffered writer for the --csv/--tsv/--sv long output
+ *
+ * With one row of ~150 fields per connection, the separated-values
+ * output for a big trace is millions of little printf()s.  Instead,
+ * each field is formatted by hand straight into a large buffer, which
+ * goes out with a single write() whenever it fills (and at the end).
+ * When connections are reported as they're retired (--stream), each
+ * row is flushed as soon as it's done instead.  Either way, SVFlush()
+ * must be called before anything else goes to stdout through stdio.
+ *
+ * The fields come out exactly as "%15s" of the value printf() would
+ * have made.  Fixed-point doubles that land too close to a rounding
+ * boundary for us to be sure (or that are negative or huge) are just
+ * handed to snprintf(), which doesn't happen often.
+ */
+
+#include <errno.h>
+
+#define SV_BUF_SIZE	(256*1024)	/* bytes per write() */
+#define SV_FIELD_WIDTH	15		/* fields are right-justified */
+#define SV_MAX_PREC	6		/* most fraction digits done by hand */
+#define SV_VAL_SIZE	20		/* output.c's value buffers */
+
+static char *svbuf = NULL;
+static int svlen = 0;
+
+static u_llong sv_pow10[SV_MAX_PREC+1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000
+};
+
+
+/* local routines */
+static void SVPut(char *str, int len);
+static void SVPadded(char *str, int len);
+static int FormatU(char *bufend, u_llong val);
+
+
+
+void
+SVFlush(void)
+{
+    char *pch = svbuf;
+    int ret;
+
+    /* anything already queued through stdio goes first */
+    fflush(stdout);
+
+    while (svlen > 0) {
+	ret = write(fileno(stdout), pch, svlen);
+	if (ret < 0) {
+	    if (errno == EINTR)
+		continue;
+	    perror("write");
+	    exit(-1);
+	}
+	pch += ret;
+	svlen -= ret;
+    }
+}
+
+
+static void
+SVPut(
+    char *str,
+    int len)
+{
+    if (svbuf == NULL)
+	svbuf = MallocZ(SV_BUF_SIZE);
+
+    if (svlen + len > SV_BUF_SIZE) {
+	SVFlush();
+	if (len > SV_BUF_SIZE) {
+	    /* (can't happen with anything we print) */
+	    fflush(stdout);
+	    fwrite(str, 1, len, stdout);
+	    fflush(stdout);
+	    return;
+	}
+    }
+
+    memcpy(svbuf+svlen, str, len);
+    svlen += len;
+}
+
+
+/* digits of val, written backwards ending just before bufend */
+static int
+FormatU(
+    char *bufend,
+    u_llong val)
+{
+    char *pch = bufend;
+
+    do {
+	*--pch = '0' + (val % 10);
+	val /= 10;
+    } while (val != 0);
+
+    return(bufend - pch);
+}
+
+
+/* a field: right-justified, then the separator */
+static void
+SVPadded(
+    char *str,
+    int len)
+{
+    static char spaces[SV_FIELD_WIDTH+1] = "               ";
+
+    if (len < SV_FIELD_WIDTH)
+	SVPut(spaces, SV_FIELD_WIDTH - len);
+    SVPut(str, len);
+    SVPut(sp, strlen(sp));
+}
+
+
+void
+SVRaw(
+    char *str)
+{
+    SVPut(str, strlen(str));
+}
+
+
+void
+SVRawU(
+    u_llong val)
+{
+    char buf[24];
+    int len;
+
+    len = FormatU(buf+sizeof(buf), val);
+    SVPut(buf+sizeof(buf)-len, len);
+}
+
+
+void
+SVField(
+    char *str)
+{
+    SVPadded(str, strlen(str));
+}
+
+
+void
+SVFieldU(
+    u_llong val)
+{
+    char buf[24];
+    int len;
+
+    len = FormatU(buf+sizeof(buf), val);
+    SVPadded(buf+sizeof(buf)-len, len);
+}
+
+
+/* like printf("%.*f"), for finite val */
+void
+SVFieldF(
+    double val,
+    int prec)
+{
+    char buf[48];
+    char *pch = buf+sizeof(buf);
+    double scaled;
+    double frac;
+    u_llong whole;
+    u_llong rounded;
+
+    /* only the easy (and usual) cases here: non-negative, not so */
+    /* big that the scaling loses precision, and not nearly halfway */
+    /* between two answers */
+    if ((prec >= 0) && (prec <= SV_MAX_PREC) &&
+	((val > 0.0) || ((val == 0.0) && !signbit(val)))) {
+	scaled = val * (double)sv_pow10[prec];
+	if (scaled < 1e12) {
+	    whole = (u_llong)scaled;
+	    frac = scaled - (double)whole;
+	    if ((frac < 0.499) || (frac > 0.501)) {
+		rounded = whole + ((frac > 0.5)?1:0);
+		if (prec > 0) {
+		    int i;
+		    u_llong fraction = rounded % sv_pow10[prec];
+		    for (i = 0; i < prec; ++i) {
+			*--pch = '0' + (fraction % 10);
+			fraction /= 10;
+		    }
+		    *--pch = '.';
+		}
+		pch -= FormatU(pch, rounded / sv_pow10[prec]);
+		SVPadded(pch, buf+sizeof(buf)-pch);
+		return;
+	    }
+	}
+    }
+
+    /* (cut short just like the StatLine routines' buffers would) */
+    snprintf(buf, SV_VAL_SIZE, "%.*f", prec, val);
+    SVPadded(buf, strlen(buf));
+}
+
+
+void
+SVEndRow(void)
+{
+    SVPut("\n", 1);
+}
@@ -80,15 +80,49 @@ static struct ether_header eth_header;
 #define EH_SIZE sizeof(struct ether_header)
 static char *ip_buf;  /* [IP_MAXPACKET] */
 static struct pcap_pkthdr *callback_phdr;
+static struct ether_header *callback_phys;
+static struct ip *callback_pip;
 static void *callback_plast;
 
+/* Whenever we can, we hand out pointers straight into pcap's own */
+/* buffer rather than copying every packet into ip_buf.  That's fine */
+/* because pcap doesn't touch the buffer again until the next read. */
+/* The IP header needs to be aligned, though, which it usually isn't */
+/* (14 bytes of ethernet header...), so on machines that can't do */
+/* unaligned loads we still have to copy those. */
+#if defined(__i386__) || defined(__x86_64__) || defined(__amd64__)
+#define IP_ALIGN_MASK	0x0	/* hardware doesn't care */
+#else
+#define IP_ALIGN_MASK	0x3	/* 32 bit fields in the headers */
+#endif /* __i386__ etc */
 
-static int callback(
-    char *user,
-    struct pcap_pkthdr *phdr,
-    char *buf)
+
+/* point at the IP packet at "buf+offset", copying only if we must */
+static void
+SetIPPointer(
+    char *buf,
+    int offset,
+    int iplen)
+{
+    char *pip = buf + offset;
+
+    if (((u_long)pip & IP_ALIGN_MASK) != 0) {
+	memcpy(ip_buf, pip, iplen-offset);
+	pip = ip_buf;
+    }
+
+    callback_pip = (struct ip *) pip;
+    callback_plast = pip+iplen-offset-1;
+}
+
+
+/* find the IP packet in a frame of link type "type" */
+static int
+DecodeLink(
+    int type,
+    char *buf,
+    int caplen)
 {
-    int type;
     int iplen;
     static int offset = -1;
   
@@ -97,16 +131,17 @@ static int callback(
       tt_uint16 vlan_proto;
     } *vlanhptr;
   
-    iplen = phdr->caplen;
+    /* nothing to return unless we get all the way thru */
+    callback_pip = NULL;
+
+    iplen = caplen;
     if (iplen > IP_MAXPACKET)
 	iplen = IP_MAXPACKET;
     if (iplen < sizeof(struct ether_header) + sizeof(struct ip))
       return(-1);
 
-    type = pcap_datalink(pcap);
-
-    /* remember the stuff we always save */
-    callback_phdr = phdr;
+    /* unless we need to fake one up, the ether header is in the buffer */
+    callback_phys = (struct ether_header *) buf;
 
     /* kindof ugly, but about the only way to make them fit together :-( */
     switch (type) {
@@ -115,36 +150,33 @@ static int callback(
 	/* this.  It looks just like ethernet to me */
       case PCAP_DLT_EN10MB:
 	offset = find_ip_eth(buf); /* Here we check if we are dealing with Straight Ethernet encapsulation or PPPoE */
-	memcpy(&eth_header, buf, EH_SIZE); /* save ether header */
 	switch (offset)
 	{
 		case EH_SIZE: /* straight Ethernet encapsulation */
-			memcpy((char *)ip_buf,buf+offset,iplen-offset);
-			callback_plast = ip_buf+iplen-offset-1;
 			break;
 		case PPPOE_SIZE: /* PPPoE encapsulation */
 			/* we use a fake ether type here */
+			memcpy(&eth_header, buf, EH_SIZE);
 			eth_header.ether_type = htons(ETHERTYPE_IP);
-			memcpy((char *)ip_buf,buf+offset,iplen-offset);
-			callback_plast = ip_buf+iplen-offset-1;
+			callback_phys = &eth_header;
 			break;
 	        case -1: /* Not an IP packet */
 	                 /* Let's check if it is a VLAN header that
 			  * caused us to receive -1, and if we had an IP
 			  * packet buried inside */
-	                if (eth_header.ether_type == htons(ETHERTYPE_VLAN)) {
+	                if (callback_phys->ether_type == htons(ETHERTYPE_VLAN)) {
 			  vlanhptr=(struct vlanh*) (buf+EH_SIZE);
 			  if ( (ntohs(vlanhptr->vlan_proto) == ETHERTYPE_IP) ||
 			       (ntohs(vlanhptr->vlan_proto) == ETHERTYPE_IPV6)
 			     ) {
 			    offset=EH_SIZE+sizeof(struct vlanh);
-			    memcpy((char *)ip_buf,buf+offset,iplen-offset);
-			    callback_plast = ip_buf+iplen-offset-1;
 			    /* Set ethernet type as whatever followed the dumb
 			     * VLAN header to prevent the rest of the code
 			     * from ignoring us.
 			     */
+			    memcpy(&eth_header, buf, EH_SIZE);
 			    eth_header.ether_type=vlanhptr->vlan_proto;
+			    callback_phys = &eth_header;
 			    break;
 			    }
 			}	  
@@ -156,86 +188,109 @@ static int callback(
       case PCAP_DLT_IEEE802:
 	/* just pretend it's "normal" ethernet */
 	offset = 14;		/* 22 bytes of IEEE cruft */
-	memcpy(&eth_header,buf,EH_SIZE);  /* save ether header */
-	memcpy(ip_buf,buf+offset,iplen-offset);
-	callback_plast = (char *)ip_buf+iplen-offset-1;
 	break;
       case PCAP_DLT_SLIP:
-	memcpy(ip_buf,buf+16,iplen-16);
-	callback_plast = (char *)ip_buf+iplen-16-1;
+	offset = 16;
+	callback_phys = &eth_header;
 	break;
       case PCAP_DLT_PPP:
 	/* deals with raw PPP and also with HDLC PPP frames */
 	offset = find_ip_ppp(buf);
 	if (offset < 0) /* Not an IP packet */
 		return (-1);
-	memcpy((char *)ip_buf,buf+offset,iplen-offset);
-	callback_plast = ip_buf+iplen-offset-1;
+	callback_phys = &eth_header;
 	break;
       case PCAP_DLT_FDDI:
 	if (offset < 0)
 	      offset = find_ip_fddi(buf,iplen);
 	if (offset < 0)
 	      return(-1);
-	memcpy((char *)ip_buf,buf+offset,iplen-offset);
-	callback_plast = ip_buf+iplen-offset-1;
+	callback_phys = &eth_header;
 	break;
       case PCAP_DLT_NULL:
 	/* no phys header attached */
 	offset = 4;
-	memcpy((char *)ip_buf,buf+offset,iplen-offset);
-	callback_plast = ip_buf+iplen-offset-1;
+	callback_phys = &eth_header;
 	break;
       case PCAP_DLT_ATM_RFC1483:
 	/* ATM RFC1483 - LLC/SNAP ecapsulated atm */
-	memcpy((char*)ip_buf,buf+8,iplen-8);
-	callback_plast = ip_buf+iplen-8-1;
+	offset = 8;
+	callback_phys = &eth_header;
 	break;
       case PCAP_DLT_RAW:
 	/* raw IP */
 	offset = 0;
-	memcpy((char *)ip_buf,buf+offset,iplen-offset);
-	callback_plast = ip_buf+iplen-offset-1;
+	callback_phys = &eth_header;
 	break;
       case PCAP_DLT_LINUX_SLL:
 	/* linux cooked socket */
 	offset = 16;
-	memcpy((char *)ip_buf, buf+offset, iplen-offset);
-	callback_plast = ip_buf+iplen-offset-1;
+	callback_phys = &eth_header;
 	break;
       // Patch sent by Brandon Eisenamann to passby 802.11, LLC/SNAP
       // and Prism2 headers to get to the IP packet.
       case PCAP_DLT_IEEE802_11:
 	offset=24+8;// 802.11 header + LLC/SNAP header
-	memcpy((char *)ip_buf, buf+offset, iplen-offset);
-	callback_plast = ip_buf+iplen-offset-1;
+	callback_phys = &eth_header;
 	break;
       case PCAP_DLT_IEEE802_11_RADIO:
 	offset=64+24;//WLAN header + 802.11 header
 	memcpy(&eth_header,buf,EH_SIZE); // save ethernet header
-	memcpy((char *)ip_buf, buf+offset, iplen-offset);
-	callback_plast = ip_buf+iplen-offset-1;
+	callback_phys = &eth_header;
 	break;
       case PCAP_DLT_PRISM2:
 	offset=144+24+8; // PRISM2+IEEE 802.11+ LLC/SNAP headers
-	memcpy((char *)ip_buf, buf+offset, iplen-offset);
-	callback_plast = ip_buf+iplen-offset-1;
+	callback_phys = &eth_header;
 	break;
       case PCAP_DLT_C_HDLC:
 	offset=4;
-	memcpy((char *)ip_buf, buf+offset, iplen-offset);
-	callback_plast = (char *)ip_buf+iplen-offset-1;
+	callback_phys = &eth_header;
 	break;
       default:
 	fprintf(stderr,"Don't understand link-level format (%d)\n", type);
 
 	exit(1);
     }
+
+    SetIPPointer(buf, offset, iplen);
     
     return(0);
 }
 
 
+static int callback(
+    char *user,
+    struct pcap_pkthdr *phdr,
+    char *buf)
+{
+    /* remember the stuff we always save */
+    callback_phdr = phdr;
+
+    return(DecodeLink(pcap_datalink(pcap), buf, phdr->caplen));
+}
+
+
+/* at least one tcpdump implementation (AIX) seems to be */
+/* storing NANOseconds in the usecs field of the timestamp. */
+/* This confuses EVERYTHING.  Try to compensate. */
+static void
+FixBogusNanoseconds(
+    struct timeval *ptime)
+{
+    static Bool bogus_nanoseconds = FALSE;
+
+    if ((ptime->tv_usec >= US_PER_SEC) ||
+	(bogus_nanoseconds)) {
+	if (!bogus_nanoseconds) {
+	    fprintf(stderr,
+		    "tcpdump: attempting to adapt to bogus nanosecond timestamps\n");
+	    bogus_nanoseconds = TRUE;
+	}
+	ptime->tv_usec /= 1000;
+    }
+}
+
+
 /* currently only works for ETHERNET and FDDI */
 static int
 pread_tcpdump(
@@ -265,36 +320,28 @@ pread_tcpdump(
 	    return(0);
 	}
 
-	/* at least one tcpdump implementation (AIX) seems to be */
-	/* storing NANOseconds in the usecs field of the timestamp. */
-	/* This confuses EVERYTHING.  Try to compensate. */
-	{
-	    static Bool bogus_nanoseconds = FALSE;
-	    if ((callback_phdr->ts.tv_usec >= US_PER_SEC) ||
-		(bogus_nanoseconds)) {
-		if (!bogus_nanoseconds) {
-		    fprintf(stderr,
-			    "tcpdump: attempting to adapt to bogus nanosecond timestamps\n");
-		    bogus_nanoseconds = TRUE;
-		}
-		callback_phdr->ts.tv_usec /= 1000;
-	    }
+	/* if the callback didn't like it, then skip it */
+	if (callback_pip == NULL) {
+	    if (debug > 2)
+		fprintf(stderr,"pread_tcpdump: skipping unusable packet\n");
+	    continue;
 	}
 
 	/* fill in all of the return values */
-	*pphys     = &eth_header;/* everything assumed to be ethernet */
+	*pphys     = callback_phys;/* everything assumed to be ethernet */
 	*pphystype = PHYS_ETHER; /* everything assumed to be ethernet */
-	*ppip      = (struct ip *) ip_buf;
+	*ppip      = callback_pip;
 	*pplast    = callback_plast; /* last byte in IP packet */
 	/* (copying time structure in 2 steps to avoid RedHat brain damage) */
 	ptime->tv_usec = callback_phdr->ts.tv_usec;
 	ptime->tv_sec = callback_phdr->ts.tv_sec;
+	FixBogusNanoseconds(ptime);
 	*plen      = callback_phdr->len;
 	*ptlen     = callback_phdr->caplen;
 
 	/* if it's not IP, then skip it */
-	if ((ntohs(eth_header.ether_type) != ETHERTYPE_IP) &&
-	    (ntohs(eth_header.ether_type) != ETHERTYPE_IPV6)) {
+	if ((ntohs(callback_phys->ether_type) != ETHERTYPE_IP) &&
+	    (ntohs(callback_phys->ether_type) != ETHERTYPE_IPV6)) {
 	    if (debug > 2)
 		fprintf(stderr,"pread_tcpdump: not an IP packet\n");
 	    continue;
@@ -305,38 +352,17 @@ pread_tcpdump(
 }
 
 
-pread_f *is_tcpdump(char *filename)
+/* set up the fake ether header for link type "type", returns the */
+/* name of the link type (or NULL if we don't understand it) */
+static char *
+SetupLinkType(
+    int type)
 {
-    char errbuf[100];
-    char *physname = "<unknown>";
-    int type;
+    char *physname;
 
-#ifdef __WIN32   
-      if ((pcap = pcap_open_offline(filename, errbuf)) == NULL) {
-#else       
-      if ((pcap = pcap_open_offline("-", errbuf)) == NULL) {
-#endif /* __WIN32 */	  
-	if (debug > 2)
-	    fprintf(stderr,"PCAP said: '%s'\n", errbuf);
-	rewind(stdin);
-	return(NULL);
-    }
-
-
-    if (debug) {
-	printf("Using 'pcap' version of tcpdump\n");
-	if (debug > 1) {
-	    printf("\tversion_major: %d\n", pcap_major_version(pcap));
-	    printf("\tversion_minor: %d\n", pcap_minor_version(pcap));
-	    printf("\tsnaplen: %d\n", pcap_snapshot(pcap));
-	    printf("\tlinktype: %d\n", pcap_datalink(pcap));
-	    printf("\tswapped: %d\n", pcap_is_swapped(pcap));
-	}
-    }
-
-    /* check the phys type (pretend everything is ethernet) */
+    /* pretend everything is ethernet */
     memset(&eth_header,0,EH_SIZE);
-    switch (type = pcap_datalink(pcap)) {
+    switch (type) {
       case 100:
       case PCAP_DLT_EN10MB:
 	/* OK, we understand this one */
@@ -392,6 +418,44 @@ pread_f *is_tcpdump(char *filename)
 	physname = "Cisco HDLC";
 	break;
       default:
+	return(NULL);
+    }
+
+    return(physname);
+}
+
+
+pread_f *is_tcpdump(char *filename)
+{
+    char errbuf[100];
+    char *physname;
+    int type;
+
+#ifdef __WIN32   
+      if ((pcap = pcap_open_offline(filename, errbuf)) == NULL) {
+#else       
+      if ((pcap = pcap_open_offline("-", errbuf)) == NULL) {
+#endif /* __WIN32 */	  
+	if (debug > 2)
+	    fprintf(stderr,"PCAP said: '%s'\n", errbuf);
+	rewind(stdin);
+	return(NULL);
+    }
+
+
+    if (debug) {
+	printf("Using 'pcap' version of tcpdump\n");
+	if (debug > 1) {
+	    printf("\tversion_major: %d\n", pcap_major_version(pcap));
+	    printf("\tversion_minor: %d\n", pcap_minor_version(pcap));
+	    printf("\tsnaplen: %d\n", pcap_snapshot(pcap));
+	    printf("\tlinktype: %d\n", pcap_datalink(pcap));
+	    printf("\tswapped: %d\n", pcap_is_swapped(pcap));
+	}
+    }
+
+    /* check the phys type (pretend everything is ethernet) */
+    if ((physname = SetupLinkType(type = pcap_datalink(pcap))) == NULL) {
         fprintf(stderr,"tcptrace did not understand link format (%d)!\n",type);
         fprintf(stderr,
 		"\t If you can give us a capture file with this link format\n\
@@ -413,6 +477,550 @@ pread_f *is_tcpdump(char *filename)
 }
 
 
+/*
+ * Reading pcap and pcapng files directly
+ *
+ * When the input is a plain (uncompressed) file, we don't need stdio,
+ * the compression pipes, or libpcap at all.  We just map the whole file
+ * and walk the records in place, handing out pointers right into the
+ * mapping (see SetIPPointer()).  The kernel is told that we're reading
+ * sequentially and is asked to fetch the next chunk ahead of us; the
+ * part we've already finished with is dropped so that huge files don't
+ * fill up memory.  This also handles a few things that the old pcap
+ * libraries can't: nanosecond timestamps and pcapng files, where every
+ * interface can have its own link type and timestamp resolution.
+ */
+#if defined(HAVE_LONG_LONG) && !defined(__WIN32) && !defined(__VMS)
+#define MMAP_PCAP
+#endif /* HAVE_LONG_LONG etc */
+
+#ifdef MMAP_PCAP
+
+#include <sys/mman.h>
+#include <fcntl.h>
+
+/* pcap magic numbers */
+#define PCAP_MAGIC_USEC		0xa1b2c3d4
+#define PCAP_MAGIC_NSEC		0xa1b23c4d
+
+/* pcapng block types */
+#define PCAPNG_SHB		0x0a0d0d0a	/* section header */
+#define PCAPNG_IDB		0x00000001	/* interface description */
+#define PCAPNG_PB		0x00000002	/* packet (obsolete) */
+#define PCAPNG_SPB		0x00000003	/* simple packet */
+#define PCAPNG_EPB		0x00000006	/* enhanced packet */
+#define PCAPNG_BYTE_ORDER	0x1a2b3c4d
+
+/* pcapng interface options that we care about */
+#define PCAPNG_OPT_END		0
+#define PCAPNG_OPT_TSRESOL	9
+#define PCAPNG_OPT_TSOFFSET	14
+
+/* how far ahead we ask the kernel to read */
+#define MMAP_READAHEAD		(16*1024*1024)
+#define MMAP_ADVISE_STEP	(4*1024*1024)
+
+/* one pcapng interface */
+struct mmap_iface {
+    int		linktype;
+    Bool	usable;		/* we understand the link type */
+    u_llong	units;		/* timestamp units per second */
+    llong	tsoffset;	/* seconds to add to timestamps */
+};
+
+static char	*mmap_base = NULL;	/* the whole file */
+static u_long	mmap_size = 0;
+static u_long	mmap_pos = 0;		/* next record */
+static u_long	mmap_rec_pos = 0;	/* record we last returned */
+static u_long	mmap_stop = ~0UL;	/* no records after this one */
+static u_long	mmap_advised = 0;	/* read ahead thru here */
+static Bool	mmap_swapped;		/* file byte order != ours */
+static Bool	mmap_ng;		/* pcapng rather than pcap */
+static int	mmap_linktype;		/* pcap only */
+static Bool	mmap_nsecs;		/* pcap only */
+static struct mmap_iface *mmap_ifaces = NULL;	/* pcapng only */
+static int	mmap_nifaces = 0;
+static int	mmap_max_ifaces = 0;
+static struct timeval mmap_last_time;	/* for pcapng simple packets */
+
+
+/* get 16 and 32 bit values out of the file (which needn't be aligned) */
+static u_int
+MmapGet32(
+    char *p)
+{
+    u_int val;
+
+    memcpy(&val, p, sizeof(val));
+    return(mmap_swapped?SWAPLONG(val):val);
+}
+
+static u_short
+MmapGet16(
+    char *p)
+{
+    u_short val;
+
+    memcpy(&val, p, sizeof(val));
+    return(mmap_swapped?SWAPSHORT(val):val);
+}
+
+
+static void
+MmapUnmap(void)
+{
+    if (mmap_base) {
+	munmap(mmap_base, mmap_size);
+	mmap_base = NULL;
+    }
+    mmap_size = mmap_pos = mmap_rec_pos = mmap_advised = 0;
+    mmap_stop = ~0UL;
+}
+
+
+/* keep the kernel reading ahead of us, and drop what we're done with */
+static void
+MmapAdvise(void)
+{
+    u_long pagesize = getpagesize();
+    u_long start, len;
+
+    if (mmap_pos + MMAP_READAHEAD - MMAP_ADVISE_STEP < mmap_advised)
+	return;
+
+    /* forget everything more than one step behind us */
+    start = (mmap_advised > MMAP_READAHEAD + MMAP_ADVISE_STEP)?
+	mmap_advised - MMAP_READAHEAD - MMAP_ADVISE_STEP : 0;
+    start &= ~(pagesize-1);
+    len = (mmap_pos > MMAP_ADVISE_STEP)?mmap_pos - MMAP_ADVISE_STEP:0;
+    len &= ~(pagesize-1);
+    if (len > start)
+	madvise(mmap_base + start, len - start, MADV_DONTNEED);
+
+    /* and ask for the next chunk */
+    start = mmap_advised & ~(pagesize-1);
+    if (start < mmap_size) {
+	len = MMAP_READAHEAD;
+	if (start + len > mmap_size)
+	    len = mmap_size - start;
+	madvise(mmap_base + start, len, MADV_WILLNEED);
+    }
+    mmap_advised = start + MMAP_READAHEAD;
+}
+
+
+/* convert a pcapng timestamp for interface "pif" */
+static void
+MmapNgTime(
+    struct mmap_iface *pif,
+    u_llong ts,
+    struct timeval *ptime)
+{
+    u_llong frac = ts % pif->units;
+
+    ptime->tv_sec = ts / pif->units + pif->tsoffset;
+    if (pif->units == US_PER_SEC)
+	ptime->tv_usec = frac;
+    else if ((pif->units % US_PER_SEC) == 0)
+	ptime->tv_usec = frac / (pif->units / US_PER_SEC);
+    else
+	ptime->tv_usec = (u_long)((double)frac * US_PER_SEC / pif->units);
+}
+
+
+/* remember a new pcapng interface */
+static void
+MmapNgInterface(
+    char *pblock,
+    u_int blen)
+{
+    struct mmap_iface *pif;
+    char *popt;
+    char *pend = pblock + blen - 4;
+
+    if (mmap_nifaces == mmap_max_ifaces) {
+	mmap_max_ifaces = mmap_max_ifaces?mmap_max_ifaces*2:4;
+	mmap_ifaces = ReallocZ(mmap_ifaces,
+			       mmap_nifaces * sizeof(struct mmap_iface),
+			       mmap_max_ifaces * sizeof(struct mmap_iface));
+    }
+    pif = &mmap_ifaces[mmap_nifaces++];
+    pif->linktype = MmapGet16(pblock+8);
+    pif->units = US_PER_SEC;
+    pif->tsoffset = 0;
+
+    /* walk the options */
+    for (popt = pblock+16; popt + 4 <= pend; ) {
+	u_short code = MmapGet16(popt);
+	u_short olen = MmapGet16(popt+2);
+
+	if ((code == PCAPNG_OPT_END) || (popt + 4 + olen > pend))
+	    break;
+	if ((code == PCAPNG_OPT_TSRESOL) && (olen >= 1)) {
+	    u_char resol = popt[4];
+	    int i;
+
+	    if (resol & 0x80) {
+		/* power of 2 */
+		resol &= 0x7f;
+		pif->units = (resol < 64)?((u_llong)1 << resol):1;
+	    } else {
+		/* power of 10 */
+		pif->units = 1;
+		for (i=0; (i < resol) && (i < 19); ++i)
+		    pif->units *= 10;
+	    }
+	} else if ((code == PCAPNG_OPT_TSOFFSET) && (olen >= 8)) {
+	    u_llong offset;
+
+	    memcpy(&offset, popt+4, sizeof(offset));
+	    if (mmap_swapped)
+		offset = ((u_llong)SWAPLONG((u_int)offset) << 32) |
+		    SWAPLONG((u_int)(offset >> 32));
+	    pif->tsoffset = (llong)offset;
+	}
+	popt += 4 + ((olen + 3) & ~3);
+    }
+
+    if (debug > 1)
+	fprintf(stderr,"pcapng interface %d: linktype %d, %" FS_ULL " units/sec\n",
+		mmap_nifaces-1, pif->linktype, pif->units);
+
+    pif->usable = (SetupLinkType(pif->linktype) != NULL);
+    if (!pif->usable) {
+	fprintf(stderr,"tcptrace did not understand link format (%d) of pcapng interface %d, ignoring it\n",
+		pif->linktype, mmap_nifaces-1);
+    }
+}
+
+
+/* start a new pcapng section, returns FALSE if it doesn't look right */
+static Bool
+MmapNgSection(
+    char *pblock)
+{
+    u_int bom;
+
+    memcpy(&bom, pblock+8, sizeof(bom));
+    if (bom == PCAPNG_BYTE_ORDER)
+	mmap_swapped = FALSE;
+    else if (bom == SWAPLONG(PCAPNG_BYTE_ORDER))
+	mmap_swapped = TRUE;
+    else
+	return(FALSE);
+
+    /* interface numbers start over in every section */
+    mmap_nifaces = 0;
+
+    return(TRUE);
+}
+
+
+static int
+pread_pcap_mmap(
+    struct timeval	*ptime,
+    int		 	*plen,
+    int		 	*ptlen,
+    void		**pphys,
+    int			*pphystype,
+    struct ip		**ppip,
+    void		**pplast)
+{
+    while (1) {
+	char *prec = mmap_base + mmap_pos;
+	u_long left = mmap_size - mmap_pos;
+	char *pdata;
+	u_int caplen;
+	int linktype;
+
+	if (mmap_pos > mmap_stop) {
+	    /* the caller only wanted part of the file */
+	    MmapUnmap();
+	    return(0);
+	}
+
+	if (mmap_pos + MMAP_ADVISE_STEP >= mmap_advised)
+	    MmapAdvise();
+
+	mmap_rec_pos = mmap_pos;
+
+	if (!mmap_ng) {
+	    /* plain old pcap */
+	    /* (complain the way pread_tcpdump() does when libpcap */
+	    /* finds a file cut short) */
+	    if (left < sizeof(struct packet_header)) {
+		if (left)
+		    fprintf(stderr,"PCAP error: 'truncated'\n");
+		MmapUnmap();
+		return(0);
+	    }
+	    caplen = MmapGet32(prec+8);
+	    if (caplen > left - sizeof(struct packet_header)) {
+		fprintf(stderr,"PCAP error: 'truncated'\n");
+		MmapUnmap();
+		return(0);
+	    }
+	    ptime->tv_sec = MmapGet32(prec);
+	    ptime->tv_usec = MmapGet32(prec+4);
+	    if (mmap_nsecs)
+		ptime->tv_usec /= 1000;
+	    else
+		FixBogusNanoseconds(ptime);
+	    *plen = MmapGet32(prec+12);
+	    pdata = prec + sizeof(struct packet_header);
+	    linktype = mmap_linktype;
+	    mmap_pos += sizeof(struct packet_header) + caplen;
+	} else {
+	    /* pcapng, skip everything except packets */
+	    u_int btype, blen;
+	    struct mmap_iface *pif;
+
+	    if (left < 12) {
+		if (left)
+		    fprintf(stderr,"pcapng: truncated block at end of file\n");
+		MmapUnmap();
+		return(0);
+	    }
+	    btype = MmapGet32(prec);
+	    if (btype == PCAPNG_SHB) {
+		if (!MmapNgSection(prec)) {
+		    fprintf(stderr,"pcapng: bad section header, giving up\n");
+		    MmapUnmap();
+		    return(0);
+		}
+	    }
+	    blen = MmapGet32(prec+4);
+	    if ((blen < 12) || (blen > left) || (blen & 3)) {
+		fprintf(stderr,"pcapng: bad block length (%u), giving up\n", blen);
+		MmapUnmap();
+		return(0);
+	    }
+	    mmap_pos += blen;
+
+	    switch (btype) {
+	      case PCAPNG_IDB:
+		if (blen >= 20)
+		    MmapNgInterface(prec, blen);
+		continue;
+	      case PCAPNG_EPB:
+	      case PCAPNG_PB:
+		if (blen < 32)
+		    continue;
+		if (btype == PCAPNG_EPB)
+		    pif = (MmapGet32(prec+8) < mmap_nifaces)?
+			&mmap_ifaces[MmapGet32(prec+8)]:NULL;
+		else
+		    pif = (MmapGet16(prec+8) < mmap_nifaces)?
+			&mmap_ifaces[MmapGet16(prec+8)]:NULL;
+		if (pif == NULL)
+		    continue;
+		MmapNgTime(pif,
+			   ((u_llong)MmapGet32(prec+12) << 32) | MmapGet32(prec+16),
+			   ptime);
+		caplen = MmapGet32(prec+20);
+		*plen = MmapGet32(prec+24);
+		pdata = prec + 28;
+		if (caplen > blen - 32)
+		    continue;
+		break;
+	      case PCAPNG_SPB:
+		if ((blen < 16) || (mmap_nifaces == 0))
+		    continue;
+		pif = &mmap_ifaces[0];
+		/* no timestamp, the best we can do is the last one */
+		*ptime = mmap_last_time;
+		*plen = MmapGet32(prec+8);
+		caplen = blen - 16;
+		if (caplen > *plen)
+		    caplen = *plen;
+		pdata = prec + 12;
+		break;
+	      default:
+		continue;
+	    }
+	    if (!pif->usable) {
+		/* we said we'd ignore this interface */
+		if (debug > 2)
+		    fprintf(stderr,"pread_pcap_mmap: skipping packet from interface with link format %d\n",
+			    pif->linktype);
+		continue;
+	    }
+	    linktype = pif->linktype;
+	    mmap_last_time = *ptime;
+	    if (mmap_nifaces > 1)
+		SetupLinkType(linktype);
+	}
+
+	/* find the IP packet */
+	if (DecodeLink(linktype, pdata, caplen) != 0) {
+	    if (debug > 2)
+		fprintf(stderr,"pread_pcap_mmap: skipping unusable packet\n");
+	    continue;
+	}
+
+	/* if it's not IP, then skip it */
+	if ((ntohs(callback_phys->ether_type) != ETHERTYPE_IP) &&
+	    (ntohs(callback_phys->ether_type) != ETHERTYPE_IPV6)) {
+	    if (debug > 2)
+		fprintf(stderr,"pread_pcap_mmap: not an IP packet\n");
+	    continue;
+	}
+
+	*ptlen     = caplen;
+	*pphys     = callback_phys;
+	*pphystype = PHYS_ETHER;
+	*ppip      = callback_pip;
+	*pplast    = callback_plast;
+
+	return(1);
+    }
+}
+
+
+/* how far thru the mapped file we are (-1 if we're not reading one) */
+long
+PcapMmapPosition(void)
+{
+    return(mmap_base?(long)mmap_pos:-1);
+}
+
+
+/* where the packet we last returned started (-1 if we're not reading */
+/* a mapped file) */
+long
+PcapMmapPacketOffset(void)
+{
+    return(mmap_base?(long)mmap_rec_pos:-1);
+}
+
+
+/* only return the packets whose records start between "start" and */
+/* "stop", returns FALSE if we can't jump around in this file */
+Bool
+PcapMmapSeek(
+    u_long start,
+    u_long stop)
+{
+    /* pcapng interface blocks could be anywhere, we'd miss them */
+    if ((mmap_base == NULL) || mmap_ng)
+	return(FALSE);
+
+    if (start < sizeof(struct dump_file_header))
+	start = sizeof(struct dump_file_header);
+    mmap_pos = mmap_advised = start;
+    mmap_stop = stop;
+
+    if (debug)
+	fprintf(stderr,"pcap (mmap): reading records from %lu thru %lu\n",
+		start, stop);
+
+    return(TRUE);
+}
+
+
+pread_f *is_pcap_mmap(char *filename)
+{
+    struct stat str_stat;
+    u_int magic;
+    char *physname;
+    int fd;
+
+    /* forget the last file */
+    MmapUnmap();
+
+    /* only for real, uncompressed files */
+    if (FileIsStdin(filename) || CompIsCompressed())
+	return(NULL);
+
+    if ((fd = open(filename, O_RDONLY)) < 0)
+	return(NULL);
+    if ((fstat(fd, &str_stat) != 0) ||
+	(str_stat.st_size < sizeof(struct dump_file_header))) {
+	close(fd);
+	return(NULL);
+    }
+    mmap_size = str_stat.st_size;
+    mmap_base = mmap(NULL, mmap_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);		/* the mapping stays */
+    if (mmap_base == MAP_FAILED) {
+	if (debug)
+	    perror("mmap");
+	mmap_base = NULL;
+	MmapUnmap();
+	return(NULL);
+    }
+    madvise(mmap_base, mmap_size, MADV_SEQUENTIAL);
+
+    /* which kind of file is it? */
+    memcpy(&magic, mmap_base, sizeof(magic));
+    mmap_swapped = FALSE;
+    if ((magic == SWAPLONG(PCAP_MAGIC_USEC)) ||
+	(magic == SWAPLONG(PCAP_MAGIC_NSEC))) {
+	mmap_swapped = TRUE;
+	magic = SWAPLONG(magic);
+    }
+
+    if ((magic == PCAP_MAGIC_USEC) || (magic == PCAP_MAGIC_NSEC)) {
+	mmap_ng = FALSE;
+	mmap_nsecs = (magic == PCAP_MAGIC_NSEC);
+	mmap_linktype = MmapGet32(mmap_base+20);
+	mmap_pos = sizeof(struct dump_file_header);
+	if ((physname = SetupLinkType(mmap_linktype)) == NULL) {
+	    /* let the pcap library complain about it */
+	    MmapUnmap();
+	    return(NULL);
+	}
+	if (debug)
+	    fprintf(stderr,"pcap file (mmap%s), physical type is %d (%s)\n",
+		    mmap_nsecs?", nanoseconds":"", mmap_linktype, physname);
+    } else if ((magic == PCAPNG_SHB) && (mmap_size >= 28) &&
+	       MmapNgSection(mmap_base)) {
+	mmap_ng = TRUE;
+	mmap_pos = 0;
+	if (debug)
+	    fprintf(stderr,"pcapng file (mmap)\n");
+    } else {
+	MmapUnmap();
+	return(NULL);
+    }
+
+    if (ip_buf == NULL)
+	ip_buf = MallocZ(IP_MAXPACKET);
+
+    return(pread_pcap_mmap);
+}
+
+#else /* MMAP_PCAP */
+
+long
+PcapMmapPosition(void)
+{
+    return(-1);
+}
+
+long
+PcapMmapPacketOffset(void)
+{
+    return(-1);
+}
+
+Bool
+PcapMmapSeek(
+    u_long start,
+    u_long stop)
+{
+    return(FALSE);
+}
+
+pread_f *is_pcap_mmap(char *filename)
+{
+    return(NULL);
+}
+
+#endif /* MMAP_PCAP */
+
+
+
 /* support for writing a new pcap file */
 
 void
@@ -422,6 +1030,8 @@ PcapSavePacket(
     void *plast)
 {
     static MFILE *f_savefile = NULL;
+    struct ether_header save_eth_header;	/* (not eth_header, which the */
+					/* --readahead reader is filling in) */
     struct pcap_pkthdr phdr;
     int wlen;
 
@@ -464,9 +1074,9 @@ PcapSavePacket(
     Mfwrite(&phdr, sizeof(phdr), 1, f_savefile);
 
     /* write a (bogus) ethernet header */
-    memset(&eth_header,0,EH_SIZE);
-    eth_header.ether_type = htons(ETHERTYPE_IP);
-    Mfwrite(&eth_header, sizeof(eth_header), 1, f_savefile);
+    memset(&save_eth_header,0,EH_SIZE);
+    save_eth_header.ether_type = htons(ETHERTYPE_IP);
+    Mfwrite(&save_eth_header, sizeof(save_eth_header), 1, f_savefile);
 
     /* write the IP/TCP parts */
     wlen = phdr.caplen - EH_SIZE;	/* remove the ether header */
@@ -490,4 +1100,27 @@ compiled into the program (See GROK_TCPDUMP)\n");
 }
 
 
+long
+PcapMmapPosition(void)
+{
+    return(-1);
+}
+
+
+long
+PcapMmapPacketOffset(void)
+{
+    return(-1);
+}
+
+
+Bool
+PcapMmapSeek(
+    u_long start,
+    u_long stop)
+{
+    return(FALSE);
+}
+
+
 #endif /* GROK_TCPDUMP */
@@ -90,6 +90,9 @@ static int  ParseExtendedOpt(char *argsource, char *arg);
 static void ParseExtendedBool(char *argsource, char *arg);
 static void ParseExtendedVar(char *argsource, char *arg);
 static void ProcessFile(char *filename);
+static void ProcessLive(char *ifname);
+static void ProcessMerged(char **names, int count);
+static void ProcessPackets(pread_f *ppread, Bool is_stdin);
 static void QuitSig(int signum);
 static void Usage(void);
 static void BadArg(char *argsource, char *format, ...);
@@ -145,11 +148,23 @@ Bool ns_hdrs = TRUE;
 Bool dup_ack_handling = TRUE;
 Bool csv = FALSE;
 Bool tsv = FALSE;
+Bool merge_files = FALSE;
+Bool make_index = FALSE;
+Bool use_index = FALSE;
+Bool stream_output = FALSE;
+Bool reassemble_streams = FALSE;
+Bool plot_binary = FALSE;
 u_long remove_live_conn_interval = REMOVE_LIVE_CONN_INTERVAL;
 u_long nonreal_live_conn_interval = NONREAL_LIVE_CONN_INTERVAL;
 u_long remove_closed_conn_interval = REMOVE_CLOSED_CONN_INTERVAL;
+u_long remove_udp_conn_interval = REMOVE_UDP_CONN_INTERVAL;
 u_long update_interval = UPDATE_INTERVAL;
 u_long max_conn_num = MAX_CONN_NUM;
+u_long readahead_files = 0;
+u_long output_threads = 0;
+u_long stream_mem = 0;
+u_long live_ring_size = LIVE_RING_SIZE;
+u_long reasm_window = REASM_WINDOW;
 int debug = 0;
 u_long beginpnum = 0;
 u_long endpnum = 0;
@@ -165,6 +180,9 @@ char *output_file_prefix = NULL;
 char *xplot_title_prefix = NULL;
 char *xplot_args = NULL;
 char *sv = NULL;
+char *bpf_expr = NULL;
+char *live_iface = NULL;
+char *render_plots = NULL;
 /* globals */
 struct timeval current_time;
 int num_modules = 0;
@@ -174,6 +192,7 @@ char *comment;
 
 /* locally global variables */
 static u_long filesize = 0;
+static int file_count = 0;
 char **filenames = NULL;
 int num_files = 0;
 u_int numfiles;
@@ -185,6 +204,12 @@ static char *max_conn_num_st = NULL;
 static char *live_conn_interval_st = NULL;
 static char *nonreal_conn_interval_st = NULL;
 static char *closed_conn_interval_st = NULL;
+static char *udp_conn_interval_st = NULL;
+static char *readahead_files_st = NULL;
+static char *output_threads_st = NULL;
+static char *stream_mem_st = NULL;
+static char *live_ring_st = NULL;
+static char *reasm_window_st = NULL;
 
 /* for elapsed processing time */
 struct timeval wallclock_start;
@@ -253,6 +278,8 @@ static struct ext_bool_op {
      "print all packets AND dump the TCP/UDP data"},
     {"continuous", &run_continuously, TRUE,
      "run continuously and don't provide a summary"},
+    {"stream", &stream_output, TRUE,
+     "real-time mode that prints each connection as it's retired"},
     {"print_seq_zero", &print_seq_zero, TRUE,
      "print sequence numbers as offset from initial sequence number"},
     {"limit_conn_num", &conn_num_threshold, TRUE,
@@ -267,6 +294,14 @@ static struct ext_bool_op {
      "display the long output as tab separated values"},
     {"turn_off_BSD_dupack", &dup_ack_handling, FALSE,
      "turn of the BSD version of the duplicate ack handling"},
+    {"merge", &merge_files, TRUE,
+     "read all the files at once, merging their packets by timestamp"},
+    {"make_index", &make_index, TRUE,
+     "write an index of where each connection is to FILE.tcpidx"},
+    {"use_index", &use_index, TRUE,
+     "with -o, use FILE.tcpidx to only read the connections asked for"},
+    {"binary_plots", &plot_binary, TRUE,
+     "write the graphs compactly as FILE.tpb (see --render_plots)"},
 
 };
 #define NUM_EXTENDED_BOOLS (sizeof(extended_bools) / sizeof(struct ext_bool_op))
@@ -279,6 +314,14 @@ static void VerifyMaxConnNum(char *varname, char *value);
 static void VerifyLiveConnInt(char *varname, char *value);
 static void VerifyNonrealLiveConnInt(char *varname, char*value);
 static void VerifyClosedConnInt(char *varname, char *value);
+static void VerifyUdpConnInt(char *varname, char *value);
+static void VerifyReadAhead(char *varname, char *value);
+static void VerifyOutputThreads(char *varname, char *value);
+static void VerifyStreamMem(char *varname, char *value);
+static void VerifyLiveRing(char *varname, char *value);
+static void VerifyReasmWindow(char *varname, char *value);
+static void VerifyBPF(char *varname, char *value);
+static void VerifyRenderPlots(char *varname, char *value);
 
 /* extended variable options */
 /* they must all be strings */
@@ -307,10 +350,28 @@ static struct ext_var_op {
      "time interval of inactivity after which an open connection is considered closed"},
      {"remove_closed_conn_interval", &closed_conn_interval_st, VerifyClosedConnInt,
      "time interval after which a closed connection is removed in real-time mode"},
+    {"remove_udp_conn_interval", &udp_conn_interval_st, VerifyUdpConnInt,
+     "idle time after which a UDP flow is removed in real-time mode"},
     {"xplot_args", &xplot_args, NULL,
      "arguments to pass to xplot, if we are calling xplot from here"},
     {"sv", &sv, NULL,
      "separator to use for long output with <STR>-separated-values"},
+    {"readahead", &readahead_files_st, VerifyReadAhead,
+     "read this many input files at once in background threads"},
+    {"output_threads", &output_threads_st, VerifyOutputThreads,
+     "write the output files in the background with this many threads"},
+    {"bpf", &bpf_expr, VerifyBPF,
+     "only look at packets matching this pcap filter expression"},
+    {"stream_mem", &stream_mem_st, VerifyStreamMem,
+     "MB of connection state to keep in streaming mode (implies --stream)"},
+    {"live", &live_iface, NULL,
+     "capture from this network interface rather than reading files"},
+    {"live_ring", &live_ring_st, VerifyLiveRing,
+     "MB of kernel ring buffer to capture into with --live"},
+    {"reasm_window", &reasm_window_st, VerifyReasmWindow,
+     "KB of out-of-order data to hold per connection for stream modules"},
+    {"render_plots", &render_plots, VerifyRenderPlots,
+     "turn the FILE.tpb args into xplot or gnuplot input and exit"},
    
 };
 #define NUM_EXTENDED_VARS (sizeof(extended_vars) / sizeof(struct ext_var_op))
@@ -724,6 +785,7 @@ main(
     char *argv[])
 {
     int i;
+    int prefetched = 0;
     double etime;
    
     if (argc == 1)
@@ -740,6 +802,26 @@ main(
     /* parse the flags */
     CheckArguments(&argc,argv);
 
+    /* not a trace, just binary plots to turn into something viewable */
+    if (render_plots) {
+	int bad = 0;
+
+	for (i=0; i < argc; ++i)
+	    if (!PlotRender(filenames[i], render_plots))
+		++bad;
+	exit(bad ? 1 : 0);
+    }
+
+    /* streaming is real-time mode that still reports each connection */
+    if (stream_output)
+	run_continuously = TRUE;
+
+    /* a live capture never ends, so it's always real-time mode */
+    if (live_iface) {
+	run_continuously = TRUE;
+	argc = 0;
+    }
+
     /* Used with <SP>-separated-values,
      * prints a '#' before each header line if --csv/--tsv is requested.
      */
@@ -760,11 +842,14 @@ main(
     gettimeofday(&wallclock_start, NULL);
 
     num_files = argc;
-    printf("%s%d arg%s remaining, starting with '%s'\n",
-	   comment,
-	   num_files,
-	   num_files>1?"s":"",
-	   filenames[0]);
+    if (live_iface)
+	printf("%sCapturing from interface '%s'\n", comment, live_iface);
+    else
+	printf("%s%d arg%s remaining, starting with '%s'\n",
+	       comment,
+	       num_files,
+	       num_files>1?"s":"",
+	       filenames[0]);
     
 
 
@@ -774,24 +859,58 @@ main(
     /* knock, knock... */
     printf("%s%s\n\n", comment, VERSION);
 
-    /* read each file in turn */
+    /* the index needs to know exactly where each packet came from */
+    if ((make_index || use_index) &&
+	(merge_files || run_continuously || (readahead_files > 0))) {
+	fprintf(stderr,"\
+--make_index and --use_index can't be used with --merge, -C, or --readahead\n");
+	make_index = use_index = FALSE;
+    }
+    if (use_index && do_udp) {
+	fprintf(stderr,"--use_index only finds TCP connections, not used with -u\n");
+	use_index = FALSE;
+    }
+    if (use_index)
+	IndexLoad(filenames, argc);
+
     numfiles = argc;
-    for (i=0; i < argc; ++i) {
-	if (debug || (numfiles > 1)) {
-	    if (argc > 1)
-		printf("%sRunning file '%s' (%d of %d)\n", comment, filenames[i], i+1, numfiles);
-	    else
-		printf("%sRunning file '%s'\n", comment, filenames[i]);
-	}
+    if (live_iface) {
+	ProcessLive(live_iface);
+    } else if (merge_files && (argc > 1)) {
+	/* simultaneous captures, read them all at once */
+	for (i=0; i < argc; ++i)
+	    printf("%sMerging file '%s' (%d of %d)\n", comment, filenames[i], i+1, numfiles);
+	ProcessMerged(filenames, argc);
+    } else {
+	/* read each file in turn */
+	for (i=0; i < argc; ++i) {
+	    /* keep this file and the next few decompressing in the */
+	    /* background */
+	    while ((readahead_files > 0) &&
+		   (prefetched < argc) && (prefetched < i + readahead_files))
+		CompPrefetch(filenames[prefetched++]);
+
+	    if (debug || (numfiles > 1)) {
+		if (argc > 1)
+		    printf("%sRunning file '%s' (%d of %d)\n", comment, filenames[i], i+1, numfiles);
+		else
+		    printf("%sRunning file '%s'\n", comment, filenames[i]);
+	    }
 
-	/* do the real work */
-	ProcessFile(filenames[i]);
+	    /* do the real work */
+	    ProcessFile(filenames[i]);
+	}
     }
 
     /* clean up output */
     if (printticks)
 	printf("\n");
 
+    if (make_index)
+	IndexWrite(filenames, argc);
+    if (use_index)
+	IndexFinish();
+
     /* get ending wallclock time */
     gettimeofday(&wallclock_finished, NULL);
 
@@ -819,6 +938,8 @@ main(
 	fprintf(stdout,"%s\tfirst packet:  %s\n", comment, ts2ascii(&first_packet));
 	fprintf(stdout,"%s\tlast packet:   %s\n", comment, ts2ascii(&last_packet));
     }
+    if (live_iface)
+	LiveStats();
     if (verify_checksums) {
 	fprintf(stdout,"%sbad IP checksums:  %ld\n", comment, bad_ip_checksums);
 	fprintf(stdout,"%sbad TCP checksums: %ld\n", comment, bad_tcp_checksums);
@@ -827,39 +948,27 @@ main(
     }
 
     /* close files, cleanup, and etc... */
+    trace_flush();
     trace_done();
     udptrace_done();
 
     FinishModules();
     plotter_done();
+    Mfinish();
 
     exit(0);
 }
 
 
-static void
-ProcessFile(
+/* open an input file and figure out which format it's in, returns */
+/* the routine to read its packets with (exits if it can't) */
+pread_f *
+OpenTraceFile(
     char *filename)
 {
     pread_f *ppread;
-    int ret;
-    struct ip *pip;
-    struct tcphdr *ptcp;
-    int phystype;
-    void *phys;  /* physical transport header */
-    tcp_pair *ptp;
-    int fix;
-    int len;
-    int tlen;
-    void *plast;
     struct stat str_stat;
-    long int location = 0;
-    u_long fpnum = 0;
-    Bool is_stdin = 0;
-    static int file_count = 0;
-
-    /* share the current file name */
-    cur_filename = filename;
+    int fix;
 
 #ifdef __WIN32
     /* If the file is compressed, exit (Windows version does not support compressed dump files) */
@@ -876,7 +985,6 @@ ProcessFile(
     /* see how big the file is */
     if (FileIsStdin(filename)) {
 	filesize = 1;
-	is_stdin = 1;
     } else {
 	if (stat(filename,&str_stat) != 0) {
 	    perror("stat");
@@ -954,7 +1062,21 @@ rather than:\n\
 	/* print file size */
 	printf("Trace file size: %lu bytes\n", filesize);
     }
-    location = 0;
+
+    return(ppread);
+}
+
+
+static void
+ProcessFile(
+    char *filename)
+{
+    pread_f *ppread;
+
+    /* share the current file name */
+    cur_filename = filename;
+
+    ppread = OpenTraceFile(filename);
 
     /* inform the modules, if they care... */
     ModulesPerFile(filename);
@@ -962,6 +1084,112 @@ rather than:\n\
     /* count the files */
     ++file_count;
 
+    /* only read the parts we need, if we can */
+    if (use_index)
+	IndexStartFile(file_count);
+
+    /* read the file in a separate thread, if requested */
+    if (readahead_files > 0)
+	ppread = ReadAheadStart(ppread);
+
+    ProcessPackets(ppread, FileIsStdin(filename));
+
+    /* stop reading ahead (we might have quit early) */
+    if (readahead_files > 0)
+	ReadAheadStop();
+
+    /* close the input file */
+    CompCloseFile(filename);
+}
+
+
+/* read all of the files at once, handing the packets to the */
+/* analysis in timestamp order (--merge) */
+static void
+ProcessMerged(
+    char **names,
+    int count)
+{
+    pread_f *ppread;
+    struct stat str_stat;
+    int i;
+
+    /* the modules get told the total size */
+    filesize = 0;
+    for (i=0; i < count; ++i) {
+	if (FileIsStdin(names[i]))
+	    continue;
+	if (stat(names[i],&str_stat) != 0) {
+	    perror(names[i]);
+	    exit(1);
+	}
+	filesize += str_stat.st_size;
+    }
+
+    /* start a reader for each of the files */
+    ppread = MergeStart(names, count);
+
+    /* as far as the modules are concerned, it's just one big file */
+    cur_filename = names[0];
+    ModulesPerFile(names[0]);
+    ++file_count;
+
+    /* the files are already being read in parallel, so no read ahead */
+    /* here (the merge routine also keeps cur_filename up to date) */
+
+    /* there's no one file position to report progress with */
+    ProcessPackets(ppread, TRUE);
+
+    /* shut down the readers (we might have quit early) */
+    MergeStop();
+}
+
+
+/* capture from a network interface until interrupted (--live) */
+static void
+ProcessLive(
+    char *ifname)
+{
+    pread_f *ppread;
+
+    ppread = LiveStart(ifname);
+
+    /* as far as the modules are concerned, it's a file that never ends */
+    filesize = 1;
+    cur_filename = ifname;
+    ModulesPerFile(ifname);
+    ++file_count;
+
+    if (readahead_files > 0)
+	ppread = ReadAheadStart(ppread);
+
+    /* there's no file position to report progress with */
+    ProcessPackets(ppread, TRUE);
+
+    if (readahead_files > 0)
+	ReadAheadStop();
+
+    LiveStop();
+}
+
+
+/* the main analysis loop, run each packet from ppread thru the mill */
+static void
+ProcessPackets(
+    pread_f *ppread,
+    Bool is_stdin)
+{
+    int ret;
+    struct ip *pip;
+    struct tcphdr *ptcp;
+    int phystype;
+    void *phys;  /* physical transport header */
+    tcp_pair *ptp;
+    int len;
+    int tlen;
+    void *plast;
+    long int location = 0;
+    u_long fpnum = 0;
 
     /* read each packet */
     while (1) {
@@ -992,7 +1220,7 @@ rather than:\n\
 		    fprintf(stderr, "\
 Warning, first packet in file %s comes BEFORE the last packet\n\
 in the previous file.  That will likely confuse the program, please\n\
-order the files in time if you have trouble\n", filename);
+order the files in time (or use --merge) if you have trouble\n", cur_filename);
 		} else {
 		    static int warned = 0;
 
@@ -1000,11 +1228,11 @@ order the files in time if you have trouble\n", filename);
 			fprintf(stderr, "\
 Warning, packet %ld in file %s comes BEFORE the previous packet\n\
 That will likely confuse the program, so be careful!\n",
-				fpnum, filename);
+				fpnum, cur_filename);
 		    } else if (!warned) {
 			fprintf(stderr, "\
 Packets in file %s are out of order.\n\
-That will likely confuse the program, so be careful!\n", filename);
+That will likely confuse the program, so be careful!\n", cur_filename);
 		    }
 		    warned = 1;
 		}
@@ -1014,7 +1242,8 @@ That will likely confuse the program, so be careful!\n", filename);
 	
 
 	/* install signal handler */
-	if (fpnum == 1) {
+	/* (a live capture handles SIGINT itself, and stops cleanly) */
+	if ((fpnum == 1) && (live_iface == NULL)) {
 	    signal(SIGINT,QuitSig);
 	}
 
@@ -1034,6 +1263,14 @@ That will likely confuse the program, so be careful!\n", filename);
 		    fprintf(stderr, "%s: ", cur_filename);
 		if (is_stdin) {
 		    fprintf(stderr ,"%lu", fpnum);
+		} else if (CompPosition() >= 0) {
+		    /* (what the decompressor has read, which can run a */
+		    /* buffer's worth ahead of the packets) */
+		    location = CompPosition();
+		    frac = (unsigned)(100.0 * location / filesize);
+		    if (frac > 100)
+			frac = 100;
+		    fprintf(stderr ,"%lu %u%% (compressed)", fpnum, frac);
 		} else if (CompIsCompressed()) {
 		    frac = location/(filesize/100);
 		    if (frac <= 100)
@@ -1041,7 +1278,9 @@ That will likely confuse the program, so be careful!\n", filename);
 		    else
 			fprintf(stderr ,"%lu ~100%% + %u%% (compressed)", fpnum, frac-100);
 		} else {
-		    location = ftell(stdin);
+		    /* exact if we're reading the file directly */
+		    if ((location = PcapMmapPosition()) < 0)
+			location = ftell(stdin);
 		    frac = location/(filesize/100);
 
 		    fprintf(stderr ,"%lu %u%%", fpnum, frac);
@@ -1095,6 +1334,14 @@ for other packet types, I just don't have a place to test them\n\n");
 	    continue;
 	}
 
+	/* packet-level filter, if requested */
+	if (bpf_expr && !PassesBPF(pip,plast,len,tlen))
+	    continue;
+
+	/* with an index, only the connections asked for */
+	if (use_index && !IndexWantsPacket(pip,plast,file_count))
+	    continue;
+
 	/* print the packet, if requested */
 	if (printallofem || dump_packet_data) {
 	    printf("Packet %lu\n", pnum);
@@ -1173,6 +1420,9 @@ for other packet types, I just don't have a place to test them\n\n");
 	if (ptp == NULL)
 	    continue;
 
+	if (make_index)
+	    IndexNotePacket(ptp,file_count);
+
 	/* unless this connection is being ignored, tell the modules */
 	/* about it */
 	if (!ptp->ignore_pair) {
@@ -1182,6 +1432,10 @@ for other packet types, I just don't have a place to test them\n\n");
 
 	    /* also, pass the packet to any modules defined */
 	    ModulesPerPacket(pip,ptp,plast);
+
+	    /* and then the bytes it completed, if any */
+	    if (reassemble_streams)
+		ReasmPacket(ptp);
 	}
 
 	/* for efficiency, only allow a signal every 1000 packets	*/
@@ -1209,9 +1463,6 @@ for other packet types, I just don't have a place to test them\n\n");
 	sigprocmask(SIG_UNBLOCK, &mask, NULL);
 	signal(SIGINT,SIG_DFL);
     }
-
-    /* close the input file */
-    CompCloseFile(filename);
 }
 
 
@@ -1222,10 +1473,12 @@ QuitSig(
     printf("%c\n\n", 7);  /* BELL */
     printf("Terminating processing early on signal %d\n", signum);
     printf("Partial result after processing %lu packets:\n\n\n", pnum);
+    trace_flush();
     FinishModules();
     plotter_done();
     trace_done();
     udptrace_done();
+    Mfinish();
     exit(1);
 }
 
@@ -1720,7 +1973,7 @@ CheckArguments(
     ParseArgs("command line",pargc,argv);
 
     /* make sure we found the files */
-    if (filenames == NULL) {
+    if ((filenames == NULL) && (live_iface == NULL)) {
 	BadArg(NULL,"must specify at least one file name\n");
     }
 
@@ -2063,6 +2316,85 @@ VerifyClosedConnInt(
 }
 
 
+static void 
+VerifyUdpConnInt(
+    char *varname, 
+    char *value)
+{
+    remove_udp_conn_interval = VerifyPositive(varname, value);  
+}
+
+
+static void
+VerifyStreamMem(
+    char *varname,
+    char *value)
+{
+    stream_mem = VerifyPositive(varname, value);
+    stream_output = TRUE;
+}
+
+
+static void
+VerifyLiveRing(
+    char *varname,
+    char *value)
+{
+    live_ring_size = VerifyPositive(varname, value);
+}
+
+
+static void
+VerifyReasmWindow(
+    char *varname,
+    char *value)
+{
+    reasm_window = VerifyPositive(varname, value);
+}
+
+
+static void
+VerifyReadAhead(
+    char *varname,
+    char *value)
+{
+    readahead_files = VerifyPositive(varname, value);
+}
+
+
+static void
+VerifyRenderPlots(
+    char *varname,
+    char *value)
+{
+    if ((strcmp(value, "xplot") != 0) && (strcmp(value, "gnuplot") != 0)) {
+	fprintf(stderr,
+		"Value '%s' is not valid for variable '%s' (xplot or gnuplot)\n",
+		value, varname);
+	exit(1);
+    }
+}
+
+
+static void
+VerifyOutputThreads(
+    char *varname,
+    char *value)
+{
+    output_threads = VerifyPositive(varname, value);
+}
+
+
+
+static void
+VerifyBPF(
+    char *varname,
+    char *value)
+{
+    InstallBPF(value);
+}
+
+
 
 static void
 ParseArgs(
@@ -2399,6 +2731,10 @@ LoadModules(
 		fprintf(stderr,"Module \"%s\" enabled\n",
 			modules[i].module_name);
 	    modules[i].module_inuse = TRUE;
+
+	    /* someone wants the byte streams put back together */
+	    if (modules[i].module_stream_data != NULL)
+		reassemble_streams = TRUE;
 	} else {
 	    if (debug)
 		fprintf(stderr,"Module \"%s\" not active\n",
@@ -2416,6 +2752,10 @@ FinishModules(void)
 {
     int i;
 
+    /* hand over what's left of the streams before they're done */
+    if (reassemble_streams)
+	ReasmDone();
+
     for (i=0; i < NUM_MODULES; ++i) {
 	if (!modules[i].module_inuse)
 	    continue;  /* might be disabled */
@@ -2454,7 +2794,7 @@ ModulesPerConn(
 	if (pmodstruct) {
 	    /* make sure the array is there */
 	    if (!ptp->pmod_info) {
-		ptp->pmod_info = MallocZ(num_modules * sizeof(void *));
+		ptp->pmod_info = ConnAlloc(ptp,num_modules * sizeof(void *));
 	    }
 
 	    /* remember this structure */
@@ -2470,6 +2810,10 @@ ModulesPerOldConn(
 {
     int i;
 
+    /* the rest of its streams come first */
+    if (reassemble_streams)
+	ReasmFinish(ptp);
+
     for (i=0; i < NUM_MODULES; ++i) {
 	if (!modules[i].module_inuse)
 	    continue;  /* might be disabled */
@@ -2487,6 +2831,29 @@ ModulesPerOldConn(
 }
 
 
+void
+ModulesPerOldUDPConn(
+    udp_pair *pup)
+{
+    int i;
+
+    for (i=0; i < NUM_MODULES; ++i) {
+	if (!modules[i].module_inuse)
+	    continue;  /* might be disabled */
+
+	if (modules[i].module_udp_deleteconn == NULL)
+	    continue;  /* they might not care */
+
+	if (debug>3)
+	    fprintf(stderr,"Calling UDP delete conn routine for module \"%s\"\n",
+		    modules[i].module_name);
+
+	(*modules[i].module_udp_deleteconn)(pup,
+					    pup->pmod_info?pup->pmod_info[i]:NULL);
+    }
+}
+
+
 static void
 ModulesPerUDPConn(
     udp_pair *pup)
@@ -2509,7 +2876,7 @@ ModulesPerUDPConn(
 	if (pmodstruct) {
 	    /* make sure the array is there */
 	    if (!pup->pmod_info) {
-		pup->pmod_info = MallocZ(num_modules * sizeof(void *));
+		pup->pmod_info = UdpConnAlloc(pup,num_modules * sizeof(void *));
 	    }
 
 	    /* remember this structure */
@@ -2566,6 +2933,33 @@ ModulesPerPacket(
 }
 
 
+void
+ModulesPerStream(
+    tcp_pair *ptp,
+    tcb *ptcb,
+    u_llong offset,
+    char *pdata,
+    u_long len)
+{
+    int i;
+
+    for (i=0; i < NUM_MODULES; ++i) {
+	if (!modules[i].module_inuse)
+	    continue;  /* might be disabled */
+
+	if (modules[i].module_stream_data == NULL)
+	    continue;  /* they might not care */
+
+	if (debug>3)
+	    fprintf(stderr,"Calling stream routine for module \"%s\"\n",
+		    modules[i].module_name);
+
+	(*modules[i].module_stream_data)(ptp,ptcb,offset,pdata,len,
+					 ptp->pmod_info?ptp->pmod_info[i]:NULL);
+    }
+}
+
+
 static void
 ModulesPerUDPPacket(
     struct ip *pip,
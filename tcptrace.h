@@ -109,6 +109,9 @@ static char const GCC_UNUSED rcsid_tcptrace[] =
 /* memory allocation routines */
 #include "pool.h"
 
+/* arena allocation routines */
+#include "arena.h"
+
 /* we want LONG LONG in some places */
 #if SIZEOF_UNSIGNED_LONG_LONG_INT >= 8
 #define HAVE_LONG_LONG
@@ -269,13 +272,16 @@ typedef struct segment {
     u_char	retrans;	/* retransmit count */
     u_int	acked;		/* how MANY times has has it been acked? */
     timeval	time;		/* time the segment was sent */
-    struct segment *next;
-    struct segment *prev;
 } segment;
 
+/* the segments seen in one quarter of the sequence space, kept in a */
+/* sorted array (segs[first] thru segs[first+nsegs-1]) that is only */
+/* ever grown, so it can be binary searched and recycled in place */
 typedef struct quadrant {
-    segment	*seglist_head;
-    segment	*seglist_tail;
+    segment	*segs;
+    u_int	first;		/* index of the lowest segment */
+    u_int	nsegs;		/* number of segments in use */
+    u_int	maxsegs;	/* number of segments allocated */
     Bool 	full;
     struct quadrant *prev;
     struct quadrant *next;
@@ -285,6 +291,113 @@ typedef struct seqspace {
     quadrant 	*pquad[4];
 } seqspace;
 
+/* The parts of a tcb that only some options touch live in blocks of */
+/* their own, so that the state walked for every packet stays small */
+
+/* hardware duplicate detection (--check_hwdups) */
+#define SEGS_TO_REMEMBER 8
+typedef struct tcb_hwdups {
+    struct str_hardware_dups {
+	seqnum	hwdup_seq;	/* sequence number */
+	u_short	hwdup_id;	/* IP ID */
+	u_long	hwdup_packnum; /* packet number */
+    } hardware_dups[SEGS_TO_REMEMBER];
+    u_char hardware_dups_ix;
+} tcb_hwdups;
+
+/* the Reno LEAST estimate (see FAQ), from the first retransmission on */
+typedef struct tcb_least {
+    u_long	LEAST;
+    u_long	recovered, recovered_orig, rto_segment;
+    u_long	event_retrans, event_dupacks;
+} tcb_least;
+
+/* content extraction (-e) */
+#define EXTR_BUF_MIN	2048		/* a stream's first buffer */
+#define EXTR_BUF_SIZE	(32*1024)	/* most bytes gathered up per write */
+#define EXTR_BUF_TOTAL	(64*1024*1024)	/* ...for all the streams at once */
+typedef struct tcb_extract {
+    struct tcb	*ptcb;
+    MFILE	*extr_contents_file;	/* NULL until the first write */
+    seqnum	extr_lastseq;	/* last sequence number we stored */
+    u_llong	extr_lastoff;	/* ...and where it went in the file */
+
+    /* bytes that follow on from each other, not written yet */
+    char	*extr_buf;
+    u_llong	extr_buf_off;	/* file offset of extr_buf[0] */
+    u_int	extr_buf_len;
+    u_int	extr_buf_size;
+    struct tcb_extract *extr_next;	/* streams with a buffer, */
+    struct tcb_extract *extr_prev;	/* least recently used first */
+} tcb_extract;
+
+/* stream reassembly for the modules that read payload (reasm.c) */
+typedef struct reasm_buf {
+    struct reasm_buf *next;	/* while it's waiting for a hole to fill */
+    u_llong	off;		/* stream offset of data[0] */
+    u_int	len;
+    u_short	refs;		/* one while held, plus one per ReasmHold() */
+    u_char	bclass;		/* which pool it came from */
+    char	*data;
+} reasm_buf;
+
+typedef struct tcb_reasm {
+    struct tcb	*ptcb;
+    Bool	started;
+    Bool	finished;	/* everything's been handed over */
+    seqnum	next_seq;	/* sequence number of the next in-order byte */
+    u_llong	next_off;	/* ...and its offset in the stream */
+    reasm_buf	*early;		/* data past a hole, by offset */
+    u_long	early_bytes;
+    struct tcb_reasm *next_active;
+    struct tcb_reasm *prev_active;
+} tcb_reasm;
+
+/* graph output and RTT sample dumps */
+typedef struct tcb_graphs {
+    /* Instantaneous throughput info */
+    timeval	thru_firsttime;	/* time of first packet this interval */
+    u_long	thru_bytes;	/* number of bytes this interval */
+    u_long	thru_pkts;	/* number of packets this interval */
+    PLOTTER	thru_plotter;	/* throughput data dump file */
+    timeval	thru_lasttime;	/* time of previous segment */
+    PLINE	thru_avg_line;	/* average throughput line */
+    PLINE	thru_inst_line;	/* instantaneous throughput line */
+
+    /* Time Sequence Graph info for this one */
+    PLOTTER	tsg_plotter;
+
+    /* Time Line Graph */
+    PLOTTER     tline_plotter;
+   
+    /* Dumped RTT samples */
+    MFILE	*rtt_dump_file;
+
+    /* RTT Graph info for this one */
+    PLOTTER	rtt_plotter;
+    PLINE	rtt_line;
+
+    /* Segment size graph */
+    PLOTTER	segsize_plotter;
+    PLINE	segsize_line;
+    PLINE	segsize_avg_line;
+
+    /* Congestion window graph */
+    PLOTTER	owin_plotter;
+    PLINE	owin_line;
+    PLINE       rwin_line;
+    PLINE	owin_avg_line;
+    PLINE 	owin_wavg_line;
+
+    /* RWIN Graph info for this one */
+    PLOTTER	recvwin_plotter;
+    PLINE	recvwin_line;
+} tcb_graphs;
+
+/* a tcb's plotter, or NO_PLOTTER if it has no graphs at all */
+#define TCB_PLOTTER(ptcb,which) \
+    (((ptcb)->pgraphs == NULL) ? NO_PLOTTER : (ptcb)->pgraphs->which)
+
 typedef struct tcb {
     /* parent pointer */
     struct stcp_pair *ptp;
@@ -356,14 +469,8 @@ typedef struct tcb {
     u_int seq_wrap_count;              /* wrap count */
     
     /* hardware duplicate detection */
-#define SEGS_TO_REMEMBER 8
-    struct str_hardware_dups {
-	seqnum	hwdup_seq;	/* sequence number */
-	u_short	hwdup_id;	/* IP ID */
-	u_long	hwdup_packnum; /* packet number */
-    } hardware_dups[SEGS_TO_REMEMBER];
+    struct tcb_hwdups *phwdups;	/* recent segments, NULL until first seen */
     u_long num_hardware_dups;
-    u_char hardware_dups_ix;
 
     /* did I detect any "bad" tcp behavior? */
     /* at present, this means: */
@@ -433,55 +540,21 @@ typedef struct tcb {
     double	retr_tm_sum2;	/* sum of squares, for stdev */
     u_long	retr_tm_count;	/* for averages */
 
-    /* Instantaneous throughput info */
-    timeval	thru_firsttime;	/* time of first packet this interval */
-    u_long	thru_bytes;	/* number of bytes this interval */
-    u_long	thru_pkts;	/* number of packets this interval */
-    PLOTTER	thru_plotter;	/* throughput data dump file */
-    timeval	thru_lasttime;	/* time of previous segment */
-    PLINE	thru_avg_line;	/* average throughput line */
-    PLINE	thru_inst_line;	/* instantaneous throughput line */
-
     /* data transfer time stamps - mallman */
     timeval	first_data_time;
     timeval	last_data_time;
 
-    /* Time Sequence Graph info for this one */
-    PLOTTER	tsg_plotter;
-    char	*tsg_plotfile;
+    /* graphs and RTT dumps, NULL unless one was asked for */
+    struct tcb_graphs *pgraphs;
 
-    /* Time Line Graph */
-    PLOTTER     tline_plotter;
-   
-    /* Dumped RTT samples */
-    MFILE	*rtt_dump_file;
+    /* Extracted stream contents, NULL until the first saved byte */
+    struct tcb_extract *pextract;
 
-    /* Extracted stream contents */
-    MFILE	*extr_contents_file;
+    /* Reassembled stream for module_stream_data, NULL until the */
+    /* first byte (and unless some module wants it) */
+    struct tcb_reasm *preasm;
     u_llong	trunc_bytes;	/* data bytes not see due to trace file truncation */
     u_llong	trunc_segs;	/* segments with trunc'd bytes */
-    seqnum	extr_lastseq;	/* last sequence number we stored */
-    seqnum	extr_initseq;	/* initial sequence number (same as SYN unless we missed it) */
-
-    /* RTT Graph info for this one */
-    PLOTTER	rtt_plotter;
-    PLINE	rtt_line;
-
-    /* Segment size graph */
-    PLOTTER	segsize_plotter;
-    PLINE	segsize_line;
-    PLINE	segsize_avg_line;
-
-    /* Congestion window graph */
-    PLOTTER	owin_plotter;
-    PLINE	owin_line;
-    PLINE       rwin_line;
-    PLINE	owin_avg_line;
-    PLINE 	owin_wavg_line;
-
-    /* RWIN Graph info for this one */
-    PLOTTER	recvwin_plotter;
-    PLINE	recvwin_line;
 
     /* for tracking unidirectional idle time */
     timeval	last_time;	/* last packet SENT from this side */
@@ -494,10 +567,9 @@ typedef struct tcb {
 
     /* for computing LEAST (see FAQ) */
     enum	tcp_strains { TCP_RENO, TCP_SACK, TCP_DSACK } tcp_strain;
-    u_long	LEAST;
     char	in_rto;
-    u_long	recovered, recovered_orig, rto_segment, lastackno;
-    u_long	event_retrans, event_dupacks;
+    u_long	lastackno;
+    struct tcb_least *pleast;	/* NULL until the first retransmission */
 
     /* host name letter(s) */
     char	*host_letter;
@@ -505,19 +577,31 @@ typedef struct tcb {
 
 
 typedef u_short hash;
+typedef u_llong hash64;
 
 typedef struct {
     ipaddr	a_address;
     ipaddr	b_address;
     portnum	a_port;
     portnum	b_port;
-    hash	hash;
+    hash64	hash;		/* AddrHash() of the above, same both ways */
 } tcp_pair_addrblock;
 
 
+/* where a connection is in the input files (--make_index) */
+typedef struct tcp_pair_index {
+    u_int		first_file;	/* 1 is the first file read */
+    u_int		last_file;
+    u_llong		first_offset;	/* where the packet records start */
+    u_llong		last_offset;
+    timeval		first_time;
+    timeval		last_time;
+} tcp_pair_index;
+
 struct stcp_pair {
     /* are we ignoring this one?? */
     Bool		ignore_pair;
+    Bool		filtered_early;	/* (because -f ruled it out) */
 
     /* inactive (previous instance of current connection */
     Bool		inactive;
@@ -546,6 +630,16 @@ struct stcp_pair {
 
     /* which file this connection is from */
     char		*filename;
+
+    /* its number, as printed (the first one is 1) */
+    int			conn_num;
+
+    /* where its packets are (only kept with --make_index) */
+    tcp_pair_index	*pindex;
+
+    /* where the connection's own memory comes from (real-time mode, */
+    /* otherwise NULL for the run-lifetime arena) */
+    arena		*parena;
 };
 typedef struct stcp_pair tcp_pair;
 
@@ -555,38 +649,6 @@ typedef struct tcphdr tcphdr;
 extern int num_tcp_pairs;	/* how many pairs are in use */
 extern tcp_pair **ttp;		/* array of pointers to allocated pairs */
 
-/* Wed Aug 20, 2003 - Ramani*/
-/*  Prior to version 6.4.11, the data structure for storing the snapshots of 
- connections was a hashtable with linked lists. But this might lead to a 
- worst case scenario when many connections hash to the same hash table entry.
- In such a case, searching for the connections degrades to searching a linked 
- list with a worst case complexity of O(number of connections in list). Hence 
- the new version implements an AVL tree in place of linked list leading to a 
- worst case complexity of O(ln(number of connections in tree)). 
-    The modified data structure was tested with dumpfiles containing lots of 
- connections. A comparison of the profiles suggests an improvement in the time 
- spent in the dotrace function. Even though the AVL tree implementation 
- involves balancing the tree, since most of the accesses involve searching the 
- data structure, AVL tree performs MUCH better than linked list.
-     The algorithms for AVL tree implementation are based on those explained in
- "Data Structures and Program Design in C by Robert L.Kruse, Bruce P.Leung, 
- Clovis L.Tondo". The source code for AVL tree implementation is from the 
- Institute of Applied Iconoclasm who put up the source code at 
- <http://www.purists.org>. We thank Georg for the source code whose mail 
- address has been mentioned as <georg@purists.org> */
-
-/* Data structures for AVL tree */
-
-/* Which of a given node's subtrees is higher in the AVL tree */
-enum AVLSKEW {
-   EQUAL1, LEFT, RIGHT
-};
-                                                                                
-/* Did an insertion/deletion succeed and if we need to balance the AVL tree */
-enum AVLRES {
-   OK, BALANCE
-};
-
 /* Tue Nov 17, 1998 */
 /* prior to version 5.13, we kept a hash table of all of the connections. */
 /* The most recently-accessed connections move to the front of the bucket */
@@ -597,10 +659,13 @@ enum AVLRES {
 /* system keeps a quick snapshot of the connection (ptp_snap) in the */
 /* hash table.  We only retrieve the connection record if the snapshot */
 /* matches. The result is that it works MUCH better when memory is low. */
+
+/* The snapshots used to hang off of a fixed size table of AVL trees */
+/* (version 6.4.11 through 6.6.8).  They are now the slots of a growable */
+/* open-addressed table, keyed by a 64 bit hash of the 4-tuple, see */
+/* conntab.c for the details. */
 typedef struct ptp_snap {
-    enum AVLSKEW        skew;      /* Skew of the AVL tree node */
     tcp_pair_addrblock	addr_pair; /* just a copy */
-    struct ptp_snap     *left, *right;  /* Left and right trees of the AVL node */
     void		*ptp;
 } ptp_snap;
 
@@ -608,16 +673,22 @@ typedef struct ptp_snap {
 typedef struct ptp_ptr {
   struct ptp_ptr	*next;
   struct ptp_ptr	*prev;
-  struct ptp_snap	*from;
   tcp_pair		*ptp;
 } ptp_ptr;
 
 #define NONREAL_LIVE_CONN_INTERVAL      4*60    /* 4 minutes */
 #define REMOVE_LIVE_CONN_INTERVAL	8*3600	/* 8 hours */
 #define REMOVE_CLOSED_CONN_INTERVAL	8*60	/* 8 minutes */
+#define REMOVE_UDP_CONN_INTERVAL	2*60	/* 2 minutes */
 #define UPDATE_INTERVAL			30	/* 30 seconds */
 #define MAX_CONN_NUM			50000	/* max number of connections */
 						/* for continuous mode */
+#define CONN_ARENA_SIZE			1024	/* arena chunk size for each */
+						/* connection in continuous mode */
+#define UDP_CONN_ARENA_SIZE		256	/* same, for each UDP flow */
+#define LIVE_RING_SIZE			64	/* MB of capture ring for --live */
+#define REASM_WINDOW			512	/* KB of out-of-order payload */
+						/* held per connection */
 
 /* minimal support for UDP "connections" */
 typedef struct ucb {
@@ -666,8 +737,12 @@ struct sudp_pair {
     /* which file this connection is from */
     char		*filename;
 
-    /* linked list of usage */
+    /* names and module records, in real-time mode (else NULL) */
+    arena		*parena;
+
+    /* list of flows by most recent use (real-time mode) */
     struct sudp_pair *next;
+    struct sudp_pair *prev;
 };
 typedef struct sudp_pair udp_pair;
 typedef struct udphdr udphdr;
@@ -716,6 +791,7 @@ extern Bool show_triple_dupack;
 extern Bool show_zwnd_probes;
 extern Bool use_short_names;
 extern Bool save_tcp_data;
+extern Bool reassemble_streams;
 extern Bool graph_time_zero;
 extern Bool graph_seq_zero;
 extern Bool print_seq_zero;
@@ -734,11 +810,23 @@ extern Bool ns_hdrs;
 extern Bool dup_ack_handling;
 extern Bool csv;
 extern Bool tsv;
+extern Bool merge_files;
+extern Bool make_index;
+extern Bool use_index;
+extern Bool stream_output;
+extern Bool plot_binary;
+extern char *render_plots;
 extern u_long remove_live_conn_interval;
 extern u_long nonreal_live_conn_interval;
 extern u_long remove_closed_conn_interval;
+extern u_long remove_udp_conn_interval;
 extern u_long update_interval;
 extern u_long max_conn_num;
+extern u_long readahead_files;
+extern u_long output_threads;
+extern u_long stream_mem;
+extern u_long live_ring_size;
+extern u_long reasm_window;
 
 extern int debug;
 extern int thru_interval;
@@ -750,6 +838,8 @@ extern char *output_file_prefix;
 extern char *xplot_title_prefix;
 extern char *xplot_args;
 extern char *sv;
+extern char *bpf_expr;
+extern char *live_iface;
 extern char *sp;       /* Separator used for long output with <SP>-separated-values */
 
 /* Used to comment out header lines of the long output
@@ -785,6 +875,7 @@ void *MallocZ(int);
 void *ReallocZ(void *oldptr, int obytes, int nbytes);
 void trace_init(void);
 void trace_done(void);
+void trace_flush(void);
 void seglist_init(tcb *);
 void printpacket(int, int, void *, int, struct ip *, void *plast, tcb *tcb);
 void plotter_vtick(PLOTTER, timeval, u_long);
@@ -804,6 +895,7 @@ void plotter_htick(PLOTTER, timeval, u_long);
 void plotter_dtick(PLOTTER, timeval, u_long);
 void plotter_dot(PLOTTER, timeval, u_long);
 void plotter_done(void);
+void plotter_release(PLOTTER);
 void plotter_dline(PLOTTER, timeval, u_long, timeval, u_long);
 void plotter_diamond(PLOTTER, timeval, u_long);
 void plotter_darrow(PLOTTER, timeval, u_long);
@@ -823,6 +915,8 @@ void PrintBrief(tcp_pair *);
 void UDPPrintBrief(udp_pair *);
 void OnlyConn(int);
 void IgnoreConn(int);
+Bool IgnoringConn(int);
+void SkipTcpPairs(int);
 void OnlyUDPConn(int);
 void IgnoreUDPConn(int);
 double elapsed(timeval, timeval);
@@ -852,20 +946,26 @@ void DoThru(tcb *ptcb, int nbytes);
 struct mfile *Mfopen(char *fname, char *mode);
 void Minit(void);
 int Mfileno(MFILE *pmf);
+char *Mfname(MFILE *pmf);
 int Mvfprintf(MFILE *pmf, char *format, va_list ap);
 int Mfwrite(void *buf, u_long size, u_long nitems, MFILE *pmf);
+int Mfpwrite(MFILE *pmf, void *buf, u_long len, u_llong offset);
 long Mftell(MFILE *pmf);
 int Mfseek(MFILE *pmf, long offset, int ptrname);
 int Mfprintf(MFILE *pmf, char *format, ...);
 int Mfflush(MFILE *pmf);
 int Mfclose(MFILE *pmf);
+int Mfrelease(MFILE *pmf);
 int Mfpipe(int pipes[2]);
+void Mfinish(void);
 struct tcp_options *ParseOptions(struct tcphdr *ptcp, void *plast);
 FILE *CompOpenHeader(char *filename);
 FILE *CompOpenFile(char *filename);
 void CompCloseFile(char *filename);
 void CompFormats(void);
 int CompIsCompressed(void);
+long CompPosition(void);
+void CompPrefetch(char *filename);
 Bool FileIsStdin(char *filename);
 struct tcb *ptp2ptcb(tcp_pair *ptp, struct ip *pip, struct tcphdr *ptcp);
 void PcapSavePacket(char *filename, struct ip *pip, void *plast);
@@ -879,16 +979,15 @@ Bool udp_cksum_valid(struct ip *pip, struct udphdr *pudp, void *plast);
 ipaddr *str2ipaddr(char *str);
 int IPcmp(ipaddr *pipA, ipaddr *pipB);
 void ModulesPerOldConn(tcp_pair *ptp);
+void ModulesPerOldUDPConn(udp_pair *pup);
+void ModulesPerStream(tcp_pair *ptp, tcb *ptcb, u_llong offset,
+		      char *pdata, u_long len);
 
 /* Memory allocation routines with page boundaries */ 
 tcp_pair *MakeTcpPair(void);
 void FreeTcpPair(tcp_pair *ptr);
 udp_pair *MakeUdpPair(void);
 void FreeUdpPair(udp_pair *ptr);
-seqspace *MakeSeqspace(void);
-void FreeSeqspace(seqspace *ptr);
-ptp_snap *MakePtpSnap(void);
-void FreePtpSnap(ptp_snap *ptr);
 segment *MakeSegment(void);
 void FreeSegment(segment *ptr);
 quadrant *MakeQuadrant(void);
@@ -897,10 +996,20 @@ ptp_ptr *MakePtpPtr(void);
 void FreePtpPtr(ptp_ptr *ptr);
 void freequad(quadrant **);
 
-/* AVL tree support routines */
-enum AVLRES SnapInsert(ptp_snap **n, ptp_snap *new_node);
-enum AVLRES SnapRemove(ptp_snap **n, tcp_pair_addrblock address);
-int AVL_WhichDir(tcp_pair_addrblock *ptpa1, tcp_pair_addrblock *ptpa2);
+/* memory that lives exactly as long as a connection (trace.c) */
+void *ConnAlloc(tcp_pair *ptp, unsigned bytes);
+char *ConnStrdup(tcp_pair *ptp, char *str);
+
+/* connection index support routines */
+hash64 AddrHash(tcp_pair_addrblock *ptpa);
+ptp_snap *SnapFind(tcp_pair_addrblock *paddr, int *pdir);
+void SnapInsert(tcp_pair_addrblock *paddr, void *ptp);
+void SnapRemove(tcp_pair_addrblock *paddr);
+void SnapStats(char *comment);
+ptp_snap *UdpSnapFind(udp_pair_addrblock *paddr, int *pdir);
+void UdpSnapInsert(udp_pair_addrblock *paddr, udp_pair *pup);
+void UdpSnapRemove(udp_pair_addrblock *paddr);
+void UdpSnapStats(char *comment);
     
 /* high-level line drawing */
 PLINE new_line(PLOTTER pl, char *label, char *color);
@@ -910,11 +1019,34 @@ void extend_line(PLINE pline, timeval xval, int yval);
 void udptrace_init(void);
 void udptrace_done(void);
 udp_pair *udpdotrace(struct ip *pip, struct udphdr *pudp, void *plast);
+void *UdpConnAlloc(udp_pair *pup, unsigned bytes);
 
 /* filter routines */
 void HelpFilter(void);
 void ParseFilter(char *expr);
 Bool PassesFilter(tcp_pair *ptp);
+Bool PassesEarlyFilter(tcp_pair *ptp);
+
+/* connection index routines */
+void IndexNotePacket(tcp_pair *ptp, int file_num);
+void IndexWrite(char **filenames, int count);
+void IndexLoad(char **filenames, int count);
+void IndexStartFile(int file_num);
+void IndexFinish(void);
+Bool IndexWantsPacket(struct ip *pip, void *plast, int file_num);
+
+/* packet filter routines */
+void InstallBPF(char *expr);
+Bool PassesBPF(struct ip *pip, void *plast, int len, int tlen);
+
+/* one's complement checksums (cksum.c) */
+struct cksum_kernel {
+    char *name;
+    u_short (*sum)(void *pvoid, int nbytes);	/* native order */
+    Bool (*usable)(void);			/* can this CPU run it? */
+};
+extern struct cksum_kernel cksum_kernels[];
+u_short OnesSum(void *pvoid, int nbytes);
 
 /* simple string expansion for file names, directories, etc */
 char *ExpandFormat(const char *format);
@@ -944,14 +1076,6 @@ of bits as specified in RFC 2481 and draft-ietf-tsvwg-ecn-04.txt */
 #define A2B 1
 #define B2A -1
 
-/* If the AVL node is to left or right in the AVL tree */
-/* Words "LEFT" and "RIGHT" have already been taken in an enum
- * above. Let us call them LT, RT just not to make it ambiguous for ourselves
- * or the compiler or both :-)
- */
-#define LT -2
-#define RT 2
-
 /*macros for maintaining the seqspace used for rexmit*/
 #define QUADSIZE	(0x40000000)
 #define QUADNUM(seq)	((seq>>30)+1)
@@ -1076,6 +1200,7 @@ struct tcp_options {
 #define THROUGHPUT_FILE_EXTENSION	"_tput.xpl"
 #define CONTENTS_FILE_EXTENSION		"_contents.dat"
 #define RECVWIN_FILE_EXTENSION		"_rwin.xpl"
+#define PLOTBIN_FILE_EXTENSION		".tpb"
 
 /* name of file to store filtered output into */
 #define PASS_FILTER_FILENAME		"PF"
@@ -1091,6 +1216,59 @@ struct tcp_options {
 typedef int pread_f(struct timeval *, int *, int *, void **,
 		   int *, struct ip **, void **);
 
+/* reading ahead in a separate thread (readahead.c) */
+pread_f *ReadAheadStart(pread_f *);
+void ReadAheadStop(void);
+
+/* writing the output files in the background (mfasync.c) */
+struct ma_file;
+Bool MAsyncStart(int nthreads);
+struct ma_file *MAsyncOpen(char *fname, Bool truncate);
+void MAsyncWrite(struct ma_file *pmaf, char *buf, u_long len, u_llong offset);
+void MAsyncClose(struct ma_file *pmaf);
+void MAsyncRelease(struct ma_file *pmaf);
+void MAsyncStop(void);
+
+/* graphs in a compact binary form (plotbin.c) */
+struct plotbin;
+struct plotbin *PlotBinOpen(MFILE *f);
+void PlotBinHeader(struct plotbin *ppb, Bool axis_switched, char *text);
+void PlotBinEvent(struct plotbin *ppb, char *cmd, int argc,
+		  struct timeval t1, u_long x1,
+		  struct timeval t2, u_long x2, char *color);
+void PlotBinClose(struct plotbin *ppb);
+char *PlotSwapExt(char *filename, char *ext);
+Bool PlotRender(char *filename, char *format);
+
+/* reading several files at once, in timestamp order (merge.c) */
+pread_f *MergeStart(char **names, int count);
+void MergeStop(void);
+
+/* capturing from a network interface (live.c) */
+pread_f *LiveStart(char *ifname);
+void LiveStop(void);
+void LiveStats(void);
+
+/* buffered --csv/--tsv/--sv rows (svout.c) */
+void SVRaw(char *str);
+void SVRawU(u_llong val);
+void SVField(char *str);
+void SVFieldU(u_llong val);
+void SVFieldF(double val, int prec);
+void SVEndRow(void);
+void SVFlush(void);
+
+/* in-order payload for the modules (reasm.c) */
+void ReasmNote(tcb *ptcb, seqnum seq, char *pdata, u_long len);
+void ReasmPacket(tcp_pair *ptp);
+void ReasmFlush(tcb *ptcb);
+void ReasmFinish(tcp_pair *ptp);
+void ReasmDone(void);
+void ReasmFree(tcp_pair *ptp);
+reasm_buf *ReasmHold(void);
+void ReasmRelease(reasm_buf *pbuf);
+pread_f *OpenTraceFile(char *filename);
+
 /* give the prototypes for the is_GLORP() routines supported */
 #ifdef GROK_SNOOP
 	pread_f *is_snoop(char *);
@@ -1100,7 +1278,11 @@ typedef int pread_f(struct timeval *, int *, int *, void **,
 #endif /* GROK_NETM */
 #ifdef GROK_TCPDUMP
 	pread_f *is_tcpdump(char *);
+	pread_f *is_pcap_mmap(char *);
 #endif /* GROK_TCPDUMP */
+long PcapMmapPosition(void);
+long PcapMmapPacketOffset(void);
+Bool PcapMmapSeek(u_long start, u_long stop);
 #ifdef GROK_ETHERPEEK
 	pread_f *is_EP(char *);
 #endif /* GROK_ETHERPEEK */
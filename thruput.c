@@ -69,15 +69,16 @@ DoThru(
     double etime;
     double thruput;
     char *myname, *hisname;
+    tcb_graphs *pgraphs = ptcb->pgraphs;
 
     /* init, if not already done */
-    if (ZERO_TIME(&ptcb->thru_firsttime)) {
+    if (ZERO_TIME(&pgraphs->thru_firsttime)) {
 	char title[210];
 
-	ptcb->thru_firsttime = current_time;
-	ptcb->thru_lasttime = current_time;
-	ptcb->thru_pkts = 1;
-	ptcb->thru_bytes = nbytes;
+	pgraphs->thru_firsttime = current_time;
+	pgraphs->thru_lasttime = current_time;
+	pgraphs->thru_pkts = 1;
+	pgraphs->thru_bytes = nbytes;
 	
 
 	/* bug fix from Michele Clark - UNC */
@@ -91,19 +92,19 @@ DoThru(
 	/* create the plotter file */
 	snprintf(title,sizeof(title),"%s_==>_%s (throughput)",
 		myname, hisname);
-	ptcb->thru_plotter = new_plotter(ptcb,NULL,title,
+	pgraphs->thru_plotter = new_plotter(ptcb,NULL,title,
 					 "time","thruput (bytes/sec)",
 					 THROUGHPUT_FILE_EXTENSION);
 	if (graph_time_zero) {
 	    /* set graph zero points */
-	    plotter_nothing(ptcb->thru_plotter, current_time);
+	    plotter_nothing(pgraphs->thru_plotter, current_time);
 	}
 
 	/* create lines for average and instantaneous values */
-	ptcb->thru_avg_line =
-	    new_line(ptcb->thru_plotter, "avg. tput", "blue");
-	ptcb->thru_inst_line =
-	    new_line(ptcb->thru_plotter, "inst. tput", "red");
+	pgraphs->thru_avg_line =
+	    new_line(pgraphs->thru_plotter, "avg. tput", "blue");
+	pgraphs->thru_inst_line =
+	    new_line(pgraphs->thru_plotter, "inst. tput", "red");
 
 	return;
     }
@@ -113,16 +114,16 @@ DoThru(
 	return;
 
     /* see if we should output the stats yet */
-    if (ptcb->thru_pkts+1 >= thru_interval) {
+    if (pgraphs->thru_pkts+1 >= thru_interval) {
 
 	/* compute stats for this interval */
-	etime = elapsed(ptcb->thru_firsttime,current_time);
+	etime = elapsed(pgraphs->thru_firsttime,current_time);
 	if (etime == 0.0)
 	    etime = 1000;	/* ick, what if "no time" has passed?? */
-	thruput = (double) ptcb->thru_bytes / ((double) etime / 1000000.0);
+	thruput = (double) pgraphs->thru_bytes / ((double) etime / 1000000.0);
 
 	/* instantaneous plot */
-	extend_line(ptcb->thru_inst_line,
+	extend_line(pgraphs->thru_inst_line,
 		     current_time, (int) thruput);
 
 	/* compute stats for connection lifetime */
@@ -132,28 +133,28 @@ DoThru(
 	thruput = (double) ptcb->data_bytes / ((double) etime / 1000000.0);
 
 	/* long-term average */
-	extend_line(ptcb->thru_avg_line,
+	extend_line(pgraphs->thru_avg_line,
 		     current_time, (int) thruput);
 
 	/* reset stats for this interval */
-	ptcb->thru_firsttime = current_time;
-	ptcb->thru_pkts = 0;
-	ptcb->thru_bytes = 0;
+	pgraphs->thru_firsttime = current_time;
+	pgraphs->thru_pkts = 0;
+	pgraphs->thru_bytes = 0;
     }
 
     /* immediate value in yellow ticks */
     if (plot_tput_instant) {
-	etime = elapsed(ptcb->thru_lasttime,current_time);
+	etime = elapsed(pgraphs->thru_lasttime,current_time);
 	if (etime == 0.0)
 	    etime = 1000;	/* ick, what if "no time" has passed?? */
 	thruput = (double) nbytes / ((double) etime / 1000000.0);
-	plotter_temp_color(ptcb->thru_plotter,"yellow");
-	plotter_dot(ptcb->thru_plotter,
+	plotter_temp_color(pgraphs->thru_plotter,"yellow");
+	plotter_dot(pgraphs->thru_plotter,
 		    current_time, (int) thruput);
     }
 
     /* add in the latest packet */
-    ptcb->thru_lasttime = current_time;
-    ++ptcb->thru_pkts;
-    ptcb->thru_bytes += nbytes;
+    pgraphs->thru_lasttime = current_time;
+    ++pgraphs->thru_pkts;
+    pgraphs->thru_bytes += nbytes;
 }
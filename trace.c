@@ -64,7 +64,6 @@ static char const GCC_UNUSED rcsid[] =
 
 /* locally global variables */
 static int tcp_packet_count = 0;
-static int search_count = 0;
 static int active_conn_count = 0;
 static int closed_conn_count = 0;
 static Bool *ignore_pairs = NULL;/* which ones will we ignore */
@@ -73,6 +72,11 @@ static Bool more_conns_ignored = FALSE;
 static double sample_elapsed_time=0; /* to keep track of owin samples */
 static double total_elapsed_time=0; /* to keep track of owin samples */ 
 static int num_removed_tcp_pairs = 0;
+static int num_streamed_tcp_pairs = 0;	/* reported in streaming mode */
+static Bool streamed_missing_data = FALSE; /* ... and had holes (see -e) */
+static tcb_extract *extr_lru_head = NULL; /* -e streams with bytes held, */
+static tcb_extract *extr_lru_tail = NULL; /* least recently used first */
+static u_long extr_buffered = 0;	  /* ...and their buffer space */
 static int tline_left  = 0; /* left and right time lines for the time line charts */
 static int tline_right = 0;
 
@@ -85,10 +89,21 @@ u_long tcp_trace_count = 0;
 
 /* local routine definitions */
 static tcp_pair *NewTTP(struct ip *, struct tcphdr *);
+static void InitGraphs(tcb_graphs *pgraphs);
+static void FreeGraphLines(tcb_graphs *pgraphs);
 static tcp_pair *FindTTP(struct ip *, struct tcphdr *, int *, ptp_ptr **);
 static void MoreTcpPairs(int num_needed);
 static void ExtractContents(u_long seq, u_long tcp_data_bytes,
 			    u_long saved_data_bytes, void *pdata, tcb *ptcb);
+static void ExtractWrite(tcb_extract *pext, u_llong offset, char *pdata,
+			 u_long len);
+static void ExtractFlush(tcb_extract *pext);
+static void ExtractPwrite(tcb_extract *pext, char *pdata, u_long len,
+			  u_llong offset);
+static void ExtractBufGrow(tcb_extract *pext, u_int need);
+static void ExtractBufUsed(tcb_extract *pext);
+static void ExtractBufFree(tcb_extract *pext);
+static void ExtractFinish(void);
 static Bool check_hw_dups(u_short id, seqnum seq, tcb *ptcb);
 static u_long SeqRep(tcb *ptcb, u_long seq);
 static void UpdateConnLists(ptp_ptr *tcp_ptr, struct tcphdr *ptcp);
@@ -103,6 +118,13 @@ static void RemoveOldConns(ptp_ptr **conn_list_head,
 			   int *conn_count);
 static void RemoveConn(const ptp_ptr *tcp_ptr);
 static void RemoveTcpPair(const ptp_ptr *tcp_ptr);
+static void ReleaseGraphs(tcb_graphs *pgraphs);
+static void ReleaseExtract(tcb_extract *pext);
+static void FinishIdleTime(tcp_pair *ptp);
+static void StreamConn(tcp_pair *ptp);
+static ptp_ptr *OldestConn(ptp_ptr *pkeep);
+static void RetireConn(ptp_ptr *tcp_ptr);
+static void EnforceMemBudget(ptp_ptr *pkeep);
 static Bool MissingData(tcp_pair *ptp);
 
 /* options */
@@ -327,110 +349,22 @@ CopyAddr(
     if (PIP_ISV4(pip)) { /* V4 */
 	IP_COPYADDR(&ptpa->a_address, IPV4ADDR2ADDR(&pip->ip_src));
 	IP_COPYADDR(&ptpa->b_address, IPV4ADDR2ADDR(&pip->ip_dst));
-	/* fill in the hashed address */
-	ptpa->hash = ptpa->a_address.un.ip4.s_addr
-	    + ptpa->b_address.un.ip4.s_addr
-	    + ptpa->a_port + ptpa->b_port;
-       
     } else { /* V6 */
-	int i;
 	struct ipv6 *pip6 = (struct ipv6 *)pip;
 	IP_COPYADDR(&ptpa->a_address, IPV6ADDR2ADDR(&pip6->ip6_saddr));
 	IP_COPYADDR(&ptpa->b_address, IPV6ADDR2ADDR(&pip6->ip6_daddr));
-	/* fill in the hashed address */
-	ptpa->hash = ptpa->a_port + ptpa->b_port;
-	for (i=0; i < 16; ++i) {
-	    ptpa->hash += ptpa->a_address.un.ip6.s6_addr[i];
-	    ptpa->hash += ptpa->b_address.un.ip6.s6_addr[i];
-	}
     }
 
+    /* fill in the hashed address */
+    ptpa->hash = AddrHash(ptpa);
+
     if (debug > 3)
-	printf("Hash of (%s:%d,%s:%d) is %d\n",
+	printf("Hash of (%s:%d,%s:%d) is %" FS_ULL "\n",
 	       HostName(ptpa->a_address),
 	       ptpa->a_port,
 	       HostName(ptpa->b_address),
 	       ptpa->b_port,
-	       ptpa->hash);
-}
-
-/* 
- * This function tells us which way to go (Left or Right) in search for our 
- * matching 4-tuple {IP1:port1; IP2:port2} in the AVL tree hash-bucket.
- * 
- * It returns LT or RT depending on if we had to go left or right in the AVL Tree to
- * find our exact 4-tuple match, if it existed in the tree.
- * If the exact 4-tuple is found, it returns 0.
- */
-
-int
-AVL_WhichDir(
-	     tcp_pair_addrblock *ptpa1,
-	     tcp_pair_addrblock *ptpa2)
-{
-
-    /*
-     * Here is our algorithm. If ptpa1={x1:p1; x2:p2} and ptpa2={y1:q1; y2:q2}
-     * we choose X1=min(x1,x2) and X2=max(x1,x2); Similarly for Y1, Y2.
-     * P1=port associated with X1, i.e. it is p1 if x1<x2 and it is p2 if not.
-     * P2=port associated with X2. Similarly Q1, Q2 are calculated based on Y1,Y2.
-     * 
-     * Compare (X1, Y1)? ; X1<Y1 => LEFT; X1>Y1 => RIGHT; X1==Y1 => Continue down
-     * 
-     * Compare (X2, Y2)? ; X2<Y2 => LEFT; X2>Y2 => RIGHT; X2==Y2 => Continue down
-     * 
-     * Compare (P1, Q1)? ; P1<Q1 => LEFT; P1>Q1 => RIGHT; P1==Q1 => Continue down
-     * 
-     * Compare (P2, Q2)? ; P2<Q2 => LEFT; P2>Q2 => RIGHT;
-     * 
-     * If P2==Q2, then this connection should have matched the A2B or B2A catch 
-     * from WhichDir()
-     */
-	
-    ipaddr *X1, *X2, *Y1, *Y2;
-    int P1, P2, Q1, Q2;
-	
-    if (IP_LOWADDR(&(ptpa1->a_address), &(ptpa1->b_address))) {		
-        X1=&ptpa1->a_address;
-	P1=ptpa1->a_port;	    
-	X2=&ptpa1->b_address;
-	P2=ptpa1->b_port;
-    } 
-    else {
-        X1=&ptpa1->b_address;
-	P1=ptpa1->b_port;
-	X2=&ptpa1->a_address;
-	P2=ptpa1->a_port;
-    }
-
-    if (IP_LOWADDR(&(ptpa2->a_address), &(ptpa2->b_address))) {		
-        Y1=&ptpa2->a_address;
-	Q1=ptpa2->a_port;
-	Y2=&ptpa2->b_address;
-	Q2=ptpa2->b_port;
-    } 
-    else {
-        Y1=&ptpa2->b_address;
-	Q1=ptpa2->b_port;	    
- 	Y2=&ptpa2->a_address;
-	Q2=ptpa2->a_port;
-    }
-
-    // Optimization suggested by Dr.Ostermann. Check the ports first.
-    if (P1<Q1) return LT;
-    if (Q1<P1) return RT;
-	
-    if (P2<Q2) return LT;
-    if (Q2<P2) return RT;
-
-
-    if (IP_LOWADDR(X1,Y1)) return LT;
-    if (IP_LOWADDR(Y1,X1)) return RT;
-	
-    if (IP_LOWADDR(X2,Y2)) return LT;
-    if (IP_LOWADDR(Y2,X2)) return RT;
-	
-    return 0;
+	       (u_llong)ptpa->hash);
 }
 
 int
@@ -493,6 +427,21 @@ SameConn(
 
 
 
+/* no plotters until the options that want them make them */
+static void
+InitGraphs(
+    tcb_graphs *pgraphs)
+{
+    pgraphs->thru_plotter = NO_PLOTTER;
+    pgraphs->tsg_plotter = NO_PLOTTER;
+    pgraphs->owin_plotter = NO_PLOTTER;
+    pgraphs->tline_plotter = NO_PLOTTER;
+    pgraphs->segsize_plotter = NO_PLOTTER;
+    pgraphs->recvwin_plotter = NO_PLOTTER;
+    pgraphs->rtt_plotter = NO_PLOTTER;
+}
+
+
 static tcp_pair *
 NewTTP(
     struct ip *pip,
@@ -506,6 +455,7 @@ NewTTP(
     }
     ptp = MakeTcpPair();
     ++num_tcp_pairs;
+    ptp->conn_num = num_tcp_pairs + 1;
 
     if (!run_continuously) {
       /* make a new one, if possible */
@@ -525,8 +475,13 @@ NewTTP(
     ptp->a2b.time.tv_sec = -1;
     ptp->b2a.time.tv_sec = -1;
 
-    ptp->a2b.host_letter = strdup(NextHostLetter());
-    ptp->b2a.host_letter = strdup(NextHostLetter());
+    /* in real-time mode, the connection's memory comes from an arena */
+    /* of its own that goes away with it (see ConnAlloc()) */
+    if (run_continuously)
+	ptp->parena = ArenaCreate(CONN_ARENA_SIZE);
+
+    ptp->a2b.host_letter = ConnStrdup(ptp,NextHostLetter());
+    ptp->b2a.host_letter = ConnStrdup(ptp,NextHostLetter());
 
     ptp->a2b.ptp = ptp;
     ptp->b2a.ptp = ptp;
@@ -534,16 +489,24 @@ NewTTP(
     ptp->b2a.ptwin = &ptp->a2b;
 
     /* fill in connection name fields */
-    ptp->a_hostname = strdup(HostName(ptp->addr_pair.a_address));
-    ptp->a_portname = strdup(ServiceName(ptp->addr_pair.a_port));
+    ptp->a_hostname = ConnStrdup(ptp,HostName(ptp->addr_pair.a_address));
+    ptp->a_portname = ConnStrdup(ptp,ServiceName(ptp->addr_pair.a_port));
     ptp->a_endpoint =
-	strdup(EndpointName(ptp->addr_pair.a_address,
-			    ptp->addr_pair.a_port));
-    ptp->b_hostname = strdup(HostName(ptp->addr_pair.b_address));
-    ptp->b_portname = strdup(ServiceName(ptp->addr_pair.b_port));
+	ConnStrdup(ptp,EndpointName(ptp->addr_pair.a_address,
+				    ptp->addr_pair.a_port));
+    ptp->b_hostname = ConnStrdup(ptp,HostName(ptp->addr_pair.b_address));
+    ptp->b_portname = ConnStrdup(ptp,ServiceName(ptp->addr_pair.b_port));
     ptp->b_endpoint = 
-	strdup(EndpointName(ptp->addr_pair.b_address,
-			    ptp->addr_pair.b_port));
+	ConnStrdup(ptp,EndpointName(ptp->addr_pair.b_address,
+				    ptp->addr_pair.b_port));
+
+    /* if the filter can already rule this connection out, don't */
+    /* bother analyzing (or graphing) it at all */
+    if (filter_output && !run_continuously && !ptp->ignore_pair &&
+	!PassesEarlyFilter(ptp)) {
+	ptp->ignore_pair = TRUE;
+	ptp->filtered_early = TRUE;
+    }
 
     /* make the initial guess that each side is a reno tcp */
     /* this might actually be a poor thing to do in the sense that
@@ -553,83 +516,88 @@ NewTTP(
     ptp->a2b.tcp_strain = TCP_RENO;
     ptp->b2a.tcp_strain = TCP_RENO;
 
-    ptp->a2b.LEAST = ptp->b2a.LEAST = 0;
     ptp->a2b.in_rto = ptp->b2a.in_rto = FALSE;
 
+    /* graph state is only carried by connections that might be graphed */
+    if (graph_tsg || graph_owin || graph_tline || graph_segsize ||
+	graph_recvwin || graph_rtt || graph_tput || dump_rtt) {
+	ptp->a2b.pgraphs = ConnAlloc(ptp,sizeof(tcb_graphs));
+	ptp->b2a.pgraphs = ConnAlloc(ptp,sizeof(tcb_graphs));
+	InitGraphs(ptp->a2b.pgraphs);
+	InitGraphs(ptp->b2a.pgraphs);
+    }
+
     /* init time sequence graphs */
-    ptp->a2b.tsg_plotter = ptp->b2a.tsg_plotter = NO_PLOTTER;
     if (graph_tsg && !ptp->ignore_pair) {
 	if (!ignore_non_comp || (SYN_SET(ptcp))) {
 	    snprintf(title,sizeof(title),"%s_==>_%s (time sequence graph)",
 		    ptp->a_endpoint, ptp->b_endpoint);
-	    ptp->a2b.tsg_plotter =
+	    ptp->a2b.pgraphs->tsg_plotter =
 		new_plotter(&ptp->a2b,NULL,title,
 			    graph_time_zero?"relative time":"time",
 			    graph_seq_zero?"sequence offset":"sequence number",
 			    PLOT_FILE_EXTENSION);
 	    snprintf(title,sizeof(title),"%s_==>_%s (time sequence graph)",
 		    ptp->b_endpoint, ptp->a_endpoint);
-	    ptp->b2a.tsg_plotter =
+	    ptp->b2a.pgraphs->tsg_plotter =
 		new_plotter(&ptp->b2a,NULL,title,
 			    graph_time_zero?"relative time":"time",
 			    graph_seq_zero?"sequence offset":"sequence number",
 			    PLOT_FILE_EXTENSION);
 	    if (graph_time_zero) {
 		/* set graph zero points */
-		plotter_nothing(ptp->a2b.tsg_plotter, current_time);
-		plotter_nothing(ptp->b2a.tsg_plotter, current_time);
+		plotter_nothing(ptp->a2b.pgraphs->tsg_plotter, current_time);
+		plotter_nothing(ptp->b2a.pgraphs->tsg_plotter, current_time);
 	    }
 	}
     }
 
     /* init owin graphs */
-    ptp->a2b.owin_plotter = ptp->b2a.owin_plotter = NO_PLOTTER;
     if (graph_owin && !ptp->ignore_pair) {
 	if (!ignore_non_comp || (SYN_SET(ptcp))) {
 	    snprintf(title,sizeof(title),"%s_==>_%s (outstanding data)",
 		    ptp->a_endpoint, ptp->b_endpoint);
-	    ptp->a2b.owin_plotter =
+	    ptp->a2b.pgraphs->owin_plotter =
 		new_plotter(&ptp->a2b,NULL,title,
 			    graph_time_zero?"relative time":"time",
 			    "Outstanding Data (bytes)",
 			    OWIN_FILE_EXTENSION);
 	    snprintf(title,sizeof(title),"%s_==>_%s (outstanding data)",
 		    ptp->b_endpoint, ptp->a_endpoint);
-	    ptp->b2a.owin_plotter =
+	    ptp->b2a.pgraphs->owin_plotter =
 		new_plotter(&ptp->b2a,NULL,title,
 			    graph_time_zero?"relative time":"time",
 			    "Outstanding Data (bytes)",
 			    OWIN_FILE_EXTENSION);
 	    if (graph_time_zero) {
 		/* set graph zero points */
-		plotter_nothing(ptp->a2b.owin_plotter, current_time);
-		plotter_nothing(ptp->b2a.owin_plotter, current_time);
+		plotter_nothing(ptp->a2b.pgraphs->owin_plotter, current_time);
+		plotter_nothing(ptp->b2a.pgraphs->owin_plotter, current_time);
 	    }
-	    ptp->a2b.owin_line =
-		new_line(ptp->a2b.owin_plotter, "owin", "red");
-	    ptp->b2a.owin_line =
-		new_line(ptp->b2a.owin_plotter, "owin", "red");
+	    ptp->a2b.pgraphs->owin_line =
+		new_line(ptp->a2b.pgraphs->owin_plotter, "owin", "red");
+	    ptp->b2a.pgraphs->owin_line =
+		new_line(ptp->b2a.pgraphs->owin_plotter, "owin", "red");
 
 	    if (show_rwinline) {
-	      ptp->a2b.rwin_line =
-	        new_line(ptp->a2b.owin_plotter, "rwin", "yellow");
-	      ptp->b2a.rwin_line =
-	        new_line(ptp->b2a.owin_plotter, "rwin", "yellow");
+	      ptp->a2b.pgraphs->rwin_line =
+	        new_line(ptp->a2b.pgraphs->owin_plotter, "rwin", "yellow");
+	      ptp->b2a.pgraphs->rwin_line =
+	        new_line(ptp->b2a.pgraphs->owin_plotter, "rwin", "yellow");
 	    }
 	  
-	    ptp->a2b.owin_avg_line =
-		new_line(ptp->a2b.owin_plotter, "avg owin", "blue");
-	    ptp->b2a.owin_avg_line =
-		new_line(ptp->b2a.owin_plotter, "avg owin", "blue");
-	    ptp->a2b.owin_wavg_line =
-		new_line(ptp->a2b.owin_plotter, "wavg owin", "green");
-	    ptp->b2a.owin_wavg_line =
-		new_line(ptp->b2a.owin_plotter, "wavg owin", "green");
+	    ptp->a2b.pgraphs->owin_avg_line =
+		new_line(ptp->a2b.pgraphs->owin_plotter, "avg owin", "blue");
+	    ptp->b2a.pgraphs->owin_avg_line =
+		new_line(ptp->b2a.pgraphs->owin_plotter, "avg owin", "blue");
+	    ptp->a2b.pgraphs->owin_wavg_line =
+		new_line(ptp->a2b.pgraphs->owin_plotter, "wavg owin", "green");
+	    ptp->b2a.pgraphs->owin_wavg_line =
+		new_line(ptp->b2a.pgraphs->owin_plotter, "wavg owin", "green");
 	}
     }
 
     /* init time line graphs (Avinash, 2 July 2002) */
-    ptp->a2b.tline_plotter = ptp->b2a.tline_plotter = NO_PLOTTER;
     if (graph_tline && !ptp->ignore_pair) {
 	if (!ignore_non_comp || (SYN_SET(ptcp))) {
 	    /* We don't want the standard a2b type name so we will specify
@@ -645,7 +613,7 @@ NewTTP(
 	     * segments going in either direction to be plotted on the same
 	     * graph
 	     */ 
-	    ptp->a2b.tline_plotter = ptp->b2a.tline_plotter =
+	    ptp->a2b.pgraphs->tline_plotter = ptp->b2a.pgraphs->tline_plotter =
 		new_plotter(&ptp->a2b,filename,title,
 			    "segments",
 			    "relative time",
@@ -657,11 +625,11 @@ NewTTP(
 	     * Both the plotters are the same so we will
 	     * only call this function once.
 	     */
-	    plotter_switch_axis(ptp->a2b.tline_plotter, TRUE);
+	    plotter_switch_axis(ptp->a2b.pgraphs->tline_plotter, TRUE);
 	      
 	    /* set graph zero points */
-	    plotter_nothing(ptp->a2b.tline_plotter, current_time);
-	    plotter_nothing(ptp->b2a.tline_plotter, current_time);
+	    plotter_nothing(ptp->a2b.pgraphs->tline_plotter, current_time);
+	    plotter_nothing(ptp->b2a.pgraphs->tline_plotter, current_time);
 
 	    /* Some graph initializations 
 	     * Generating a drawing space between x=0-100.
@@ -674,77 +642,72 @@ NewTTP(
 	     */
 	    tline_left  = 40;
 	    tline_right = 60;
-	    plotter_invisible(ptp->a2b.tline_plotter, current_time, 0);
-	    plotter_invisible(ptp->a2b.tline_plotter, current_time, 100);
+	    plotter_invisible(ptp->a2b.pgraphs->tline_plotter, current_time, 0);
+	    plotter_invisible(ptp->a2b.pgraphs->tline_plotter, current_time, 100);
 	}
     }
    
    
     /* init segment size graphs */
-    ptp->a2b.segsize_plotter = ptp->b2a.segsize_plotter = NO_PLOTTER;
     if (graph_segsize && !ptp->ignore_pair) {
 	snprintf(title,sizeof(title),"%s_==>_%s (segment size graph)",
 		ptp->a_endpoint, ptp->b_endpoint);
-	ptp->a2b.segsize_plotter =
+	ptp->a2b.pgraphs->segsize_plotter =
 	    new_plotter(&ptp->a2b,NULL,title,
 			graph_time_zero?"relative time":"time",
 			"segment size (bytes)",
 			SEGSIZE_FILE_EXTENSION);
 	snprintf(title,sizeof(title),"%s_==>_%s (segment size graph)",
 		ptp->b_endpoint, ptp->a_endpoint);
-	ptp->b2a.segsize_plotter =
+	ptp->b2a.pgraphs->segsize_plotter =
 	    new_plotter(&ptp->b2a,NULL,title,
 			graph_time_zero?"relative time":"time",
 			"segment size (bytes)",
 			SEGSIZE_FILE_EXTENSION);
 	if (graph_time_zero) {
 	    /* set graph zero points */
-	    plotter_nothing(ptp->a2b.segsize_plotter, current_time);
-	    plotter_nothing(ptp->b2a.segsize_plotter, current_time);
+	    plotter_nothing(ptp->a2b.pgraphs->segsize_plotter, current_time);
+	    plotter_nothing(ptp->b2a.pgraphs->segsize_plotter, current_time);
 	}
-	ptp->a2b.segsize_line =
-	    new_line(ptp->a2b.segsize_plotter, "segsize", "red");
-	ptp->b2a.segsize_line =
-	    new_line(ptp->b2a.segsize_plotter, "segsize", "red");
-	ptp->a2b.segsize_avg_line =
-	    new_line(ptp->a2b.segsize_plotter, "avg segsize", "blue");
-	ptp->b2a.segsize_avg_line =
-	    new_line(ptp->b2a.segsize_plotter, "avg segsize", "blue");
+	ptp->a2b.pgraphs->segsize_line =
+	    new_line(ptp->a2b.pgraphs->segsize_plotter, "segsize", "red");
+	ptp->b2a.pgraphs->segsize_line =
+	    new_line(ptp->b2a.pgraphs->segsize_plotter, "segsize", "red");
+	ptp->a2b.pgraphs->segsize_avg_line =
+	    new_line(ptp->a2b.pgraphs->segsize_plotter, "avg segsize", "blue");
+	ptp->b2a.pgraphs->segsize_avg_line =
+	    new_line(ptp->b2a.pgraphs->segsize_plotter, "avg segsize", "blue");
     }
 
     /* init RWIN graphs */
-    ptp->a2b.recvwin_plotter = ptp->b2a.recvwin_plotter = NO_PLOTTER;
     if (graph_recvwin && !ptp->ignore_pair) {
 	snprintf(title,sizeof(title),"%s_==>_%s (advertised receive window graph)",
 		ptp->a_endpoint, ptp->b_endpoint);
-	ptp->a2b.recvwin_plotter =
+	ptp->a2b.pgraphs->recvwin_plotter =
 	    new_plotter(&ptp->a2b,NULL,title,
 			graph_time_zero?"relative time":"time",
 			"advertised window (bytes)",
 			RECVWIN_FILE_EXTENSION);
 	snprintf(title,sizeof(title),"%s_==>_%s (advertised receive window graph)",
 		ptp->b_endpoint, ptp->a_endpoint);
-	ptp->b2a.recvwin_plotter =
+	ptp->b2a.pgraphs->recvwin_plotter =
 	    new_plotter(&ptp->b2a,NULL,title,
 			graph_time_zero?"relative time":"time",
 			"advertised window (bytes)",
 			RECVWIN_FILE_EXTENSION);
 	if (graph_time_zero) {
 	    /* set graph zero points */
-	    plotter_nothing(ptp->a2b.recvwin_plotter, current_time);
-	    plotter_nothing(ptp->b2a.recvwin_plotter, current_time);
+	    plotter_nothing(ptp->a2b.pgraphs->recvwin_plotter, current_time);
+	    plotter_nothing(ptp->b2a.pgraphs->recvwin_plotter, current_time);
 	}
-	ptp->a2b.recvwin_line =
-	    new_line(ptp->a2b.recvwin_plotter, "recvwin", "red");
-	ptp->b2a.recvwin_line =
-	    new_line(ptp->b2a.recvwin_plotter, "recvwin", "red");
+	ptp->a2b.pgraphs->recvwin_line =
+	    new_line(ptp->a2b.pgraphs->recvwin_plotter, "recvwin", "red");
+	ptp->b2a.pgraphs->recvwin_line =
+	    new_line(ptp->b2a.pgraphs->recvwin_plotter, "recvwin", "red");
     }
 
-    /* init RTT graphs */
-    ptp->a2b.rtt_plotter = ptp->b2a.rtt_plotter = NO_PLOTTER;
-
-    ptp->a2b.ss = MakeSeqspace();
-    ptp->b2a.ss = MakeSeqspace();
+    ptp->a2b.ss = ConnAlloc(ptp,sizeof(seqspace));
+    ptp->b2a.ss = ConnAlloc(ptp,sizeof(seqspace));
 
     ptp->filename = cur_filename;
 
@@ -753,26 +716,8 @@ NewTTP(
 
 
 
-/* connection records are stored in a hash table.  Buckets are linked	*/
-/* lists sorted by most recent access.					*/
-#ifdef SMALL_TABLE
-#define HASH_TABLE_SIZE 1021  /* oughta be prime */
-#else /* SMALL_TABLE */
-#define HASH_TABLE_SIZE 4099  /* oughta be prime */
-#endif /* SMALL_TABLE */
-static ptp_snap *ptp_hashtable[HASH_TABLE_SIZE] = {NULL};
-
-
-/* search efficiency data (optional) */
-/* one entry per hash table bucket */
-struct search_efficiency {
-    unsigned num_connections;
-    unsigned max_connections;
-    unsigned max_depth;
-    unsigned num_searches;
-    unsigned num_comparisons;
-};
-static struct search_efficiency hashtable_efficiency[HASH_TABLE_SIZE];
+/* connection records are indexed by a snapshot of their addresses, */
+/* kept in a growable hash table (see conntab.c)		     */
 
 
 /* double linked-lists of live and closed connections */
@@ -789,13 +734,9 @@ FindTTP(
     int *pdir,
     ptp_ptr **tcp_ptr)
 {
-    ptp_snap **pptph_head = NULL;
     ptp_snap *ptph;
     tcp_pair_addrblock	tp_in;
-    struct search_efficiency *pse = NULL;
-    unsigned depth = 0;
-    int dir, conn_status;
-    hash hval;
+    int dir;
     *tcp_ptr = NULL;
 
     if (debug > 10) {
@@ -805,179 +746,136 @@ FindTTP(
     /* grab the address from this packet */
     CopyAddr(&tp_in, pip, ntohs(ptcp->th_sport), ntohs(ptcp->th_dport));
 
-    /* grab the hash value (already computed by CopyAddr) */
-    hval = tp_in.hash % HASH_TABLE_SIZE;
-
-    pptph_head = &ptp_hashtable[hval];
+    /* See if the connection index already holds this exact */
+    /* connection, in either the A2B or B2A directions. */
+    if ((ptph = SnapFind(&tp_in, &dir)) != NULL) {
+	/* OK, this looks good, suck it into memory */
+	tcb *thisdir;
+	tcb *otherdir;
+	tcp_pair *ptp;
+	if (run_continuously) {
+	    ptp_ptr *ptr = (ptp_ptr *)ptph->ptp;
+	    ptp = ptr->ptp;
+	}
+	else {
+	    ptp = (tcp_pair *)ptph->ptp;
+	}
 
-    if (debug) {
-	/* search efficiency checking */
-	pse = &hashtable_efficiency[hval];
-    }
-   
-    if (pse) {
-	/* search efficiency instrumentation */
-	depth = 0;
-	++pse->num_searches;
-    }
-
-    for (ptph = *pptph_head; ptph; ) {
-	if (debug) {
-	    /* search efficiency instrumentation */
-	    ++search_count;
-	    if (pse) {
-		++depth;
-		++pse->num_comparisons;
-	    }
+	/* figure out which direction this packet is going */
+	if (dir == A2B) {
+	    thisdir  = &ptp->a2b;
+	    otherdir = &ptp->b2a;
+	} else {
+	    thisdir  = &ptp->b2a;
+	    otherdir = &ptp->a2b;
 	}
 
-	/* See if the current node in the AVL tree hash-bucket 
-	 * is the exact same connection as ourselves,
-	 * either in A2B or B2A directions.
-	 */
-	    
-	dir = WhichDir(&tp_in, &ptph->addr_pair);
-       	    
-	if (dir == A2B || dir == B2A) {
-	    /* OK, this looks good, suck it into memory */
-	  
-	    tcb *thisdir;
-	    tcb *otherdir;
-	    tcp_pair *ptp;
-	    if (run_continuously) {
-		ptp_ptr *ptr = (ptp_ptr *)ptph->ptp;
-		ptp = ptr->ptp;
-	    }
-	    else {
-		ptp = (tcp_pair *)ptph->ptp;
-	    }
-	  
-	    /* figure out which direction this packet is going */
-	    if (dir == A2B) {
-		thisdir  = &ptp->a2b;
-		otherdir = &ptp->b2a;
-	    } else {
-		thisdir  = &ptp->b2a;
-		otherdir = &ptp->a2b;
-	    }
-	  
-	    /* check for "inactive" */
-	    /* (this shouldn't happen anymore, they aren't on the list */
-	    if (ptp->inactive) {
-	     
-		if (!run_continuously)
-		    continue;
-		else {
-		    *tcp_ptr = (ptp_ptr *)ptph->ptp;
-		    return ((*tcp_ptr)->ptp);
+	/* check for "inactive" */
+	/* (this shouldn't happen anymore, they aren't in the index, */
+	/*  except in continuous mode where closed ones stay around) */
+	if (ptp->inactive && run_continuously && !stream_output) {
+	    *tcp_ptr = (ptp_ptr *)ptph->ptp;
+	    *pdir = dir;
+	    return ((*tcp_ptr)->ptp);
+	}
+
+
+	/* Fri Oct 16, 1998 */
+	/* note: original heuristic was not sufficient.  Bugs */
+	/* were pointed out by Brian Utterback and later by */
+	/* myself and Mark Allman */
+
+	/* (streaming mode reports connections, so it wants them split */
+	/*  up the same way) */
+	if (!run_continuously || stream_output) { 
+	    /* check for NEW connection on these same endpoints */
+	    /* 1) At least 4 minutes idle time */
+	    /*  OR */
+	    /* 2) heuristic (we might miss some) either: */
+	    /*    this packet has a SYN */
+	    /*    last conn saw both FINs and/or RSTs */
+	    /*    SYN sequence number outside last window (rfc 1122) */
+	    /*      (or less than initial Sequence, */
+	    /*       for wrap around trouble)  - Tue Nov  3, 1998*/
+	    /*  OR */
+	    /* 3) this is a SYN, last had a SYN, seq numbers differ */
+	    /* if so, mark it INACTIVE and skip from now on */
+	    if (0 && SYN_SET(ptcp)) {
+		/* better keep this debugging around, it keeps breaking */
+		printf("elapsed: %f sec\n",
+		       elapsed(ptp->last_time,current_time)/1000000);
+		printf("SYN_SET: %d\n", SYN_SET(ptcp));
+		printf("a2b.fin_count: %d\n", ptp->a2b.fin_count);
+		printf("b2a.fin_count: %d\n", ptp->b2a.fin_count);
+		printf("a2b.reset_count: %d\n", ptp->a2b.reset_count);
+		printf("b2a.reset_count: %d\n", ptp->b2a.reset_count);
+		printf("dir: %d (%s)\n", dir, dir==A2B?"A2B":"B2A");
+		printf("seq:    %lu \n", (u_long)ntohl(ptcp->th_seq));
+		printf("winend: %lu \n", otherdir->windowend);
+		printf("syn:    %lu \n", otherdir->syn);
+		printf("SEQ_GREATERTHAN winend: %d\n", 
+		       SEQ_GREATERTHAN(ntohl(ptcp->th_seq),otherdir->windowend));
+		printf("SEQ_LESSTHAN init syn: %d\n", 
+		       SEQ_LESSTHAN(ntohl(ptcp->th_seq),thisdir->syn));
+	    } 
+
+	    if (/* rule 1 */
+		(elapsed(ptp->last_time,current_time)/1000000 > nonreal_live_conn_interval)//(4*60)) - Using nonreal_live_conn_interval instead of the 4 mins heuristic
+		|| /* rule 2 */
+		((SYN_SET(ptcp)) && 
+		 (((thisdir->fin_count >= 1) ||
+		   (otherdir->fin_count >= 1)) ||
+		  ((thisdir->reset_count >= 1) ||
+		   (otherdir->reset_count >= 1))) &&
+		 (SEQ_GREATERTHAN(ntohl(ptcp->th_seq),otherdir->windowend) ||
+		  SEQ_LESSTHAN(ntohl(ptcp->th_seq),thisdir->syn)))
+		|| /* rule 3 */
+		(SYN_SET(ptcp) &&
+		 (thisdir->syn_count > 1) &&
+		 (thisdir->syn != ntohl(ptcp->th_seq)))) {
+
+		if (debug>1) {
+		    printf("%s: Marking %p %s<->%s INACTIVE (idle: %f sec)\n",
+			   ts2ascii(&current_time),
+			   ptp,
+			   ptp->a_endpoint, ptp->b_endpoint,
+			   elapsed(ptp->last_time,
+				   current_time)/1000000);
+		    if (debug > 3)
+			PrintTrace(ptp);
 		}
-	    }
-	  
-	  
-	    /* Fri Oct 16, 1998 */
-	    /* note: original heuristic was not sufficient.  Bugs */
-	    /* were pointed out by Brian Utterback and later by */
-	    /* myself and Mark Allman */
-	  
-	    if (!run_continuously) { 
-		/* check for NEW connection on these same endpoints */
-		/* 1) At least 4 minutes idle time */
-		/*  OR */
-		/* 2) heuristic (we might miss some) either: */
-		/*    this packet has a SYN */
-		/*    last conn saw both FINs and/or RSTs */
-		/*    SYN sequence number outside last window (rfc 1122) */
-		/*      (or less than initial Sequence, */
-		/*       for wrap around trouble)  - Tue Nov  3, 1998*/
-		/*  OR */
-		/* 3) this is a SYN, last had a SYN, seq numbers differ */
-		/* if so, mark it INACTIVE and skip from now on */
-		if (0 && SYN_SET(ptcp)) {
-		    /* better keep this debugging around, it keeps breaking */
-		    printf("elapsed: %f sec\n",
-			   elapsed(ptp->last_time,current_time)/1000000);
-		    printf("SYN_SET: %d\n", SYN_SET(ptcp));
-		    printf("a2b.fin_count: %d\n", ptp->a2b.fin_count);
-		    printf("b2a.fin_count: %d\n", ptp->b2a.fin_count);
-		    printf("a2b.reset_count: %d\n", ptp->a2b.reset_count);
-		    printf("b2a.reset_count: %d\n", ptp->b2a.reset_count);
-		    printf("dir: %d (%s)\n", dir, dir==A2B?"A2B":"B2A");
-		    printf("seq:    %lu \n", (u_long)ntohl(ptcp->th_seq));
-		    printf("winend: %lu \n", otherdir->windowend);
-		    printf("syn:    %lu \n", otherdir->syn);
-		    printf("SEQ_GREATERTHAN winend: %d\n", 
-			   SEQ_GREATERTHAN(ntohl(ptcp->th_seq),otherdir->windowend));
-		    printf("SEQ_LESSTHAN init syn: %d\n", 
-			   SEQ_LESSTHAN(ntohl(ptcp->th_seq),thisdir->syn));
-		} 
-	     
-		if (/* rule 1 */
-		    (elapsed(ptp->last_time,current_time)/1000000 > nonreal_live_conn_interval)//(4*60)) - Using nonreal_live_conn_interval instead of the 4 mins heuristic
-		    || /* rule 2 */
-		    ((SYN_SET(ptcp)) && 
-		     (((thisdir->fin_count >= 1) ||
-		       (otherdir->fin_count >= 1)) ||
-		      ((thisdir->reset_count >= 1) ||
-		       (otherdir->reset_count >= 1))) &&
-		     (SEQ_GREATERTHAN(ntohl(ptcp->th_seq),otherdir->windowend) ||
-		      SEQ_LESSTHAN(ntohl(ptcp->th_seq),thisdir->syn)))
-		    || /* rule 3 */
-		    (SYN_SET(ptcp) &&
-		     (thisdir->syn_count > 1) &&
-		     (thisdir->syn != ntohl(ptcp->th_seq)))) {
-		
-		    if (debug>1) {
-			printf("%s: Marking %p %s<->%s INACTIVE (idle: %f sec)\n",
-			       ts2ascii(&current_time),
-			       ptp,
-			       ptp->a_endpoint, ptp->b_endpoint,
-			       elapsed(ptp->last_time,
-				       current_time)/1000000);
-			if (debug > 3)
-			    PrintTrace(ptp);
-		    }
-		
+
+		if (run_continuously) {
+		    /* in streaming mode, the old one is done, so report */
+		    /* on it and get rid of it now */
+		    RetireConn((ptp_ptr *)ptph->ptp);
+		} else {
 		    /* we won't need this one anymore, remove it from the */
-		    /* hash table so we won't have to skip over it */
+		    /* index so we won't have to skip over it */
 		    ptp->inactive = TRUE;
-		
+
 		    if (debug > 4)
-			printf("Removing connection from hashtable:\
+			printf("Removing connection from index:\
                           FindTTP() calling SnapRemove()\n");
-		
-		    /* Removes connection snapshot from AVL tree */
-		    SnapRemove(pptph_head, ptph->addr_pair); 
-		
-		    break;
+
+		    SnapRemove(&ptp->addr_pair);
 		}
+
+		ptph = NULL;
 	    }
-	  
+	}
+
+	if (ptph) {
 	    if (run_continuously) 
 		(*tcp_ptr) = (ptp_ptr *)ptph->ptp;
-	  
+
 	    *pdir = dir;
 	    return (ptp);
-	} else {  // WhichDir returned 0, meaning if it exists, it's deeper 
-	    conn_status = AVL_WhichDir(&tp_in,&ptph->addr_pair);	
-	    if (conn_status == LT)
-		ptph = ptph->left;
-	    else if (conn_status == RT)
-		ptph = ptph->right;
-	    else if (!conn_status)  {
-		fprintf(stderr, "WARNING!! AVL_WhichDir() should not return 0 if\n"
-				"\tWhichDir() didn't return A2B or B2A previously\n");
-		break;
-	    }
 	}
     }
    
    
     /* Didn't find it, make a new one, if possible */
-    if (0) {
-	printf("trace.c:FindTTP() calling MakePtpSnap()\n");
-    }
-    ptph = MakePtpSnap();
-  
     if (run_continuously) {
 	ptp_ptr *ptr = (ptp_ptr *)MakePtpPtr();
 	ptr->prev = NULL;
@@ -992,10 +890,7 @@ FindTTP(
 	    live_conn_list_head->prev = ptr;
 	    live_conn_list_head = ptr;
 	}
-	ptr->from = ptph;
 	ptr->ptp = NewTTP(pip, ptcp);
-	ptph->addr_pair = ptr->ptp->addr_pair;
-	ptph->ptp = (void *)ptr;
 	if (conn_num_threshold) {
 	    active_conn_count++;
 	    if (active_conn_count > max_conn_num) {
@@ -1008,37 +903,29 @@ FindTTP(
 		FreePtpPtr(last_ptr);
 	    }
 	}
+
+	/* To insert the new connection snapshot into the index */
+	if (debug > 4)
+	    printf("Inserting connection into index:\
+             FindTTP() calling SnapInsert() \n");
+	SnapInsert(&ptr->ptp->addr_pair, ptr);
+
+	*pdir = A2B;
+	*tcp_ptr = ptr;
+	return (ptr->ptp);
     }
     else {
 	tcp_pair *tmp = NewTTP(pip,ptcp);
-	ptph->addr_pair = tmp->addr_pair;
-	ptph->ptp = tmp;
-    }
 
-    /* To insert the new connection snapshot into the AVL tree */
-   
-    if (debug > 4)
-	printf("Inserting connection into hashtable:\
+	/* To insert the new connection snapshot into the index */
+	if (debug > 4)
+	    printf("Inserting connection into index:\
              FindTTP() calling SnapInsert() \n");
-    SnapInsert(pptph_head, ptph);
-   
-    if (pse) {
-	/* search efficiency instrumentation */
-	++pse->num_connections;
-	if (depth > pse->max_depth)
-	    pse->max_depth = depth;
-	if (pse->num_connections > pse->max_connections)
-	    pse->max_connections = pse->num_connections;
-    }
+	SnapInsert(&tmp->addr_pair, tmp);
 
-
-    *pdir = A2B;
-    if (run_continuously) {
-	*tcp_ptr = (ptp_ptr *)ptph->ptp;
-	return ((*tcp_ptr)->ptp);
+	*pdir = A2B;
+	return (tmp);
     }
-    else
-	return (tcp_pair *)(ptph->ptp);
 }
      
 static void 
@@ -1146,6 +1033,10 @@ UpdateConnLists(
     }
     last_update_time = current_time;
   }
+
+  /* keep the connection state within the streaming memory budget */
+  if (stream_mem)
+    EnforceMemBudget(tcp_ptr);
 }
 
 
@@ -1255,108 +1146,261 @@ RemoveOldConns(
 
 
 
-/* remove tcp pair from the hash table */
+/* remove tcp pair from the connection index */
 static void
 RemoveConn(
 	   const ptp_ptr *tcp_ptr)
 {
-  hash		hval;
-   
    if (0) {
       printf("trace.c: RemoveConn(%p %s<->%s) called\n", 
 	     tcp_ptr->ptp, tcp_ptr->ptp->a_endpoint, tcp_ptr->ptp->b_endpoint);
    }
    
+   /* in streaming mode, this is the last chance to report on it */
+   if (stream_output)
+     StreamConn(tcp_ptr->ptp);
+
    ModulesPerOldConn(tcp_ptr->ptp);
    
-   hval = tcp_ptr->ptp->addr_pair.hash % HASH_TABLE_SIZE;
-   
-   /* Remove the connection snapshot from AVL tree */
+   /* Remove the connection snapshot from the index */
    if (debug > 4)
-     printf("Removing connection from hashtable:\
+     printf("Removing connection from index:\
              RemoveConn() calling SnapRemove()\n");
    
-   SnapRemove(&ptp_hashtable[hval], tcp_ptr->ptp->addr_pair);
+   SnapRemove(&tcp_ptr->ptp->addr_pair);
    
    RemoveTcpPair(tcp_ptr);
 }
 
 
 
+/* in streaming mode, each connection is reported as it's retired, */
+/* the same way that trace_done() reports on all of them otherwise */
 static void
-RemoveTcpPair(
-	      const ptp_ptr *tcp_ptr)
+StreamConn(
+	   tcp_pair *ptp)
 {
-  int	i = 0;
-  tcp_pair *ptp = tcp_ptr->ptp;
+    if (printsuppress || ptp->ignore_pair)
+	return;
+    if (filter_output && !PassesFilter(ptp))
+	return;
+    if (ignore_non_comp && !ConnComplete(ptp))
+	return;
 
-  if (0) {
-    printf("trace.c: RemoveTcpPair(%p) called\n", tcp_ptr->ptp);
-  }
-  
-  free(ptp->a2b.host_letter);
-  free(ptp->b2a.host_letter);
+    FinishIdleTime(ptp);
+
+    if (num_streamed_tcp_pairs++ == 0)
+	fprintf(stdout,"%sTCP connection info:\n", comment);
+
+    if (printbrief) {
+	fprintf(stdout,"%3d: ", ptp->conn_num);
+	PrintBrief(ptp);
+    } else {
+	if (csv || tsv || (sv != NULL)) {
+	    if (num_streamed_tcp_pairs == 1)
+		PrintSVHeader();
+	    SVRawU(ptp->conn_num);
+	    SVRaw(sp);
+	} else {
+	    if (num_streamed_tcp_pairs > 1)
+		fprintf(stdout,"================================\n");
+	    fprintf(stdout,"TCP connection %d:\n", ptp->conn_num);
+	}
+	PrintTrace(ptp);
+
+	/* out it goes, one write() per row, so it's not held up (or */
+	/* overtaken by anything else printed while we keep going) */
+	SVFlush();
+    }
+
+    if (save_tcp_data && MissingData(ptp))
+	streamed_missing_data = TRUE;
+}
+
+
+
+/* the connection that's been quiet the longest, open or closed, but */
+/* never pkeep (which is the one the current packet belongs to) */
+static ptp_ptr *
+OldestConn(
+	   ptp_ptr *pkeep)
+{
+    ptp_ptr *plive = live_conn_list_tail;
+    ptp_ptr *pclosed = closed_conn_list_tail;
+
+    /* pkeep was just moved to the head, so if it's the tail, it's alone */
+    if (plive == pkeep)
+	plive = NULL;
+    if (pclosed == pkeep)
+	pclosed = NULL;
+
+    if (plive == NULL)
+	return(pclosed);
+    if (pclosed == NULL)
+	return(plive);
+
+    if (tv_lt(pclosed->ptp->last_time, plive->ptp->last_time))
+	return(pclosed);
+    return(plive);
+}
+
+
+
+/* take a connection off its list and get rid of it */
+static void
+RetireConn(
+	   ptp_ptr *tcp_ptr)
+{
+    if (tcp_ptr->ptp->inactive) {
+	UpdateConnList(tcp_ptr, FALSE,
+		       &closed_conn_list_head, &closed_conn_list_tail);
+	if (conn_num_threshold)
+	    --closed_conn_count;
+    } else {
+	UpdateConnList(tcp_ptr, FALSE,
+		       &live_conn_list_head, &live_conn_list_tail);
+	if (conn_num_threshold)
+	    --active_conn_count;
+    }
 
-  free(ptp->a_hostname);
-  free(ptp->a_portname);
-  free(ptp->a_endpoint);
+    RemoveConn(tcp_ptr);
+    num_removed_tcp_pairs++;
+    FreePtpPtr(tcp_ptr);
+}
 
-  free(ptp->b_hostname);
-  free(ptp->b_portname);
-  free(ptp->b_endpoint);
 
-  if (ptp->a2b.owin_line) {
-    free(ptp->a2b.owin_line);
+
+/* retire the least recently active connections until the rest of */
+/* them fit in --stream_mem.  What's counted is the connection state */
+/* proper: the pools (pairs, segments, quadrants) and the arenas that */
+/* hold everything else a connection owns */
+static void
+EnforceMemBudget(
+		 ptp_ptr *pkeep)
+{
+    unsigned long budget = stream_mem * 1024 * 1024;
+    ptp_ptr *ptr;
+
+    while (PoolBytesInUse() + ArenaBytes() > budget) {
+	if ((ptr = OldestConn(pkeep)) == NULL)
+	    break;  /* just the current one, nothing we can do */
+
+	if (debug > 1)
+	    fprintf(stderr,"Over the memory budget, retiring %s<->%s\n",
+		    ptr->ptp->a_endpoint, ptr->ptp->b_endpoint);
+
+	RetireConn(ptr);
+    }
+}
+
+
+
+static void
+FreeGraphLines(
+	       tcb_graphs *pgraphs)
+{
+  if (pgraphs->owin_line) {
+    free(pgraphs->owin_line);
   }
-  
   if (show_rwinline) {
-    if (ptp->a2b.rwin_line) {
-      free(ptp->a2b.rwin_line);
+    if (pgraphs->rwin_line) {
+      free(pgraphs->rwin_line);
     }
   }
-    
-  if (ptp->a2b.owin_avg_line) {
-    free(ptp->a2b.owin_avg_line);
-  }
-  if (ptp->a2b.owin_wavg_line) {
-    free(ptp->a2b.owin_avg_line);
+  if (pgraphs->owin_avg_line) {
+    free(pgraphs->owin_avg_line);
   }
-  if (ptp->b2a.owin_line) {
-    free(ptp->b2a.owin_line);
+  if (pgraphs->owin_wavg_line) {
+    free(pgraphs->owin_wavg_line);
   }
-  
-  if (show_rwinline) {
-    if (ptp->b2a.rwin_line) {
-      free(ptp->b2a.rwin_line);
-    }
+
+  if (pgraphs->segsize_line) {
+    free(pgraphs->segsize_line);
   }
-  
-  if (ptp->b2a.owin_avg_line) {
-    free(ptp->b2a.owin_avg_line);
+  if (pgraphs->segsize_avg_line) {
+    free(pgraphs->segsize_avg_line);
   }
-  if (ptp->b2a.owin_wavg_line) {
-    free(ptp->b2a.owin_wavg_line);
+
+  if (pgraphs->recvwin_line) {
+    free(pgraphs->recvwin_line);
   }
 
-  if (ptp->a2b.segsize_line) {
-    free(ptp->a2b.segsize_line);
+  if (pgraphs->thru_avg_line) {
+    free(pgraphs->thru_avg_line);
   }
-  if (ptp->a2b.segsize_avg_line) {
-    free(ptp->a2b.segsize_avg_line);
+  if (pgraphs->thru_inst_line) {
+    free(pgraphs->thru_inst_line);
   }
-  if (ptp->b2a.segsize_line) {
-    free(ptp->b2a.segsize_line);
+  if (pgraphs->rtt_line) {
+    free(pgraphs->rtt_line);
   }
-  if (ptp->b2a.segsize_avg_line) {
-    free(ptp->b2a.segsize_avg_line);
+}
+
+
+
+/* finish the connection's graphs and close its dump file, giving the */
+/* plotter slots back for the connections that come along later */
+static void
+ReleaseGraphs(
+	      tcb_graphs *pgraphs)
+{
+  plotter_release(pgraphs->thru_plotter);
+  plotter_release(pgraphs->tsg_plotter);
+  plotter_release(pgraphs->tline_plotter); /* shared, 2nd call is a no-op */
+  plotter_release(pgraphs->rtt_plotter);
+  plotter_release(pgraphs->segsize_plotter);
+  plotter_release(pgraphs->owin_plotter);
+  plotter_release(pgraphs->recvwin_plotter);
+
+  if ((pgraphs->rtt_dump_file != NULL) &&
+      (pgraphs->rtt_dump_file != (MFILE *) -1)) {
+    Mfrelease(pgraphs->rtt_dump_file);
   }
+}
+
+
+
+static void
+ReleaseExtract(
+	       tcb_extract *pext)
+{
+  ExtractBufFree(pext);
 
-  if (ptp->a2b.recvwin_line) {
-    free(ptp->a2b.recvwin_line);
+  if ((pext->extr_contents_file != NULL) &&
+      (pext->extr_contents_file != (MFILE *) -1)) {
+    Mfrelease(pext->extr_contents_file);
   }
-  if (ptp->b2a.recvwin_line) {
-    free(ptp->b2a.recvwin_line);
+}
+
+
+
+static void
+RemoveTcpPair(
+	      const ptp_ptr *tcp_ptr)
+{
+  int	i = 0;
+  tcp_pair *ptp = tcp_ptr->ptp;
+
+  if (0) {
+    printf("trace.c: RemoveTcpPair(%p) called\n", tcp_ptr->ptp);
+  }
+  
+  if (ptp->a2b.pgraphs) {
+    ReleaseGraphs(ptp->a2b.pgraphs);
+    FreeGraphLines(ptp->a2b.pgraphs);
   }
+  if (ptp->b2a.pgraphs) {
+    ReleaseGraphs(ptp->b2a.pgraphs);
+    FreeGraphLines(ptp->b2a.pgraphs);
+  }
+
+  if (ptp->a2b.pextract)
+    ReleaseExtract(ptp->a2b.pextract);
+  if (ptp->b2a.pextract)
+    ReleaseExtract(ptp->b2a.pextract);
+
+  if (reassemble_streams)
+    ReasmFree(ptp);
 
   if (ptp->a2b.ss) {
     for (i = 0; i < 4; i++) {
@@ -1364,7 +1408,6 @@ RemoveTcpPair(
 	freequad(&ptp->a2b.ss->pquad[i]);
       }
     }
-    FreeSeqspace(ptp->a2b.ss);
   }
 
   if (ptp->b2a.ss) {
@@ -1373,14 +1416,42 @@ RemoveTcpPair(
 	freequad(&ptp->b2a.ss->pquad[i]);
       }
     }
-    FreeSeqspace(ptp->b2a.ss);
   }
 
+  /* the names, sequence spaces, and module records all go at once */
+  ArenaFree(ptp->parena);
+
   FreeTcpPair(ptp);
 }
 
 
 
+/* give out memory that lives exactly as long as the connection, from */
+/* its own arena in real-time mode (where connections are removed) */
+/* and from the run-lifetime arena otherwise (where they never are) */
+void *
+ConnAlloc(
+    tcp_pair *ptp,
+    unsigned bytes)
+{
+    if (ptp->parena)
+	return(ArenaAlloc(ptp->parena,bytes));
+    return(RunAlloc(bytes));
+}
+
+
+char *
+ConnStrdup(
+    tcp_pair *ptp,
+    char *str)
+{
+    if (ptp->parena)
+	return(ArenaStrdup(ptp->parena,str));
+    return(RunStrdup(str));
+}
+
+
+
 tcp_pair *
 dotrace(
     struct ip *pip,
@@ -1620,6 +1691,10 @@ dotrace(
     /***********************************************************************/
     /***********************************************************************/
     if (ptp_save->ignore_pair) {
+	/* the options are still checked for truncation, so that the */
+	/* "too short to process" count doesn't depend on -f */
+	if (ptp_save->filtered_early)
+	    (void) ParseOptions(ptcp,plast);
 	return(ptp_save);
     }
 
@@ -1649,11 +1724,11 @@ dotrace(
 
 
     /* plotter shorthand */
-    to_tsgpl     = otherdir->tsg_plotter;
-    from_tsgpl   = thisdir->tsg_plotter;
+    to_tsgpl     = TCB_PLOTTER(otherdir,tsg_plotter);
+    from_tsgpl   = TCB_PLOTTER(thisdir,tsg_plotter);
    
     /* plotter shorthand (NOTE: we are using one plotter for both directions) */
-    tlinepl      = thisdir->tline_plotter;
+    tlinepl      = TCB_PLOTTER(thisdir,tline_plotter);
 
     /* check the options */
     ptcpo = ParseOptions(ptcp,plast);
@@ -1724,9 +1799,11 @@ dotrace(
     }
 
     /* segment size graphs */
-    if ((tcp_data_length > 0) && (thisdir->segsize_plotter != NO_PLOTTER)) {
-	extend_line(thisdir->segsize_line, current_time, tcp_data_length);
-	extend_line(thisdir->segsize_avg_line, current_time,
+    if ((tcp_data_length > 0) &&
+	(TCB_PLOTTER(thisdir,segsize_plotter) != NO_PLOTTER)) {
+	extend_line(thisdir->pgraphs->segsize_line, current_time,
+		    tcp_data_length);
+	extend_line(thisdir->pgraphs->segsize_avg_line, current_time,
 		    thisdir->data_bytes / thisdir->data_pkts);
     }
 
@@ -1774,6 +1851,11 @@ dotrace(
 
 	if (save_tcp_data)
 	    ExtractContents(start,tcp_data_length,saved,pdata,thisdir);
+
+	/* and put aside for the modules that read the streams */
+	if (reassemble_streams && (pdata <= (u_char *)plast))
+	    ReasmNote(thisdir, SYN_SET(ptcp) ? start+1 : start,
+		      (char *)pdata, saved);
     }
 
     /* do rexmit stats */
@@ -1856,26 +1938,29 @@ dotrace(
         otherdir->lastackno = th_ack;	
     }
 
-    /* LEAST */
+    /* LEAST (in_rto means there's been a retransmission, so pleast */
+    /* is there) */
     if (thisdir->tcp_strain == TCP_RENO) {
       if (thisdir->in_rto && tcp_data_length > 0) {
-        if (retrans_num_bytes>0 && th_seq < thisdir->recovered)
-          thisdir->event_retrans++;
+        tcb_least *pleast = thisdir->pleast;
+        if (retrans_num_bytes>0 && th_seq < pleast->recovered)
+          pleast->event_retrans++;
         if (IsRTO(thisdir, th_seq)) {
-          thisdir->recovered = thisdir->recovered_orig = thisdir->seq;
-          thisdir->rto_segment = th_seq;
+          pleast->recovered = pleast->recovered_orig = thisdir->seq;
+          pleast->rto_segment = th_seq;
         }
-        if (!(retrans_num_bytes>0) && thisdir->ack <= thisdir->recovered_orig)
-          thisdir->recovered = th_seq;
+        if (!(retrans_num_bytes>0) && thisdir->ack <= pleast->recovered_orig)
+          pleast->recovered = th_seq;
       }
       if (otherdir->in_rto && ACK_SET(ptcp)) {
-        if (th_ack > otherdir->recovered) {
-          otherdir->LEAST -=
-            (otherdir->event_dupacks < otherdir->event_retrans)?
-             otherdir->event_dupacks:otherdir->event_retrans;
+        tcb_least *pleast = otherdir->pleast;
+        if (th_ack > pleast->recovered) {
+          pleast->LEAST -=
+            (pleast->event_dupacks < pleast->event_retrans)?
+             pleast->event_dupacks:pleast->event_retrans;
           otherdir->in_rto = FALSE;
         } else if (th_ack == otherdir->lastackno &&
-                   th_ack >= otherdir->rto_segment) otherdir->event_dupacks++;
+                   th_ack >= pleast->rto_segment) pleast->event_dupacks++;
       }
     }
 
@@ -1893,16 +1978,18 @@ dotrace(
     /* stats for rexmitted data */
     if (retrans_num_bytes>0) {
 	retrans = TRUE;
+	if (thisdir->pleast == NULL)
+	    thisdir->pleast = ConnAlloc(thisdir->ptp,sizeof(tcb_least));
         /* for reno LEAST estimate */
         if (thisdir->tcp_strain == TCP_RENO &&
             !thisdir->in_rto && IsRTO(thisdir, th_seq)) {
           thisdir->in_rto = TRUE;
-          thisdir->recovered = thisdir->recovered_orig = thisdir->seq;
-          thisdir->rto_segment = th_seq;
-          thisdir->event_retrans = 1; thisdir->event_dupacks = 0;
+          thisdir->pleast->recovered = thisdir->pleast->recovered_orig = thisdir->seq;
+          thisdir->pleast->rto_segment = th_seq;
+          thisdir->pleast->event_retrans = 1; thisdir->pleast->event_dupacks = 0;
         }
 	thisdir->rexmit_pkts += 1;
-	thisdir->LEAST++;
+	thisdir->pleast->LEAST++;
 	thisdir->rexmit_bytes += retrans_num_bytes;
 	/* don't color the SYNs and FINs, it's confusing, we'll do them */
 	/* differently below... */
@@ -2363,14 +2450,16 @@ dotrace(
 	    /* case 1, first block under cumack */
 	    if (ptcpo->sacks[0].sack_right <= th_ack) {
 	        thisdir->num_dsacks++;
-	        if (otherdir->LEAST > 0) otherdir->LEAST--;
+	        if (otherdir->pleast && (otherdir->pleast->LEAST > 0))
+		    --otherdir->pleast->LEAST;
 	    /* case 2, first block inside second */
 	    } else if (ptcpo->sack_count > 1) {
 	        if (ptcpo->sacks[0].sack_right <= ptcpo->sacks[1].sack_right
 	            && ptcpo->sacks[0].sack_left >= ptcpo->sacks[1].sack_left)
 	        {
 	            thisdir->num_dsacks++;
-	            if (otherdir->LEAST > 0) otherdir->LEAST--;
+	            if (otherdir->pleast && (otherdir->pleast->LEAST > 0))
+			--otherdir->pleast->LEAST;
 	    /* case 3, first and second block overlap */
 	        } else if ((ptcpo->sacks[0].sack_left <=
 	                    ptcpo->sacks[1].sack_left &&
@@ -2381,7 +2470,8 @@ dotrace(
 	                  ptcpo->sacks[0].sack_left <
 	                    ptcpo->sacks[1].sack_right)) {
                     thisdir->num_dsacks++;
-	            if (otherdir->LEAST > 0) otherdir->LEAST--;
+	            if (otherdir->pleast && (otherdir->pleast->LEAST > 0))
+			--otherdir->pleast->LEAST;
 	        }
 	    }
 	    /* if we saw any dsacks from the other guy, we'll assume he did
@@ -2493,8 +2583,8 @@ dotrace(
         	total_elapsed_time = (elapsed(ptp_save->first_time, ptp_save->last_time))/1000000;
 		thisdir->owin_wavg += (u_llong)((thisdir->previous_owin_sample) * sample_elapsed_time);
 		/* graph owin_wavg */
-		if (thisdir->owin_plotter != NO_PLOTTER) {
-			extend_line(thisdir->owin_wavg_line, thisdir->previous_owin_sample_time,
+		if (TCB_PLOTTER(thisdir,owin_plotter) != NO_PLOTTER) {
+			extend_line(thisdir->pgraphs->owin_wavg_line, thisdir->previous_owin_sample_time,
 		        	(total_elapsed_time)?((u_llong)((thisdir->owin_wavg)/total_elapsed_time)):0);
 		} 
 	    	thisdir->previous_owin_sample_time = thisdir->last_time;
@@ -2502,19 +2592,19 @@ dotrace(
 	}
 
 	/* graph owin */
-	if (thisdir->owin_plotter != NO_PLOTTER) {
-	    extend_line(thisdir->owin_line, current_time, owin);
+	if (TCB_PLOTTER(thisdir,owin_plotter) != NO_PLOTTER) {
+	    extend_line(thisdir->pgraphs->owin_line, current_time, owin);
 	    if (show_rwinline) {
-	      extend_line(thisdir->rwin_line, current_time, 
+	      extend_line(thisdir->pgraphs->rwin_line, current_time, 
 			  otherdir->win_last);
 	    }
-	    extend_line(thisdir->owin_avg_line, current_time,
+	    extend_line(thisdir->pgraphs->owin_avg_line, current_time,
 			(thisdir->owin_count?(thisdir->owin_tot/thisdir->owin_count):0)); 
 	}
 
 	/* add to rwin graph */
-	if (thisdir->recvwin_plotter != NO_PLOTTER) {
-	    extend_line(thisdir->recvwin_line, current_time, otherdir->win_last);
+	if (TCB_PLOTTER(thisdir,recvwin_plotter) != NO_PLOTTER) {
+	    extend_line(thisdir->pgraphs->recvwin_line, current_time, otherdir->win_last);
 	}
 
     }
@@ -2527,6 +2617,52 @@ dotrace(
 
 
 
+/* at the end of a streaming run, report on and release whatever */
+/* connections are left, in the order they went quiet */
+void
+trace_flush(void)
+{
+    ptp_ptr *ptr;
+
+    if (!stream_output)
+	return;
+
+    while ((ptr = OldestConn(NULL)) != NULL)
+	RetireConn(ptr);
+}
+
+
+/* complete the "idle time" calculations using NOW */
+static void
+FinishIdleTime(
+    tcp_pair *ptp)
+{
+    tcb *thisdir; 
+    u_llong itime;
+
+    /* if it's CLOSED, skip it */
+    if ((FinCount(ptp)>=2) || (ConnReset(ptp)))
+	return;
+
+    /* a2b direction */
+    thisdir = &ptp->a2b;
+    if (!ZERO_TIME(&thisdir->last_time)) {
+	itime = elapsed(thisdir->last_time,current_time);
+	if (itime > thisdir->idle_max)
+	    thisdir->idle_max = itime;
+    }
+	
+
+    /* b2a direction */
+    thisdir = &ptp->b2a;
+    if (!ZERO_TIME(&thisdir->last_time)) {
+	itime = elapsed(thisdir->last_time,current_time);
+	if (itime > thisdir->idle_max)
+	    thisdir->idle_max = itime;
+    }
+}
+
+
 void
 trace_done(void)
 {
@@ -2535,10 +2671,32 @@ trace_done(void)
   int ix;
   static int count = 0;
   Bool incomplete_pkt_capture = FALSE;
+
+  /* the contents files get whatever they're still owed */
+  ExtractFinish();
   
+  if (stream_output) {
+    if (!printsuppress) {
+	if (num_streamed_tcp_pairs == 0)
+	    fprintf(stdout,"%sno TCP connections reported\n", comment);
+	fprintf(stdout,"%s%d TCP %s traced, %d reported\n",
+		comment,
+		num_tcp_pairs + 1,
+		num_tcp_pairs==0?"connection":"connections",
+		num_streamed_tcp_pairs);
+    }
+    if (debug>1) {
+	fprintf(stdout,"%sTotal TCP packets: %u\n", comment, tcp_packet_count);
+	SnapStats(comment);
+    }
+    incomplete_pkt_capture = streamed_missing_data;
+  }
+
   if (!run_continuously) {
     if (!printsuppress) {
-	if (tcp_trace_count == 0) {
+	/* (with --use_index, the connections we skipped over count, */
+	/* even if we didn't read a single packet) */
+	if ((tcp_trace_count == 0) && (num_tcp_pairs < 0)) {
 	    fprintf(stdout,"%sno traced TCP packets\n", comment);
 	    return;
 	} else {
@@ -2562,70 +2720,13 @@ trace_done(void)
 
     /* generate statistics for data storage efficiency */
     if (debug>1) {
-	int h;
-	int occupied_buckets = 0;
-	int max_bucket_occupancy = 0;
-	int max_searches = 0;
-	int max_depth = 0;
-	int max_comparisons = 0;
-	float max_searches_compare = 0.0;
-	fprintf(stdout,"%sTotal searches: %u\n", comment, tcp_packet_count);
-	fprintf(stdout,"%s  Total comparisons: %u\n", comment, search_count);
-	fprintf(stdout,"%s  Average compares/search: %.2f\n",
-		comment, (float)search_count / (float)tcp_packet_count);
-	fprintf(stdout,"%sHash table size: %u\n", comment, HASH_TABLE_SIZE);
-	for (h=0; h < HASH_TABLE_SIZE; ++h) {
-	    struct search_efficiency *pse = &hashtable_efficiency[h];
-	    float searches_compare;
-	    if (pse->num_connections > 0)
-		++occupied_buckets;
-	    if (pse->max_connections > max_bucket_occupancy)
-		max_bucket_occupancy = pse->max_connections;
-	    if (pse->num_searches > max_searches)
-		max_searches = pse->num_searches;
-	    if (pse->num_comparisons > max_comparisons)
-		max_comparisons = pse->num_comparisons;
-	    if (pse->max_depth > max_depth)
-		max_depth = pse->max_depth;
-	    searches_compare = (float) pse->num_comparisons / (float) pse->num_searches;
-	    if (searches_compare > max_searches_compare)
-		max_searches_compare = searches_compare;
-	}
-	fprintf(stdout,"%s    Occupied hash buckets: %u\n", comment, occupied_buckets);
-	fprintf(stdout,"%s    Max entries/bucket: %u\n", comment, max_bucket_occupancy);
-	fprintf(stdout,"%s    Max searches/bucket: %u\n", comment, max_searches);
-	fprintf(stdout,"%s    Max comparisons/bucket: %u\n", comment, max_comparisons);
-	fprintf(stdout,"%s    Max avg compares/search: %.2f\n", comment, max_searches_compare);
-	fprintf(stdout,"%s    Max tree depth: %u\n", comment, max_depth);
+	fprintf(stdout,"%sTotal TCP packets: %u\n", comment, tcp_packet_count);
+	SnapStats(comment);
     }
 
     /* complete the "idle time" calculations using NOW */
-    for (ix = 0; ix <= num_tcp_pairs; ++ix) {
-	tcp_pair *ptp = ttp[ix];
-	tcb *thisdir; 
-	u_llong itime;
-
-	/* if it's CLOSED, skip it */
-	if ((FinCount(ptp)>=2) || (ConnReset(ptp)))
-	    continue;
-
-	/* a2b direction */
-	thisdir = &ptp->a2b;
-	if (!ZERO_TIME(&thisdir->last_time)) {
-	    itime = elapsed(thisdir->last_time,current_time);
-	    if (itime > thisdir->idle_max)
-		thisdir->idle_max = itime;
-	}
-	    
-
-	/* b2a direction */
-	thisdir = &ptp->b2a;
-	if (!ZERO_TIME(&thisdir->last_time)) {
-	    itime = elapsed(thisdir->last_time,current_time);
-	    if (itime > thisdir->idle_max)
-		thisdir->idle_max = itime;
-	}
-    }
+    for (ix = 0; ix <= num_tcp_pairs; ++ix)
+	FinishIdleTime(ttp[ix]);
   }
 
     /* if we're filtering, see which connections pass */
@@ -2676,7 +2777,8 @@ trace_done(void)
 			  PrintSVHeader();
 			  first = FALSE;
 		       }
-		       fprintf(stdout, "%d%s", ix+1, sp);
+		       SVRawU(ix+1);
+		       SVRaw(sp);
 		    }
 		    else {
 		       if (ix > 0)
@@ -2708,6 +2810,7 @@ trace_done(void)
 	    }	  
 	}
     }
+    SVFlush();
   }
   
     /* if we're filtering, close the file */
@@ -2786,11 +2889,6 @@ trace_init(void)
 
     initted = TRUE;
 
-    /* create an array to hold any pairs that we might create */
-    ttp = (tcp_pair **) MallocZ(max_tcp_pairs * sizeof(tcp_pair *));
-
-    /* create an array to keep track of which ones to ignore */
-    ignore_pairs = (Bool *) MallocZ(max_tcp_pairs * sizeof(Bool));
     if (!run_continuously) {
         /* create an array to hold any pairs that we might create */
         ttp = (tcp_pair **) MallocZ(max_tcp_pairs * sizeof(tcp_pair *));
@@ -2848,6 +2946,58 @@ OnlyConn(
 }
 
 
+/* will connection number "ix" be ignored? */
+Bool
+IgnoringConn(
+    int ix)
+{
+    --ix;
+
+    if (ix >= max_tcp_pairs)
+	return(more_conns_ignored);
+
+    return(ignore_pairs[ix]);
+}
+
+
+/* Make the next new connection number "ix", as if all of the ones in */
+/* between had been seen (and ignored).  The index uses this when it */
+/* skips over the parts of the file it doesn't need. */
+void
+SkipTcpPairs(
+    int ix)
+{
+    static tcp_pair skipped_pair;
+
+    if (run_continuously)
+	return;
+
+    /* all of the skipped ones share a single, ignored, stand-in */
+    if (skipped_pair.a_hostname == NULL) {
+	skipped_pair.ignore_pair = TRUE;
+	skipped_pair.inactive = TRUE;
+	skipped_pair.a_hostname = skipped_pair.b_hostname = "";
+	skipped_pair.a_portname = skipped_pair.b_portname = "";
+	skipped_pair.a_endpoint = skipped_pair.b_endpoint = "";
+	skipped_pair.a2b.ptp = skipped_pair.b2a.ptp = &skipped_pair;
+	skipped_pair.a2b.ptwin = &skipped_pair.b2a;
+	skipped_pair.b2a.ptwin = &skipped_pair.a2b;
+    }
+
+    --ix;
+    while (num_tcp_pairs+1 < ix) {
+	++num_tcp_pairs;
+	if ((num_tcp_pairs+1) >= max_tcp_pairs)
+	    MoreTcpPairs(num_tcp_pairs+1);
+	ttp[num_tcp_pairs] = &skipped_pair;
+
+	/* keep the host letters the same as a full run */
+	NextHostLetter();
+	NextHostLetter();
+    }
+}
+
+
 /* get a long (4 byte) option (to avoid address alignment problems) */
 static u_long
 get_long_opt(
@@ -3065,16 +3215,8 @@ ExtractContents(
     tcb *ptcb)
 {
     u_long missing;
-    long offset;
-    u_long fptr;
-	/* Maximum filename could be :
-		aaaaaaaa2bbbbbbbb_contents.dat which
-		takes 8+1+8+ size of the extension */
-    static char filename[MAX_HOSTLETTER_LEN
-					+1      /* for "2" */
-					+MAX_HOSTLETTER_LEN
-					+sizeof(CONTENTS_FILE_EXTENSION)
-					+1];    /* for terminating NULL. */
+    long long offset;
+    tcb_extract *pext;
 
     if (debug > 2)
 	fprintf(stderr,
@@ -3091,47 +3233,38 @@ ExtractContents(
 		missing,tcp_data_bytes,saved_data_bytes);
     }
 
-    
-    /* if the FILE is "-1", couldn't open file */
-    if (ptcb->extr_contents_file == (MFILE *) -1) {
-	return;
-    }
-
-    /* if the FILE is NULL, open file */
-    snprintf(filename,sizeof(filename),"%s2%s%s", ptcb->host_letter, ptcb->ptwin->host_letter,
-	    CONTENTS_FILE_EXTENSION);
-    if (ptcb->extr_contents_file == (MFILE *) NULL) {
-	MFILE *f;
-
-	if ((f = Mfopen(filename,"w")) == NULL) {
-	    perror(filename);
-	    ptcb->extr_contents_file = (MFILE *) -1;
-	}
-
-	if (debug)
-	    fprintf(stderr,"TCP contents file is '%s'\n", filename);
-
-	ptcb->extr_contents_file = f;
+    /* the extraction state comes into being with the first saved bytes */
+    if (ptcb->pextract == NULL) {
+	ptcb->pextract = ConnAlloc(ptcb->ptp,sizeof(tcb_extract));
+	pext = ptcb->pextract;
+	pext->ptcb = ptcb;
 
 	if (ptcb->syn_count == 0) {
 	    /* we haven't seen the SYN.  This is bad because we can't tell */
 	    /* if there is data BEFORE this, which makes it tough to store */
 	    /* the file.  Let's be optimistic and hope we don't see */
 	    /* anything before this point.  Otherwise, we're stuck */
-	    ptcb->extr_lastseq = seq;
+	    pext->extr_lastseq = seq;
 	} else {
 	    /* beginning of the file is the data just past the SYN */
-	    ptcb->extr_lastseq = ptcb->syn+1;
+	    pext->extr_lastseq = ptcb->syn+1;
 	}
-	/* in any case, anything before HERE is illegal (fails for very */
-	/* long files - FIXME */
-	ptcb->extr_initseq = ptcb->extr_lastseq;
+	pext->extr_lastoff = 0;
+    }
+    pext = ptcb->pextract;
+
+    /* if the FILE is "-1", couldn't open file */
+    if (pext->extr_contents_file == (MFILE *) -1) {
+	return;
     }
 
-    /* it's illegal for the bytes to be BEFORE extr_initseq unless the file */
-    /* is "really long" (seq space has wrapped around) - FIXME(ugly) */
-    if ((SEQCMP(seq,ptcb->extr_initseq) < 0) &&
-	(ptcb->data_bytes < (0xffffffff/2))) {
+    /* see where we should start writing: measured from the last */
+    /* thing we stored, so the file can be longer than the sequence */
+    /* space */
+    offset = (long long)pext->extr_lastoff + (int)(seq - pext->extr_lastseq);
+
+    /* it's illegal for the bytes to be before the start of the file */
+    if (offset < 0) {
 	/* if we haven't (didn't) seen the SYN, then can't do this!! */
 	if (debug>1) {
 	    fprintf(stderr,
@@ -3141,47 +3274,225 @@ ExtractContents(
 	return;
     }
 
-    /* see where we should start writing */
-    /* a little complicated, because we want to support really long files */
-    offset = SEQCMP(seq,ptcb->extr_lastseq);
-    
-
-    if (debug>10)
+    if (debug>1)
 	fprintf(stderr,
-		"TRYING to save %ld bytes from stream '%s2%s' at offset %ld\n",
+		"Saving %ld bytes from '%s2%s' at offset %lld\n",
 		saved_data_bytes,
 		ptcb->host_letter, ptcb->ptwin->host_letter,
 		offset);
 
-    /* seek to the correct place in the file */
-    if (Mfseek(ptcb->extr_contents_file, offset, SEEK_CUR) == -1) {
-	perror("fseek");
-	exit(-1);
+    ExtractWrite(pext, offset, pdata, saved_data_bytes);
+
+    pext->extr_lastseq = seq;
+    pext->extr_lastoff = offset;
+}
+
+
+
+/* store the bytes, gathering up the ones that follow on from each */
+/* other so that the file sees a few big writes, not a seek and a */
+/* write for every segment */
+static void
+ExtractWrite(
+    tcb_extract *pext,
+    u_llong offset,
+    char *pdata,
+    u_long len)
+{
+    u_llong end = offset + len;
+
+    /* in (or just past) what we're holding, and it fits */
+    if ((pext->extr_buf_len > 0) &&
+	(offset >= pext->extr_buf_off) &&
+	(offset <= pext->extr_buf_off + pext->extr_buf_len) &&
+	(end - pext->extr_buf_off <= EXTR_BUF_SIZE)) {
+	ExtractBufUsed(pext);
+	if (end - pext->extr_buf_off > pext->extr_buf_size)
+	    ExtractBufGrow(pext, end - pext->extr_buf_off);
+	memcpy(pext->extr_buf + (offset - pext->extr_buf_off), pdata, len);
+	if (end - pext->extr_buf_off > pext->extr_buf_len)
+	    pext->extr_buf_len = end - pext->extr_buf_off;
+	return;
     }
 
-    /* see where we are */
-    fptr = Mftell(ptcb->extr_contents_file);
+    /* otherwise, what we have goes first (the later bytes win) */
+    ExtractFlush(pext);
 
-    if (debug>1)
+    /* too big to be worth holding, just write it */
+    if (len >= EXTR_BUF_SIZE) {
+	ExtractPwrite(pext, pdata, len, offset);
+	return;
+    }
+
+    /* start gathering again here */
+    if (len > pext->extr_buf_size)
+	ExtractBufGrow(pext, len);
+    memcpy(pext->extr_buf, pdata, len);
+    pext->extr_buf_off = offset;
+    pext->extr_buf_len = len;
+    ExtractBufUsed(pext);
+}
+
+
+
+/* write out the bytes being gathered */
+static void
+ExtractFlush(
+    tcb_extract *pext)
+{
+    if (pext->extr_buf_len == 0)
+	return;
+
+    ExtractPwrite(pext, pext->extr_buf, pext->extr_buf_len,
+		  pext->extr_buf_off);
+    pext->extr_buf_len = 0;
+}
+
+
+
+/* put bytes in the stream's file (opening it the first time) */
+static void
+ExtractPwrite(
+    tcb_extract *pext,
+    char *pdata,
+    u_long len,
+    u_llong offset)
+{
+    tcb *ptcb = pext->ptcb;
+	/* Maximum filename could be :
+		aaaaaaaa2bbbbbbbb_contents.dat which
+		takes 8+1+8+ size of the extension */
+    static char filename[MAX_HOSTLETTER_LEN
+					+1      /* for "2" */
+					+MAX_HOSTLETTER_LEN
+					+sizeof(CONTENTS_FILE_EXTENSION)
+					+1];    /* for terminating NULL. */
+
+    /* if the FILE is NULL, open file */
+    if (pext->extr_contents_file == (MFILE *) NULL) {
+	MFILE *f;
+
+	snprintf(filename,sizeof(filename),"%s2%s%s",
+		 ptcb->host_letter, ptcb->ptwin->host_letter,
+		 CONTENTS_FILE_EXTENSION);
+
+	if ((f = Mfopen(filename,"w")) == NULL) {
+	    perror(filename);
+	    pext->extr_contents_file = (MFILE *) -1;
+	    return;
+	}
+
+	if (debug)
+	    fprintf(stderr,"TCP contents file is '%s'\n", filename);
+
+	pext->extr_contents_file = f;
+    }
+
+    if (pext->extr_contents_file == (MFILE *) -1)
+	return;
+
+    if (debug>10)
 	fprintf(stderr,
-		"Saving %ld bytes from '%s2%s' at offset %ld in file '%s'\n",
-		saved_data_bytes,
-		ptcb->host_letter, ptcb->ptwin->host_letter,
-		fptr, filename);
+		"Writing %ld bytes from stream '%s2%s' at offset %llu\n",
+		len, ptcb->host_letter, ptcb->ptwin->host_letter, offset);
 
     /* store the bytes */
-    if (Mfwrite(pdata,1,saved_data_bytes,ptcb->extr_contents_file)
-	!= saved_data_bytes) {
-	perror("fwrite");
+    if (Mfpwrite(pext->extr_contents_file, pdata, len, offset) != 0) {
+	perror("pwrite");
 	exit(-1);
     }
+}
 
-    /* go back to where we started to not confuse the next write */
-    ptcb->extr_lastseq = seq;
-    if (Mfseek(ptcb->extr_contents_file, fptr, SEEK_SET) == -1) {
-	perror("fseek 2");
-	exit(-1);
-    }
+
+
+/* make room for "need" bytes in the stream's buffer, taking the */
+/* memory back from the streams that haven't been written to lately */
+/* if there isn't enough to go around */
+static void
+ExtractBufGrow(
+    tcb_extract *pext,
+    u_int need)
+{
+    u_int nsize = (pext->extr_buf_size > 0) ? pext->extr_buf_size : EXTR_BUF_MIN;
+
+    while (nsize < need)
+	nsize *= 2;
+    if (nsize > EXTR_BUF_SIZE)
+	nsize = EXTR_BUF_SIZE;
+
+    while ((extr_buffered + (nsize - pext->extr_buf_size) > EXTR_BUF_TOTAL) &&
+	   (extr_lru_head != NULL) && (extr_lru_head != pext))
+	ExtractBufFree(extr_lru_head);
+
+    pext->extr_buf = ReallocZ(pext->extr_buf, pext->extr_buf_size, nsize);
+    extr_buffered += nsize - pext->extr_buf_size;
+    pext->extr_buf_size = nsize;
+}
+
+
+
+/* the stream's buffer was just used, so it goes to the end of the line */
+static void
+ExtractBufUsed(
+    tcb_extract *pext)
+{
+    if (pext == extr_lru_tail)
+	return;
+
+    /* off the list (if it's there) ... */
+    if (pext->extr_prev)
+	pext->extr_prev->extr_next = pext->extr_next;
+    else if (extr_lru_head == pext)
+	extr_lru_head = pext->extr_next;
+    if (pext->extr_next)
+	pext->extr_next->extr_prev = pext->extr_prev;
+
+    /* ... and back on the end */
+    pext->extr_next = NULL;
+    pext->extr_prev = extr_lru_tail;
+    if (extr_lru_tail)
+	extr_lru_tail->extr_next = pext;
+    else
+	extr_lru_head = pext;
+    extr_lru_tail = pext;
+}
+
+
+
+/* write out and give back a stream's buffer */
+static void
+ExtractBufFree(
+    tcb_extract *pext)
+{
+    if (pext->extr_buf == NULL)
+	return;
+
+    ExtractFlush(pext);
+
+    if (pext->extr_prev)
+	pext->extr_prev->extr_next = pext->extr_next;
+    else
+	extr_lru_head = pext->extr_next;
+    if (pext->extr_next)
+	pext->extr_next->extr_prev = pext->extr_prev;
+    else
+	extr_lru_tail = pext->extr_prev;
+    pext->extr_next = pext->extr_prev = NULL;
+
+    free(pext->extr_buf);
+    pext->extr_buf = NULL;
+    extr_buffered -= pext->extr_buf_size;
+    pext->extr_buf_size = 0;
+}
+
+
+
+/* write out everything that's still being gathered */
+static void
+ExtractFinish(void)
+{
+    while (extr_lru_head != NULL)
+	ExtractBufFree(extr_lru_head);
 }
 
 
@@ -3195,10 +3506,15 @@ check_hw_dups(
 {
     int i;
     struct str_hardware_dups *pshd;
+    tcb_hwdups *phd;
+
+    if (tcb->phwdups == NULL)
+	tcb->phwdups = ConnAlloc(tcb->ptp,sizeof(tcb_hwdups));
+    phd = tcb->phwdups;
 
     /* see if we've seen this one before */
     for (i=0; i < SEGS_TO_REMEMBER; ++i) {
-	pshd = &tcb->hardware_dups[i];
+	pshd = &phd->hardware_dups[i];
 	
 	if ((pshd->hwdup_seq == seq) && (pshd->hwdup_id == id) &&
 	    (pshd->hwdup_seq != 0) && (pshd->hwdup_id != 0)) {
@@ -3214,11 +3530,11 @@ check_hw_dups(
     }
 
     /* remember it */
-    pshd = &tcb->hardware_dups[tcb->hardware_dups_ix];
+    pshd = &phd->hardware_dups[phd->hardware_dups_ix];
     pshd->hwdup_seq = seq;
     pshd->hwdup_id = id;
     pshd->hwdup_packnum = pnum;
-    tcb->hardware_dups_ix = (tcb->hardware_dups_ix+1) % SEGS_TO_REMEMBER;
+    phd->hardware_dups_ix = (phd->hardware_dups_ix+1) % SEGS_TO_REMEMBER;
 
     return(FALSE);
 }
@@ -3263,39 +3579,6 @@ SeqRep(
 }
 
 
-/*------------------------------------------------------------------------
- *  cksum  -  Return 16-bit ones complement of 16-bit ones complement sum 
- *------------------------------------------------------------------------
- */
-static u_short
-cksum(
-    void *pvoid,		/* any alignment is legal */
-    int nbytes)
-{
-    u_char *pchar = pvoid;
-    u_long sum = 0;
-
-    while (nbytes >= 2) {
-	/* can't assume pointer alignment :-( */
-	sum += (pchar[0]<<8);
-	sum += pchar[1];
-
-	pchar+=2;
-	nbytes -= 2;
-    }
-
-    /* special check for odd length */
-    if (nbytes == 1) {
-	sum += (pchar[0]<<8);
-	/* lower byte is assumed to be 0 */
-    }
-
-    sum = (sum >> 16) + (sum & 0xffff);	/* add in carry   */
-    sum += (sum >> 16);			/* maybe one more */
-
-    return(sum);
-}
-
 /* compute IP checksum */
 static u_short
 ip_cksum(
@@ -3316,7 +3599,7 @@ ip_cksum(
     }
 
     /* ... else IPv4 */
-    sum = cksum(pip, IP_HL(pip)*4);
+    sum = OnesSum(pip, IP_HL(pip)*4);
     return(sum);
 }
 
@@ -3371,7 +3654,7 @@ tcp_cksum(
 	}
 
 	/* 2 4-byte numbers, next to each other */
-	sum += cksum(&pip->ip_src,4*2);
+	sum += OnesSum(&pip->ip_src,4*2);
 
 	/* type */
 	sum += (u_short) pip->ip_p;
@@ -3396,7 +3679,7 @@ tcp_cksum(
        
         /* Forming the pseudo-header */
         /* source address */
-        sum += cksum(&pip6->ip6_saddr,16);
+        sum += OnesSum(&pip6->ip6_saddr,16);
        
         /* Looking for the destination address.
 	 * May be in the IPv6 header or the last address in the 
@@ -3405,7 +3688,7 @@ tcp_cksum(
        
         /* No extension headers, hence, routing header not present */
         if(pip6->ip6_nheader == IPPROTO_TCP) {
-	   sum += cksum(&pip6->ip6_daddr,16);
+	   sum += OnesSum(&pip6->ip6_daddr,16);
 	}
         /* Some extension headers present. Searching for routing header */
         else {
@@ -3418,14 +3701,14 @@ tcp_cksum(
 	   if(!ret) {  /* Found the routing header */
 	      if(pipv6_ext->ip6ext_len >= 2) { /* Sanity check */
 		 char *daddr = (char *)((char *)pipv6_ext + 8 + ((pipv6_ext->ip6ext_len - 2) * 8));
-		 sum += cksum(&daddr,16);
+		 sum += OnesSum(daddr,16);
 	      }
 	      else {  /* Not a valid routing header */
 		 return(-1);
 	      }
 	   }
 	   else {  /* Routing header not found */
-	      sum += cksum(&pip6->ip6_daddr,16);
+	      sum += OnesSum(&pip6->ip6_daddr,16);
 	   }
 	}
        
@@ -3448,7 +3731,7 @@ tcp_cksum(
     }
 
     /* checksum the TCP header and data */
-    sum += cksum(ptcp,tcp_length);
+    sum += OnesSum(ptcp,tcp_length);
 
     /* roll down into a 16-bit number */
     sum = (sum >> 16) + (sum & 0xffff);
@@ -3487,7 +3770,7 @@ udp_cksum(
 
     if (PIP_ISV4(pip)) {
 	/* 2 4-byte numbers, next to each other */
-	sum += cksum(&pip->ip_src,4*2);
+	sum += OnesSum(&pip->ip_src,4*2);
 
 	/* type */
 	sum += (u_short) pip->ip_p;
@@ -3511,7 +3794,7 @@ udp_cksum(
        
         /* Forming the pseudo-header */
         /* source address */
-        sum += cksum(&pip6->ip6_saddr,16);
+        sum += OnesSum(&pip6->ip6_saddr,16);
        
         /* Looking for the destination address.
 	 * May be in the IPv6 header or the last address in the 
@@ -3520,7 +3803,7 @@ udp_cksum(
        
         /* No extension headers, hence, routing header not present */
         if(pip6->ip6_nheader == IPPROTO_UDP) {
-	   sum += cksum(&pip6->ip6_daddr,16);
+	   sum += OnesSum(&pip6->ip6_daddr,16);
 	}
         /* Some extension headers present. Searching for routing header */
         else {
@@ -3533,14 +3816,14 @@ udp_cksum(
 	   if(!ret) {  /* Found the routing header */
 	      if(pipv6_ext->ip6ext_len >= 2) { /* Sanity check */
 		 char *daddr = (char *)((char *)pipv6_ext + 8 + ((pipv6_ext->ip6ext_len - 2) * 8));
-		 sum += cksum(&daddr,16);
+		 sum += OnesSum(daddr,16);
 	      }
 	      else {  /* Not a valid routing header */
 		 return(-1);
 	      }
 	   }
 	   else {  /* Routing header not found */
-	      sum += cksum(&pip6->ip6_daddr,16);
+	      sum += OnesSum(&pip6->ip6_daddr,16);
 	   }
 	}
        
@@ -3559,7 +3842,7 @@ udp_cksum(
     }
 
     /* checksum the UDP header and data */
-    sum += cksum(pudp,udp_length);
+    sum += OnesSum(pudp,udp_length);
 
     /* roll down into a 16-bit number */
     sum = (sum >> 16) + (sum & 0xffff);
@@ -61,10 +61,14 @@ static char const GCC_UNUSED rcsid[] =
 #include "gcache.h"
 
 /* locally global variables */
-static int packet_count = 0;
-static int search_count = 0;
 static Bool *ignore_pairs = NULL;/* which ones will we ignore */
 static Bool more_conns_ignored = FALSE;
+static int num_removed_udp_pairs = 0;
+
+/* in real-time mode, flows by most recent use (for aging them out) */
+static udp_pair *live_udp_list_head = NULL;
+static udp_pair *live_udp_list_tail = NULL;
+static timeval last_udp_update_time = {0, 0};
 
 
 
@@ -79,6 +83,10 @@ u_long udp_trace_count = 0;
 static udp_pair *NewUTP(struct ip *, struct udphdr *);
 static udp_pair *FindUTP(struct ip *, struct udphdr *, int *);
 static void MoreUdpPairs(int num_needed);
+static char *UdpConnStrdup(udp_pair *pup, char *str);
+static void UdpListUnlink(udp_pair *pup);
+static void UdpListPush(udp_pair *pup);
+static void RemoveOldUdpConns(void);
 
 
 
@@ -101,9 +109,16 @@ NewUTP(
     }
 
     /* create a new UDP pair record and remember where you put it */
-    utp[num_udp_pairs] = pup;
+    /* (not in real-time mode, where it won't live to be printed) */
+    if (!run_continuously)
+	utp[num_udp_pairs] = pup;
     pup->ignore_pair=ignore_pairs[num_udp_pairs];
 
+    /* in real-time mode, the flow's memory comes from an arena of its */
+    /* own that goes away with it (see UdpConnAlloc()) */
+    if (run_continuously)
+	pup->parena = ArenaCreate(UDP_CONN_ARENA_SIZE);
+
 
     /* grab the address from this packet */
     CopyAddr(&pup->addr_pair,
@@ -116,18 +131,18 @@ NewUTP(
     pup->b2a.ptwin = &pup->a2b;
 
     /* fill in connection name fields */
-    pup->a2b.host_letter = strdup(NextHostLetter());
-    pup->b2a.host_letter = strdup(NextHostLetter());
-    pup->a_hostname = strdup(HostName(pup->addr_pair.a_address));
-    pup->a_portname = strdup(ServiceName(pup->addr_pair.a_port));
+    pup->a2b.host_letter = UdpConnStrdup(pup,NextHostLetter());
+    pup->b2a.host_letter = UdpConnStrdup(pup,NextHostLetter());
+    pup->a_hostname = UdpConnStrdup(pup,HostName(pup->addr_pair.a_address));
+    pup->a_portname = UdpConnStrdup(pup,ServiceName(pup->addr_pair.a_port));
     pup->a_endpoint =
-	strdup(EndpointName(pup->addr_pair.a_address,
-			    pup->addr_pair.a_port));
-    pup->b_hostname = strdup(HostName(pup->addr_pair.b_address));
-    pup->b_portname = strdup(ServiceName(pup->addr_pair.b_port));
+	UdpConnStrdup(pup,EndpointName(pup->addr_pair.a_address,
+				       pup->addr_pair.a_port));
+    pup->b_hostname = UdpConnStrdup(pup,HostName(pup->addr_pair.b_address));
+    pup->b_portname = UdpConnStrdup(pup,ServiceName(pup->addr_pair.b_port));
     pup->b_endpoint = 
-	strdup(EndpointName(pup->addr_pair.b_address,
-			    pup->addr_pair.b_port));
+	UdpConnStrdup(pup,EndpointName(pup->addr_pair.b_address,
+				       pup->addr_pair.b_port));
 
     pup->filename = cur_filename;
 
@@ -136,61 +151,128 @@ NewUTP(
 
 
 
-/* connection records are stored in a hash table.  Buckets are linked	*/
-/* lists sorted by most recent access.					*/
-#define HASH_TABLE_SIZE 1021  /* oughta be prime */
+/* flow records are indexed by a snapshot of their addresses, kept */
+/* in a growable hash table (see conntab.c)			     */
 static udp_pair *
 FindUTP(
     struct ip *pip,
     struct udphdr *pudp,
     int *pdir)
 {
-    static udp_pair *pup_hashtable[HASH_TABLE_SIZE] = {NULL};
-    udp_pair **ppup_head = NULL;
+    udp_pair_addrblock tp_in;
+    ptp_snap *psnap;
     udp_pair *pup;
-    udp_pair *pup_last;
-    udp_pair tp_in;
     int dir;
-    hash hval;
 
     /* grab the address from this packet */
-    CopyAddr(&tp_in.addr_pair, pip,
+    CopyAddr(&tp_in, pip,
 	     ntohs(pudp->uh_sport), ntohs(pudp->uh_dport));
 
-    /* grab the hash value (already computed by CopyAddr) */
-    hval = tp_in.addr_pair.hash % HASH_TABLE_SIZE;
-    
-
-    pup_last = NULL;
-    ppup_head = &pup_hashtable[hval];
-    for (pup = *ppup_head; pup; pup=pup->next) {
-	++search_count;
-	if (SameConn(&tp_in.addr_pair,&pup->addr_pair,&dir)) {
-	    /* move to head of access list (unless already there) */
-	    if (pup != *ppup_head) {
-		pup_last->next = pup->next; /* unlink */
-		pup->next = *ppup_head;	    /* move to head */
-		*ppup_head = pup;
-	    }
-	    *pdir = dir;
-	    return(pup);
-	}
-	pup_last = pup;
+    /* see if the index already holds this flow, in either direction */
+    if ((psnap = UdpSnapFind(&tp_in, &dir)) != NULL) {
+	*pdir = dir;
+	return((udp_pair *)psnap->ptp);
     }
 
     /* Didn't find it, make a new one, if possible */
     pup = NewUTP(pip,pudp);
 
-    /* put at the head of the access list */
-    if (pup) {
-	pup->next = *ppup_head;
-	*ppup_head = pup;
-    }
+    if (pup)
+	UdpSnapInsert(&pup->addr_pair, pup);
 
     *pdir = A2B;
     return(pup);
 }
-     
+
+
+
+/* give out memory that lives exactly as long as the flow (see */
+/* ConnAlloc() in trace.c for the TCP version) */
+void *
+UdpConnAlloc(
+    udp_pair *pup,
+    unsigned bytes)
+{
+    if (pup->parena)
+	return(ArenaAlloc(pup->parena,bytes));
+    return(RunAlloc(bytes));
+}
+
+
+static char *
+UdpConnStrdup(
+    udp_pair *pup,
+    char *str)
+{
+    if (pup->parena)
+	return(ArenaStrdup(pup->parena,str));
+    return(RunStrdup(str));
+}
+
+
+
+/* take a flow out of the list of flows by use */
+static void
+UdpListUnlink(
+    udp_pair *pup)
+{
+    if (pup->prev)
+	pup->prev->next = pup->next;
+    else
+	live_udp_list_head = pup->next;
+
+    if (pup->next)
+	pup->next->prev = pup->prev;
+    else
+	live_udp_list_tail = pup->prev;
+
+    pup->next = pup->prev = NULL;
+}
+
+
+/* put a flow at the head (most recently used end) of the list */
+static void
+UdpListPush(
+    udp_pair *pup)
+{
+    pup->prev = NULL;
+    pup->next = live_udp_list_head;
+    if (live_udp_list_head)
+	live_udp_list_head->prev = pup;
+    else
+	live_udp_list_tail = pup;
+    live_udp_list_head = pup;
+}
+
+
+/* real-time mode: get rid of the flows that have been idle too long */
+/* (the list is sorted by last use, so they're all at the tail)      */
+static void
+RemoveOldUdpConns(void)
+{
+    udp_pair *pup;
+
+    while ((pup = live_udp_list_tail) != NULL) {
+	if ((elapsed(pup->last_time, current_time) / 1000000) <
+	    remove_udp_conn_interval)
+	    break;
+
+	if (debug > 4)
+	    printf("RemoveOldUdpConns: removing %s<->%s\n",
+		   pup->a_endpoint, pup->b_endpoint);
+
+	UdpListUnlink(pup);
+	ModulesPerOldUDPConn(pup);
+	UdpSnapRemove(&pup->addr_pair);
+
+	/* the names and module records all go at once */
+	ArenaFree(pup->parena);
+	FreeUdpPair(pup);
+	++num_removed_udp_pairs;
+    }
+}
+
+
 void IgnoreUDPConn(
 		   int ix)
 {
@@ -239,10 +321,7 @@ udpdotrace(
     udp_pair	*pup_save;
     ucb		*thisdir;
     ucb		*otherdir;
-    udp_pair	tp_in;
     int		dir;
-    u_short	uh_sport;	/* source port */
-    u_short	uh_dport;	/* destination port */
     u_short	uh_ulen;	/* data length */
 
     /* make sure we have enough of the packet */
@@ -257,15 +336,11 @@ udpdotrace(
 
 
     /* convert interesting fields to local byte order */
-    uh_sport = ntohs(pudp->uh_sport);
-    uh_dport = ntohs(pudp->uh_dport);
     uh_ulen = ntohs(pudp->uh_ulen);
 
     /* make sure this is one of the connections we want */
     pup_save = FindUTP(pip,pudp,&dir);
 
-    ++packet_count;
-
     if (pup_save == NULL) {
 	return(NULL);
     }
@@ -278,6 +353,21 @@ udpdotrace(
     }
     pup_save->last_time = current_time;
 
+    /* in real-time mode, keep the flows in order of use and every */
+    /* so often age out the idle ones */
+    if (run_continuously) {
+	if (pup_save != live_udp_list_head) {
+	    if (pup_save->packets != 0)
+		UdpListUnlink(pup_save);
+	    UdpListPush(pup_save);
+	}
+	if ((elapsed(last_udp_update_time, current_time) / 1000000) >=
+	    update_interval) {
+	    RemoveOldUdpConns();
+	    last_udp_update_time = current_time;
+	}
+    }
+
     // Lets not waste any more CPU cycles if we are ignoring this connection.
     if (pup_save->ignore_pair)
 	  return (pup_save);
@@ -296,10 +386,6 @@ udpdotrace(
 		    pip,plast,NULL);
     }
 
-    /* grab the address from this packet */
-    CopyAddr(&tp_in.addr_pair, pip,
-	     uh_sport, uh_dport);
-
     /* figure out which direction this packet is going */
     if (dir == A2B) {
 	thisdir  = &pup_save->a2b;
@@ -360,9 +446,12 @@ udptrace_done(void)
 	      if (!warn_printtrunc)
 		   fprintf(stdout,"\t(use -w option to show details)\n");
 	 }
-	 if (debug>1)
-	      fprintf(stdout,"average search length: %d\n",
-		      search_count / packet_count);
+	 if (debug>1) {
+	      UdpSnapStats(comment);
+	      if (run_continuously)
+		   fprintf(stdout,"%sUDP flows aged out: %d\n",
+			   comment, num_removed_udp_pairs);
+	 }
 	 
 	 /* print each connection */
 	 if(!run_continuously) {